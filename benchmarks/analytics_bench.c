@@ -0,0 +1,118 @@
+/**
+ * @file analytics_bench.c
+ * @brief Dashboard polling benchmark for the analytics counters
+ *
+ * Builds a fleet spread over a number of cities with the counters attached, rents half of it with rentVehicle and
+ * moves some vehicles around. Then it answers "how many free trotinetes are there in each city" once by walking the
+ * vehicle list and many times through the counters, checks that both agree, and reports the queries per second of
+ * each.
+ *
+ * Usage: analytics_bench [vehicles] [cities] [queries]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../models/analytics.h"
+#include "../models/rentals.h"
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  int vehicles = argc > 1 ? atoi(argv[1]) : 100000;
+  int cities = argc > 2 ? atoi(argv[2]) : 50;
+  long queries = argc > 3 ? atol(argv[3]) : 10000000;
+
+  FleetStats *stats = createFleetStats();
+  attachFleetStats(stats);
+
+  VehicleList *vehicleList = NULL;
+  UserList *userList = NULL;
+  RentStore *rentStore = createRentStore();
+  User user = {0};
+  user.nif = 1;
+  user.wallet = 2000000000;
+  createUserList(&userList, user);
+
+  for (int i = 0; i < vehicles; i++)
+  {
+    Vehicle vehicle = {0};
+    sprintf(vehicle.registration, "V%d", i);
+    strcpy(vehicle.type, i % 3 == 0 ? "bicicleta" : "trotinete");
+    sprintf(vehicle.location, "city-%d", i % cities);
+    vehicle.battery = 100;
+    vehicle.cost = 1;
+    createVehicleList(&vehicleList, vehicle);
+  }
+
+  // the list is built by head insertion, so renting from the head keeps each search short
+  long long revenue = 0;
+  int index = 0;
+  Rent rent;
+  for (VehicleList *current = vehicleList; current != NULL; current = current->next, index++)
+  {
+    if (index % 2 == 0 && rentVehicle(current->vehicle.registration, 1, 10, current, userList, rentStore, &rent) == RENT_OK)
+      revenue += 10;
+    else if (index % 7 == 0 && index < 1000)
+      moveAndRechargeVehicle(&current, current->vehicle.registration, "city-0");
+  }
+
+  double start = now();
+  long long walked = 0;
+  for (int c = 0; c < cities; c++)
+  {
+    char city[50];
+    sprintf(city, "city-%d", c);
+    for (VehicleList *current = vehicleList; current != NULL; current = current->next)
+    {
+      if (!current->vehicle.isInUse && strcmp(current->vehicle.type, "trotinete") == 0 &&
+          strcmp(current->vehicle.location, city) == 0)
+        walked++;
+    }
+  }
+  double walkTime = (now() - start) / cities;
+
+  char (*names)[50] = malloc(cities * sizeof(*names));
+  for (int c = 0; c < cities; c++)
+    sprintf(names[c], "city-%d", c);
+
+  long long counted = 0;
+  for (int c = 0; c < cities; c++)
+    counted += countFleetVehicles(stats, names[c], "trotinete", false);
+
+  start = now();
+  long long sink = 0;
+  for (long q = 0; q < queries; q++)
+    sink += countFleetVehicles(stats, names[q % cities], "trotinete", false);
+  double queryTime = (now() - start) / queries;
+
+  long long booked = 0;
+  int64_t today = statsDay(time(NULL));
+  for (int c = 0; c < cities; c++)
+    booked += countFleetRevenue(stats, names[c], today);
+
+  printf("vehicles: %d  cities: %d  queries: %ld (%lld)\n", vehicles, cities, queries, sink);
+  printf("list walk:  %14.0f queries/s\n", 1 / walkTime);
+  printf("counters:   %14.0f queries/s\n", 1 / queryTime);
+  printf("free trotinetes: %lld (walk %lld)  revenue today: %lld (expected %lld)  %s\n", counted, walked, booked, revenue,
+         counted == walked && booked == revenue ? "OK" : "MISMATCH");
+
+  free(names);
+  destroyRentStore(rentStore);
+  destroyFleetStats(stats);
+  return counted == walked && booked == revenue ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file binformat_bench.c
+ * @brief Checksum and validation benchmark for the versioned binary file format
+ *
+ * Measures the CRC32C throughput against memcpy over the same buffer, then writes a users file in the versioned
+ * format and reads it back through the reader, which checks the CRC of every block, and compares the time with a
+ * plain read of the same bytes.
+ *
+ * Usage: binformat_bench [megabytes] [users] [file]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../models/binformat.h"
+#include "../models/user.h"
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 256;
+  int count = argc > 2 ? atoi(argv[2]) : 1000000;
+  char *fileName = argc > 3 ? argv[3] : "./binformat_bench.bin";
+  size_t bytes = megabytes << 20;
+
+  uint8_t *source = (uint8_t *)malloc(bytes);
+  uint8_t *copy = (uint8_t *)malloc(bytes);
+  if (source == NULL || copy == NULL)
+  {
+    perror("could not allocate memory!");
+    return 1;
+  }
+  for (size_t i = 0; i < bytes; i++)
+    source[i] = (uint8_t)(i * 2654435761u >> 13);
+  memcpy(copy, source, bytes); // touch every page before timing
+
+  double start = now();
+  memcpy(copy, source, bytes);
+  double copyTime = now() - start;
+  start = now();
+  uint32_t crc = crc32c(0, source, bytes);
+  double crcTime = now() - start;
+  printf("crc32c (%s): %.2f GB/s  memcpy: %.2f GB/s  crc: %08x\n", crc32cHardwareAvailable() ? "sse4.2" : "tables",
+         bytes / crcTime / 1e9, bytes / copyTime / 1e9, crc ^ copy[bytes / 2] ^ source[bytes / 2]);
+  free(source);
+  free(copy);
+
+  UserList *users = NULL;
+  for (int i = count - 1; i >= 0; i--)
+  {
+    User user = {0};
+    user.nif = i + 1;
+    sprintf(user.name, "user-%d", i);
+    user.wallet = 100;
+    UserList *node = (UserList *)malloc(sizeof(UserList));
+    node->user = user;
+    node->next = users;
+    users = node;
+  }
+
+  FILE *pFile = fopen(fileName, "wb");
+  if (pFile == NULL)
+  {
+    perror("could not open the file!");
+    return 1;
+  }
+  BinWriter writer;
+  uint8_t record[USER_RECORD_SIZE] = {0};
+  bool ok = openBinWriter(&writer, pFile, BIN_USERS, USER_RECORD_SIZE);
+  for (UserList *node = users; ok && node != NULL; node = node->next)
+  {
+    putU32(record, (uint32_t)node->user.nif);
+    putString(record + 4, node->user.name, sizeof(node->user.name));
+    ok = binWrite(&writer, record);
+  }
+  ok = closeBinWriter(&writer) && ok;
+  long fileSize = ftell(pFile);
+  fclose(pFile);
+
+  // the first pass brings the file into the OS page cache, so both timed passes read from memory
+  uint8_t *buffer = (uint8_t *)malloc(fileSize);
+  pFile = fopen(fileName, "rb");
+  ok = ok && fread(buffer, fileSize, 1, pFile) == 1;
+  rewind(pFile);
+  start = now();
+  ok = ok && fread(buffer, fileSize, 1, pFile) == 1;
+  double rawTime = now() - start;
+
+  rewind(pFile);
+  BinReader reader;
+  long read = 0;
+  start = now();
+  if (openBinReader(&reader, pFile, BIN_USERS, USER_RECORD_SIZE) == BIN_FORMAT_VERSIONED)
+  {
+    while (binRead(&reader) != NULL)
+      read++;
+  }
+  double validateTime = now() - start;
+  ok = ok && !reader.corrupt && read == count;
+  closeBinReader(&reader);
+  fclose(pFile);
+  free(buffer);
+  unlink(fileName);
+
+  printf("file: %ld bytes  raw read: %.2f GB/s  validated read: %.2f GB/s  records: %ld  %s\n", fileSize,
+         fileSize / rawTime / 1e9, fileSize / validateTime / 1e9, read, ok ? "OK" : "FAILED");
+
+  while (users != NULL)
+  {
+    UserList *next = users->next;
+    free(users);
+    users = next;
+  }
+  return ok ? 0 : 1;
+}
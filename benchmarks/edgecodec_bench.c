@@ -0,0 +1,244 @@
+/**
+ * @file edgecodec_bench.c
+ * @brief Size and load benchmark for the compressed edge file
+ *
+ * Builds a synthetic road-like graph (5M vertices with 10 edges each by default, 50M edges), where most edges link
+ * vertices with close cods and the weights are distances with two decimals, or come from a small set of values
+ * when [distinct weights] is given. The graph is saved in the 12 byte edge records of the versioned binary format
+ * and in the compressed edge file, then both are loaded into adjacency arrays: cold, with the files dropped from
+ * the OS page cache, and warm. The decoded graph is checked against the original, and random lookups of a single
+ * adjacency list are timed.
+ *
+ * Usage: edgecodec_bench [vertices] [edges per vertex] [distinct weights] [directory]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../models/binformat.h"
+#include "../models/edgecodec.h"
+
+#define LOOKUPS 1000000
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Flushes a file to disk and drops it from the OS page cache
+ *
+ * @param fileName The path of the file
+ * @return The size of the file
+ */
+static long dropFromCache(char *fileName)
+{
+  int fd = open(fileName, O_RDONLY);
+  long size = lseek(fd, 0, SEEK_END);
+  fsync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+  return size;
+}
+
+/**
+ * @brief Saves the graph as 12 byte edge records
+ *
+ * @param fileName The path of the file
+ * @param arrays A pointer to the adjacency lists
+ * @return True if the file was written, false otherwise
+ */
+static bool writeRecords(char *fileName, EdgeArrays *arrays)
+{
+  FILE *fp = fopen(fileName, "wb");
+  BinWriter writer;
+  uint8_t record[EDGE_RECORD_SIZE];
+  bool ok = fp != NULL && openBinWriter(&writer, fp, BIN_EDGES, EDGE_RECORD_SIZE);
+
+  for (int v = 0; ok && v < arrays->vertexCount; v++)
+  {
+    for (int64_t e = arrays->offsets[v]; ok && e < arrays->offsets[v + 1]; e++)
+    {
+      putU32(record, (uint32_t)arrays->cods[v]);
+      putU32(record + 4, (uint32_t)arrays->targets[e]);
+      putF32(record + 8, arrays->weights[e]);
+      ok = binWrite(&writer, record);
+    }
+  }
+  ok = ok && closeBinWriter(&writer);
+  return fp != NULL && fclose(fp) == 0 && ok;
+}
+
+/**
+ * @brief Loads the 12 byte edge records into adjacency arrays
+ *
+ * @param fileName The path of the file
+ * @param arrays Receives the adjacency lists
+ * @param vertexCount The number of vertices of the graph
+ * @param edgeCount The number of edges of the graph
+ * @return True if every record was read, false otherwise
+ */
+static bool readRecords(char *fileName, EdgeArrays *arrays, int vertexCount, int64_t edgeCount)
+{
+  FILE *fp = fopen(fileName, "rb");
+  BinReader reader;
+  const uint8_t *record;
+  int64_t e = 0;
+  int v = -1;
+
+  arrays->cods = (int *)malloc((vertexCount + 1) * sizeof(int));
+  arrays->offsets = (int64_t *)malloc((vertexCount + 1) * sizeof(int64_t));
+  arrays->targets = (int *)malloc(edgeCount * sizeof(int));
+  arrays->weights = (float *)malloc(edgeCount * sizeof(float));
+  if (fp == NULL || openBinReader(&reader, fp, BIN_EDGES, EDGE_RECORD_SIZE) != BIN_FORMAT_VERSIONED)
+    return false;
+  while ((record = binRead(&reader)) != NULL && e < edgeCount)
+  {
+    int origin = (int)getU32(record);
+    if (v < 0 || arrays->cods[v] != origin)
+    {
+      if (++v == vertexCount)
+        break;
+      arrays->cods[v] = origin;
+      arrays->offsets[v] = e;
+    }
+    arrays->targets[e] = (int)getU32(record + 4);
+    arrays->weights[e] = getF32(record + 8);
+    e++;
+  }
+  bool ok = !reader.corrupt && e == edgeCount;
+  closeBinReader(&reader);
+  fclose(fp);
+  arrays->offsets[v + 1] = e;
+  arrays->vertexCount = v + 1;
+  arrays->edgeCount = e;
+  return ok;
+}
+
+/**
+ * @brief Checks decoded adjacency lists against the original ones
+ *
+ * @param original A pointer to the original lists
+ * @param decoded A pointer to the decoded lists
+ * @param tolerance The largest difference allowed between two weights
+ * @return True if the lists match, false otherwise
+ */
+static bool sameEdges(EdgeArrays *original, EdgeArrays *decoded, float tolerance)
+{
+  if (original->vertexCount != decoded->vertexCount || original->edgeCount != decoded->edgeCount)
+    return false;
+  for (int v = 0; v < original->vertexCount; v++)
+    if (original->cods[v] != decoded->cods[v] || original->offsets[v + 1] != decoded->offsets[v + 1])
+      return false;
+  for (int64_t e = 0; e < original->edgeCount; e++)
+  {
+    float difference = original->weights[e] - decoded->weights[e];
+    if (original->targets[e] != decoded->targets[e] || difference > tolerance || difference < -tolerance)
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int vertexCount = argc > 1 ? atoi(argv[1]) : 5000000;
+  int degree = argc > 2 ? atoi(argv[2]) : 10;
+  int distinct = argc > 3 ? atoi(argv[3]) : 0;
+  char *directory = argc > 4 ? argv[4] : ".";
+  char rawFile[512];
+  char compressedFile[512];
+  snprintf(rawFile, sizeof(rawFile), "%s/edgecodec_bench.raw", directory);
+  snprintf(compressedFile, sizeof(compressedFile), "%s/edgecodec_bench.edges", directory);
+
+  EdgeArrays graph;
+  int64_t edgeCount = (int64_t)vertexCount * degree;
+  unsigned int seed = 3;
+  graph.vertexCount = vertexCount;
+  graph.edgeCount = edgeCount;
+  graph.cods = (int *)malloc(vertexCount * sizeof(int));
+  graph.offsets = (int64_t *)malloc((vertexCount + 1) * sizeof(int64_t));
+  graph.targets = (int *)malloc(edgeCount * sizeof(int));
+  graph.weights = (float *)malloc(edgeCount * sizeof(float));
+  if (graph.cods == NULL || graph.offsets == NULL || graph.targets == NULL || graph.weights == NULL)
+  {
+    perror("could not allocate memory!");
+    return 1;
+  }
+  for (int v = 0; v < vertexCount; v++)
+  {
+    graph.cods[v] = v;
+    graph.offsets[v] = (int64_t)v * degree;
+    for (int64_t e = graph.offsets[v]; e < graph.offsets[v] + degree; e++)
+    {
+      // nine roads in ten lead to a city with a close cod
+      int target = rand_r(&seed) % 10 != 0 ? v + rand_r(&seed) % 4001 - 2000 : rand_r(&seed) % vertexCount;
+      graph.targets[e] = target < 0 ? -target : target >= vertexCount ? 2 * vertexCount - 1 - target : target;
+      graph.weights[e] = distinct > 0 ? 0.5f * (1 + rand_r(&seed) % distinct) : (1 + rand_r(&seed) % 20000) / 100.0f;
+    }
+  }
+  graph.offsets[vertexCount] = edgeCount;
+
+  double start = now();
+  bool ok = writeEdgeFile(compressedFile, &graph);
+  double encodeTime = now() - start;
+  ok = writeRecords(rawFile, &graph) && ok;
+  long rawSize = dropFromCache(rawFile);
+  long compressedSize = dropFromCache(compressedFile);
+  printf("edges: %lld  records: %.1f MB (%.2f bytes/edge)  compressed: %.1f MB (%.2f bytes/edge)  ratio: %.2fx\n",
+         (long long)edgeCount, rawSize / 1e6, (double)rawSize / edgeCount, compressedSize / 1e6,
+         (double)compressedSize / edgeCount, (double)rawSize / compressedSize);
+  printf("encode: %.3f s  %.1f M edges/s\n", encodeTime, edgeCount / encodeTime / 1e6);
+
+  for (int pass = 0; pass < 2 && ok; pass++)
+  {
+    const char *label = pass == 0 ? "cold" : "warm";
+    EdgeArrays loaded = {0};
+
+    start = now();
+    ok = readRecords(rawFile, &loaded, vertexCount, edgeCount);
+    double rawTime = now() - start;
+    ok = ok && sameEdges(&graph, &loaded, 0);
+    freeEdgeArrays(&loaded);
+
+    start = now();
+    EdgeFile *file = openEdgeFile(compressedFile);
+    ok = ok && file != NULL && edgeFileDecode(file, &loaded);
+    double compressedTime = now() - start;
+    closeEdgeFile(file);
+    ok = ok && sameEdges(&graph, &loaded, distinct > 0 ? 0 : 0.5f / EDGE_WEIGHT_SCALE + 1e-3f);
+    freeEdgeArrays(&loaded);
+
+    printf("%s load  records: %.3f s  %6.1f M edges/s   compressed: %.3f s  %6.1f M edges/s  %.2fx\n", label,
+           rawTime, edgeCount / rawTime / 1e6, compressedTime, edgeCount / compressedTime / 1e6,
+           rawTime / compressedTime);
+  }
+
+  EdgeFile *file = openEdgeFile(compressedFile);
+  int targets[256];
+  float weights[256];
+  long found = 0;
+  start = now();
+  for (int i = 0; file != NULL && i < LOOKUPS; i++)
+    found += edgeFileNeighbours(file, rand_r(&seed) % vertexCount, targets, weights, 256) == degree;
+  double lookupTime = now() - start;
+  closeEdgeFile(file);
+  ok = ok && found == LOOKUPS;
+  printf("random list lookups: %.0f ns each  %s\n", lookupTime / LOOKUPS * 1e9, ok ? "OK" : "FAILED");
+
+  unlink(rawFile);
+  unlink(compressedFile);
+  freeEdgeArrays(&graph);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,323 @@
+/**
+ * @file graphstore_bench.c
+ * @brief Benchmark of route queries while the distances of the roads change, versioned graph against a lock
+ *
+ * Reader threads compute shortest paths between random cities for a few seconds while one writer changes the
+ * distance of random roads as fast as it can. It runs three times:
+ * - versioned, no writer: the readers alone on the versioned graph
+ * - versioned: the readers pin a version per query and the writer publishes a new version per change
+ * - rwlock: the readers hold a read lock per query and the writer changes the roads in place under the write lock
+ * It reports the queries per second and the p50, p99 and maximum query latency of the readers, and the changes per
+ * second of the writer. Every 16th query the reader also sums the roads of its graph before and after the query,
+ * and the sums must match: a reader never sees a graph change under it.
+ *
+ * Usage: graphstore_bench [readers] [seconds] [vertices]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "../models/graphstore.h"
+#include "../models/memstats.h"
+
+#define DEGREE 4        // roads from every city
+#define MAX_ROAD 10     // longest road
+#define NEIGHBOURHOOD 8 // roads go to one of the next NEIGHBOURHOOD cities, so routes are long
+#define CHECK_EVERY 16  // queries between two checks that the graph did not change under the reader
+#define MAX_SAMPLES 1000000
+
+typedef enum BenchMode
+{
+  MODE_VERSIONED_ALONE,
+  MODE_VERSIONED,
+  MODE_RWLOCK
+} BenchMode;
+
+typedef struct Fixture
+{
+  BenchMode mode;
+  GraphStore *store;
+  Vertex *graph; // of the rwlock mode
+  pthread_rwlock_t lock;
+  int vertexCount;
+  bool stopping;
+} Fixture;
+
+typedef struct Reader
+{
+  pthread_t thread;
+  Fixture *fixture;
+  unsigned int seed;
+  long long queries;
+  long long violations;
+  double *latencies; // us
+  long samples;
+} Reader;
+
+typedef struct Writer
+{
+  pthread_t thread;
+  Fixture *fixture;
+  unsigned int seed;
+  long long changes;
+} Writer;
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Sums the distances of every road of a graph
+ *
+ * @param graph The graph
+ * @return The sum
+ */
+static double sumRoads(Vertex *graph)
+{
+  double sum = 0;
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+    for (Adj *adj = vertex->adjacents; adj != NULL; adj = adj->next)
+      sum += adj->dist;
+  return sum;
+}
+
+/**
+ * @brief Thread body of a reader: shortest paths between random cities until the run stops
+ *
+ * @param arg A pointer to the Reader
+ * @return NULL
+ */
+static void *runReader(void *arg)
+{
+  Reader *reader = (Reader *)arg;
+  Fixture *fixture = reader->fixture;
+  GraphReader *slot = fixture->mode != MODE_RWLOCK ? graphStoreReader(fixture->store) : NULL;
+  int length;
+
+  while (!__atomic_load_n(&fixture->stopping, __ATOMIC_RELAXED))
+  {
+    int origin = rand_r(&reader->seed) % fixture->vertexCount;
+    int dest = rand_r(&reader->seed) % fixture->vertexCount;
+    bool isChecked = reader->queries % CHECK_EVERY == 0;
+    double start = now();
+
+    Vertex *graph;
+    if (fixture->mode == MODE_RWLOCK)
+    {
+      pthread_rwlock_rdlock(&fixture->lock);
+      graph = fixture->graph;
+    }
+    else
+    {
+      graph = pinGraph(fixture->store, slot)->graph;
+    }
+    double before = isChecked ? sumRoads(graph) : 0;
+    shortestPath(graph, origin, dest, NULL, 0, &length);
+    if (isChecked && sumRoads(graph) != before)
+      reader->violations++;
+    if (fixture->mode == MODE_RWLOCK)
+      pthread_rwlock_unlock(&fixture->lock);
+    else
+      unpinGraph(slot);
+
+    if (reader->samples < MAX_SAMPLES)
+      reader->latencies[reader->samples++] = (now() - start) * 1e6;
+    reader->queries++;
+  }
+  releaseGraphReader(slot);
+  return NULL;
+}
+
+/**
+ * @brief Thread body of the writer: changes the distance of random roads until the run stops
+ *
+ * @param arg A pointer to the Writer
+ * @return NULL
+ */
+static void *runWriter(void *arg)
+{
+  Writer *writer = (Writer *)arg;
+  Fixture *fixture = writer->fixture;
+  bool res;
+
+  while (!__atomic_load_n(&fixture->stopping, __ATOMIC_RELAXED))
+  {
+    int origin = rand_r(&writer->seed) % fixture->vertexCount;
+    int dest = (origin + 1 + rand_r(&writer->seed) % NEIGHBOURHOOD) % fixture->vertexCount;
+    float distance = (float)(1 + rand_r(&writer->seed) % MAX_ROAD);
+    if (fixture->mode == MODE_RWLOCK)
+    {
+      pthread_rwlock_wrlock(&fixture->lock);
+      fixture->graph = setAdjacentDistanceCod(fixture->graph, origin, dest, distance, &res);
+      pthread_rwlock_unlock(&fixture->lock);
+    }
+    else
+    {
+      res = graphStoreSetDistance(fixture->store, origin, dest, distance);
+    }
+    writer->changes += res;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Compares two latencies for qsort
+ *
+ * @param a A pointer to the first latency
+ * @param b A pointer to the second latency
+ * @return Negative, zero or positive as a is smaller than, equal to or larger than b
+ */
+static int compareLatencies(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Builds a graph of cities linked to the next ones by roads of random lengths
+ *
+ * @param vertexCount The number of cities
+ * @return The graph
+ */
+static Vertex *buildGraph(int vertexCount)
+{
+  Vertex *graph = createRoute();
+  unsigned int seed = 1234;
+  bool res;
+  for (int i = vertexCount - 1; i >= 0; i--)
+  {
+    char city[N];
+    sprintf(city, "Cidade%07d", i);
+    graph = insertRouteVertex(graph, createRouteVertex(city, i), &res);
+  }
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+    for (int j = 0; j < DEGREE; j++)
+    {
+      int neighbour = (vertex->cod + 1 + rand_r(&seed) % NEIGHBOURHOOD) % vertexCount;
+      float distance = (float)(1 + rand_r(&seed) % MAX_ROAD);
+      if (!existAdj(vertex->adjacents, neighbour))
+        vertex->adjacents = insertAdj(vertex->adjacents, createAdj(neighbour, distance), &res);
+    }
+  return graph;
+}
+
+/**
+ * @brief Runs the readers, and the writer unless alone, for a number of seconds and prints a line of the report
+ *
+ * @param mode The mode
+ * @param readerCount The number of reader threads
+ * @param seconds The duration of the run
+ * @param vertexCount The number of cities
+ * @return True if no reader saw its graph change under it, false otherwise
+ */
+static bool runMode(BenchMode mode, int readerCount, double seconds, int vertexCount)
+{
+  static const char *modeNames[] = {"versioned, no writer", "versioned", "rwlock"};
+  Fixture fixture = {0};
+  fixture.mode = mode;
+  fixture.vertexCount = vertexCount;
+  if (mode == MODE_RWLOCK)
+  {
+    fixture.graph = buildGraph(vertexCount);
+    pthread_rwlock_init(&fixture.lock, NULL);
+  }
+  else
+  {
+    fixture.store = createGraphStore(buildGraph(vertexCount));
+  }
+
+  Reader *readers = (Reader *)calloc(readerCount, sizeof(Reader));
+  Writer writer = {0};
+  for (int i = 0; i < readerCount; i++)
+  {
+    readers[i].fixture = &fixture;
+    readers[i].seed = 1234 + i;
+    readers[i].latencies = (double *)malloc(MAX_SAMPLES * sizeof(double));
+    pthread_create(&readers[i].thread, NULL, runReader, &readers[i]);
+  }
+  writer.fixture = &fixture;
+  writer.seed = 99;
+  if (mode != MODE_VERSIONED_ALONE)
+    pthread_create(&writer.thread, NULL, runWriter, &writer);
+
+  struct timespec pause = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+  nanosleep(&pause, NULL);
+  __atomic_store_n(&fixture.stopping, true, __ATOMIC_RELAXED);
+  if (mode != MODE_VERSIONED_ALONE)
+    pthread_join(writer.thread, NULL);
+
+  long long queries = 0, violations = 0;
+  long samples = 0;
+  double *latencies = (double *)malloc((long)readerCount * MAX_SAMPLES * sizeof(double));
+  for (int i = 0; i < readerCount; i++)
+  {
+    pthread_join(readers[i].thread, NULL);
+    queries += readers[i].queries;
+    violations += readers[i].violations;
+    memcpy(latencies + samples, readers[i].latencies, readers[i].samples * sizeof(double));
+    samples += readers[i].samples;
+    free(readers[i].latencies);
+  }
+  qsort(latencies, samples, sizeof(double), compareLatencies);
+
+  printf("%-22s %12.0f %10.1f %10.1f %10.1f %12.0f %10lld", modeNames[mode], queries / seconds,
+         samples > 0 ? latencies[(long)((samples - 1) * 0.50)] : 0, samples > 0 ? latencies[(long)((samples - 1) * 0.99)] : 0,
+         samples > 0 ? latencies[samples - 1] : 0, writer.changes / seconds, violations);
+  if (mode == MODE_RWLOCK)
+  {
+    printf("\n");
+    destroyRoutes(fixture.graph);
+    pthread_rwlock_destroy(&fixture.lock);
+  }
+  else
+  {
+    GraphStoreStats stats;
+    graphStoreReclaim(fixture.store);
+    readGraphStoreStats(fixture.store, &stats);
+    printf("   versions %ld, reclaimed %lld, retired %d\n", stats.current, stats.reclaimed, stats.retired);
+    destroyGraphStore(fixture.store);
+  }
+  free(latencies);
+  free(readers);
+  return violations == 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int readerCount = argc > 1 ? atoi(argv[1]) : 4;
+  double seconds = argc > 2 ? atof(argv[2]) : 3;
+  int vertexCount = argc > 3 ? atoi(argv[3]) : 2000;
+  if (readerCount < 1 || seconds <= 0 || vertexCount < 2)
+  {
+    fprintf(stderr, "Usage: graphstore_bench [readers] [seconds] [vertices]\n");
+    return 2;
+  }
+
+  printf("readers: %d  seconds: %.1f  vertices: %d\n\n", readerCount, seconds, vertexCount);
+  printf("%-22s %12s %10s %10s %10s %12s %10s\n", "mode", "queries/s", "p50 us", "p99 us", "max us", "changes/s",
+         "violations");
+  bool ok = runMode(MODE_VERSIONED_ALONE, readerCount, seconds, vertexCount);
+  ok = runMode(MODE_VERSIONED, readerCount, seconds, vertexCount) && ok;
+  ok = runMode(MODE_RWLOCK, readerCount, seconds, vertexCount) && ok;
+
+  MemCounters vertices, edges;
+  memCounters(MEM_VERTICES, &vertices);
+  memCounters(MEM_EDGES, &edges);
+  printf("\nlive graph bytes after the runs: %lld\n", (long long)(vertices.liveBytes + edges.liveBytes));
+  ok = ok && vertices.liveBytes == 0 && edges.liveBytes == 0;
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file memory_bench.c
+ * @brief Memory benchmark for the stores, in bytes per record
+ *
+ * Fills the graph, fleet, users and rents with records whose strings have realistic lengths, creates and frees
+ * temporaries with createUser and createVehicle, and prints the memory report: the bytes of each subsystem, per
+ * record, next to the size of the structs and the unused chars of their fixed arrays. The numbers are the ones to
+ * compare between releases. Every store is then freed and each subsystem is checked to be back to zero live bytes.
+ *
+ * Usage: memory_bench [records per store] [vertices] [edges per vertex]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../models/memstats.h"
+
+int main(int argc, char *argv[])
+{
+  int count = argc > 1 ? atoi(argv[1]) : 1000000;
+  int vertexCount = argc > 2 ? atoi(argv[2]) : 100000;
+  int degree = argc > 3 ? atoi(argv[3]) : 4;
+
+  UserList *users = NULL;
+  VehicleList *vehicles = NULL;
+  RentStore *rentStore = createRentStore();
+  Vertex *graph = createRoute();
+  Vertex **vertices = (Vertex **)malloc((vertexCount + 1) * sizeof(Vertex *));
+  bool res;
+  if (rentStore == NULL || vertices == NULL)
+  {
+    perror("could not allocate memory!");
+    return 1;
+  }
+
+  for (int i = vertexCount - 1; i >= 0; i--)
+  {
+    char city[N];
+    sprintf(city, "Cidade%07d", i);
+    vertices[i] = createRouteVertex(city, i);
+    graph = insertRouteVertex(graph, vertices[i], &res);
+  }
+  for (int i = 0; i < vertexCount; i++)
+    for (int j = degree; j >= 1; j--)
+      vertices[i]->adjacents = insertAdj(vertices[i]->adjacents, createAdj((i + j) % vertexCount, (float)j), &res);
+  for (int i = 0; i < count; i++)
+  {
+    User user = {0};
+    user.nif = 200000000 + i;
+    sprintf(user.name, "Maria Ferreira %d", i % 1000);
+    sprintf(user.email, "maria.ferreira%d@mail.pt", i);
+    strcpy(user.password, "k3r9x2mq7a");
+    user.wallet = 20;
+    createUserList(&users, user);
+
+    Vehicle vehicle = {0};
+    sprintf(vehicle.registration, "%02d-%02d-%c%c", i / 100 % 100, i % 100, 'A' + i / 10000 % 26, 'A' + i / 260000 % 26);
+    strcpy(vehicle.type, i % 3 == 0 ? "bicicleta" : "trotinete");
+    strcpy(vehicle.location, vertices[i % vertexCount]->city);
+    vehicle.battery = 80;
+    vehicle.cost = 1;
+    createVehicleList(&vehicles, vehicle);
+
+    Rent rent = {0};
+    rent.id = nextRentId(rentStore);
+    strcpy(rent.vehicleRegistration, vehicle.registration);
+    rent.userNif = user.nif;
+    rent.timeInMinutes = 10;
+    createRentList(rentStore, rent);
+  }
+
+  // a user and a vehicle temporary are freed, another user is kept until after the report, which counts it
+  char text[50] = "temporary";
+  memFree(MEM_TEMPORARIES, createUser(1, text, text, 1, 1, text, 0, false));
+  memFree(MEM_TEMPORARIES, createVehicle(text, "trotinete", 1, 1, false, vertices[0]->city, graph));
+  User *leaked = createUser(2, text, text, 1, 1, text, 0, false);
+
+  printf("records per store: %d  vertices: %d  edges per vertex: %d\n\n", count, vertexCount, degree);
+  printMemoryReport(stdout, graph, users, vehicles, rentStore);
+
+  memFree(MEM_TEMPORARIES, leaked);
+  destroyRentStore(rentStore);
+  destroyRoutes(graph);
+  while (users != NULL)
+  {
+    UserList *next = users->next;
+    memFree(MEM_USERS, users);
+    users = next;
+  }
+  while (vehicles != NULL)
+  {
+    VehicleList *next = vehicles->next;
+    memFree(MEM_VEHICLES, vehicles);
+    vehicles = next;
+  }
+  free(vertices);
+
+  bool ok = true;
+  for (int tag = 0; tag <= MEM_TAGS; tag++)
+  {
+    MemCounters counters;
+    memCounters(tag, &counters);
+    ok = ok && counters.liveBytes == 0 && counters.allocations == counters.frees;
+  }
+  printf("\nevery subsystem back to zero live bytes after freeing the stores: %s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+/**
+ * @file pager_bench.c
+ * @brief Cold and warm load benchmark for the paged storage file
+ *
+ * Stores users, vehicles, rents and a graph in one storage file, then loads everything back three times: cold, with
+ * the file dropped from the OS page cache and a new pager; warm, through the same pager, whose cache already holds
+ * the pages; and through a pager with a cache of only a few pages, which has to stream every table through it. The
+ * cold and warm pager gets at least as many frames as the file has pages, so the warm load hits on every page. The
+ * loaded record counts are checked against what was stored, and a few records are looked up straight from the file.
+ *
+ * Then it checks that the file survives crashes. A child process replaces the tables through a cache of a few
+ * pages, so the new pages are written while it runs, and kills itself with SIGKILL before flushing: the old tables
+ * must load unchanged. The newest superblock is then overwritten with garbage, as if its write had been torn: the
+ * file must open with the tables of the superblock before it.
+ *
+ * Usage: pager_bench [records per table] [cache pages] [file]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../models/pager.h"
+#include "../models/rentals.h"
+#include "../models/memstats.h"
+
+#define GRAPH_VERTICES 1000
+#define GRAPH_EDGES_PER_VERTEX 5
+#define CRASH_CACHE_PAGES 8
+#define CRASH_WALLET 7
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Loads every table of a storage file and frees what was loaded
+ *
+ * @param pager A pointer to the storage file
+ * @return The number of records loaded
+ */
+static long loadAll(Pager *pager)
+{
+  UserList *users = NULL;
+  VehicleList *vehicles = NULL;
+  RentStore *rentStore = createRentStore();
+  Vertex *graph = createRoute();
+  bool res;
+  long records = 0;
+
+  loadUsersFromPager(pager, &users);
+  loadVehiclesFromPager(pager, &vehicles);
+  loadRentsFromPager(pager, rentStore);
+  graph = loadGraphFromPager(pager, graph, &res);
+
+  while (users != NULL)
+  {
+    UserList *next = users->next;
+    memFree(MEM_USERS, users);
+    users = next;
+    records++;
+  }
+  while (vehicles != NULL)
+  {
+    VehicleList *next = vehicles->next;
+    memFree(MEM_VEHICLES, vehicles);
+    vehicles = next;
+    records++;
+  }
+  records += rentStore->count;
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+  {
+    records++;
+    for (Adj *adj = vertex->adjacents; adj != NULL; adj = adj->next)
+      records++;
+  }
+
+  destroyRentStore(rentStore);
+  destroyRoutes(graph);
+  return records;
+}
+
+/**
+ * @brief Checks that every user of a storage file has the given wallet
+ *
+ * @param fileName The path of the file
+ * @param count The number of users expected
+ * @param wallet The wallet every user must have
+ * @return True if the file opens and holds count users with that wallet, false otherwise
+ */
+static bool checkUsers(char *fileName, int count, int wallet)
+{
+  Pager *pager = openPager(fileName, CRASH_CACHE_PAGES);
+  if (pager == NULL)
+  {
+    return false;
+  }
+  PagerCursor cursor;
+  User user;
+  int found = 0;
+  bool ok = pagerOpenCursor(pager, PAGER_USERS, sizeof(User), &cursor);
+  while (ok && pagerNext(&cursor, &user))
+  {
+    ok = user.wallet == wallet;
+    found++;
+  }
+  pagerCloseCursor(&cursor);
+  ok = ok && found == count && loadAll(pager) > 0;
+  return closePager(pager) && ok;
+}
+
+/**
+ * @brief Prints the time and cache counters of one load
+ *
+ * @param label The name of the run
+ * @param pager A pointer to the storage file
+ * @param seconds The time the load took
+ * @param records The number of records loaded
+ */
+static void report(const char *label, Pager *pager, double seconds, long records)
+{
+  printf("%-12s %8.3f s  %10.0f records/s  hits: %ld  misses: %ld  page reads: %ld\n", label, seconds,
+         records / seconds, pager->hits, pager->misses, pager->pageReads);
+  pager->hits = pager->misses = pager->pageReads = 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int count = argc > 1 ? atoi(argv[1]) : 100000;
+  int cachePages = argc > 2 ? atoi(argv[2]) : 16384;
+  char *fileName = argc > 3 ? argv[3] : "./pager_bench.db";
+
+  UserList *users = NULL;
+  VehicleList *vehicles = NULL;
+  RentStore *rentStore = createRentStore();
+  Vertex *graph = createRoute();
+  bool res;
+
+  for (int i = 0; i < count; i++)
+  {
+    User user = {0};
+    user.nif = i + 1;
+    sprintf(user.name, "user-%d", i);
+    user.wallet = 100;
+    createUserList(&users, user);
+
+    Vehicle vehicle = {0};
+    sprintf(vehicle.registration, "V%d", i);
+    strcpy(vehicle.type, "trotinete");
+    sprintf(vehicle.location, "city-%d", i % GRAPH_VERTICES);
+    vehicle.cost = 1;
+    createVehicleList(&vehicles, vehicle);
+
+    Rent rent = {0};
+    rent.id = i;
+    strcpy(rent.vehicleRegistration, vehicle.registration);
+    rent.userNif = user.nif;
+    rent.timeInMinutes = 10;
+    createRentList(rentStore, rent);
+  }
+  for (int i = GRAPH_VERTICES - 1; i >= 0; i--)
+  {
+    char city[N];
+    sprintf(city, "city-%04d", i);
+    graph = insertRouteVertex(graph, createRouteVertex(city, i), &res);
+  }
+  for (int i = 0; i < GRAPH_VERTICES; i++)
+    for (int j = 1; j <= GRAPH_EDGES_PER_VERTEX; j++)
+      graph = insertAdjacentVertexCod(graph, i, (i + j * 7) % GRAPH_VERTICES, (float)j, &res);
+  long stored = 3L * count + GRAPH_VERTICES + GRAPH_VERTICES * GRAPH_EDGES_PER_VERTEX;
+
+  unlink(fileName);
+  Pager *pager = openPager(fileName, cachePages);
+  if (pager == NULL)
+    return 1;
+  double start = now();
+  bool ok = storeUsersInPager(pager, users) && storeVehiclesInPager(pager, vehicles) &&
+            storeRentsInPager(pager, rentStore) && saveGraphInPager(pager, graph);
+  uint32_t pages = pager->super.pageCount;
+  ok = closePager(pager) && ok;
+  double storeTime = now() - start;
+  printf("records: %ld  pages: %u  cache pages: %d\n", stored, pages, cachePages);
+  printf("%-12s %8.3f s  %10.0f records/s\n", "store", storeTime, stored / storeTime);
+
+  // drop the file from the OS page cache, so the first load reads it from the disk
+  int fd = open(fileName, O_RDONLY);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+
+  // sequential loads of a file larger than the cache would evict every page before it is read again
+  int loadPages = cachePages > (int)pages ? cachePages : (int)pages;
+  pager = openPager(fileName, loadPages);
+  start = now();
+  long cold = loadAll(pager);
+  report("cold load", pager, now() - start, cold);
+
+  start = now();
+  long warm = loadAll(pager);
+  report("warm load", pager, now() - start, warm);
+  closePager(pager);
+
+  pager = openPager(fileName, CRASH_CACHE_PAGES);
+  start = now();
+  long streamed = loadAll(pager);
+  report("8 page cache", pager, now() - start, streamed);
+
+  // each lookup streams its table through the 8 pages, the last one reads the whole users table for nothing
+  User user;
+  Vehicle vehicle;
+  Rent rent;
+  start = now();
+  bool isFound = findUserInPager(pager, 1, &user) && findVehicleInPager(pager, "V0", &vehicle) &&
+                 findRentInPager(pager, 0, &rent) && !findUserInPager(pager, count + 1, &user);
+  report("4 lookups", pager, now() - start, 4);
+  closePager(pager);
+
+  ok = ok && cold == stored && warm == stored && streamed == stored && isFound;
+  printf("loaded: %ld / %ld / %ld (expected %ld), lookups: %s  %s\n", cold, warm, streamed, stored,
+         isFound ? "found" : "not found", ok ? "OK" : "MISMATCH");
+
+  for (UserList *node = users; node != NULL; node = node->next)
+    node->user.wallet = CRASH_WALLET;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    pager = openPager(fileName, CRASH_CACHE_PAGES);
+    storeUsersInPager(pager, users);
+    storeVehiclesInPager(pager, vehicles);
+    kill(getpid(), SIGKILL);
+  }
+  int status;
+  bool isKilled = pid > 0 && waitpid(pid, &status, 0) == pid && WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+  bool isIntact = checkUsers(fileName, count, 100);
+  printf("killed while replacing the tables: %s, old tables intact: %s\n", isKilled ? "yes" : "no",
+         isIntact ? "yes" : "no");
+
+  pager = openPager(fileName, CRASH_CACHE_PAGES);
+  bool isReplaced = pager != NULL && storeUsersInPager(pager, users) && flushPager(pager);
+  uint64_t generation = pager != NULL ? pager->durable.generation : 0;
+  isReplaced = closePager(pager) && isReplaced && checkUsers(fileName, count, CRASH_WALLET);
+  uint8_t garbage[PAGER_PAGE_SIZE];
+  memset(garbage, 0x5a, sizeof(garbage));
+  fd = open(fileName, O_WRONLY);
+  bool isTorn = fd >= 0 && pwrite(fd, garbage, sizeof(garbage), (off_t)(generation % PAGER_SUPERBLOCKS) *
+                                                                     PAGER_PAGE_SIZE) == PAGER_PAGE_SIZE;
+  if (fd >= 0)
+    close(fd);
+  bool isRolledBack = isTorn && checkUsers(fileName, count, 100);
+  printf("replaced the users: %s, newest superblock torn: %s, previous tables intact: %s\n",
+         isReplaced ? "yes" : "no", isTorn ? "yes" : "no", isRolledBack ? "yes" : "no");
+
+  ok = ok && isKilled && isIntact && isReplaced && isRolledBack;
+  printf("%s\n", ok ? "OK" : "FAILED");
+  unlink(fileName);
+  return ok ? 0 : 1;
+}
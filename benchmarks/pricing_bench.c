@@ -0,0 +1,122 @@
+/**
+ * @file pricing_bench.c
+ * @brief Month-end re-pricing benchmark for the pricing engine
+ *
+ * Prices the same set of rents (10M by default) once with priceRent, one call per rent, and once with
+ * priceRentBatch over parallel arrays, and checks that both give the same total. It also checks that rents too long
+ * for a 32-bit price are saturated instead of wrapping around to a negative price.
+ *
+ * Usage: pricing_bench [rents] [locations]
+ * Build with -O3 -march=native to let the compiler vectorize the batch loop.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../models/pricing.h"
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t rents = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+  int cities = argc > 2 ? atoi(argv[2]) : 200;
+  PricingEngine *engine = createPricingEngine();
+
+  int trotinete = addPricingType(engine, "trotinete", 50);
+  addPricingTier(engine, trotinete, 0, 15);
+  addPricingTier(engine, trotinete, 30, 10);
+  addPricingTier(engine, trotinete, 120, 8);
+  int bicicleta = addPricingType(engine, "bicicleta", 0);
+  addPricingTier(engine, bicicleta, 0, 5);
+  addPricingTier(engine, bicicleta, 60, 3);
+  int carro = addPricingType(engine, "carro", 100);
+  addPricingTier(engine, carro, 0, 30);
+  addPricingTier(engine, carro, 60, 25);
+  addPricingTier(engine, carro, 240, 20);
+  addPricingTier(engine, carro, 1440, 15);
+
+  for (int i = 0; i < cities; i++)
+  {
+    char city[PRICING_NAME_SIZE];
+    sprintf(city, "city-%d", i);
+    addPricingLocation(engine, city, i % 4 * 5);
+  }
+  compilePricing(engine);
+
+  uint16_t *types = malloc(rents * sizeof(uint16_t));
+  uint16_t *locations = malloc(rents * sizeof(uint16_t));
+  int32_t *minutes = malloc(rents * sizeof(int32_t));
+  int32_t *prices = malloc(rents * sizeof(int32_t));
+  unsigned int seed = 7;
+
+  for (size_t i = 0; i < rents; i++)
+  {
+    types[i] = (uint16_t)(rand_r(&seed) % 3);
+    locations[i] = (uint16_t)(rand_r(&seed) % engine->tableLocations);
+    minutes[i] = 1 + rand_r(&seed) % 300;
+  }
+
+  // touch the output pages now, so the batch run does not pay for the first page faults
+  memset(prices, 0, rents * sizeof(int32_t));
+
+  double start = now();
+  long long scalarTotal = 0;
+  for (size_t i = 0; i < rents; i++)
+  {
+    scalarTotal += priceRent(engine, types[i], locations[i], minutes[i]);
+  }
+  double scalarTime = now() - start;
+
+  start = now();
+  priceRentBatch(engine, types, locations, minutes, prices, rents);
+  double batchTime = now() - start;
+
+  long long batchTotal = 0;
+  for (size_t i = 0; i < rents; i++)
+  {
+    batchTotal += prices[i];
+  }
+
+  printf("rents: %zu  types: %d  locations: %d\n", rents, engine->tableTypes, engine->tableLocations);
+  printf("priceRent:      %8.3f s  %10.1f M rents/s\n", scalarTime, rents / scalarTime / 1e6);
+  printf("priceRentBatch: %8.3f s  %10.1f M rents/s\n", batchTime, rents / batchTime / 1e6);
+  printf("total: %lld (batch %lld)  %s\n", scalarTotal, batchTotal, scalarTotal == batchTotal ? "OK" : "MISMATCH");
+
+  // a carro rented for INT32_MAX minutes costs more than INT32_MAX, a bicicleta for 500M minutes fits
+  int city = searchPricingLocation(engine, "city-0");
+  uint16_t longTypes[2] = {(uint16_t)carro, (uint16_t)bicicleta};
+  uint16_t longLocations[2] = {(uint16_t)city, (uint16_t)city};
+  int32_t longMinutes[2] = {INT32_MAX, 500000000};
+  int32_t longExpected[2] = {INT32_MAX, 5 * 60 + (500000000 - 60) * 3};
+  int32_t longPrices[2];
+  priceRentBatch(engine, longTypes, longLocations, longMinutes, longPrices, 2);
+  bool isLongOk = true;
+  for (int i = 0; i < 2; i++)
+  {
+    int price = priceRent(engine, longTypes[i], longLocations[i], longMinutes[i]);
+    isLongOk = isLongOk && price == longExpected[i] && longPrices[i] == longExpected[i];
+  }
+  printf("long rents: %d (batch %d), %d (batch %d)  %s\n", priceRent(engine, carro, city, INT32_MAX), longPrices[0],
+         priceRent(engine, bicicleta, city, 500000000), longPrices[1], isLongOk ? "OK" : "MISMATCH");
+
+  free(types);
+  free(locations);
+  free(minutes);
+  free(prices);
+  destroyPricingEngine(engine);
+  return scalarTotal == batchTotal && isLongOk ? 0 : 1;
+}
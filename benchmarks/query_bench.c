@@ -0,0 +1,164 @@
+/**
+ * @file query_bench.c
+ * @brief Scaling benchmark for the read-only queries on the work-stealing task pool
+ *
+ * Builds a graph of cities linked to their neighbours by roads of random lengths, spreads the vehicles over the
+ * cities, and runs the same batch of shortest path, radius and reachability queries on the calling thread and on
+ * pools of 1, 2, 4, 8 and 16 workers. Every pool must give the results of the calling thread, query by query. The
+ * speedup is reported against the pool of one worker.
+ *
+ * Usage: query_bench [queries] [vertices] [vehicles] [max threads]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../models/queries.h"
+#include "../models/memstats.h"
+
+#define DEGREE 4        // roads from every city
+#define MAX_ROAD 10     // longest road
+#define NEAR_RADIUS 12  // radius of the NEAR queries
+#define NEIGHBOURHOOD 8 // roads go to one of the next NEIGHBOURHOOD cities, so routes are long
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Checks that two runs of a query gave the same results
+ *
+ * @param a The query run on the calling thread
+ * @param b The same query run on a pool
+ * @return True if the results are the same, false otherwise
+ */
+static bool sameResults(Query *a, Query *b)
+{
+  switch (a->type)
+  {
+  case QUERY_ROUTE:
+    return a->distance == b->distance && a->length == b->length &&
+           (a->length > QUERY_MAX_PATH || memcmp(a->path, b->path, a->length * sizeof(int)) == 0);
+  case QUERY_NEAR:
+    return a->count == b->count &&
+           (a->count < 0 || memcmp(a->found, b->found, (a->count < QUERY_MAX_FOUND ? a->count : QUERY_MAX_FOUND) * sizeof(Vehicle *)) == 0);
+  case QUERY_REACHABLE:
+    return a->isReachable == b->isReachable;
+  default:
+    return true;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int queryCount = argc > 1 ? atoi(argv[1]) : 5000;
+  int vertexCount = argc > 2 ? atoi(argv[2]) : 2000;
+  int vehicleCount = argc > 3 ? atoi(argv[3]) : 5000;
+  int maxThreads = argc > 4 ? atoi(argv[4]) : 16;
+  unsigned int seed = 1234;
+  bool res;
+
+  Vertex *graph = createRoute();
+  Vertex **vertices = (Vertex **)malloc(vertexCount * sizeof(Vertex *));
+  VehicleList *vehicles = NULL;
+  Query *expected = (Query *)malloc(queryCount * sizeof(Query));
+  Query *queries = (Query *)malloc(queryCount * sizeof(Query));
+  if (vertices == NULL || expected == NULL || queries == NULL)
+  {
+    perror("could not allocate memory!");
+    return 1;
+  }
+
+  for (int i = vertexCount - 1; i >= 0; i--)
+  {
+    char city[N];
+    sprintf(city, "Cidade%07d", i);
+    vertices[i] = createRouteVertex(city, i);
+    graph = insertRouteVertex(graph, vertices[i], &res);
+  }
+  for (int i = 0; i < vertexCount; i++)
+    for (int j = 0; j < DEGREE; j++)
+    {
+      int neighbour = (i + 1 + rand_r(&seed) % NEIGHBOURHOOD) % vertexCount;
+      vertices[i]->adjacents = insertAdj(vertices[i]->adjacents, createAdj(neighbour, (float)(1 + rand_r(&seed) % MAX_ROAD)), &res);
+    }
+  for (int i = 0; i < vehicleCount; i++)
+  {
+    Vehicle vehicle = {0};
+    sprintf(vehicle.registration, "%02d-%02d-%c%c", i / 100 % 100, i % 100, 'A' + i / 10000 % 26, 'A' + i / 260000 % 26);
+    strcpy(vehicle.type, i % 3 == 0 ? "bicicleta" : "trotinete");
+    strcpy(vehicle.location, vertices[rand_r(&seed) % vertexCount]->city);
+    vehicle.battery = 80;
+    vehicle.cost = 1;
+    createVehicleList(&vehicles, vehicle);
+  }
+
+  // 40% routes, 40% radius searches, 20% reachability checks
+  for (int i = 0; i < queryCount; i++)
+  {
+    Query *query = &expected[i];
+    memset(query, 0, sizeof(Query));
+    int pick = rand_r(&seed) % 10;
+    query->type = pick < 4 ? QUERY_ROUTE : pick < 8 ? QUERY_NEAR : QUERY_REACHABLE;
+    query->origin = rand_r(&seed) % vertexCount;
+    query->dest = rand_r(&seed) % vertexCount;
+    query->radius = NEAR_RADIUS;
+    strcpy(query->vehicleType, rand_r(&seed) % 3 == 0 ? "bicicleta" : "trotinete");
+  }
+  memcpy(queries, expected, queryCount * sizeof(Query));
+
+  double start = now();
+  for (int i = 0; i < queryCount; i++)
+    runQuery(graph, vehicles, &expected[i]);
+  double serial = queryCount / (now() - start);
+  printf("queries: %d  vertices: %d  vehicles: %d\n", queryCount, vertexCount, vehicleCount);
+  printf("  calling thread   queries/s: %10.0f\n", serial);
+
+  bool ok = true;
+  double baseline = 0;
+  for (int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    TaskPool *pool = createTaskPool(threads);
+    if (pool == NULL)
+      return 1;
+    start = now();
+    ok = runQueries(pool, graph, vehicles, queries, queryCount) && ok;
+    double rate = queryCount / (now() - start);
+    TaskPoolStats stats;
+    readTaskPoolStats(pool, &stats);
+    destroyTaskPool(pool);
+
+    int mismatches = 0;
+    for (int i = 0; i < queryCount; i++)
+      mismatches += !sameResults(&expected[i], &queries[i]);
+    ok = ok && mismatches == 0;
+    if (threads == 1)
+      baseline = rate;
+    printf("  threads: %2d  queries/s: %10.0f  speedup: %5.2fx  steals: %6lld  splits: %6lld  mismatches: %d\n",
+           threads, rate, rate / baseline, stats.stolen, stats.splits, mismatches);
+  }
+
+  while (vehicles != NULL)
+  {
+    VehicleList *next = vehicles->next;
+    memFree(MEM_VEHICLES, vehicles);
+    vehicles = next;
+  }
+  destroyRoutes(graph);
+  free(vertices);
+  free(expected);
+  free(queries);
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+/**
+ * @file rent_bench.c
+ * @brief Rentals-per-second benchmark for the rent transaction API
+ *
+ * Builds a fleet and a set of users, then repeatedly rents every vehicle with rentVehicle and returns it with
+ * deleteRent. Each round also tries to rent vehicles that are already in use and users without money, so the
+ * rollback paths are timed too. At the end the wallets are checked against the prices that were charged.
+ *
+ * Then the expiry is checked, on the rent store and through the commands of the server: a rent whose time is over
+ * must release its vehicle and leave the wallet charged once, and a second expiry must change nothing. A vehicle
+ * returned through the commands must end its rent at once, with the minutes that were not used given back.
+ *
+ * Usage: rent_bench [vehicles] [users] [rounds]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../models/commands.h"
+#include "../models/rentals.h"
+#include "../models/memstats.h"
+
+#define INITIAL_WALLET 1000000
+
+/**
+ * @brief Runs a command line through a command context
+ *
+ * @param context A pointer to the context
+ * @param line The command line
+ * @param response Receives the response line
+ * @return True if the response starts with OK, false otherwise
+ */
+static bool runCommand(CommandContext *context, char *line, char *response)
+{
+  Command command;
+  parseCommand(line, strlen(line), &command);
+  executeCommand(context, &command, response, COMMAND_RESPONSE_SIZE);
+  return strncmp(response, "OK", 2) == 0;
+}
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  int vehicles = argc > 1 ? atoi(argv[1]) : 2000;
+  int users = argc > 2 ? atoi(argv[2]) : 2000;
+  int rounds = argc > 3 ? atoi(argv[3]) : 20;
+
+  VehicleList *vehicleList = NULL;
+  UserList *userList = NULL;
+  RentStore *rentStore = createRentStore();
+  char (*registrations)[50] = malloc(vehicles * sizeof(*registrations));
+  int64_t *ids = malloc(vehicles * sizeof(int64_t));
+  unsigned int seed = 42;
+
+  for (int i = 0; i < vehicles; i++)
+  {
+    Vehicle vehicle = {0};
+    sprintf(registrations[i], "%02d-%02d-%c%c", i / 100 % 100, i % 100, 'A' + i / 10000 % 26, 'A' + i / 260000 % 26);
+    sprintf(vehicle.registration, "%s", registrations[i]);
+    strcpy(vehicle.type, i % 3 == 0 ? "bicicleta" : "trotinete");
+    strcpy(vehicle.location, "Braga");
+    vehicle.battery = 100;
+    vehicle.cost = 1 + i % 5;
+    createVehicleList(&vehicleList, vehicle);
+  }
+  for (int i = 0; i < users; i++)
+  {
+    User user = {0};
+    user.nif = i + 1;
+    user.wallet = i == 0 ? 0 : INITIAL_WALLET; // user 1 can never pay
+    createUserList(&userList, user);
+  }
+
+  long long charged = 0;
+  long rented = 0, refused = 0, returned = 0;
+  double rentTime = 0, refuseTime = 0, returnTime = 0;
+
+  for (int round = 0; round < rounds; round++)
+  {
+    double start = now();
+    for (int i = 0; i < vehicles; i++)
+    {
+      Rent rent;
+      int nif = 2 + rand_r(&seed) % (users - 1);
+      int minutes = 1 + rand_r(&seed) % 30;
+      if (rentVehicle(registrations[i], nif, minutes, vehicleList, userList, rentStore, &rent) == RENT_OK)
+      {
+        ids[i] = rent.id;
+        charged += (long long)(1 + i % 5) * minutes;
+        rented++;
+      }
+    }
+    rentTime += now() - start;
+
+    start = now();
+    for (int i = 0; i < vehicles; i++)
+    {
+      Rent rent;
+      // the vehicle is in use, and user 1 has no money: both must be rolled back
+      if (rentVehicle(registrations[i], 2, 1, vehicleList, userList, rentStore, &rent) != RENT_OK)
+        refused++;
+      if (rentVehicle(registrations[i], 1, 1, vehicleList, userList, rentStore, &rent) != RENT_OK)
+        refused++;
+    }
+    refuseTime += now() - start;
+
+    start = now();
+    for (int i = 0; i < vehicles; i++)
+    {
+      if (deleteRent(rentStore, ids[i], vehicleList))
+        returned++;
+    }
+    returnTime += now() - start;
+  }
+
+  long long balance = 0;
+  for (UserList *current = userList; current != NULL; current = current->next)
+    balance += current->user.wallet;
+  long long expected = (long long)(users - 1) * INITIAL_WALLET - charged;
+
+  printf("vehicles: %d  users: %d  rounds: %d\n", vehicles, users, rounds);
+  printf("rentals/s:          %12.0f (%ld rents)\n", rented / rentTime, rented);
+  printf("refused rentals/s:  %12.0f (%ld refused)\n", refused / refuseTime, refused);
+  printf("returns/s:          %12.0f (%ld returns)\n", returned / returnTime, returned);
+  printf("balance: %lld (expected %lld)  %s\n", balance, expected, balance == expected ? "OK" : "MISMATCH");
+
+  // a rent of the store expires at its end time, once
+  Rent rent;
+  User *payer = searchUser(userList, 2);
+  Vehicle *vehicle = searchVehicle(vehicleList, registrations[0]);
+  int wallet = payer->wallet;
+  bool isExpired = rentVehicle(registrations[0], 2, 10, vehicleList, userList, rentStore, &rent) == RENT_OK;
+  isExpired = isExpired && expireRents(rentStore, rent.endTime - 1, vehicleList, userList) == 0 && vehicle->isInUse;
+  isExpired = isExpired && expireRents(rentStore, rent.endTime, vehicleList, userList) == 1 && !vehicle->isInUse &&
+              searchRentById(rentStore, rent.id) == NULL;
+  isExpired = isExpired && expireRents(rentStore, rent.endTime + 3600, vehicleList, userList) == 0 &&
+              payer->wallet == wallet - rent.price;
+  printf("store rent expired once, vehicle released, charged once: %s\n", isExpired ? "OK" : "FAILED");
+
+  // two rents made with createRent before either is added to the store get their own IDs
+  Rent *firstRent = createRent(registrations[2], 2, 5, vehicleList, userList, rentStore);
+  Rent *secondRent = createRent(registrations[3], 2, 5, vehicleList, userList, rentStore);
+  bool isUnique = firstRent != NULL && secondRent != NULL && firstRent->id != secondRent->id &&
+                  createRentList(rentStore, *firstRent) && createRentList(rentStore, *secondRent);
+  printf("rents made before they are added have unique IDs: %s\n", isUnique ? "OK" : "FAILED");
+  memFree(MEM_TEMPORARIES, firstRent);
+  memFree(MEM_TEMPORARIES, secondRent);
+
+  // through the commands: the first rent is returned right away and the vehicle rented again
+  UserStore *userStore = userStoreFromList(userList);
+  RentStore *engineStore = createRentStore(); // its timer wheel starts now, the other one was moved an hour ahead
+  CommandContext context;
+  char response[COMMAND_RESPONSE_SIZE];
+  char line[COMMAND_LINE_SIZE];
+  User user;
+  int expired = 0;
+  bool isSettled = userStore != NULL && initCommandContext(&context, vehicleList, userStore, NULL, engineStore);
+  userStoreGet(userStore, 3, &user);
+  snprintf(line, sizeof(line), "RENT %s 3 10", registrations[1]);
+  isSettled = isSettled && runCommand(&context, line, response);
+  int64_t firstEnd = time(NULL) + 10 * 60;
+  snprintf(line, sizeof(line), "RETURN %s", registrations[1]);
+  isSettled = isSettled && runCommand(&context, line, response);
+  snprintf(line, sizeof(line), "RENT %s 3 20", registrations[1]);
+  isSettled = isSettled && runCommand(&context, line, response);
+  int price = atoi(strchr(response + 3, ' ') + 1);
+  vehicle = searchVehicle(vehicleList, registrations[1]);
+  isSettled = isSettled && settleRents(&context, firstEnd + 1, &expired) == 2 && expired == 0 && vehicle->isInUse;
+  isSettled = isSettled && settleRents(&context, firstEnd + 10 * 60 + 1, &expired) == 0 && expired == 1 &&
+              !vehicle->isInUse && engineStore->count == 0;
+  settleRents(&context, firstEnd + 86400, &expired);
+  isSettled = isSettled && expired == 0;
+  wallet = user.wallet;
+  userStoreGet(userStore, 3, &user);
+  // the returned rent is charged for its first minute only
+  isSettled = isSettled && user.wallet == wallet - (1 + 1 % 5) - price;
+  printf("returned rent ended and refunded, newer rent expired once and charged once: %s\n",
+         isSettled ? "OK" : "FAILED");
+  if (userStore != NULL)
+  {
+    freeCommandContext(&context);
+    destroyUserStore(userStore);
+  }
+
+  free(registrations);
+  free(ids);
+  destroyRentStore(rentStore);
+  destroyRentStore(engineStore);
+  return balance == expected && isExpired && isUnique && isSettled ? 0 : 1;
+}
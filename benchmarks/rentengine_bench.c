@@ -0,0 +1,205 @@
+/**
+ * @file rentengine_bench.c
+ * @brief Scaling benchmark for the concurrent rental engine
+ *
+ * Runs two workloads with 1, 2, 4, 8 and 16 threads:
+ * - contention-free: every thread rents and returns its own vehicles, charged to its own users
+ * - contention-heavy: every thread fights for the same 16 vehicles and 8 wallets
+ * Each successful rent checks that nobody else holds the vehicle, and the wallets are checked against the prices
+ * charged at the end. The speedup is reported against the single thread run of the same workload.
+ *
+ * Usage: rentengine_bench [operations per thread] [max threads]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include "../models/rentengine.h"
+#include "../models/memstats.h"
+
+#define VEHICLES_PER_THREAD 64
+#define USERS_PER_THREAD 64
+#define HOT_VEHICLES 16
+#define HOT_USERS 8
+#define INITIAL_WALLET 1000000000
+
+typedef struct Fixture
+{
+  VehicleList *vehicleList;
+  UserStore *userStore;
+  RentEngine *engine;
+  char (*registrations)[50];
+  int *holders; // threads holding each vehicle, must never go above one
+  int vehicles;
+  int users;
+  bool contended;
+  long operations;
+} Fixture;
+
+typedef struct Worker
+{
+  pthread_t thread;
+  Fixture *fixture;
+  int index;
+  long long charged;
+  long rented;
+  long violations;
+} Worker;
+
+/**
+ * @brief Thread body: rents a vehicle and returns it right away, over and over
+ *
+ * @param arg A pointer to the worker
+ * @return NULL
+ */
+static void *runWorker(void *arg)
+{
+  Worker *worker = (Worker *)arg;
+  Fixture *fixture = worker->fixture;
+  RentWorker *rentWorker = rentEngineWorker(fixture->engine, worker->index);
+  unsigned int seed = 1234 + worker->index;
+
+  for (long i = 0; i < fixture->operations; i++)
+  {
+    int vehicle, nif;
+    if (fixture->contended)
+    {
+      vehicle = rand_r(&seed) % fixture->vehicles;
+      nif = 1 + rand_r(&seed) % fixture->users;
+    }
+    else
+    {
+      vehicle = worker->index * VEHICLES_PER_THREAD + (int)(i % VEHICLES_PER_THREAD);
+      nif = 1 + worker->index * USERS_PER_THREAD + (int)(i % USERS_PER_THREAD);
+    }
+
+    Rent rent;
+    if (rentEngineRent(rentWorker, fixture->registrations[vehicle], nif, 1, &rent) == RENT_OK)
+    {
+      if (__atomic_fetch_add(&fixture->holders[vehicle], 1, __ATOMIC_ACQ_REL) != 0)
+        worker->violations++;
+      worker->charged += 1;
+      worker->rented++;
+      __atomic_fetch_sub(&fixture->holders[vehicle], 1, __ATOMIC_ACQ_REL);
+      rentEngineReturn(fixture->engine, fixture->registrations[vehicle]);
+    }
+
+    // keep the per-thread logs from growing without bound during long runs
+    if (rentWorker->logCount >= 1 << 16)
+      rentWorker->logCount = 0;
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Runs one workload with a number of threads
+ *
+ * @param threads The number of threads
+ * @param contended Whether the threads share the vehicles and users
+ * @param operations The number of rent attempts per thread
+ * @param rate Receives the successful rents per second
+ * @return True if no vehicle was held twice and the balances match, false otherwise
+ */
+static bool runWorkload(int threads, bool contended, long operations, double *rate)
+{
+  Fixture fixture = {0};
+  fixture.vehicles = contended ? HOT_VEHICLES : threads * VEHICLES_PER_THREAD;
+  fixture.users = contended ? HOT_USERS : threads * USERS_PER_THREAD;
+  fixture.contended = contended;
+  fixture.operations = operations;
+  fixture.registrations = malloc(fixture.vehicles * sizeof(*fixture.registrations));
+  fixture.holders = calloc(fixture.vehicles, sizeof(int));
+  fixture.userStore = createUserStore();
+
+  for (int i = 0; i < fixture.vehicles; i++)
+  {
+    Vehicle vehicle = {0};
+    sprintf(fixture.registrations[i], "%02d-%02d-ZZ", i / 100, i % 100);
+    strcpy(vehicle.registration, fixture.registrations[i]);
+    strcpy(vehicle.type, "trotinete");
+    strcpy(vehicle.location, "Braga");
+    vehicle.cost = 1;
+    createVehicleList(&fixture.vehicleList, vehicle);
+  }
+  for (int i = 1; i <= fixture.users; i++)
+  {
+    User user = {0};
+    user.nif = i;
+    user.wallet = INITIAL_WALLET;
+    userStoreInsert(fixture.userStore, user);
+  }
+
+  fixture.engine = createRentEngine(fixture.vehicleList, fixture.userStore, 0, threads);
+  Worker *workers = calloc(threads, sizeof(Worker));
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < threads; i++)
+  {
+    workers[i].fixture = &fixture;
+    workers[i].index = i;
+    pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]);
+  }
+
+  long long charged = 0;
+  long rented = 0, violations = 0;
+  for (int i = 0; i < threads; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+    charged += workers[i].charged;
+    rented += workers[i].rented;
+    violations += workers[i].violations;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  long long expected = (long long)fixture.users * INITIAL_WALLET - charged;
+  bool ok = violations == 0 && userStoreTotalBalance(fixture.userStore) == expected;
+  *rate = rented / seconds;
+
+  destroyRentEngine(fixture.engine);
+  destroyUserStore(fixture.userStore);
+  while (fixture.vehicleList != NULL)
+  {
+    VehicleList *next = fixture.vehicleList->next;
+    memFree(MEM_VEHICLES, fixture.vehicleList);
+    fixture.vehicleList = next;
+  }
+  free(fixture.registrations);
+  free(fixture.holders);
+  free(workers);
+
+  if (!ok)
+    printf("  %d threads: %ld double rentals, wallets %s\n", threads, violations, violations ? "not checked" : "do not match the charges");
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  long operations = argc > 1 ? atol(argv[1]) : 1000000;
+  int maxThreads = argc > 2 ? atoi(argv[2]) : 16;
+  bool ok = true;
+
+  for (int contended = 0; contended <= 1; contended++)
+  {
+    double baseline = 0;
+    printf("%s workload, %ld attempts per thread\n", contended ? "contention-heavy" : "contention-free", operations);
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+      double rate;
+      ok = runWorkload(threads, contended, operations, &rate) && ok;
+      if (threads == 1)
+        baseline = rate;
+      printf("  threads: %2d  rents/s: %12.0f  speedup: %5.2fx\n", threads, rate, rate / baseline);
+    }
+  }
+
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,317 @@
+/**
+ * @file rentlog_bench.c
+ * @brief Throughput and crash recovery check of the write-ahead log of the rents
+ *
+ * Runs in a scratch directory, where the log and the rents snapshot are written to saved-data like in the program.
+ * First it times the changes per second of a rent store with a log for a few batch sizes. Then a child process makes
+ * the same sequence of creates, edits and deletes, with checkpoints on the way, and kills itself with SIGKILL while
+ * the last batch is still buffered. Half a record is appended to the log, as if the process had died in the middle
+ * of a write, and the rents are recovered: they must be exactly the ones of the batches that were flushed, and the
+ * torn record must be cut off. Finally more changes are logged on top of the recovered store and recovered again,
+ * and a rent whose record the log cannot write must be refused with RENT_NOT_LOGGED and rolled back, while a rent
+ * whose removal it cannot write must stay in the store until the expiry is retried. Last, the log must give back the
+ * wallet changes and the vehicle claims of its records once, and none of the records a snapshot already holds.
+ *
+ * Usage: rentlog_bench [changes] [directory]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "../models/rentlog.h"
+#include "../models/memstats.h"
+
+#define CRASH_SYNC_EVERY 8
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Removes the log and the rents snapshot of the scratch directory
+ */
+static void removeFiles()
+{
+  unlink(RENT_LOG_FILE);
+  unlink(RENTS_FILE);
+  unlink(RENTS_SEQ_FILE);
+}
+
+/**
+ * @brief Applies the change number i of the sequence, each one is a single record of the log
+ *
+ * Two rents are created out of every three changes. The third change edits the rent created just before it, or
+ * deletes the one created two changes before it, in turns.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param i The number of the change
+ * @return True if the change was applied, false otherwise
+ */
+static bool applyChange(RentStore *rentStore, long i)
+{
+  Rent rent;
+  memset(&rent, 0, sizeof(Rent));
+
+  switch (i % 3)
+  {
+  case 2:
+    if (i % 6 == 5)
+      return removeRent(rentStore, i - 2);
+    rent = searchRentById(rentStore, i - 1)->rent;
+    rent.price += 7;
+    rent.timeInMinutes += 1;
+    return editRent(rentStore, i - 1, rent);
+  default:
+    rent.id = i;
+    snprintf(rent.vehicleRegistration, sizeof(rent.vehicleRegistration), "%02ld-%02ld-AA", i / 100 % 100, i % 100);
+    rent.userNif = 100000 + (int)(i % 977);
+    rent.timeInMinutes = 1 + (int)(i % 60);
+    rent.price = 2 * rent.timeInMinutes;
+    rent.startTime = 1700000000 + i;
+    rent.endTime = rent.startTime + rent.timeInMinutes * 60;
+    return createRentList(rentStore, rent);
+  }
+}
+
+/**
+ * @brief Checks that two rent stores hold the same rents
+ *
+ * @param rentStore A pointer to the rent store that is checked
+ * @param expected A pointer to the rent store with the expected rents
+ * @return True if both have the same rents, false otherwise
+ */
+static bool sameRents(RentStore *rentStore, RentStore *expected)
+{
+  if (rentStore->count != expected->count)
+  {
+    return false;
+  }
+  for (RentList *node = expected->head; node != NULL; node = node->next)
+  {
+    RentList *found = searchRentById(rentStore, node->rent.id);
+    if (found == NULL || found->rent.price != node->rent.price ||
+        found->rent.timeInMinutes != node->rent.timeInMinutes || found->rent.userNif != node->rent.userNif ||
+        found->rent.endTime != node->rent.endTime ||
+        strcmp(found->rent.vehicleRegistration, node->rent.vehicleRegistration) != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Times a number of changes made to a rent store with a log
+ *
+ * @param changes The number of changes
+ * @param syncEvery The number of records of each batch
+ * @return The changes per second
+ */
+static double timeChanges(long changes, int syncEvery)
+{
+  removeFiles();
+  RentStore *rentStore = createRentStore();
+  RentLog *log = openRentLog(rentStore, syncEvery, changes + 1);
+  double start = now();
+  for (long i = 0; i < changes; i++)
+    applyChange(rentStore, i);
+  closeRentLog(log);
+  double seconds = now() - start;
+  destroyRentStore(rentStore);
+  return changes / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+  long changes = argc > 1 ? atol(argv[1]) : 20000;
+  char *directory = argc > 2 ? argv[2] : "./rentlog_bench.d";
+  if (changes < 3 * CRASH_SYNC_EVERY)
+  {
+    fprintf(stderr, "Usage: rentlog_bench [changes] [directory]\n");
+    return 2;
+  }
+
+  // the log and the snapshot are always in ./saved-data
+  char path[512];
+  char cwd[512];
+  snprintf(path, sizeof(path), "%s/saved-data", directory);
+  mkdir(directory, 0755);
+  mkdir(path, 0755);
+  if (getcwd(cwd, sizeof(cwd)) == NULL || chdir(directory) != 0)
+  {
+    perror("Could not open file");
+    return 2;
+  }
+
+  printf("changes: %ld\n\n", changes);
+  printf("%-12s %14s\n", "sync every", "changes/s");
+  int batches[] = {1, 8, 64};
+  for (int i = 0; i < 3; i++)
+    printf("%-12d %14.0f\n", batches[i], timeChanges(changes, batches[i]));
+
+  // the last change is still buffered when the child dies, unless the sequence ends a batch
+  long crashed = changes - (changes % CRASH_SYNC_EVERY == 0 ? 1 : 0);
+  long durable = crashed - crashed % CRASH_SYNC_EVERY;
+  removeFiles();
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    RentStore *rentStore = createRentStore();
+    openRentLog(rentStore, CRASH_SYNC_EVERY, changes / 4);
+    for (long i = 0; i < crashed; i++)
+      applyChange(rentStore, i);
+    kill(getpid(), SIGKILL);
+  }
+  int status;
+  bool isKilled = pid > 0 && waitpid(pid, &status, 0) == pid && WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+
+  struct stat info;
+  stat(RENT_LOG_FILE, &info);
+  long long logSize = info.st_size;
+  char torn[sizeof(RentLogRecord) / 2];
+  memset(torn, 0x5a, sizeof(torn));
+  int fd = open(RENT_LOG_FILE, O_WRONLY | O_APPEND);
+  bool isTorn = fd >= 0 && write(fd, torn, sizeof(torn)) == (ssize_t)sizeof(torn);
+  if (fd >= 0)
+    close(fd);
+
+  RentStore *expected = createRentStore();
+  for (long i = 0; i < durable; i++)
+    applyChange(expected, i);
+
+  RentStore *recovered = createRentStore();
+  double start = now();
+  long replayed = recoverRents(recovered, NULL, NULL);
+  double recoverTime = now() - start;
+  stat(RENT_LOG_FILE, &info);
+  bool isRecovered = sameRents(recovered, expected) && info.st_size == logSize;
+  printf("\nkilled with %ld of %ld changes flushed: %s, torn record appended: %s\n", durable, crashed,
+         isKilled ? "yes" : "no", isTorn ? "yes" : "no");
+  printf("recovered %d rents, %ld records replayed in %.3f ms, torn record cut: %s\n", recovered->count, replayed,
+         recoverTime * 1e3, info.st_size == logSize ? "yes" : "no");
+
+  // the recovered store keeps logging after the records that were replayed
+  RentLog *log = openRentLog(recovered, CRASH_SYNC_EVERY, changes / 4);
+  for (long i = durable; i < crashed; i++)
+  {
+    applyChange(recovered, i);
+    applyChange(expected, i);
+  }
+  bool isClosed = log != NULL && closeRentLog(log);
+  RentStore *again = createRentStore();
+  bool isContinued = isClosed && recoverRents(again, NULL, NULL) >= 0 && sameRents(again, expected);
+  printf("logged the lost changes again and recovered %d rents: %s\n", again->count, isContinued ? "yes" : "no");
+
+  // a log whose writes fail refuses the rent, which gives the vehicle and the money back
+  VehicleList *vehicles = NULL;
+  UserList *users = NULL;
+  Vehicle vehicle = {0};
+  User user = {0};
+  Rent rent;
+  strcpy(vehicle.registration, "00-00-AA");
+  vehicle.cost = 2;
+  createVehicleList(&vehicles, vehicle);
+  user.nif = 1;
+  user.wallet = 100;
+  createUserList(&users, user);
+  log = openRentLog(again, 1, changes);
+  int writable = log != NULL ? log->fd : -1;
+  if (log != NULL)
+    log->fd = open(RENT_LOG_FILE, O_RDONLY);
+  bool isRefused = log != NULL &&
+                   rentVehicle(vehicle.registration, 1, 10, vehicles, users, again, &rent) == RENT_NOT_LOGGED &&
+                   !vehicles->vehicle.isInUse && users->user.wallet == 100;
+  printf("rent the log could not write refused and rolled back: %s\n", isRefused ? "yes" : "no");
+
+  // a rent whose removal the log refuses does not expire yet, and is expired once the log writes again
+  int refusing = log != NULL ? log->fd : -1;
+  if (log != NULL)
+    log->fd = writable;
+  bool isRetried = log != NULL && rentVehicle(vehicle.registration, 1, 10, vehicles, users, again, &rent) == RENT_OK;
+  // the rents logged above are long over, they expire first so only the new rent is due below
+  int overdue = again->count - 1;
+  isRetried = isRetried && expireRents(again, rent.startTime, vehicles, users) == overdue;
+  if (isRetried)
+    log->fd = refusing;
+  isRetried = isRetried && expireRents(again, rent.endTime, vehicles, users) == 0 &&
+              searchRentById(again, rent.id) != NULL && vehicles->vehicle.isInUse;
+  if (log != NULL)
+    log->fd = writable;
+  isRetried = isRetried && expireRents(again, rent.endTime, vehicles, users) == 1 &&
+              searchRentById(again, rent.id) == NULL && !vehicles->vehicle.isInUse;
+  printf("rent the log could not remove expired on the next call: %s\n", isRetried ? "yes" : "no");
+  if (log != NULL)
+  {
+    close(refusing);
+    closeRentLog(log);
+  }
+
+  // the log gives back the wallets and the vehicles too, once, over the lists as they were before its records
+  removeFiles();
+  RentStore *live = createRentStore();
+  vehicles->vehicle.isInUse = false;
+  users->user.wallet = 100;
+  log = openRentLog(live, 1, changes);
+  bool isReplayed = log != NULL && rentLogWallet(log, 1, 50) && applyWalletDelta(&users->user.wallet, 50) &&
+                    rentLogWallet(log, 2, 30) &&
+                    rentVehicle(vehicle.registration, 1, 10, vehicles, users, live, &rent) == RENT_OK;
+  isReplayed = closeRentLog(log) && isReplayed;
+  vehicles->vehicle.isInUse = false;
+  users->user.wallet = 100;
+  RentStore *replayedStore = createRentStore();
+  isReplayed = isReplayed && recoverRents(replayedStore, vehicles, &users) == 3 && vehicles->vehicle.isInUse &&
+               searchUser(users, 1)->wallet == 130 && searchUser(users, 2) != NULL &&
+               searchUser(users, 2)->wallet == 30 && searchRentById(replayedStore, rent.id) != NULL;
+  // a snapshot taken after the records holds them, they are skipped
+  isReplayed = isReplayed && storeRentsInFile(replayedStore, RENTS_FILE, RENTS_SEQ_FILE);
+  RentStore *snapshotStore = createRentStore();
+  vehicles->vehicle.isInUse = false;
+  searchUser(users, 1)->wallet = 100;
+  isReplayed = isReplayed && recoverRents(snapshotStore, vehicles, &users) == 0 && !vehicles->vehicle.isInUse &&
+               searchUser(users, 1)->wallet == 100 && snapshotStore->sequence == 3;
+  // and cutting the log keeps only the records after the snapshot
+  log = openRentLog(snapshotStore, 1, changes);
+  isReplayed = isReplayed && log != NULL && rentLogTrim(log, 2) && log->size == (long long)sizeof(RentLogRecord) &&
+               rentLogTrim(log, 3) && log->size == 0;
+  closeRentLog(log);
+  printf("wallets and vehicles replayed once, log cut after the snapshot: %s\n", isReplayed ? "yes" : "no");
+  destroyRentStore(live);
+  destroyRentStore(replayedStore);
+  destroyRentStore(snapshotStore);
+
+  memFree(MEM_VEHICLES, vehicles);
+  while (users != NULL)
+  {
+    UserList *next = users->next;
+    memFree(MEM_USERS, users);
+    users = next;
+  }
+
+  destroyRentStore(expected);
+  destroyRentStore(recovered);
+  destroyRentStore(again);
+  removeFiles();
+  rmdir("saved-data");
+  if (chdir(cwd) == 0)
+    rmdir(directory);
+  bool ok = isKilled && isTorn && isRecovered && isContinued && isRefused && isRetried && isReplayed;
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
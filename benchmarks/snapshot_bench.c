@@ -0,0 +1,204 @@
+/**
+ * @file snapshot_bench.c
+ * @brief Foreground and background snapshot benchmark
+ *
+ * Fills the stores with users, vehicles, rents and a graph, then saves them twice into a scratch directory: once
+ * with writeSnapshot on the serving thread, which is how long requests would be paused, and once with
+ * startSnapshot while the serving thread keeps editing rents until the child is done. The second run reports the
+ * time spent in fork, the number of edits served meanwhile and the slowest one, which includes the copy-on-write
+ * faults of the pages the child still shares.
+ *
+ * Then it checks the commit of a snapshot: a manifest is left in the directory as if the process had died after the
+ * commit point, with one file still waiting under its temporary name and one already renamed, and recoverSnapshot
+ * must finish the renames and remove the manifest.
+ *
+ * Usage: snapshot_bench [records per store] [directory]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../models/snapshot.h"
+
+#define GRAPH_VERTICES 1000
+#define GRAPH_EDGES_PER_VERTEX 5
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Prints the report of a snapshot
+ *
+ * @param label The name of the run
+ * @param report A pointer to the report
+ */
+static void report(const char *label, SnapshotReport *report)
+{
+  printf("%-12s %8.3f s  %6.1f MB  %d files  %6.1f MB/s  %s\n", label, report->seconds, report->bytes / 1e6,
+         report->files, report->bytes / 1e6 / report->seconds, report->ok ? "OK" : "FAILED");
+}
+
+/**
+ * @brief Leaves a committed snapshot half renamed in a directory and recovers it
+ *
+ * The users get one more user under users.bin.tmp, vehicles.bin counts as already renamed, and the manifest lists
+ * both.
+ *
+ * @param directory The directory of a snapshot
+ * @param users A pointer to the head node of the user list
+ * @return True if users.bin was replaced by the temporary file and the manifest removed, false otherwise
+ */
+static bool checkRecovery(char *directory, UserList *users)
+{
+  char path[512];
+  char temporary[512];
+  char manifestPath[512];
+  struct stat info;
+
+  User user = {0};
+  user.nif = -1;
+  createUserList(&users, user);
+  snprintf(path, sizeof(path), "%s/users.bin", directory);
+  snprintf(temporary, sizeof(temporary), "%s/users.bin.tmp", directory);
+  snprintf(manifestPath, sizeof(manifestPath), "%s/" SNAPSHOT_MANIFEST, directory);
+  if (!storeUsersInFile(users, temporary) || stat(temporary, &info) != 0)
+  {
+    return false;
+  }
+  long long size = info.st_size;
+  FILE *manifest = fopen(manifestPath, "w");
+  if (manifest == NULL)
+  {
+    return false;
+  }
+  fprintf(manifest, "users.bin\nvehicles.bin\n");
+  fclose(manifest);
+
+  bool isRecovered = recoverSnapshot(directory);
+  bool isRenamed = stat(path, &info) == 0 && info.st_size == size && access(temporary, F_OK) != 0;
+  bool isRemoved = access(manifestPath, F_OK) != 0;
+  printf("committed snapshot left half renamed: recovered %s, users.bin replaced %s, manifest removed %s\n",
+         isRecovered ? "yes" : "no", isRenamed ? "yes" : "no", isRemoved ? "yes" : "no");
+  return isRecovered && isRenamed && isRemoved;
+}
+
+/**
+ * @brief Removes the files written to the scratch directory
+ *
+ * @param directory The scratch directory
+ * @param graph A pointer to the head of the graph that was saved
+ */
+static void removeSnapshot(char *directory, Vertex *graph)
+{
+  char *names[] = {"users.bin", "vehicles.bin", "rents.bin", "rents-seq.bin", "Vertexs.bin", "warm.img", "edges.bin"};
+  char path[512];
+
+  for (int i = 0; i < 7; i++)
+  {
+    snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+    unlink(path);
+  }
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+  {
+    snprintf(path, sizeof(path), "%s/vertex-adj/%s.bin", directory, vertex->city);
+    unlink(path);
+  }
+  snprintf(path, sizeof(path), "%s/vertex-adj", directory);
+  rmdir(path);
+  rmdir(directory);
+}
+
+int main(int argc, char *argv[])
+{
+  int count = argc > 1 ? atoi(argv[1]) : 1000000;
+  char *directory = argc > 2 ? argv[2] : "./snapshot_bench.d";
+
+  UserList *users = NULL;
+  VehicleList *vehicles = NULL;
+  RentStore *rentStore = createRentStore();
+  Vertex *graph = createRoute();
+  bool res;
+
+  for (int i = 0; i < count; i++)
+  {
+    User user = {0};
+    user.nif = i + 1;
+    sprintf(user.name, "user-%d", i);
+    user.wallet = 100;
+    createUserList(&users, user);
+
+    Vehicle vehicle = {0};
+    sprintf(vehicle.registration, "V%d", i);
+    strcpy(vehicle.type, "trotinete");
+    sprintf(vehicle.location, "city-%04d", i % GRAPH_VERTICES);
+    vehicle.cost = 1;
+    createVehicleList(&vehicles, vehicle);
+
+    Rent rent = {0};
+    rent.id = nextRentId(rentStore);
+    sprintf(rent.vehicleRegistration, "V%d", i);
+    rent.userNif = i + 1;
+    rent.timeInMinutes = 10;
+    createRentList(rentStore, rent);
+  }
+  for (int i = GRAPH_VERTICES - 1; i >= 0; i--)
+  {
+    char city[N];
+    sprintf(city, "city-%04d", i);
+    graph = insertRouteVertex(graph, createRouteVertex(city, i), &res);
+  }
+  for (int i = 0; i < GRAPH_VERTICES; i++)
+    for (int j = 1; j <= GRAPH_EDGES_PER_VERTEX; j++)
+      graph = insertAdjacentVertexCod(graph, i, (i + j * 7) % GRAPH_VERTICES, (float)j, &res);
+
+  mkdir(directory, 0755);
+  SnapshotReport foreground;
+  writeSnapshot(directory, users, vehicles, rentStore, graph, &foreground);
+  report("foreground", &foreground);
+
+  Snapshot snapshot = {0};
+  SnapshotReport background;
+  unsigned int seed = 5;
+  long edits = 0;
+  double slowest = 0;
+  if (!startSnapshot(&snapshot, directory, users, vehicles, rentStore, graph))
+    return 1;
+  while (!snapshotFinished(&snapshot, &background))
+  {
+    for (int i = 0; i < 1000; i++)
+    {
+      double start = now();
+      RentList *node = searchRentById(rentStore, rand_r(&seed) % count);
+      Rent rent = node->rent;
+      rent.timeInMinutes++;
+      editRent(rentStore, rent.id, rent);
+      double elapsed = now() - start;
+      if (elapsed > slowest)
+        slowest = elapsed;
+    }
+    edits += 1000;
+  }
+  report("background", &background);
+  printf("fork: %.3f ms  edits served during the snapshot: %ld  slowest edit: %.3f ms  paused in foreground: %.3f s\n",
+         snapshot.forkSeconds * 1e3, edits, slowest * 1e3, foreground.seconds);
+
+  bool isRecovered = checkRecovery(directory, users);
+  removeSnapshot(directory, graph);
+  bool ok = foreground.ok && background.ok && isRecovered;
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,1332 @@
+/**
+ * @file suite_bench.c
+ * @brief Latency and throughput benchmark of the public operations of the models
+ *
+ * Builds the users, vehicles, rents and a road-like graph from fixed seeds at 10^3 records, then 10^4, and so on up
+ * to [max records], and times every operation one call at a time: the route algorithms, the vehicle lookups, edits,
+ * sorts, radius queries and truck runs, the user lookups and wallet updates, the rentals and the load and store
+ * functions. The graph has one city for every ten records, with roads to the next three cities, and the vehicles are
+ * spread over the cities. bestPath only works on graphs of MAX vertices, so it is timed on a graph of that size.
+ *
+ * Each operation is called until [budget] seconds or [max samples] calls were spent on it, and at least once. When
+ * the previous sizes show that a single call would take longer than SKIP_FACTOR budgets, the operation is reported
+ * as skipped instead, which is what happens to the quadratic ones at the larger sizes. Anything the operations
+ * print is discarded; the report is written to stdout as JSON, one result per operation and size, with the
+ * throughput and the p50, p99 and p999 latencies. With fewer than 1000 samples the p999 is the slowest call.
+ *
+ * The scratch files are written to a suite_bench-data directory made in [directory], which the suite works in:
+ * saveGraph and loadAdj keep the adjacency lists under ./saved-data, and this keeps them away from the real ones.
+ *
+ * Usage: suite_bench [max records] [budget seconds] [max samples] [directory]
+ *
+ * @author João Pereira
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../models/pager.h"
+#include "../models/user.h"
+#include "../models/vehicle.h"
+#include "../models/rentals.h"
+#include "../models/routes.h"
+#include "../models/edgecodec.h"
+#include "../models/warmstart.h"
+#include "../models/memstats.h"
+
+#define SEED 42
+#define WALLET 1000000000
+#define RADIUS 5
+#define WALLET_BATCH 64
+#define NAME_SIZE 50
+#define SKIP_FACTOR 10 // an operation is skipped when one call is expected to take this many budgets
+#define SCRATCH_DIRECTORY "suite_bench-data"
+
+typedef struct Fixture
+{
+  int records;
+  int vertexCount;
+  unsigned long long seed;
+  UserList *users;
+  VehicleList *vehicles;
+  RentStore *rentStore;
+  Vertex *graph;
+  Vertex *smallGraph; // MAX vertices, for bestPath
+  Pager *pager;
+  // scratch files of the store and load operations, written by the prepare step of a load if its store was skipped
+  char usersFile[512];
+  char vehiclesFile[512];
+  char rentsFile[512];
+  char seqFile[512];
+  char verticesFile[512];
+  char edgesFile[512];
+  char warmFile[512];
+  char pagerFile[512];
+  bool inPager[4]; // users, vehicles, rents and graph were stored in the pager
+  bool inAdjFiles; // saveGraph wrote the adjacency files of the graph
+
+  // arguments picked by the prepare step of the operation being timed
+  int nif;
+  int cod;
+  int target;
+  int64_t rentId;
+  char registration[NAME_SIZE];
+  char city[NAME_SIZE];
+  User user;
+  Vehicle vehicle;
+  Rent rent;
+  // an earlier call added or removed a record, which the next prepare step puts back
+  bool pendingUser;
+  bool pendingVehicle;
+  bool pendingRent;
+  bool pendingRoad;
+  WalletDelta deltas[WALLET_BATCH];
+
+  // results of the load operations, freed by the next prepare step
+  UserList *loadedUsers;
+  VehicleList *loadedVehicles; // or the vehicles collected by recoverTruck
+  RentStore *loadedRents;
+  Vertex *loadedGraph;
+} Fixture;
+
+typedef struct Benchmark
+{
+  const char *group;
+  const char *operation;
+  void (*prepare)(Fixture *fixture); // untimed, picks the arguments, may be NULL
+  void (*run)(Fixture *fixture);     // timed
+  bool fixedSize;                    // does not depend on the number of records
+  double lastMedian;                 // seconds, at the previous size, 0 if it was not run
+  double previousMedian;             // seconds, at the size before it
+} Benchmark;
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief xorshift64* pseudo random generator, fixed seeds keep the runs reproducible
+ *
+ * @param state A pointer to the generator state
+ * @return The next pseudo random number
+ */
+static unsigned long long nextRandom(unsigned long long *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+/**
+ * @brief Gets a random number in [0, bound)
+ *
+ * @param fixture A pointer to the fixture holding the generator
+ * @param bound The bound
+ * @return The random number
+ */
+static int randomBelow(Fixture *fixture, int bound)
+{
+  return (int)(nextRandom(&fixture->seed) % (unsigned long long)bound);
+}
+
+/**
+ * @brief Writes the registration of the i-th vehicle
+ *
+ * @param registration Receives the registration
+ * @param i The number of the vehicle
+ */
+static void vehicleRegistration(char *registration, int i)
+{
+  snprintf(registration, NAME_SIZE, "V%07d", i);
+}
+
+/**
+ * @brief Writes the name of the city of the vertex with a cod
+ *
+ * @param city Receives the name
+ * @param cod The cod of the vertex
+ */
+static void cityName(char *city, int cod)
+{
+  snprintf(city, NAME_SIZE, "city-%07d", cod);
+}
+
+/**
+ * @brief Frees a user list
+ *
+ * @param users A pointer to the head node of the list
+ */
+static void freeUsers(UserList *users)
+{
+  while (users != NULL)
+  {
+    UserList *next = users->next;
+    memFree(MEM_USERS, users);
+    users = next;
+  }
+}
+
+/**
+ * @brief Frees a vehicle list
+ *
+ * @param vehicles A pointer to the head node of the list
+ */
+static void freeVehicles(VehicleList *vehicles)
+{
+  while (vehicles != NULL)
+  {
+    VehicleList *next = vehicles->next;
+    memFree(MEM_VEHICLES, vehicles);
+    vehicles = next;
+  }
+}
+
+/**
+ * @brief Frees what the last load operation returned
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void freeLoaded(Fixture *fixture)
+{
+  freeUsers(fixture->loadedUsers);
+  freeVehicles(fixture->loadedVehicles);
+  if (fixture->loadedRents != NULL)
+  {
+    destroyRentStore(fixture->loadedRents);
+  }
+  destroyRoutes(fixture->loadedGraph);
+  fixture->loadedUsers = NULL;
+  fixture->loadedVehicles = NULL;
+  fixture->loadedRents = NULL;
+  fixture->loadedGraph = NULL;
+}
+
+/**
+ * @brief Builds the stores and the graph of a fixture
+ *
+ * Vertices are inserted from the last city name to the first and the roads are added to the vertices directly,
+ * so the build is linear; the operations themselves are timed on the same lists the program uses.
+ *
+ * @param fixture A pointer to the fixture
+ * @param records The number of users, vehicles and rents
+ * @return True if the fixture was built, false otherwise
+ */
+static bool buildFixture(Fixture *fixture, int records)
+{
+  bool res;
+  fixture->records = records;
+  fixture->vertexCount = records / 10 > 16 ? records / 10 : 16;
+  fixture->seed = SEED;
+  fixture->rentStore = createRentStore();
+  fixture->graph = createRoute();
+  fixture->smallGraph = createRoute();
+
+  Vertex **vertices = (Vertex **)malloc(fixture->vertexCount * sizeof(Vertex *));
+  if (vertices == NULL || fixture->rentStore == NULL)
+  {
+    perror("could not allocate memory!");
+    free(vertices);
+    return false;
+  }
+  for (int cod = fixture->vertexCount - 1; cod >= 0; cod--)
+  {
+    char city[NAME_SIZE];
+    cityName(city, cod);
+    vertices[cod] = createRouteVertex(city, cod);
+    fixture->graph = insertRouteVertex(fixture->graph, vertices[cod], &res);
+  }
+  for (int cod = 0; cod < fixture->vertexCount; cod++)
+  {
+    // the road to the next city ends up first in the list, depthFirstSearchRec follows it
+    for (int step = 3; step >= 1; step--)
+    {
+      if (cod + step < fixture->vertexCount)
+      {
+        Adj *adj = createAdj(cod + step, (float)(1 + randomBelow(fixture, 9)));
+        vertices[cod]->adjacents = insertAdj(vertices[cod]->adjacents, adj, &res);
+      }
+    }
+  }
+  free(vertices);
+
+  for (int cod = MAX - 1; cod >= 0; cod--)
+  {
+    char city[NAME_SIZE];
+    cityName(city, cod);
+    fixture->smallGraph = insertRouteVertex(fixture->smallGraph, createRouteVertex(city, cod), &res);
+  }
+  for (int cod = 0; cod < MAX; cod++)
+  {
+    fixture->smallGraph = insertAdjacentVertexCod(fixture->smallGraph, cod, (cod + 1) % MAX, 10.0f + cod, &res);
+    fixture->smallGraph = insertAdjacentVertexCod(fixture->smallGraph, cod, (cod + 2) % MAX, 25.0f + cod, &res);
+  }
+
+  for (int i = records - 1; i >= 0; i--)
+  {
+    User user = {0};
+    user.nif = i + 1;
+    snprintf(user.name, sizeof(user.name), "user-%d", i);
+    snprintf(user.email, sizeof(user.email), "user-%d@mail.pt", i);
+    strcpy(user.password, "password");
+    user.wallet = WALLET;
+    createUserList(&fixture->users, user);
+
+    Vehicle vehicle = {0};
+    vehicleRegistration(vehicle.registration, i);
+    strcpy(vehicle.type, i % 3 == 0 ? "bicicleta" : "trotinete");
+    cityName(vehicle.location, i % fixture->vertexCount);
+    vehicle.battery = randomBelow(fixture, 101);
+    vehicle.cost = 1 + randomBelow(fixture, 3);
+    createVehicleList(&fixture->vehicles, vehicle);
+  }
+  for (int i = 0; i < records; i++)
+  {
+    Rent rent = {0};
+    rent.id = nextRentId(fixture->rentStore);
+    vehicleRegistration(rent.vehicleRegistration, randomBelow(fixture, records));
+    rent.userNif = 1 + randomBelow(fixture, records);
+    rent.timeInMinutes = 1 + randomBelow(fixture, 120);
+    rent.price = rent.timeInMinutes;
+    createRentList(fixture->rentStore, rent);
+  }
+
+  unlink(fixture->pagerFile);
+  fixture->pager = openPager(fixture->pagerFile, PAGER_DEFAULT_CACHE_PAGES);
+  return fixture->users != NULL && fixture->vehicles != NULL && fixture->pager != NULL;
+}
+
+/**
+ * @brief Frees the stores and the graph of a fixture and removes its files
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void destroyFixture(Fixture *fixture)
+{
+  freeLoaded(fixture);
+  for (Vertex *vertex = fixture->graph; vertex != NULL; vertex = vertex->next)
+  {
+    char adjFile[100];
+    snprintf(adjFile, sizeof(adjFile), ADJ_FILE_FORMAT, vertex->city);
+    unlink(adjFile);
+  }
+  freeUsers(fixture->users);
+  freeVehicles(fixture->vehicles);
+  destroyRentStore(fixture->rentStore);
+  destroyRoutes(fixture->graph);
+  destroyRoutes(fixture->smallGraph);
+  if (fixture->pager != NULL)
+  {
+    closePager(fixture->pager);
+  }
+  fixture->users = NULL;
+  fixture->vehicles = NULL;
+  fixture->rentStore = NULL;
+  fixture->graph = NULL;
+  fixture->smallGraph = NULL;
+  fixture->pager = NULL;
+  fixture->pendingUser = false;
+  fixture->pendingVehicle = false;
+  fixture->pendingRent = false;
+  fixture->pendingRoad = false;
+  memset(fixture->inPager, 0, sizeof(fixture->inPager));
+  fixture->inAdjFiles = false;
+  unlink(fixture->usersFile);
+  unlink(fixture->vehiclesFile);
+  unlink(fixture->rentsFile);
+  unlink(fixture->seqFile);
+  unlink(fixture->verticesFile);
+  unlink(fixture->edgesFile);
+  unlink(fixture->warmFile);
+  unlink(fixture->pagerFile);
+}
+
+#pragma region PREPARE
+
+/**
+ * @brief Picks a random city
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickCod(Fixture *fixture)
+{
+  fixture->cod = randomBelow(fixture, fixture->vertexCount);
+  cityName(fixture->city, fixture->cod);
+}
+
+/**
+ * @brief Removes the road added by the last call of insertAdjacentVertexCod
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void undoRoadChange(Fixture *fixture)
+{
+  if (fixture->pendingRoad)
+  {
+    Vertex *vertex = searchVertexCod(fixture->graph, fixture->cod);
+    Adj *adj = vertex->adjacents;
+    if (adj != NULL && adj->cod == fixture->target)
+    {
+      vertex->adjacents = adj->next;
+      memFree(MEM_EDGES, adj);
+    }
+    fixture->pendingRoad = false;
+  }
+}
+
+/**
+ * @brief Picks a random road, which is removed again before the next one so the graph stays the same
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickRoad(Fixture *fixture)
+{
+  undoRoadChange(fixture);
+  fixture->cod = randomBelow(fixture, fixture->vertexCount);
+  fixture->target = randomBelow(fixture, fixture->vertexCount);
+  fixture->pendingRoad = true;
+}
+
+/**
+ * @brief Picks two cities eight roads apart and clears the visited flags of the graph
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickPath(Fixture *fixture)
+{
+  resetVisitedVertex(fixture->graph);
+  fixture->cod = randomBelow(fixture, fixture->vertexCount - 8);
+  fixture->target = fixture->cod + 8;
+}
+
+/**
+ * @brief Picks two cities close to the last one
+ *
+ * countPaths follows every path from the origin to the last city, so the origin stays close to it.
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickPathNearEnd(Fixture *fixture)
+{
+  fixture->cod = fixture->vertexCount - 12 + randomBelow(fixture, 4);
+  fixture->target = fixture->cod + 4;
+}
+
+/**
+ * @brief Picks a random vehicle and a copy of it with another battery level
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickVehicle(Fixture *fixture)
+{
+  vehicleRegistration(fixture->registration, randomBelow(fixture, fixture->records));
+  Vehicle *vehicle = searchVehicle(fixture->vehicles, fixture->registration);
+  if (vehicle != NULL)
+  {
+    fixture->vehicle = *vehicle;
+    fixture->vehicle.battery = randomBelow(fixture, 101);
+  }
+}
+
+/**
+ * @brief Gives every vehicle a random battery level, so each sort starts from an unsorted list
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void shuffleBatteries(Fixture *fixture)
+{
+  for (VehicleList *node = fixture->vehicles; node != NULL; node = node->next)
+  {
+    node->vehicle.battery = randomBelow(fixture, 101);
+  }
+}
+
+/**
+ * @brief Frees the vehicles collected by the last truck run and clears the visited flags of the graph
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareTruck(Fixture *fixture)
+{
+  freeLoaded(fixture);
+  resetVisitedVertex(fixture->graph);
+}
+
+/**
+ * @brief Removes the vehicle added by the last call, or adds back the one it deleted
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void undoVehicleChange(Fixture *fixture)
+{
+  if (fixture->pendingVehicle)
+  {
+    if (searchVehicle(fixture->vehicles, fixture->vehicle.registration) == NULL)
+    {
+      createVehicleList(&fixture->vehicles, fixture->vehicle);
+    }
+    else
+    {
+      deleteVehicle(&fixture->vehicles, fixture->vehicle.registration);
+    }
+    fixture->pendingVehicle = false;
+  }
+}
+
+/**
+ * @brief Picks a vehicle that is not in the list
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickNewVehicle(Fixture *fixture)
+{
+  undoVehicleChange(fixture);
+  memset(&fixture->vehicle, 0, sizeof(Vehicle));
+  snprintf(fixture->vehicle.registration, NAME_SIZE, "N%07d", randomBelow(fixture, 10000000));
+  strcpy(fixture->vehicle.type, "trotinete");
+  cityName(fixture->vehicle.location, randomBelow(fixture, fixture->vertexCount));
+  fixture->vehicle.cost = 1;
+  fixture->pendingVehicle = true;
+}
+
+/**
+ * @brief Picks a vehicle of the list to be deleted
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickVehicleToDelete(Fixture *fixture)
+{
+  undoVehicleChange(fixture);
+  pickVehicle(fixture);
+  fixture->pendingVehicle = true;
+}
+
+/**
+ * @brief Picks a random user and a copy of them with another phone
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickUser(Fixture *fixture)
+{
+  fixture->nif = 1 + randomBelow(fixture, fixture->records);
+  User *user = searchUser(fixture->users, fixture->nif);
+  if (user != NULL)
+  {
+    fixture->user = *user;
+    fixture->user.phone = randomBelow(fixture, 1000000000);
+  }
+}
+
+/**
+ * @brief Removes the user added by the last call, or adds back the one it deleted
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void undoUserChange(Fixture *fixture)
+{
+  if (fixture->pendingUser)
+  {
+    if (searchUser(fixture->users, fixture->user.nif) == NULL)
+    {
+      createUserList(&fixture->users, fixture->user);
+    }
+    else
+    {
+      deleteUser(&fixture->users, fixture->user.nif);
+    }
+    fixture->pendingUser = false;
+  }
+}
+
+/**
+ * @brief Picks a user that is not in the list
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickNewUser(Fixture *fixture)
+{
+  undoUserChange(fixture);
+  memset(&fixture->user, 0, sizeof(User));
+  fixture->user.nif = fixture->records + 1 + randomBelow(fixture, 1000000);
+  strcpy(fixture->user.name, "new user");
+  fixture->user.wallet = WALLET;
+  fixture->pendingUser = true;
+}
+
+/**
+ * @brief Picks a user of the list to be deleted
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickUserToDelete(Fixture *fixture)
+{
+  undoUserChange(fixture);
+  pickUser(fixture);
+  fixture->pendingUser = true;
+}
+
+/**
+ * @brief Picks a batch of credits and debits of one cent on random wallets
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickWalletDeltas(Fixture *fixture)
+{
+  for (int i = 0; i < WALLET_BATCH; i++)
+  {
+    fixture->deltas[i].nif = 1 + randomBelow(fixture, fixture->records);
+    fixture->deltas[i].delta = randomBelow(fixture, 2) == 0 ? 1 : -1;
+  }
+}
+
+/**
+ * @brief Picks a random user and a random vehicle, returned first if it is in use
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickFreeVehicle(Fixture *fixture)
+{
+  pickVehicle(fixture);
+  fixture->nif = 1 + randomBelow(fixture, fixture->records);
+  if (!isVehicleAvailable(fixture->vehicles, fixture->registration) &&
+      !returnVehicle(fixture->rentStore, fixture->registration, fixture->vehicles))
+  {
+    editVehicleAvailability(fixture->vehicles, fixture->registration, false);
+  }
+}
+
+/**
+ * @brief Picks a random vehicle, rented first if it is free
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickRentedVehicle(Fixture *fixture)
+{
+  Rent rent;
+  pickVehicle(fixture);
+  if (isVehicleAvailable(fixture->vehicles, fixture->registration))
+  {
+    rentVehicle(fixture->registration, 1 + randomBelow(fixture, fixture->records), 10, fixture->vehicles,
+                fixture->users, fixture->rentStore, &rent);
+  }
+}
+
+/**
+ * @brief Picks a random rent of the store and a copy of it with another time
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickRent(Fixture *fixture)
+{
+  RentList *node;
+  do
+  {
+    fixture->rentId = randomBelow(fixture, (int)fixture->rentStore->nextId);
+    node = searchRentById(fixture->rentStore, fixture->rentId);
+  } while (node == NULL);
+  fixture->rent = node->rent;
+  fixture->rent.timeInMinutes = 1 + randomBelow(fixture, 120);
+  fixture->nif = node->rent.userNif;
+  strcpy(fixture->registration, node->rent.vehicleRegistration);
+}
+
+/**
+ * @brief Removes the rent added by the last call, or adds back the one it removed
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void undoRentChange(Fixture *fixture)
+{
+  if (fixture->pendingRent)
+  {
+    if (searchRentById(fixture->rentStore, fixture->rent.id) == NULL)
+    {
+      createRentList(fixture->rentStore, fixture->rent);
+    }
+    else
+    {
+      removeRent(fixture->rentStore, fixture->rent.id);
+    }
+    fixture->pendingRent = false;
+  }
+}
+
+/**
+ * @brief Picks a rent that is not in the store
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickNewRent(Fixture *fixture)
+{
+  undoRentChange(fixture);
+  memset(&fixture->rent, 0, sizeof(Rent));
+  fixture->rent.id = nextRentId(fixture->rentStore);
+  vehicleRegistration(fixture->rent.vehicleRegistration, randomBelow(fixture, fixture->records));
+  fixture->rent.userNif = 1 + randomBelow(fixture, fixture->records);
+  fixture->rent.timeInMinutes = 10;
+  fixture->pendingRent = true;
+}
+
+/**
+ * @brief Picks a rent of the store to be removed
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void pickRentToRemove(Fixture *fixture)
+{
+  undoRentChange(fixture);
+  pickRent(fixture);
+  fixture->pendingRent = true;
+}
+
+#pragma endregion
+
+#pragma region RUN
+
+// each function calls one operation with the arguments picked by its prepare step
+
+static void runSearchVertexCod(Fixture *fixture)
+{
+  searchVertexCod(fixture->graph, fixture->cod);
+}
+
+static void runSearchVertex(Fixture *fixture)
+{
+  searchVertex(fixture->graph, fixture->city);
+}
+
+static void runInsertAdjacentVertexCod(Fixture *fixture)
+{
+  bool res;
+  fixture->graph = insertAdjacentVertexCod(fixture->graph, fixture->cod, fixture->target, 5, &res);
+}
+
+static void runDepthFirstSearchRec(Fixture *fixture)
+{
+  depthFirstSearchRec(fixture->graph, fixture->cod, fixture->target);
+}
+
+static void runCountPaths(Fixture *fixture)
+{
+  countPaths(fixture->graph, fixture->cod, fixture->target, 0);
+}
+
+static void runResetVisitedVertex(Fixture *fixture)
+{
+  resetVisitedVertex(fixture->graph);
+}
+
+static void runBestPath(Fixture *fixture)
+{
+  bestPath(fixture->smallGraph, MAX, 0);
+}
+
+static void runCheckVehiclesInRadius(Fixture *fixture)
+{
+  checkVehiclesInRadius(fixture->graph, fixture->vehicles, fixture->cod, RADIUS, "trotinete");
+}
+
+static void runRecoverTruck(Fixture *fixture)
+{
+  // a truck as large as the fleet is never full, so it makes one run and leaves the vehicles where they are
+  fixture->loadedVehicles = recoverTruck(fixture->graph, &fixture->vehicles, fixture->records);
+}
+
+static void runSearchVehicle(Fixture *fixture)
+{
+  searchVehicle(fixture->vehicles, fixture->registration);
+}
+
+static void runIsVehicleAvailable(Fixture *fixture)
+{
+  isVehicleAvailable(fixture->vehicles, fixture->registration);
+}
+
+static void runEditVehicle(Fixture *fixture)
+{
+  editVehicle(fixture->vehicles, fixture->registration, fixture->vehicle);
+}
+
+static void runEditVehicleAvailability(Fixture *fixture)
+{
+  editVehicleAvailability(fixture->vehicles, fixture->registration, fixture->vehicle.isInUse);
+}
+
+static void runCreateVehicleList(Fixture *fixture)
+{
+  createVehicleList(&fixture->vehicles, fixture->vehicle);
+}
+
+static void runDeleteVehicle(Fixture *fixture)
+{
+  deleteVehicle(&fixture->vehicles, fixture->registration);
+}
+
+static void runSortVehicleListDesc(Fixture *fixture)
+{
+  sortVehicleListDesc(&fixture->vehicles);
+}
+
+static void runSearchUser(Fixture *fixture)
+{
+  searchUser(fixture->users, fixture->nif);
+}
+
+static void runEditUser(Fixture *fixture)
+{
+  editUser(fixture->users, fixture->nif, fixture->user);
+}
+
+static void runUpdateUserWallet(Fixture *fixture)
+{
+  updateUserWallet(fixture->users, fixture->nif, 1);
+}
+
+static void runUpdateUserWalletBatch(Fixture *fixture)
+{
+  WalletStatus status[WALLET_BATCH];
+  int rejected;
+  updateUserWalletBatch(fixture->users, fixture->deltas, WALLET_BATCH, status, &rejected);
+}
+
+static void runCreateUserList(Fixture *fixture)
+{
+  createUserList(&fixture->users, fixture->user);
+}
+
+static void runDeleteUser(Fixture *fixture)
+{
+  deleteUser(&fixture->users, fixture->nif);
+}
+
+static void runRentVehicle(Fixture *fixture)
+{
+  Rent rent;
+  rentVehicle(fixture->registration, fixture->nif, 10, fixture->vehicles, fixture->users, fixture->rentStore, &rent);
+}
+
+static void runReturnVehicle(Fixture *fixture)
+{
+  returnVehicle(fixture->rentStore, fixture->registration, fixture->vehicles);
+}
+
+static void runCalculateRentPrice(Fixture *fixture)
+{
+  calculateRentPrice(fixture->vehicles, fixture->registration, 10);
+}
+
+static void runSearchRentById(Fixture *fixture)
+{
+  searchRentById(fixture->rentStore, fixture->rentId);
+}
+
+static void runSearchRentsByUser(Fixture *fixture)
+{
+  searchRentsByUser(fixture->rentStore, fixture->nif);
+}
+
+static void runSearchRentsByVehicle(Fixture *fixture)
+{
+  searchRentsByVehicle(fixture->rentStore, fixture->registration);
+}
+
+static void runEditRent(Fixture *fixture)
+{
+  editRent(fixture->rentStore, fixture->rentId, fixture->rent);
+}
+
+static void runCreateRentList(Fixture *fixture)
+{
+  createRentList(fixture->rentStore, fixture->rent);
+}
+
+static void runRemoveRent(Fixture *fixture)
+{
+  removeRent(fixture->rentStore, fixture->rentId);
+}
+
+static void runCountRents(Fixture *fixture)
+{
+  countRents(fixture->rentStore->head);
+}
+
+static void runStoreUsersInFile(Fixture *fixture)
+{
+  storeUsersInFile(fixture->users, fixture->usersFile);
+}
+
+static void runStoreVehicleListInFile(Fixture *fixture)
+{
+  storeVehicleListInFile(fixture->vehicles, fixture->vehiclesFile);
+}
+
+static void runStoreRentsInFile(Fixture *fixture)
+{
+  storeRentsInFile(fixture->rentStore, fixture->rentsFile, fixture->seqFile);
+}
+
+static void runLoadRentsFromFile(Fixture *fixture)
+{
+  loadRentsFromFile(fixture->loadedRents, fixture->rentsFile, fixture->seqFile);
+}
+
+static void runSaveVertices(Fixture *fixture)
+{
+  saveVertices(fixture->graph, fixture->verticesFile);
+}
+
+static void runLoadGraph(Fixture *fixture)
+{
+  bool res;
+  fixture->loadedGraph = loadGraph(NULL, fixture->verticesFile, &res);
+}
+
+static void runSaveGraph(Fixture *fixture)
+{
+  fixture->inAdjFiles = saveGraph(fixture->graph, fixture->verticesFile) == 1;
+}
+
+static void runLoadAdj(Fixture *fixture)
+{
+  bool res;
+  fixture->loadedGraph = loadAdj(fixture->loadedGraph, &res);
+}
+
+static void runSaveGraphEdges(Fixture *fixture)
+{
+  saveGraphEdges(fixture->graph, fixture->edgesFile);
+}
+
+static void runLoadGraphEdges(Fixture *fixture)
+{
+  bool res;
+  fixture->loadedGraph = loadGraphEdges(fixture->loadedGraph, fixture->edgesFile, &res);
+}
+
+static void runStoreUsersInPager(Fixture *fixture)
+{
+  fixture->inPager[0] = storeUsersInPager(fixture->pager, fixture->users);
+}
+
+static void runLoadUsersFromPager(Fixture *fixture)
+{
+  loadUsersFromPager(fixture->pager, &fixture->loadedUsers);
+}
+
+static void runStoreVehiclesInPager(Fixture *fixture)
+{
+  fixture->inPager[1] = storeVehiclesInPager(fixture->pager, fixture->vehicles);
+}
+
+static void runLoadVehiclesFromPager(Fixture *fixture)
+{
+  loadVehiclesFromPager(fixture->pager, &fixture->loadedVehicles);
+}
+
+static void runStoreRentsInPager(Fixture *fixture)
+{
+  fixture->inPager[2] = storeRentsInPager(fixture->pager, fixture->rentStore);
+}
+
+static void runLoadRentsFromPager(Fixture *fixture)
+{
+  loadRentsFromPager(fixture->pager, fixture->loadedRents);
+}
+
+static void runSaveGraphInPager(Fixture *fixture)
+{
+  fixture->inPager[3] = saveGraphInPager(fixture->pager, fixture->graph);
+}
+
+static void runLoadGraphFromPager(Fixture *fixture)
+{
+  bool res;
+  fixture->loadedGraph = loadGraphFromPager(fixture->pager, NULL, &res);
+}
+
+static void runWriteWarmImage(Fixture *fixture)
+{
+  writeWarmImage(fixture->warmFile, fixture->users, fixture->vehicles, fixture->rentStore, fixture->graph);
+}
+
+static void runOpenWarmImage(Fixture *fixture)
+{
+  closeWarmImage(openWarmImage(fixture->warmFile));
+}
+
+#pragma endregion
+
+#pragma region PREPARE_LOAD
+
+/**
+ * @brief Frees the last rents loaded and makes sure the rents file exists
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareRentsFile(Fixture *fixture)
+{
+  freeLoaded(fixture);
+  if (access(fixture->seqFile, F_OK) != 0)
+  {
+    storeRentsInFile(fixture->rentStore, fixture->rentsFile, fixture->seqFile);
+  }
+  fixture->loadedRents = createRentStore();
+}
+
+/**
+ * @brief Frees the last graph loaded and makes sure the vertices file exists
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareVerticesFile(Fixture *fixture)
+{
+  freeLoaded(fixture);
+  if (access(fixture->verticesFile, F_OK) != 0)
+  {
+    saveVertices(fixture->graph, fixture->verticesFile);
+  }
+}
+
+/**
+ * @brief Loads the vertices of the graph without their roads, after making sure saveGraph wrote the adjacency files
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareAdjFiles(Fixture *fixture)
+{
+  bool res;
+  freeLoaded(fixture);
+  if (!fixture->inAdjFiles)
+  {
+    runSaveGraph(fixture);
+  }
+  fixture->loadedGraph = loadGraph(NULL, fixture->verticesFile, &res);
+}
+
+/**
+ * @brief Loads the vertices of the graph without their roads, after making sure the edge file exists
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareEdgesFile(Fixture *fixture)
+{
+  bool res;
+  prepareVerticesFile(fixture);
+  if (access(fixture->edgesFile, F_OK) != 0)
+  {
+    saveGraphEdges(fixture->graph, fixture->edgesFile);
+  }
+  fixture->loadedGraph = loadGraph(NULL, fixture->verticesFile, &res);
+}
+
+/**
+ * @brief Makes sure the warm start image exists
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareWarmFile(Fixture *fixture)
+{
+  if (access(fixture->warmFile, F_OK) != 0)
+  {
+    writeWarmImage(fixture->warmFile, fixture->users, fixture->vehicles, fixture->rentStore, fixture->graph);
+  }
+}
+
+/**
+ * @brief Frees the last users loaded and makes sure the pager holds the users
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareUsersInPager(Fixture *fixture)
+{
+  freeLoaded(fixture);
+  if (!fixture->inPager[0])
+  {
+    runStoreUsersInPager(fixture);
+  }
+}
+
+/**
+ * @brief Frees the last vehicles loaded and makes sure the pager holds the vehicles
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareVehiclesInPager(Fixture *fixture)
+{
+  freeLoaded(fixture);
+  if (!fixture->inPager[1])
+  {
+    runStoreVehiclesInPager(fixture);
+  }
+}
+
+/**
+ * @brief Frees the last rents loaded and makes sure the pager holds the rents
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareRentsInPager(Fixture *fixture)
+{
+  freeLoaded(fixture);
+  if (!fixture->inPager[2])
+  {
+    runStoreRentsInPager(fixture);
+  }
+  fixture->loadedRents = createRentStore();
+}
+
+/**
+ * @brief Frees the last graph loaded and makes sure the pager holds the graph
+ *
+ * @param fixture A pointer to the fixture
+ */
+static void prepareGraphInPager(Fixture *fixture)
+{
+  freeLoaded(fixture);
+  if (!fixture->inPager[3])
+  {
+    runSaveGraphInPager(fixture);
+  }
+}
+
+#pragma endregion
+
+static Benchmark benchmarks[] = {
+    {.group = "routes", .operation = "searchVertexCod", .prepare = pickCod, .run = runSearchVertexCod},
+    {.group = "routes", .operation = "searchVertex", .prepare = pickCod, .run = runSearchVertex},
+    {.group = "routes", .operation = "insertAdjacentVertexCod", .prepare = pickRoad, .run = runInsertAdjacentVertexCod},
+    {.group = "routes", .operation = "resetVisitedVertex", .run = runResetVisitedVertex},
+    {.group = "routes", .operation = "depthFirstSearchRec", .prepare = pickPath, .run = runDepthFirstSearchRec},
+    {.group = "routes", .operation = "countPaths", .prepare = pickPathNearEnd, .run = runCountPaths},
+    {.group = "routes", .operation = "bestPath", .run = runBestPath, .fixedSize = true},
+    {.group = "vehicles", .operation = "searchVehicle", .prepare = pickVehicle, .run = runSearchVehicle},
+    {.group = "vehicles", .operation = "isVehicleAvailable", .prepare = pickVehicle, .run = runIsVehicleAvailable},
+    {.group = "vehicles", .operation = "editVehicle", .prepare = pickVehicle, .run = runEditVehicle},
+    {.group = "vehicles", .operation = "editVehicleAvailability", .prepare = pickVehicle,
+     .run = runEditVehicleAvailability},
+    {.group = "vehicles", .operation = "createVehicleList", .prepare = pickNewVehicle, .run = runCreateVehicleList},
+    {.group = "vehicles", .operation = "deleteVehicle", .prepare = pickVehicleToDelete, .run = runDeleteVehicle},
+    {.group = "vehicles", .operation = "sortVehicleListDesc", .prepare = shuffleBatteries,
+     .run = runSortVehicleListDesc},
+    {.group = "vehicles", .operation = "checkVehiclesInRadius", .prepare = pickCod, .run = runCheckVehiclesInRadius},
+    {.group = "vehicles", .operation = "recoverTruck", .prepare = prepareTruck, .run = runRecoverTruck},
+    {.group = "users", .operation = "searchUser", .prepare = pickUser, .run = runSearchUser},
+    {.group = "users", .operation = "editUser", .prepare = pickUser, .run = runEditUser},
+    {.group = "users", .operation = "updateUserWallet", .prepare = pickUser, .run = runUpdateUserWallet},
+    {.group = "users", .operation = "updateUserWalletBatch", .prepare = pickWalletDeltas,
+     .run = runUpdateUserWalletBatch},
+    {.group = "users", .operation = "createUserList", .prepare = pickNewUser, .run = runCreateUserList},
+    {.group = "users", .operation = "deleteUser", .prepare = pickUserToDelete, .run = runDeleteUser},
+    {.group = "rentals", .operation = "rentVehicle", .prepare = pickFreeVehicle, .run = runRentVehicle},
+    {.group = "rentals", .operation = "returnVehicle", .prepare = pickRentedVehicle, .run = runReturnVehicle},
+    {.group = "rentals", .operation = "calculateRentPrice", .prepare = pickVehicle, .run = runCalculateRentPrice},
+    {.group = "rentals", .operation = "searchRentById", .prepare = pickRent, .run = runSearchRentById},
+    {.group = "rentals", .operation = "searchRentsByUser", .prepare = pickRent, .run = runSearchRentsByUser},
+    {.group = "rentals", .operation = "searchRentsByVehicle", .prepare = pickRent, .run = runSearchRentsByVehicle},
+    {.group = "rentals", .operation = "editRent", .prepare = pickRent, .run = runEditRent},
+    {.group = "rentals", .operation = "createRentList", .prepare = pickNewRent, .run = runCreateRentList},
+    {.group = "rentals", .operation = "removeRent", .prepare = pickRentToRemove, .run = runRemoveRent},
+    {.group = "rentals", .operation = "countRents", .run = runCountRents},
+    {.group = "files", .operation = "storeUsersInFile", .run = runStoreUsersInFile},
+    {.group = "files", .operation = "storeVehicleListInFile", .run = runStoreVehicleListInFile},
+    {.group = "files", .operation = "storeRentsInFile", .run = runStoreRentsInFile},
+    {.group = "files", .operation = "loadRentsFromFile", .prepare = prepareRentsFile, .run = runLoadRentsFromFile},
+    {.group = "files", .operation = "saveVertices", .run = runSaveVertices},
+    {.group = "files", .operation = "loadGraph", .prepare = prepareVerticesFile, .run = runLoadGraph},
+    {.group = "files", .operation = "saveGraph", .run = runSaveGraph},
+    {.group = "files", .operation = "loadAdj", .prepare = prepareAdjFiles, .run = runLoadAdj},
+    {.group = "files", .operation = "saveGraphEdges", .run = runSaveGraphEdges},
+    {.group = "files", .operation = "loadGraphEdges", .prepare = prepareEdgesFile, .run = runLoadGraphEdges},
+    {.group = "files", .operation = "storeUsersInPager", .run = runStoreUsersInPager},
+    {.group = "files", .operation = "loadUsersFromPager", .prepare = prepareUsersInPager, .run = runLoadUsersFromPager},
+    {.group = "files", .operation = "storeVehiclesInPager", .run = runStoreVehiclesInPager},
+    {.group = "files", .operation = "loadVehiclesFromPager", .prepare = prepareVehiclesInPager,
+     .run = runLoadVehiclesFromPager},
+    {.group = "files", .operation = "storeRentsInPager", .run = runStoreRentsInPager},
+    {.group = "files", .operation = "loadRentsFromPager", .prepare = prepareRentsInPager, .run = runLoadRentsFromPager},
+    {.group = "files", .operation = "saveGraphInPager", .run = runSaveGraphInPager},
+    {.group = "files", .operation = "loadGraphFromPager", .prepare = prepareGraphInPager, .run = runLoadGraphFromPager},
+    {.group = "files", .operation = "writeWarmImage", .run = runWriteWarmImage},
+    {.group = "files", .operation = "openWarmImage", .prepare = prepareWarmFile, .run = runOpenWarmImage},
+};
+
+/**
+ * @brief Compares two latencies for qsort
+ *
+ * @param a A pointer to a latency
+ * @param b A pointer to the other latency
+ * @return Negative, zero or positive as a is lower, equal or higher than b
+ */
+static int compareLatencies(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Gets a percentile of sorted latencies
+ *
+ * @param latencies The latencies, ascending
+ * @param count The number of latencies
+ * @param fraction The percentile, between 0 and 1
+ * @return The latency in nanoseconds
+ */
+static double percentile(double *latencies, long count, double fraction)
+{
+  long index = (long)(fraction * count);
+  return latencies[index < count ? index : count - 1] * 1e9;
+}
+
+/**
+ * @brief Times an operation and writes its result as a JSON object
+ *
+ * @param json The report
+ * @param benchmark A pointer to the operation
+ * @param fixture A pointer to the fixture
+ * @param budget The seconds that can be spent on the operation
+ * @param latencies Room for maxSamples latencies
+ * @param maxSamples The largest number of calls
+ * @param first True for the first result of the report
+ */
+static void runBenchmark(FILE *json, Benchmark *benchmark, Fixture *fixture, double budget, double *latencies, long maxSamples, bool first)
+{
+  int records = benchmark->fixedSize ? MAX : fixture->records;
+  double expected = 0;
+  if (benchmark->lastMedian > 0)
+  {
+    // growth seen between the last two sizes, or linear if there is only one
+    double growth = benchmark->previousMedian > 0 ? benchmark->lastMedian / benchmark->previousMedian : 10;
+    expected = benchmark->lastMedian * (growth > 10 ? growth : 10);
+  }
+
+  fprintf(json, "%s\n    {\"group\": \"%s\", \"operation\": \"%s\", \"records\": %d", first ? "" : ",",
+          benchmark->group, benchmark->operation, records);
+  if (!benchmark->fixedSize && expected > budget * SKIP_FACTOR)
+  {
+    fprintf(json, ", \"skipped\": true, \"expected_seconds\": %.3f}", expected);
+    benchmark->previousMedian = benchmark->lastMedian;
+    benchmark->lastMedian = expected;
+    return;
+  }
+
+  long samples = 0;
+  double timed = 0;
+  double deadline = now() + budget;
+  do
+  {
+    if (benchmark->prepare != NULL)
+    {
+      benchmark->prepare(fixture);
+    }
+    double start = now();
+    benchmark->run(fixture);
+    double elapsed = now() - start;
+    latencies[samples++] = elapsed;
+    timed += elapsed;
+  } while (samples < maxSamples && now() < deadline);
+
+  qsort(latencies, samples, sizeof(double), compareLatencies);
+  fprintf(json,
+          ", \"samples\": %ld, \"ops_per_second\": %.1f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f, "
+          "\"max_ns\": %.0f}",
+          samples, samples / timed, percentile(latencies, samples, 0.5), percentile(latencies, samples, 0.99),
+          percentile(latencies, samples, 0.999), latencies[samples - 1] * 1e9);
+  fflush(json);
+  benchmark->previousMedian = benchmark->lastMedian;
+  benchmark->lastMedian = latencies[samples / 2];
+}
+
+int main(int argc, char *argv[])
+{
+  int maxRecords = argc > 1 ? atoi(argv[1]) : 1000000;
+  double budget = argc > 2 ? atof(argv[2]) : 0.25;
+  long maxSamples = argc > 3 ? atol(argv[3]) : 100000;
+  char *directory = argc > 4 ? argv[4] : ".";
+  int benchmarkCount = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+  // saveGraph and loadAdj use ./saved-data/vertex-adj, so the suite works in a scratch directory of its own
+  char scratch[512];
+  snprintf(scratch, sizeof(scratch), "%s/%s", directory, SCRATCH_DIRECTORY);
+  mkdir(scratch, 0755);
+  if (chdir(scratch) != 0 || (mkdir("./saved-data", 0755) != 0 && errno != EEXIST) ||
+      (mkdir("./saved-data/vertex-adj", 0755) != 0 && errno != EEXIST))
+  {
+    perror("could not create the scratch directory");
+    return 1;
+  }
+
+  Fixture fixture = {0};
+  strcpy(fixture.usersFile, "./suite_bench-users.bin");
+  strcpy(fixture.vehiclesFile, "./suite_bench-vehicles.bin");
+  strcpy(fixture.rentsFile, "./suite_bench-rents.bin");
+  strcpy(fixture.seqFile, "./suite_bench-rents-seq.bin");
+  strcpy(fixture.verticesFile, "./suite_bench-vertices.bin");
+  strcpy(fixture.edgesFile, "./suite_bench-edges.bin");
+  strcpy(fixture.warmFile, "./suite_bench.img");
+  strcpy(fixture.pagerFile, "./suite_bench.db");
+  double *latencies = (double *)malloc(maxSamples * sizeof(double));
+  if (latencies == NULL || maxSamples < 1)
+  {
+    perror("could not allocate memory!");
+    return 1;
+  }
+
+  // the operations print what they find, the report keeps stdout for itself
+  fflush(stdout);
+  FILE *json = fdopen(dup(STDOUT_FILENO), "w");
+  if (json == NULL || freopen("/dev/null", "w", stdout) == NULL)
+  {
+    perror("could not redirect stdout");
+    return 1;
+  }
+
+  fprintf(json, "{\n  \"benchmark\": \"suite_bench\",\n  \"seed\": %d,\n  \"budget_seconds\": %.3f,\n"
+                "  \"max_samples\": %ld,\n  \"results\": [",
+          SEED, budget, maxSamples);
+  bool first = true;
+  for (int records = 1000; records <= maxRecords; records *= 10)
+  {
+    if (!buildFixture(&fixture, records))
+    {
+      return 1;
+    }
+    for (int i = 0; i < benchmarkCount; i++)
+    {
+      if (!benchmarks[i].fixedSize || records == 1000)
+      {
+        fixture.seed = SEED + i;
+        runBenchmark(json, &benchmarks[i], &fixture, budget, latencies, maxSamples, first);
+        first = false;
+      }
+      // the next operation starts from the same stores, whatever this one left pending
+      undoUserChange(&fixture);
+      undoVehicleChange(&fixture);
+      undoRentChange(&fixture);
+      undoRoadChange(&fixture);
+    }
+    destroyFixture(&fixture);
+  }
+  fprintf(json, "\n  ]\n}\n");
+  fclose(json);
+  free(latencies);
+  rmdir("./saved-data/vertex-adj");
+  rmdir("./saved-data");
+  if (chdir("..") == 0)
+  {
+    rmdir(SCRATCH_DIRECTORY);
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file timerwheel_bench.c
+ * @brief Expiry benchmark for the hierarchical timer wheel
+ *
+ * Schedules a number of open rents (2M by default) ending at random seconds over the next days, then advances the
+ * wheel one second at a time until all of them expired. Every timer must come out on the exact tick it was
+ * scheduled for. The cost per tick is compared with a scan of every open rent, which is what checking the rents
+ * one by one would cost.
+ *
+ * Usage: timerwheel_bench [rents] [days]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../models/timerwheel.h"
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  long rents = argc > 1 ? atol(argv[1]) : 2000000;
+  int days = argc > 2 ? atoi(argv[2]) : 3;
+  int64_t start = 1700000000;
+  int64_t span = (int64_t)days * 86400;
+
+  TimerWheel *wheel = malloc(sizeof(TimerWheel));
+  TimerNode *timers = malloc(rents * sizeof(TimerNode));
+  unsigned int seed = 11;
+  initTimerWheel(wheel, start);
+
+  double begin = now();
+  for (long i = 0; i < rents; i++)
+  {
+    timers[i].previous = NULL;
+    timerWheelAdd(wheel, &timers[i], start + 1 + ((int64_t)rand_r(&seed) << 16 ^ rand_r(&seed)) % span);
+  }
+  double addTime = now() - begin;
+
+  // cancel one rent in ten, as if it was returned early
+  for (long i = 0; i < rents; i += 10)
+    timerWheelRemove(wheel, &timers[i]);
+  long expected = rents - (rents + 9) / 10;
+
+  double scanStart = now();
+  int64_t sink = 0;
+  for (int tick = 0; tick < 20; tick++)
+    for (long i = 0; i < rents; i++)
+      sink += timers[i].expires <= start + tick;
+  double scanTime = (now() - scanStart) / 20;
+
+  long expired = 0, late = 0;
+  double worstTick = 0;
+  begin = now();
+  for (int64_t tick = start + 1; tick <= start + span; tick++)
+  {
+    double tickStart = now();
+    for (TimerNode *timer = timerWheelAdvance(wheel, tick); timer != NULL; timer = timer->next)
+    {
+      expired++;
+      if (timer->expires != tick)
+        late++;
+    }
+    double tickTime = now() - tickStart;
+    if (tickTime > worstTick)
+      worstTick = tickTime;
+  }
+  double advanceTime = now() - begin;
+
+  printf("rents: %ld  ticks: %lld  (%lld)\n", rents, (long long)span, (long long)sink);
+  printf("add:           %10.1f ns/rent\n", addTime / rents * 1e9);
+  printf("wheel tick:    %10.1f us/tick (worst %.1f us)\n", advanceTime / span * 1e6, worstTick * 1e6);
+  printf("scan per tick: %10.1f us/tick\n", scanTime * 1e6);
+  printf("expired: %ld (expected %ld)  off tick: %ld  %s\n", expired, expected, late,
+         expired == expected && late == 0 && wheel->count == 0 ? "OK" : "MISMATCH");
+
+  int ok = expired == expected && late == 0 && wheel->count == 0;
+  free(timers);
+  free(wheel);
+  return ok ? 0 : 1;
+}
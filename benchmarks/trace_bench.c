@@ -0,0 +1,193 @@
+/**
+ * @file trace_bench.c
+ * @brief Overhead benchmark for the trace scopes
+ *
+ * Runs an empty traced function in a loop with tracing off and on, from one thread and then from several at once,
+ * and reports the cost per event: a call records a begin and an end event, so its cost over the untraced loop is
+ * split between the two. The trace is then flushed and the JSON file is checked to hold one begin and one end per
+ * call still in the rings.
+ *
+ * Usage: trace_bench [calls per thread] [threads] [file]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../models/trace.h"
+
+typedef struct BenchThread
+{
+  pthread_t thread;
+  long calls;
+  double seconds;
+} BenchThread;
+
+static volatile long sink = 0;
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Gets the CPU time of the calling thread in seconds, so threads sharing a core are not charged for each other
+ *
+ * @return The CPU time in seconds
+ */
+static double threadTime()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief The function being traced, it does almost nothing so the loop measures the scope
+ *
+ * @param i The iteration
+ */
+static __attribute__((noinline)) void tracedCall(long i)
+{
+  TRACE_FUNCTION();
+  sink = i;
+}
+
+/**
+ * @brief The same function without the scope
+ *
+ * @param i The iteration
+ */
+static __attribute__((noinline)) void plainCall(long i)
+{
+  sink = i;
+}
+
+/**
+ * @brief Calls the traced function in a loop
+ *
+ * @param arg A pointer to the BenchThread
+ * @return NULL
+ */
+static void *runTraced(void *arg)
+{
+  BenchThread *bench = (BenchThread *)arg;
+  double start = threadTime();
+  for (long i = 0; i < bench->calls; i++)
+    tracedCall(i);
+  bench->seconds = threadTime() - start;
+  return NULL;
+}
+
+/**
+ * @brief Calls the untraced function in a loop
+ *
+ * @param arg A pointer to the BenchThread
+ * @return NULL
+ */
+static void *runPlain(void *arg)
+{
+  BenchThread *bench = (BenchThread *)arg;
+  double start = threadTime();
+  for (long i = 0; i < bench->calls; i++)
+    plainCall(i);
+  bench->seconds = threadTime() - start;
+  return NULL;
+}
+
+/**
+ * @brief Runs a loop on a number of threads and gets the nanoseconds per call
+ *
+ * @param threads The number of threads
+ * @param calls The calls per thread
+ * @param body The loop
+ * @return The mean CPU nanoseconds per call on a thread
+ */
+static double runThreads(int threads, long calls, void *(*body)(void *))
+{
+  BenchThread *benches = (BenchThread *)calloc(threads, sizeof(BenchThread));
+  double seconds = 0;
+  for (int t = 0; t < threads; t++)
+  {
+    benches[t].calls = calls;
+    pthread_create(&benches[t].thread, NULL, body, &benches[t]);
+  }
+  for (int t = 0; t < threads; t++)
+  {
+    pthread_join(benches[t].thread, NULL);
+    seconds += benches[t].seconds;
+  }
+  free(benches);
+  return seconds / threads / calls * 1e9;
+}
+
+/**
+ * @brief Counts the begin and end events of the traced function in a trace file
+ *
+ * @param fileName The path of the file
+ * @param begins Receives the number of begin events
+ * @param ends Receives the number of end events
+ * @return True if the file looks like a complete trace_event file, false otherwise
+ */
+static bool countEvents(char *fileName, long *begins, long *ends)
+{
+  FILE *fp = fopen(fileName, "r");
+  char line[256];
+  bool closed = false;
+  *begins = *ends = 0;
+  if (fp == NULL || fgets(line, sizeof(line), fp) == NULL || strncmp(line, "{\"traceEvents\":[", 16) != 0)
+    return false;
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    if (strstr(line, "\"name\":\"tracedCall\"") != NULL)
+    {
+      *begins += strstr(line, "\"ph\":\"B\"") != NULL;
+      *ends += strstr(line, "\"ph\":\"E\"") != NULL;
+    }
+    closed = closed || strncmp(line, "],", 2) == 0;
+  }
+  fclose(fp);
+  return closed;
+}
+
+int main(int argc, char *argv[])
+{
+  long calls = argc > 1 ? atol(argv[1]) : 10000000;
+  int threads = argc > 2 ? atoi(argv[2]) : 4;
+  char *fileName = argc > 3 ? argv[3] : "trace_bench.json";
+
+  double plain = runThreads(1, calls, runPlain);
+  double off = runThreads(1, calls, runTraced);
+  startTracing();
+  double on = runThreads(1, calls, runTraced);
+  double onThreads = runThreads(threads, calls, runTraced);
+  stopTracing();
+  double plainThreads = runThreads(threads, calls, runPlain);
+
+  printf("untraced call %.1f ns\n", plain);
+  printf("tracing off   %.1f ns per call, %.1f ns per event\n", off, (off - plain) / 2);
+  printf("tracing on    %.1f ns per call, %.1f ns per event\n", on, (on - plain) / 2);
+  printf("%d threads    %.1f ns per call, %.1f ns per event\n", threads, onThreads, (onThreads - plainThreads) / 2);
+
+  double start = now();
+  bool ok = flushTrace(fileName);
+  double flushTime = now() - start;
+  long begins, ends;
+  long perRing = TRACE_RING_EVENTS / 2; // each ring keeps about this many calls, one thread per run was traced
+  ok = ok && countEvents(fileName, &begins, &ends) && begins == ends && begins <= (1 + threads) * perRing &&
+       begins >= (calls < perRing ? calls : perRing - 1);
+  printf("flushed %ld begin and %ld end events in %.3f s  %s\n", begins, ends, flushTime, ok ? "OK" : "FAILED");
+  unlink(fileName);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+/**
+ * @file userstore_bench.c
+ * @brief Multi-threaded stress benchmark for the sharded user store
+ *
+ * Every thread applies random credits and debits to random wallets and keeps the sum of the ones that were accepted.
+ * At the end the total balance of the store must be the initial total plus every accepted delta, and no wallet can be
+ * negative. The run is repeated for 1, 2, 4, ... threads up to the number of cores to show how the throughput scales.
+ * Before that, a small batch of wallet deltas checks that updateUserWalletBatch tells a balance that would be negative
+ * from one that would overflow.
+ *
+ * Usage: userstore_bench [users] [operations per thread]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include "../models/userstore.h"
+#include "../models/memstats.h"
+
+#define INITIAL_WALLET 100
+
+typedef struct Worker
+{
+  pthread_t thread;
+  UserStore *store;
+  int users;
+  long operations;
+  unsigned long long seed;
+  long long accepted; // sum of every delta that was applied
+  long rejected;
+} Worker;
+
+/**
+ * @brief xorshift64* pseudo random generator, fixed seeds keep the runs reproducible
+ *
+ * @param state A pointer to the generator state
+ * @return The next pseudo random number
+ */
+static unsigned long long nextRandom(unsigned long long *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+/**
+ * @brief Thread body: random credits and debits on random wallets
+ *
+ * @param arg A pointer to the worker
+ * @return NULL
+ */
+static void *runWorker(void *arg)
+{
+  Worker *worker = (Worker *)arg;
+
+  for (long i = 0; i < worker->operations; i++)
+  {
+    unsigned long long r = nextRandom(&worker->seed);
+    int nif = 1 + (int)(r % worker->users);
+    int amount = 1 + (int)((r >> 32) % 100);
+
+    if ((r >> 40) & 1)
+    {
+      if (userStoreUpdateWallet(worker->store, nif, amount))
+        worker->accepted += amount;
+      else
+        worker->rejected++;
+    }
+    else
+    {
+      if (userStoreDebitIfSufficient(worker->store, nif, amount))
+        worker->accepted -= amount;
+      else
+        worker->rejected++;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Runs the stress test with a given number of threads and checks the balances
+ *
+ * @param users The number of users in the store
+ * @param threads The number of worker threads
+ * @param operations The number of operations per thread
+ * @return true if every balance is consistent, false otherwise
+ */
+static bool runStress(int users, int threads, long operations)
+{
+  UserStore *store = createUserStore();
+  if (store == NULL)
+    return false;
+
+  for (int nif = 1; nif <= users; nif++)
+  {
+    User user = {0};
+    user.nif = nif;
+    user.wallet = INITIAL_WALLET;
+    userStoreInsert(store, user);
+  }
+
+  long long initial = userStoreTotalBalance(store);
+  Worker *workers = (Worker *)calloc(threads, sizeof(Worker));
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < threads; i++)
+  {
+    workers[i].store = store;
+    workers[i].users = users;
+    workers[i].operations = operations;
+    workers[i].seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+    pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]);
+  }
+
+  long long accepted = 0;
+  long rejected = 0;
+  for (int i = 0; i < threads; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+    accepted += workers[i].accepted;
+    rejected += workers[i].rejected;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  long long total = userStoreTotalBalance(store);
+  bool consistent = total == initial + accepted;
+
+  for (int nif = 1; nif <= users && consistent; nif++)
+  {
+    User user;
+    consistent = userStoreGet(store, nif, &user) && user.wallet >= 0;
+  }
+
+  printf("threads: %2d  ops/s: %12.0f  rejected: %8ld  balance: %lld (expected %lld)  %s\n",
+         threads, (threads * operations) / seconds, rejected, total, initial + accepted,
+         consistent ? "OK" : "MISMATCH");
+
+  free(workers);
+  destroyUserStore(store);
+  return consistent;
+}
+
+/**
+ * @brief Applies a batch with every outcome to two users and checks the status of each delta
+ *
+ * @return true if every status, the refused deltas and the balances are the expected ones, false otherwise
+ */
+static bool checkWalletBatch()
+{
+  UserList *users = NULL;
+  User user = {0};
+  user.nif = 1;
+  user.wallet = 10;
+  createUserList(&users, user);
+  user.nif = 2;
+  user.wallet = INT_MAX - 5;
+  createUserList(&users, user);
+
+  WalletDelta deltas[] = {{1, -5}, {1, -10}, {2, 10}, {3, 1}, {2, -5}};
+  WalletStatus expected[] = {WALLET_UPDATED, WALLET_NEGATIVE_BALANCE, WALLET_OVERFLOW, WALLET_USER_NOT_FOUND,
+                             WALLET_UPDATED};
+  int count = sizeof(deltas) / sizeof(deltas[0]);
+  WalletStatus status[5];
+  int rejected[5];
+  int refused = updateUserWalletBatch(users, deltas, count, status, rejected);
+
+  bool ok = refused == 2 && searchUser(users, 1)->wallet == 5 && searchUser(users, 2)->wallet == INT_MAX - 10;
+  for (int i = 0; i < count; i++)
+    ok = ok && status[i] == expected[i];
+  // the refused deltas come in list order, and createUserList puts each user at the head
+  ok = ok && rejected[0] == 2 && rejected[1] == 1;
+  printf("wallet batch: %d refused, negative balance %d, overflow %d  %s\n", refused, status[1], status[2],
+         ok ? "OK" : "MISMATCH");
+
+  while (users != NULL)
+  {
+    UserList *next = users->next;
+    memFree(MEM_USERS, users);
+    users = next;
+  }
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  int users = argc > 1 ? atoi(argv[1]) : 100000;
+  long operations = argc > 2 ? atol(argv[2]) : 2000000;
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  bool ok = checkWalletBatch();
+  printf("user store stress: %d users, %ld operations per thread\n", users, operations);
+
+  for (int threads = 1; threads <= cores || threads == 1; threads *= 2)
+  {
+    ok = runStress(users, threads, operations) && ok;
+  }
+  if (cores > 1 && (cores & (cores - 1)) != 0)
+  {
+    ok = runStress(users, (int)cores, operations) && ok;
+  }
+
+  // a handful of hot wallets makes every thread fight for the same records
+  ok = runStress(8, cores > 1 ? (int)cores : 2, operations) && ok;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+/**
+ * @file warmstart_bench.c
+ * @brief Restart benchmark for the warm start image
+ *
+ * Fills the stores with users, vehicles, rents and a graph, then saves them in the paged storage file and in the
+ * warm start image. Both files are dropped from the OS page cache and the stores are brought back the way a
+ * restart would: from the paged file, loading every table and rebuilding the lists and their indexes, and from
+ * the image, mapping it. Each start is reported by phase, up to the answer of its first query. The image is then
+ * verified and turned back into lists, its lookups are checked against the original stores, and random lookups
+ * are timed. The image must have the generation of the rent files saved before it, and not of the ones saved after.
+ *
+ * Usage: warmstart_bench [records per store] [directory]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../models/pager.h"
+#include "../models/warmstart.h"
+
+#define GRAPH_VERTICES 1000
+#define GRAPH_EDGES_PER_VERTEX 5
+#define LOOKUPS 1000000
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Flushes a file to disk and drops it from the OS page cache
+ *
+ * @param fileName The path of the file
+ * @return The size of the file
+ */
+static long dropFromCache(char *fileName)
+{
+  int fd = open(fileName, O_RDONLY);
+  long size = lseek(fd, 0, SEEK_END);
+  fsync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+  return size;
+}
+
+/**
+ * @brief Checks the lookups of the image against the original stores
+ *
+ * @param image A pointer to the image
+ * @param users A pointer to the head node of the original user list
+ * @param vehicles A pointer to the head node of the original vehicle list
+ * @param rentStore A pointer to the original rent store
+ * @param graph A pointer to the head of the original graph
+ * @param count The number of records per store
+ * @return True if every lookup matches, false otherwise
+ */
+static bool sameStores(WarmImage *image, UserList *users, VehicleList *vehicles, RentStore *rentStore, Vertex *graph, int count)
+{
+  unsigned int seed = 9;
+  for (int i = 0; i < 1000; i++)
+  {
+    int nif = 1 + rand_r(&seed) % count;
+    char registration[50];
+    sprintf(registration, "V%d", nif - 1);
+    const User *user = warmFindUser(image, nif);
+    const Vehicle *vehicle = warmFindVehicle(image, registration);
+    const Rent *rent = warmFindRent(image, nif - 1);
+    RentList *node = searchRentById(rentStore, nif - 1);
+    if (user == NULL || memcmp(user, searchUser(users, nif), sizeof(User)) != 0 || vehicle == NULL ||
+        memcmp(vehicle, searchVehicle(vehicles, registration), sizeof(Vehicle)) != 0 || rent == NULL ||
+        node == NULL || memcmp(rent, &node->rent, sizeof(Rent)) != 0)
+      return false;
+
+    uint32_t rents = 0;
+    const uint32_t *list = warmRentsOfUser(image, rent->userNif, &rents);
+    if (list == NULL || rents != 1 || image->rents[list[0]].id != rent->id)
+      return false;
+    list = warmRentsOfVehicle(image, rent->vehicleRegistration, &rents);
+    if (list == NULL || rents != 1 || image->rents[list[0]].id != rent->id)
+      return false;
+  }
+
+  uint32_t rents;
+  if (warmFindUser(image, -1) != NULL || warmFindVehicle(image, "none") != NULL || warmFindRent(image, -1) != NULL ||
+      warmRentsOfUser(image, -1, &rents) != NULL)
+    return false;
+
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+  {
+    const WarmVertex *stored = warmFindVertex(image, vertex->cod);
+    const WarmEdge *edges = stored != NULL ? warmEdgesOf(image, stored) : NULL;
+    uint32_t e = 0;
+    if (edges == NULL || strcmp(stored->city, vertex->city) != 0)
+      return false;
+    for (Adj *adj = vertex->adjacents; adj != NULL; adj = adj->next, e++)
+      if (e >= stored->degree || edges[e].cod != adj->cod || edges[e].dist != adj->dist)
+        return false;
+    if (e != stored->degree)
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int count = argc > 1 ? atoi(argv[1]) : 1000000;
+  char *directory = argc > 2 ? argv[2] : ".";
+  char pagerFile[512];
+  char warmFile[512];
+  char rentsFile[512];
+  char seqFile[512];
+  snprintf(pagerFile, sizeof(pagerFile), "%s/warmstart_bench.db", directory);
+  snprintf(warmFile, sizeof(warmFile), "%s/warmstart_bench.img", directory);
+  snprintf(rentsFile, sizeof(rentsFile), "%s/warmstart_bench-rents.bin", directory);
+  snprintf(seqFile, sizeof(seqFile), "%s/warmstart_bench-rents-seq.bin", directory);
+
+  UserList *users = NULL;
+  VehicleList *vehicles = NULL;
+  RentStore *rentStore = createRentStore();
+  Vertex *graph = createRoute();
+  bool res;
+
+  for (int i = 0; i < count; i++)
+  {
+    User user = {0};
+    user.nif = i + 1;
+    sprintf(user.name, "user-%d", i);
+    user.wallet = 100;
+    createUserList(&users, user);
+
+    Vehicle vehicle = {0};
+    sprintf(vehicle.registration, "V%d", i);
+    strcpy(vehicle.type, "trotinete");
+    sprintf(vehicle.location, "city-%04d", i % GRAPH_VERTICES);
+    vehicle.cost = 1;
+    createVehicleList(&vehicles, vehicle);
+
+    Rent rent = {0};
+    rent.id = nextRentId(rentStore);
+    sprintf(rent.vehicleRegistration, "V%d", i);
+    rent.userNif = i + 1;
+    rent.timeInMinutes = 10;
+    createRentList(rentStore, rent);
+  }
+  for (int i = GRAPH_VERTICES - 1; i >= 0; i--)
+  {
+    char city[N];
+    sprintf(city, "city-%04d", i);
+    graph = insertRouteVertex(graph, createRouteVertex(city, i), &res);
+  }
+  for (int i = 0; i < GRAPH_VERTICES; i++)
+    for (int j = 1; j <= GRAPH_EDGES_PER_VERTEX; j++)
+      graph = insertAdjacentVertexCod(graph, i, (i + j * 7) % GRAPH_VERTICES, (float)j, &res);
+
+  unlink(pagerFile);
+  Pager *pager = openPager(pagerFile, PAGER_DEFAULT_CACHE_PAGES);
+  bool ok = pager != NULL && storeUsersInPager(pager, users) && storeVehiclesInPager(pager, vehicles) &&
+            storeRentsInPager(pager, rentStore) && saveGraphInPager(pager, graph);
+  ok = pager != NULL && closePager(pager) && ok;
+  // the image keeps the generation of the rent files written before it, as in a snapshot
+  ok = storeRentsInFile(rentStore, rentsFile, seqFile) && ok;
+  double start = now();
+  ok = writeWarmImage(warmFile, users, vehicles, rentStore, graph) && ok;
+  double writeTime = now() - start;
+  long pagerSize = dropFromCache(pagerFile);
+  long warmSize = dropFromCache(warmFile);
+  printf("records per store: %d  paged file: %.1f MB  warm image: %.1f MB, written in %.3f s\n", count,
+         pagerSize / 1e6, warmSize / 1e6, writeTime);
+  if (!ok)
+    return 1;
+
+  // restart from the paged file: every table is loaded before the first query
+  UserList *loadedUsers = NULL;
+  VehicleList *loadedVehicles = NULL;
+  RentStore *loadedRents = createRentStore();
+  Vertex *loadedGraph = createRoute();
+  double phase[6];
+  phase[0] = now();
+  pager = openPager(pagerFile, PAGER_DEFAULT_CACHE_PAGES);
+  phase[1] = now();
+  loadUsersFromPager(pager, &loadedUsers);
+  loadVehiclesFromPager(pager, &loadedVehicles);
+  phase[2] = now();
+  loadRentsFromPager(pager, loadedRents);
+  phase[3] = now();
+  loadedGraph = loadGraphFromPager(pager, loadedGraph, &res);
+  phase[4] = now();
+  ok = searchRentsByUser(loadedRents, count / 2) != NULL;
+  phase[5] = now();
+  closePager(pager);
+  double pagedStart = phase[5] - phase[0];
+  printf("paged file   open %8.3f ms  users+vehicles %8.3f ms  rents %8.3f ms  graph %8.3f ms  first query %.3f ms"
+         "  total %8.3f ms\n",
+         (phase[1] - phase[0]) * 1e3, (phase[2] - phase[1]) * 1e3, (phase[3] - phase[2]) * 1e3,
+         (phase[4] - phase[3]) * 1e3, (phase[5] - phase[4]) * 1e3, (phase[5] - phase[0]) * 1e3);
+
+  // restart from the image: the first query only faults in the pages it reads
+  uint32_t rents;
+  phase[0] = now();
+  WarmImage *image = openWarmImage(warmFile);
+  phase[1] = now();
+  ok = ok && image != NULL && warmRentsOfUser(image, count / 2, &rents) != NULL;
+  phase[2] = now();
+  printf("warm image   open %8.3f ms  first query %.3f ms  total %8.3f ms  %.0fx sooner\n",
+         (phase[1] - phase[0]) * 1e3, (phase[2] - phase[1]) * 1e3, (phase[2] - phase[0]) * 1e3,
+         pagedStart / (phase[2] - phase[0]));
+  if (!ok)
+    return 1;
+
+  phase[0] = now();
+  ok = verifyWarmImage(image);
+  phase[1] = now();
+  UserList *warmUsers = NULL;
+  VehicleList *warmVehicles = NULL;
+  warmLoadUsers(image, &warmUsers);
+  warmLoadVehicles(image, &warmVehicles);
+  phase[2] = now();
+  RentStore *warmRents = warmLoadRents(image, createRentStore());
+  phase[3] = now();
+  Vertex *warmGraph = warmLoadGraph(image, createRoute(), &res);
+  phase[4] = now();
+  ok = ok && res && searchRentById(warmRents, count - 1) != NULL && warmRents->nextId == rentStore->nextId &&
+       searchVehicle(warmVehicles, "V0") != NULL && searchUser(warmUsers, 1) != NULL && warmGraph != NULL;
+  printf("warm image   verify %8.3f ms  lists: users+vehicles %8.3f ms  rents %8.3f ms  graph %8.3f ms\n",
+         (phase[1] - phase[0]) * 1e3, (phase[2] - phase[1]) * 1e3, (phase[3] - phase[2]) * 1e3,
+         (phase[4] - phase[3]) * 1e3);
+
+  ok = ok && sameStores(image, users, vehicles, rentStore, graph, count);
+  bool isSameGeneration = image->header->generation == rentFilesGeneration(rentsFile, seqFile);
+  bool isNewerRents = storeRentsInFile(rentStore, rentsFile, seqFile) &&
+                      image->header->generation != rentFilesGeneration(rentsFile, seqFile);
+  printf("image has the generation of the rent files written with it: %s, not of the next ones: %s\n",
+         isSameGeneration ? "yes" : "no", isNewerRents ? "yes" : "no");
+  ok = ok && isSameGeneration && isNewerRents;
+  unsigned int seed = 7;
+  long found = 0;
+  start = now();
+  for (int i = 0; i < LOOKUPS; i++)
+    found += warmFindUser(image, 1 + rand_r(&seed) % count) != NULL;
+  double lookupTime = now() - start;
+  ok = ok && found == LOOKUPS;
+  printf("random user lookups in the image: %.0f ns each  %s\n", lookupTime / LOOKUPS * 1e9, ok ? "OK" : "FAILED");
+
+  closeWarmImage(image);
+  unlink(pagerFile);
+  unlink(warmFile);
+  unlink(rentsFile);
+  unlink(seqFile);
+  return ok ? 0 : 1;
+}
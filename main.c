@@ -13,21 +13,481 @@
 #include <string.h>
 #include <stdbool.h>
 #include <locale.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "./models/user.h"
 #include "./models/vehicle.h"
 #include "./models/rentals.h"
+#include "./models/rentlog.h"
 #include "./models/routes.h"
+#include "./models/snapshot.h"
+#include "./models/edgecodec.h"
+#include "./models/warmstart.h"
+#include "./models/metrics.h"
+#include "./models/trace.h"
+#include "./models/memstats.h"
+#include "./models/server.h"
+#include "./models/replay.h"
+#include "./models/userstore.h"
+#include "./models/analytics.h"
+
+/**
+ * @brief Checks that a file of saved-data was written after another one
+ *
+ * The snapshot writes edges.bin after the vertices and the adjacency lists, and the warm start image after every
+ * store, but the stores are also saved on their own: saveGraph rewrites the vertices and the adjacency lists, and the
+ * checkpoints of the rents log rewrite rents.bin. A file that is older than the one it stands for is out of date.
+ *
+ * @param fileName The path of the file
+ * @param otherFileName The path of the file it must not be older than
+ * @return True if the file exists and the other one does not or is not newer, false otherwise
+ */
+static bool isNotOlder(char *fileName, char *otherFileName)
+{
+  struct stat info;
+  struct stat other;
+
+  if (stat(fileName, &info) != 0)
+  {
+    return false;
+  }
+  if (stat(otherFileName, &other) != 0)
+  {
+    return true;
+  }
+  return info.st_mtim.tv_sec > other.st_mtim.tv_sec ||
+         (info.st_mtim.tv_sec == other.st_mtim.tv_sec && info.st_mtim.tv_nsec >= other.st_mtim.tv_nsec);
+}
+
+/**
+ * @brief Checks that a compressed edge file holds the weights exactly
+ *
+ * A graph with more distinct weights than the dictionary can hold is written with the weights rounded to
+ * 1 / EDGE_WEIGHT_SCALE, so only a dictionary coded file can stand for the adjacency lists.
+ *
+ * @param fileName The path of the file
+ * @return True if the file is a valid edge file with dictionary coded weights, false otherwise
+ */
+static bool isExactEdgeFile(char *fileName)
+{
+  EdgeFile *file = openEdgeFile(fileName);
+  bool isExact = file != NULL && file->coding == EDGE_WEIGHTS_DICTIONARY;
+
+  if (file != NULL)
+  {
+    closeEdgeFile(file);
+  }
+  return isExact;
+}
+
+/**
+ * @brief Prints the fleet counters: the vehicles free and in use, and the rents and revenue of today
+ *
+ * @param stats A pointer to the counters
+ */
+static void printFleetStats(FleetStats *stats)
+{
+  int64_t today = statsDay(time(NULL));
+  int64_t available = 0, inUse = 0, rents = 0, revenue = 0;
+  for (int location = 0; location < stats->locations.count; location++)
+  {
+    char *name = stats->locations.names[location];
+    for (int type = 0; type < stats->types.count; type++)
+    {
+      available += countFleetVehicles(stats, name, stats->types.names[type], false);
+      inUse += countFleetVehicles(stats, name, stats->types.names[type], true);
+    }
+    rents += countFleetRents(stats, name, today);
+    revenue += countFleetRevenue(stats, name, today);
+  }
+  printf("Fleet: %lld vehicles free and %lld in use in %d locations, %lld rents today for %lld\n",
+         (long long)available, (long long)inUse, stats->locations.count, (long long)rents, (long long)revenue);
+}
+
+/**
+ * @brief Gets the time of a monotonic clock
+ *
+ * @return The time in seconds
+ */
+static double monotonicSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Checks that a warm start image holds the users, vehicles and rents of saved-data
+ *
+ * The image keeps the generation of the rent files it was written with, and every save of the rents writes a new
+ * one, so the image stands for the rents only while rents-seq.bin holds the same generation. users.bin and
+ * vehicles.bin are never saved without the rents, so the image stands for them too.
+ *
+ * @param image A pointer to the image, or NULL
+ * @return True if the image holds the stores of the files, false otherwise
+ */
+static bool isCurrentImage(WarmImage *image)
+{
+  return image != NULL && image->header->generation == rentFilesGeneration(RENTS_FILE, RENTS_SEQ_FILE);
+}
+
+/**
+ * @brief Checks that the rents log holds no record, so no change was made after the last snapshot
+ *
+ * @param fileName The path of the log
+ * @return True if the log is empty or does not exist, false otherwise
+ */
+static bool isLogEmpty(char *fileName)
+{
+  struct stat info;
+  return stat(fileName, &info) != 0 || info.st_size == 0;
+}
+
+typedef struct SavedData // the stores of saved-data, and how long each phase of loading them took
+{
+  UserStore *userStore;
+  VehicleList *vehicleList;
+  RentStore *rentStore;
+  Vertex *graph;
+  FleetStats *fleetStats; // attached, freed with destroyFleetStats
+  RentLog *rentLog;       // opened once the stores are loaded, by serve
+  bool isWarm;            // at least one store came from the warm start image
+  double buildSeconds;    // lists built from the image or read from the files
+  double verifySeconds;   // CRC32C of the image checked, after the lists were built from it
+  double replaySeconds;   // rents log replayed on top of the rents
+  double indexSeconds;    // fleet counters and user store built
+} SavedData;
+
+/**
+ * @brief Frees the users, vehicles, rents and graph built from a warm start image that turned out to be damaged
+ *
+ * @param userList A pointer to the head node of the user list, set to NULL
+ * @param data A pointer to the stores, the rent store is replaced by an empty one
+ * @return True if the empty rent store could be created, false otherwise
+ */
+static bool discardWarmStores(UserList **userList, SavedData *data)
+{
+  while (*userList != NULL)
+  {
+    UserList *next = (*userList)->next;
+    memFree(MEM_USERS, *userList);
+    *userList = next;
+  }
+  while (data->vehicleList != NULL)
+  {
+    VehicleList *next = data->vehicleList->next;
+    memFree(MEM_VEHICLES, data->vehicleList);
+    data->vehicleList = next;
+  }
+  data->graph = destroyRoutes(data->graph);
+  destroyRentStore(data->rentStore);
+  data->rentStore = createRentStore();
+  return data->rentStore != NULL;
+}
+
+/**
+ * @brief Loads the users, vehicles, rents and graph of saved-data
+ *
+ * Run recoverSnapshot first, so a snapshot that was committed but not yet renamed into place is finished. The users,
+ * vehicles and rents are rebuilt from the warm start image when its header validates and it has the generation of the
+ * rent files, and the graph when the image has one that is not older than the graph files; every other store is read
+ * from its files. The CRC32C of the image is only checked once the lists were built from it, and a damaged image is
+ * thrown away with them and the stores read from the files instead. The rents log is replayed on top of the rents
+ * either way, claiming and releasing the vehicles and changing the wallets as it goes. The fleet counters are built
+ * from the vehicles and attached, so every later change of a vehicle or rent keeps them up to date; the revenue counts
+ * the rents made from then on.
+ *
+ * @param data Receives the stores and the time of each phase
+ * @return True if the stores could be created, false otherwise
+ */
+static bool loadSavedData(SavedData *data)
+{
+  UserList *userList = NULL;
+  bool res;
+
+  data->rentStore = createRentStore();
+  if (data->rentStore == NULL)
+  {
+    return false;
+  }
+
+  double start = monotonicSeconds();
+  WarmImage *image = openWarmImage(WARM_FILE);
+  bool isWarmStores = isCurrentImage(image);
+  bool isWarmGraph = image != NULL && warmCount(image, WARM_VERTICES) > 0 && isNotOlder(WARM_FILE, GRAPH_FILE);
+  if (isWarmStores)
+  {
+    warmLoadUsers(image, &userList);
+    warmLoadVehicles(image, &data->vehicleList);
+    warmLoadRents(image, data->rentStore);
+  }
+  if (isWarmGraph)
+  {
+    data->graph = warmLoadGraph(image, createRoute(), &res);
+  }
+  double built = monotonicSeconds();
+  if ((isWarmStores || isWarmGraph) && !verifyWarmImage(image))
+  {
+    fprintf(stderr, "%s is damaged, the stores are read from the files\n", WARM_FILE);
+    isWarmStores = isWarmGraph = false;
+    if (!discardWarmStores(&userList, data))
+    {
+      closeWarmImage(image);
+      return false;
+    }
+  }
+  closeWarmImage(image);
+  double verified = monotonicSeconds();
+
+  if (!isWarmStores)
+  {
+    setUsersData(&userList);
+    setVehiclesData(&data->vehicleList);
+  }
+  if (!isWarmGraph)
+  {
+    data->graph = loadGraph(createRoute(), GRAPH_FILE, &res);
+    // a quantized edges.bin would round the weights, the adjacency files keep them exact
+    if (isNotOlder(EDGES_FILE, GRAPH_FILE) && isExactEdgeFile(EDGES_FILE))
+    {
+      data->graph = loadGraphEdges(data->graph, EDGES_FILE, &res);
+    }
+    else
+    {
+      data->graph = loadAdj(data->graph, &res);
+    }
+  }
+  double read = monotonicSeconds();
+  long replayed = isWarmStores ? replayRentLog(data->rentStore, data->vehicleList, &userList)
+                               : recoverRents(data->rentStore, data->vehicleList, &userList);
+  double replayedAt = monotonicSeconds();
+  data->isWarm = isWarmStores || isWarmGraph;
+  data->buildSeconds = (built - start) + (read - verified);
+  data->verifySeconds = verified - built;
+  data->replaySeconds = replayedAt - read;
+
+  if (replayed < 0)
+  {
+    perror("could not read the rents log");
+    return false;
+  }
+  data->fleetStats = fleetStatsFromList(data->vehicleList);
+  if (data->fleetStats == NULL)
+  {
+    return false;
+  }
+  attachFleetStats(data->fleetStats);
+  data->userStore = userStoreFromList(userList);
+  data->indexSeconds = monotonicSeconds() - replayedAt;
+  return data->userStore != NULL;
+}
+
+/**
+ * @brief Loads the stores of saved-data for the server and opens the rents log, on the loader thread of the server
+ *
+ * @param stores Receives the stores the server runs on
+ * @param argument A pointer to the SavedData that receives the stores, the rents log and the phase times
+ * @return True if the stores were loaded and the log opened, false otherwise
+ */
+static bool loadServerStores(ServerStores *stores, void *argument)
+{
+  SavedData *data = (SavedData *)argument;
+
+  if (!loadSavedData(data))
+  {
+    return false;
+  }
+  // a checkpoint of the rents alone would drop the wallet changes of its records, users.bin does not have them yet
+  data->rentLog = openRentLog(data->rentStore, RENT_LOG_SYNC_EVERY, RENT_LOG_NEVER_CHECKPOINT);
+  if (data->rentLog == NULL)
+  {
+    return false;
+  }
+  stores->vehicles = data->vehicleList;
+  stores->userStore = data->userStore;
+  stores->rentStore = data->rentStore;
+  stores->graph = data->graph;
+
+  int vehicleCount = 0;
+  for (VehicleList *node = data->vehicleList; node != NULL; node = node->next)
+  {
+    vehicleCount++;
+  }
+  printf("Loaded %d users, %d vehicles and %d rents, %s: build %.3f ms, verify %.3f ms, replay %.3f ms, "
+         "index %.3f ms\n", userStoreCount(data->userStore), vehicleCount, data->rentStore->count,
+         data->isWarm ? "warm start" : "from the files", data->buildSeconds * 1e3, data->verifySeconds * 1e3,
+         data->replaySeconds * 1e3, data->indexSeconds * 1e3);
+  fflush(stdout);
+  return true;
+}
+
+/**
+ * @brief Serves the data of saved-data until SIGINT or SIGTERM, then saves the users, vehicles and rents back
+ *
+ * The server listens at once and the stores are loaded on its loader thread. When the warm start image holds the
+ * stores as they are, with nothing in the rents log to replay on top, the lookups are answered from the image while
+ * they load; the other requests wait for them. The time each phase took is printed.
+ *
+ * Every rent and every wallet change is also written to the write-ahead log of the rents while serving, so a crash
+ * does not lose them. The server also snapshots the stores in the background every SERVER_SNAPSHOT_SECONDS, and the
+ * log is only cut once a snapshot, one of those or the one taken at the end, holds its records.
+ *
+ * @param address A port of the loopback address, or the path of a Unix domain socket
+ * @return 0 if the server ran and the data was saved, 1 otherwise
+ */
+static int serve(char *address)
+{
+  SavedData data = {0};
+
+  double start = monotonicSeconds();
+  if (!recoverSnapshot(SNAPSHOT_DIRECTORY))
+  {
+    return 1;
+  }
+  WarmImage *image = openWarmImage(WARM_FILE);
+  if (!isCurrentImage(image) || !isLogEmpty(RENT_LOG_FILE))
+  {
+    closeWarmImage(image);
+    image = NULL;
+  }
+  // created first, it blocks SIGINT and SIGTERM before the metrics dumper thread starts
+  Server *server = createServer(address, image, loadServerStores, &data);
+  if (server == NULL)
+  {
+    return 1;
+  }
+  printf("Serving on %s after %.3f ms, %s\n", address, (monotonicSeconds() - start) * 1e3,
+         image != NULL ? "the lookups are answered from the warm start image while the stores load"
+                       : "the requests wait for the stores to load");
+  fflush(stdout);
+  startMetricsDumper(NULL);
+  char *traceFile = getenv("AED_TRACE");
+  if (traceFile != NULL)
+  {
+    startTracing();
+  }
+
+  bool isStopped = runServer(server);
+  ServerStats stats = server->stats;
+  int rents = destroyServer(server);
+  if (data.rentLog == NULL)
+  {
+    return 1;
+  }
+  printf("\nStopped: %lld requests, %lld from the warm start image, %lld refused, %lld connections, paused %lld "
+         "times by backpressure, %d new rents, %lld expired, %lld snapshots, %lld failed\n", stats.requests,
+         stats.warm, stats.refused, stats.accepted, stats.paused, rents, stats.expired, stats.snapshots,
+         stats.snapshotsFailed);
+  printFleetStats(data.fleetStats);
+  destroyFleetStats(data.fleetStats);
+
+  UserList *savedUsers = NULL;
+  userStoreToList(data.userStore, &savedUsers);
+  SnapshotReport snapshotReport;
+  bool isSaved = writeSnapshot(SNAPSHOT_DIRECTORY, savedUsers, data.vehicleList, data.rentStore, NULL,
+                               &snapshotReport);
+  // the snapshot holds every record, the log is emptied
+  bool isLogged = isSaved && rentLogTrim(data.rentLog, data.rentStore->sequence);
+  isLogged = closeRentLog(data.rentLog) && isLogged;
+  printf("Saved to %s: %d, %d files, %lld bytes\n", SNAPSHOT_DIRECTORY, isSaved, snapshotReport.files,
+         snapshotReport.bytes);
+  if (traceFile != NULL)
+  {
+    stopTracing();
+    printf("Trace written to %s: %d\n", traceFile, flushTrace(traceFile));
+  }
+  if (metricsEnabled())
+  {
+    dumpMetrics(stdout);
+  }
+  return isStopped && isSaved && isLogged ? 0 : 1;
+}
+
+/**
+ * @brief Replays a command file against the data of saved-data, which is not saved back
+ *
+ * @param commandFile The path of the command file
+ * @param expectedFile The path of the expected responses, or NULL to not verify them
+ * @param responseFile The path of a file that receives the responses, or NULL
+ * @return 0 if the file was replayed and every response matched, 1 otherwise
+ */
+static int replay(char *commandFile, char *expectedFile, char *responseFile)
+{
+  SavedData data = {0};
+  CommandContext context;
+  ReplayReport report;
+
+  if (!recoverSnapshot(SNAPSHOT_DIRECTORY) || !loadSavedData(&data) ||
+      !initCommandContext(&context, data.vehicleList, data.userStore, data.graph, data.rentStore))
+  {
+    return 1;
+  }
+  startMetricsDumper(NULL);
+  char *traceFile = getenv("AED_TRACE");
+  if (traceFile != NULL)
+  {
+    startTracing();
+  }
+
+  bool isReplayed = replayCommands(&context, commandFile, expectedFile, responseFile, &report);
+  long long rents = report.rents + settleRents(&context, time(NULL), NULL);
+  freeCommandContext(&context);
+  if (isReplayed)
+  {
+    printReplayReport(stdout, &report);
+    printf("%lld new rents, %lld expired\n", rents, report.expired);
+    printFleetStats(data.fleetStats);
+  }
+  destroyFleetStats(data.fleetStats);
+  if (traceFile != NULL)
+  {
+    stopTracing();
+    printf("Trace written to %s: %d\n", traceFile, flushTrace(traceFile));
+  }
+  if (metricsEnabled())
+  {
+    dumpMetrics(stdout);
+  }
+  return isReplayed && report.mismatches == 0 ? 0 : 1;
+}
 
 /**
  * @brief The main function of the program
  *
  * This function initializes the program and calls the necessary functions to manipulate user, vehicle, and rent data.
+ * Run as "my_program serve [address]" it serves the saved data instead, see server.c for the protocol.
+ * Run as "my_program replay <commands> [expected]" it runs a command file against the saved data, comparing the
+ * responses with an expected file if one is given, and as "my_program record <commands> <responses>" it writes the
+ * responses of a command file to be used as the expected file of later runs, see replay.c.
  *
+ * @param argc The number of arguments
+ * @param argv The arguments
  * @return 0 if the program runs successfully
  */
-int main()
+int main(int argc, char *argv[])
 {
+  if (argc > 1 && strcmp(argv[1], "serve") == 0)
+  {
+    return serve(argc > 2 ? argv[2] : SERVER_ADDRESS);
+  }
+  if (argc > 2 && strcmp(argv[1], "replay") == 0)
+  {
+    return replay(argv[2], argc > 3 ? argv[3] : NULL, NULL);
+  }
+  if (argc > 3 && strcmp(argv[1], "record") == 0)
+  {
+    return replay(argv[2], NULL, argv[3]);
+  }
   printf("Program start!\n");
+  // built with -DMETRICS, kill -USR1 <pid> prints the latency of the hot operations
+  startMetricsDumper(NULL);
+  // AED_TRACE=trace.json writes a timeline of the operations that opens in ui.perfetto.dev
+  char *traceFile = getenv("AED_TRACE");
+  if (traceFile != NULL)
+  {
+    startTracing();
+  }
   setlocale(LC_ALL, "Portuguese"); // write portuguese characters
 
   static int tot = 0; // total vertex
@@ -106,7 +566,7 @@ int main()
 
 #pragma region FICHEIROS
 
-  int res1 = saveGraph(graf, "./saved-data/Vertexs.bin");
+  int res1 = saveGraph(graf, GRAPH_FILE);
   if (res1 > 0)
     puts("\nRoutes saved");
 
@@ -115,7 +575,7 @@ int main()
   puts("\nRoutes in memory:");
   showRoutes(graf);
 
-  graf = loadGraph(graf, "./saved-data/Vertexs.bin", &res);
+  graf = loadGraph(graf, GRAPH_FILE, &res);
   if (graf != NULL)
     puts("\nVertex from file\n");
   showRoutes(graf);
@@ -125,6 +585,9 @@ int main()
 
   showRoutes(graf);
 
+  bool isSavedEdges = saveGraphEdges(graf, EDGES_FILE);
+  printf("\nEdges saved compressed: %d\n", isSavedEdges);
+
 #pragma endregion
 
   Best b = bestPath(graf, tot - 1, 0);
@@ -152,6 +615,9 @@ int main()
 #pragma region VEHICLE
   VehicleList *vehicleList = NULL;
   readVehiclesFromTxt(&vehicleList);
+  // from here on every change of a vehicle or rent updates the counters
+  FleetStats *fleetStats = fleetStatsFromList(vehicleList);
+  attachFleetStats(fleetStats);
   Vehicle *vehicle = createVehicle("registration", "type", 1, 1, true, "Fafe", graf);
   printf("%s", vehicle->registration);
   bool isCreatedVehicle = createVehicleList(&vehicleList, *vehicle);
@@ -169,31 +635,31 @@ int main()
   checkVehiclesInRadius(graf, vehicleList, 0, 50, "trotinete");
 #pragma endregion
 #pragma region RENT
-  RentList *rentList = NULL;
+  RentStore *rentStore = createRentStore();
   printUserList(userList);
   updateUserWallet(userList, 123, 100);
-  Rent *rent = createRent("70-10-JK", 123, 10, vehicleList, userList, &rentList);
+  Rent *rent = createRent("70-10-JK", 123, 10, vehicleList, userList, rentStore);
   if (rent != NULL)
   {
-    bool isCreatedRent = createRentList(&rentList, *rent);
+    bool isCreatedRent = createRentList(rentStore, *rent);
     printf("\nisCreated rent: %d", isCreatedRent);
   }
   updateUserWallet(userList, 1234, 100);
-  Rent *rent2 = createRent("20-03-LL", 1234, 15, vehicleList, userList, &rentList);
+  Rent *rent2 = createRent("20-03-LL", 1234, 15, vehicleList, userList, rentStore);
   if (rent2 != NULL)
   {
-    bool isCreatedRent2 = createRentList(&rentList, *rent2);
+    bool isCreatedRent2 = createRentList(rentStore, *rent2);
     printf("\nisCreated rent2: %d", isCreatedRent2);
   }
-  printRentList(rentList);
-  bool isDeletedRent = deleteRent(&rentList, 1, "70-10-JK", vehicleList);
+  printRentList(rentStore->head);
+  bool isDeletedRent = deleteRent(rentStore, 1, vehicleList);
   printf("\nisDeleted rent: %d", isDeletedRent);
-  printRentList(rentList);
-  bool isEditedRent = editRent(rentList, 2, *rent);
+  printRentList(rentStore->head);
+  bool isEditedRent = editRent(rentStore, 2, *rent);
   printf("\nisEdited rent: %d", isEditedRent);
 
   storeVehicleListInBin(vehicleList);
-  storeRentsInBin(rentList);
+  storeRentsInBin(rentStore);
 #pragma endregion
   VehicleList *sortedVehicleList = sortVehicleListDesc(&vehicleList);
   printf("sorted vehicle list:");
@@ -217,5 +683,71 @@ int main()
   updateUserWallet(userList, 12345, 100);
   updateUserWallet(userList, 12345, -100);
   printUserList(userList);
+
+  Snapshot snapshot = {0};
+  SnapshotReport snapshotReport;
+  if (startSnapshot(&snapshot, SNAPSHOT_DIRECTORY, userList, vehicleList, rentStore, graf))
+  {
+    // the lists keep changing while the child writes them as they were at the fork
+    int walletChanges = 0;
+    struct timespec pause = {0, 1000000};
+    while (!snapshotFinished(&snapshot, &snapshotReport))
+    {
+      updateUserWallet(userList, 12345, 1);
+      walletChanges++;
+      nanosleep(&pause, NULL);
+    }
+    UserList *savedUsers = NULL;
+    setUsersData(&savedUsers);
+    User *savedUser = searchUser(savedUsers, 12345);
+    User *currentUser = searchUser(userList, 12345);
+    printf("\nSnapshot: %d, %d files, %lld bytes in %.3f s, fork %.3f ms\n", snapshotReport.ok, snapshotReport.files,
+           snapshotReport.bytes, snapshotReport.seconds, snapshot.forkSeconds * 1e3);
+    printf("%d wallet changes while it ran, user 12345 has %d in memory and %d in the snapshot\n", walletChanges,
+           currentUser != NULL ? currentUser->wallet : 0, savedUser != NULL ? savedUser->wallet : 0);
+    while (savedUsers != NULL)
+    {
+      UserList *next = savedUsers->next;
+      memFree(MEM_USERS, savedUsers);
+      savedUsers = next;
+    }
+  }
+
+  struct timespec phase[4];
+  clock_gettime(CLOCK_MONOTONIC, &phase[0]);
+  WarmImage *warmImage = openWarmImage(WARM_FILE);
+  clock_gettime(CLOCK_MONOTONIC, &phase[1]);
+  if (warmImage != NULL)
+  {
+    const User *warmUser = warmFindUser(warmImage, 12345);
+    clock_gettime(CLOCK_MONOTONIC, &phase[2]);
+    bool isVerified = verifyWarmImage(warmImage);
+    clock_gettime(CLOCK_MONOTONIC, &phase[3]);
+    printf("\nWarm start: open %.3f ms, first query %.3f ms (user 12345 %s), verify %.3f ms: %d\n",
+           (phase[1].tv_sec - phase[0].tv_sec) * 1e3 + (phase[1].tv_nsec - phase[0].tv_nsec) / 1e6,
+           (phase[2].tv_sec - phase[1].tv_sec) * 1e3 + (phase[2].tv_nsec - phase[1].tv_nsec) / 1e6,
+           warmUser != NULL ? "found" : "not found",
+           (phase[3].tv_sec - phase[2].tv_sec) * 1e3 + (phase[3].tv_nsec - phase[2].tv_nsec) / 1e6, isVerified);
+    closeWarmImage(warmImage);
+  }
+
+  if (fleetStats != NULL)
+  {
+    printf("\n");
+    printFleetStats(fleetStats);
+    destroyFleetStats(fleetStats);
+  }
+  printf("\nMemory:\n");
+  printMemoryReport(stdout, graf, userList, vehicleList, rentStore);
+  if (traceFile != NULL)
+  {
+    stopTracing();
+    printf("\nTrace written to %s: %d\n", traceFile, flushTrace(traceFile));
+  }
+  if (metricsEnabled())
+  {
+    printf("\n");
+    dumpMetrics(stdout);
+  }
   return 0;
 }
\ No newline at end of file
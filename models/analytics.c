@@ -0,0 +1,430 @@
+/**
+ * @file analytics.c
+ * @brief File containing the functions to manage the fleet and rental analytics counters
+ *
+ * This file contains materialized counters for dashboards: the number of vehicles per (location, type, availability)
+ * and the revenue and number of rents per (location, day). Locations and types are interned into small IDs, so every
+ * counter is a slot in a flat array and is updated with one atomic add. The vehicle and rent functions report their
+ * changes through the statsVehicle and statsRent hooks, which do nothing until a FleetStats is attached with
+ * attachFleetStats. Reading a counter never walks the vehicle or rent lists.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./analytics.h"
+
+static FleetStats *attachedStats = NULL;
+
+/**
+ * @brief Hashes a name with FNV-1a
+ *
+ * @param name The name to be hashed
+ * @return The hash of the name
+ */
+static uint32_t hashName(const char *name)
+{
+  uint32_t h = 2166136261u;
+  while (*name)
+  {
+    h ^= (unsigned char)*name++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/**
+ * @brief Initializes an empty table of interned names
+ *
+ * @param names A pointer to the table
+ * @param capacity The maximum number of names
+ * @return True if the table was initialized, or false if there was no memory
+ */
+static bool initNames(StatsNames *names, int capacity)
+{
+  names->count = 0;
+  names->capacity = capacity;
+  names->names = malloc(capacity * sizeof(*names->names));
+  names->slots = (int *)calloc(capacity * 2, sizeof(int));
+  return names->names != NULL && names->slots != NULL;
+}
+
+/**
+ * @brief Finds the slot of a name
+ *
+ * Slots are published with a release store after the name is written, so this can run while another thread is
+ * interning a new name.
+ *
+ * @param names A pointer to the table
+ * @param name The name to be searched for
+ * @param id Receives the ID of the name, or -1 if it is not interned
+ * @return The slot where the name is, or where it would be inserted
+ */
+static int findNameSlot(StatsNames *names, const char *name, int *id)
+{
+  int mask = names->capacity * 2 - 1;
+  int i = (int)(hashName(name) & mask);
+  int slot;
+
+  while ((slot = __atomic_load_n(&names->slots[i], __ATOMIC_ACQUIRE)) != 0)
+  {
+    if (strcmp(names->names[slot - 1], name) == 0)
+    {
+      *id = slot - 1;
+      return i;
+    }
+    i = (i + 1) & mask;
+  }
+  *id = -1;
+  return i;
+}
+
+/**
+ * @brief Interns a name, giving it the next ID if it is new
+ *
+ * @param stats A pointer to the counters
+ * @param names A pointer to the table
+ * @param name The name to be interned
+ * @return The ID of the name, or -1 if the table is full
+ */
+static int internName(FleetStats *stats, StatsNames *names, const char *name)
+{
+  int id;
+  findNameSlot(names, name, &id);
+  if (id >= 0)
+  {
+    return id;
+  }
+
+  pthread_mutex_lock(&stats->lock);
+  int slot = findNameSlot(names, name, &id);
+  if (id < 0 && names->count < names->capacity)
+  {
+    id = names->count++;
+    snprintf(names->names[id], sizeof(names->names[id]), "%s", name);
+    __atomic_store_n(&names->slots[slot], id + 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&stats->lock);
+  return id;
+}
+
+/**
+ * @brief Creates an empty set of counters
+ *
+ * @return A pointer to the counters, or NULL if there was no memory
+ */
+FleetStats *createFleetStats()
+{
+  FleetStats *stats = (FleetStats *)calloc(1, sizeof(FleetStats));
+  if (stats == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+  pthread_mutex_init(&stats->lock, NULL);
+
+  bool ok = initNames(&stats->types, ANALYTICS_MAX_TYPES) && initNames(&stats->locations, ANALYTICS_MAX_LOCATIONS);
+  stats->vehicles = (int64_t *)calloc((size_t)ANALYTICS_MAX_LOCATIONS * ANALYTICS_MAX_TYPES * 2, sizeof(int64_t));
+  stats->revenue = (DayCounter *)calloc((size_t)ANALYTICS_MAX_LOCATIONS * ANALYTICS_DAYS, sizeof(DayCounter));
+  if (!ok || stats->vehicles == NULL || stats->revenue == NULL)
+  {
+    perror("could not allocate memory!");
+    destroyFleetStats(stats);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < (size_t)ANALYTICS_MAX_LOCATIONS * ANALYTICS_DAYS; i++)
+  {
+    stats->revenue[i].day = -1;
+  }
+  return stats;
+}
+
+/**
+ * @brief Frees the counters, detaching them first if they are attached
+ *
+ * @param stats A pointer to the counters
+ */
+void destroyFleetStats(FleetStats *stats)
+{
+  if (stats == NULL)
+  {
+    return;
+  }
+  if (attachedStats == stats)
+  {
+    attachFleetStats(NULL);
+  }
+  pthread_mutex_destroy(&stats->lock);
+  free(stats->types.names);
+  free(stats->types.slots);
+  free(stats->locations.names);
+  free(stats->locations.slots);
+  free(stats->vehicles);
+  free(stats->revenue);
+  free(stats);
+}
+
+/**
+ * @brief Makes the vehicle and rent functions keep these counters up to date
+ *
+ * Only one set of counters is attached at a time. Attach them after building them with fleetStatsFromList, or
+ * before loading the vehicles, so no change is missed.
+ *
+ * @param stats A pointer to the counters, or NULL to stop counting
+ */
+void attachFleetStats(FleetStats *stats)
+{
+  __atomic_store_n(&attachedStats, stats, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Adds a vehicle to the (location, type, availability) counters
+ *
+ * @param stats A pointer to the counters
+ * @param vehicle A pointer to the vehicle
+ * @param delta 1 to add the vehicle, -1 to remove it
+ */
+static void countVehicle(FleetStats *stats, Vehicle *vehicle, int64_t delta)
+{
+  int location = internName(stats, &stats->locations, vehicle->location);
+  int type = internName(stats, &stats->types, vehicle->type);
+  if (location < 0 || type < 0)
+  {
+    return;
+  }
+
+  size_t index = ((size_t)location * ANALYTICS_MAX_TYPES + type) * 2 + (vehicle->isInUse ? 1 : 0);
+  __atomic_fetch_add(&stats->vehicles[index], delta, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Builds the counters from an existing vehicle list
+ *
+ * @param vehicleList A pointer to the head of the vehicle list
+ * @return A pointer to the counters, or NULL if there was no memory
+ */
+FleetStats *fleetStatsFromList(VehicleList *vehicleList)
+{
+  FleetStats *stats = createFleetStats();
+  if (stats == NULL)
+  {
+    return NULL;
+  }
+
+  for (VehicleList *current = vehicleList; current != NULL; current = current->next)
+  {
+    countVehicle(stats, &current->vehicle, 1);
+  }
+  return stats;
+}
+
+/**
+ * @brief Counts a vehicle that was added to the fleet
+ *
+ * @param vehicle A pointer to the vehicle
+ */
+void statsVehicleAdded(Vehicle *vehicle)
+{
+  FleetStats *stats = __atomic_load_n(&attachedStats, __ATOMIC_ACQUIRE);
+  if (stats != NULL)
+  {
+    countVehicle(stats, vehicle, 1);
+  }
+}
+
+/**
+ * @brief Uncounts a vehicle that was removed from the fleet
+ *
+ * @param vehicle A pointer to the vehicle
+ */
+void statsVehicleRemoved(Vehicle *vehicle)
+{
+  FleetStats *stats = __atomic_load_n(&attachedStats, __ATOMIC_ACQUIRE);
+  if (stats != NULL)
+  {
+    countVehicle(stats, vehicle, -1);
+  }
+}
+
+/**
+ * @brief Moves a vehicle between counters after its location, type or availability changed
+ *
+ * @param before A copy of the vehicle before the change
+ * @param after A pointer to the vehicle after the change
+ */
+void statsVehicleChanged(Vehicle *before, Vehicle *after)
+{
+  FleetStats *stats = __atomic_load_n(&attachedStats, __ATOMIC_ACQUIRE);
+  if (stats == NULL)
+  {
+    return;
+  }
+
+  if (before->isInUse != after->isInUse || strcmp(before->location, after->location) != 0 ||
+      strcmp(before->type, after->type) != 0)
+  {
+    countVehicle(stats, before, -1);
+    countVehicle(stats, after, 1);
+  }
+}
+
+/**
+ * @brief Moves a vehicle between its free and in use counters
+ *
+ * Only reads the location and type of the vehicle, so it can be called right after a compare-and-swap on isInUse.
+ *
+ * @param vehicle A pointer to the vehicle
+ * @param isInUse The new availability of the vehicle
+ */
+void statsVehicleAvailability(Vehicle *vehicle, bool isInUse)
+{
+  FleetStats *stats = __atomic_load_n(&attachedStats, __ATOMIC_ACQUIRE);
+  if (stats == NULL)
+  {
+    return;
+  }
+
+  int location = internName(stats, &stats->locations, vehicle->location);
+  int type = internName(stats, &stats->types, vehicle->type);
+  if (location < 0 || type < 0)
+  {
+    return;
+  }
+
+  size_t index = ((size_t)location * ANALYTICS_MAX_TYPES + type) * 2;
+  __atomic_fetch_add(&stats->vehicles[index + (isInUse ? 1 : 0)], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_sub(&stats->vehicles[index + (isInUse ? 0 : 1)], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Gets the day a time falls in
+ *
+ * @param when The time
+ * @return The number of whole days since the epoch, in UTC
+ */
+int64_t statsDay(time_t when)
+{
+  return (int64_t)when / 86400;
+}
+
+/**
+ * @brief Books the price of a rent in the (location, day) counters
+ *
+ * Each location keeps the last ANALYTICS_DAYS days in a ring. A rent for a day older than the one now held by its
+ * bucket is not counted.
+ *
+ * @param location The location of the rented vehicle
+ * @param price The price of the rent, negative to cancel a booking or give back part of it
+ * @param rents 1 for a new rent, -1 for a cancelled one, 0 for a change of price
+ * @param when When the rent was made
+ */
+void statsRentBooked(char *location, int price, int rents, time_t when)
+{
+  FleetStats *stats = __atomic_load_n(&attachedStats, __ATOMIC_ACQUIRE);
+  if (stats == NULL)
+  {
+    return;
+  }
+
+  int id = internName(stats, &stats->locations, location);
+  if (id < 0)
+  {
+    return;
+  }
+
+  int64_t day = statsDay(when);
+  DayCounter *bucket = &stats->revenue[(size_t)id * ANALYTICS_DAYS + day % ANALYTICS_DAYS];
+  if (__atomic_load_n(&bucket->day, __ATOMIC_ACQUIRE) != day)
+  {
+    pthread_mutex_lock(&stats->lock);
+    if (bucket->day < day)
+    {
+      __atomic_store_n(&bucket->revenue, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&bucket->rents, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&bucket->day, day, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&stats->lock);
+    if (__atomic_load_n(&bucket->day, __ATOMIC_ACQUIRE) != day)
+    {
+      return;
+    }
+  }
+
+  __atomic_fetch_add(&bucket->revenue, price, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&bucket->rents, rents, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Gets the number of vehicles of a type in a location
+ *
+ * @param stats A pointer to the counters
+ * @param location The location
+ * @param type The vehicle type
+ * @param isInUse True to count the rented vehicles, false to count the free ones
+ * @return The number of vehicles
+ */
+int64_t countFleetVehicles(FleetStats *stats, char *location, char *type, bool isInUse)
+{
+  int locationId, typeId;
+  findNameSlot(&stats->locations, location, &locationId);
+  findNameSlot(&stats->types, type, &typeId);
+  if (locationId < 0 || typeId < 0)
+  {
+    return 0;
+  }
+
+  size_t index = ((size_t)locationId * ANALYTICS_MAX_TYPES + typeId) * 2 + (isInUse ? 1 : 0);
+  return __atomic_load_n(&stats->vehicles[index], __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Finds the bucket of a location for a day
+ *
+ * @param stats A pointer to the counters
+ * @param location The location
+ * @param day The day, as returned by statsDay
+ * @return A pointer to the bucket, or NULL if that day is not held
+ */
+static DayCounter *findDay(FleetStats *stats, char *location, int64_t day)
+{
+  int id;
+  findNameSlot(&stats->locations, location, &id);
+  if (id < 0 || day < 0)
+  {
+    return NULL;
+  }
+
+  DayCounter *bucket = &stats->revenue[(size_t)id * ANALYTICS_DAYS + day % ANALYTICS_DAYS];
+  return __atomic_load_n(&bucket->day, __ATOMIC_ACQUIRE) == day ? bucket : NULL;
+}
+
+/**
+ * @brief Gets the revenue of a location on a day
+ *
+ * @param stats A pointer to the counters
+ * @param location The location
+ * @param day The day, as returned by statsDay
+ * @return The revenue, or 0 if there were no rents or the day is too old
+ */
+int64_t countFleetRevenue(FleetStats *stats, char *location, int64_t day)
+{
+  DayCounter *bucket = findDay(stats, location, day);
+  return bucket == NULL ? 0 : __atomic_load_n(&bucket->revenue, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Gets the number of rents of a location on a day
+ *
+ * @param stats A pointer to the counters
+ * @param location The location
+ * @param day The day, as returned by statsDay
+ * @return The number of rents, or 0 if there were none or the day is too old
+ */
+int64_t countFleetRents(FleetStats *stats, char *location, int64_t day)
+{
+  DayCounter *bucket = findDay(stats, location, day);
+  return bucket == NULL ? 0 : __atomic_load_n(&bucket->rents, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file analytics.h
+ * @brief File containing the functions to manage the fleet and rental analytics counters
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "./vehicle.h"
+#pragma once
+
+#define ANALYTICS_MAX_TYPES 16
+#define ANALYTICS_MAX_LOCATIONS 4096
+#define ANALYTICS_DAYS 32 // days of revenue kept per location
+
+typedef struct StatsNames
+{
+  char (*names)[50]; // interned names, the index is the ID
+  int *slots;        // open addressing table of ID + 1, 0 is empty
+  int capacity;      // fixed, so readers never see the table move
+  int count;
+} StatsNames;
+
+typedef struct DayCounter
+{
+  int64_t day; // days since the epoch this bucket holds, -1 if never used
+  int64_t revenue;
+  int64_t rents;
+} DayCounter;
+
+typedef struct FleetStats
+{
+  StatsNames types;
+  StatsNames locations;
+  int64_t *vehicles;   // [location][type][isInUse]
+  DayCounter *revenue; // [location][day % ANALYTICS_DAYS]
+  pthread_mutex_t lock; // taken to intern a new name or to start a new day in a bucket
+} FleetStats;
+
+FleetStats *createFleetStats();
+void destroyFleetStats(FleetStats *stats);
+void attachFleetStats(FleetStats *stats);
+FleetStats *fleetStatsFromList(VehicleList *vehicleList);
+void statsVehicleAdded(Vehicle *vehicle);
+void statsVehicleRemoved(Vehicle *vehicle);
+void statsVehicleChanged(Vehicle *before, Vehicle *after);
+void statsVehicleAvailability(Vehicle *vehicle, bool isInUse);
+void statsRentBooked(char *location, int price, int rents, time_t when);
+int64_t statsDay(time_t when);
+int64_t countFleetVehicles(FleetStats *stats, char *location, char *type, bool isInUse);
+int64_t countFleetRevenue(FleetStats *stats, char *location, int64_t day);
+int64_t countFleetRents(FleetStats *stats, char *location, int64_t day);
@@ -0,0 +1,393 @@
+/**
+ * @file binformat.c
+ * @brief File containing the functions of the versioned binary file format
+ *
+ * This file contains the reader and writer of the binary files of the stores. A file starts with a BIN_HEADER_SIZE
+ * header: the BIN_MAGIC bytes, the format version, the record type, the record size, the number of records, the
+ * number of records per block and a CRC32C of the header. The records follow in blocks, each one with its number
+ * of records and a CRC32C of the block. Every number is little-endian and the records are packed by the stores
+ * field by field, so the files do not depend on the padding or the byte order of the machine that wrote them.
+ * CRC32C is computed with the SSE4.2 crc32 instruction when the processor has it, and with tables otherwise.
+ *
+ * @author João Pereira
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "./binformat.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+static uint32_t crcTable[8][256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+static uint32_t (*crcUpdate)(uint32_t crc, const uint8_t *data, size_t length);
+
+/**
+ * @brief Updates a CRC32C with tables, eight bytes at a time
+ *
+ * @param crc The CRC so far, not inverted
+ * @param data The bytes
+ * @param length The number of bytes
+ * @return The updated CRC, not inverted
+ */
+static uint32_t crc32cSoftware(uint32_t crc, const uint8_t *data, size_t length)
+{
+  while (length >= 8)
+  {
+    uint32_t low = crc ^ getU32(data);
+    uint32_t high = getU32(data + 4);
+    crc = crcTable[7][low & 0xff] ^ crcTable[6][(low >> 8) & 0xff] ^ crcTable[5][(low >> 16) & 0xff] ^
+          crcTable[4][low >> 24] ^ crcTable[3][high & 0xff] ^ crcTable[2][(high >> 8) & 0xff] ^
+          crcTable[1][(high >> 16) & 0xff] ^ crcTable[0][high >> 24];
+    data += 8;
+    length -= 8;
+  }
+  while (length-- > 0)
+  {
+    crc = crcTable[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief Updates a CRC32C with the SSE4.2 crc32 instruction
+ *
+ * @param crc The CRC so far, not inverted
+ * @param data The bytes
+ * @param length The number of bytes
+ * @return The updated CRC, not inverted
+ */
+__attribute__((target("sse4.2"))) static uint32_t crc32cHardware(uint32_t crc, const uint8_t *data, size_t length)
+{
+  uint64_t crc64 = crc;
+  while (length >= 8)
+  {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    length -= 8;
+  }
+  crc = (uint32_t)crc64;
+  while (length-- > 0)
+  {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return crc;
+}
+#endif
+
+/**
+ * @brief Builds the CRC32C tables and picks the fastest implementation
+ */
+static void initCrc32c()
+{
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78u : crc >> 1;
+    }
+    crcTable[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    for (int t = 1; t < 8; t++)
+    {
+      crcTable[t][i] = crcTable[0][crcTable[t - 1][i] & 0xff] ^ (crcTable[t - 1][i] >> 8);
+    }
+  }
+
+  crcUpdate = crc32cSoftware;
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.2"))
+  {
+    crcUpdate = crc32cHardware;
+  }
+#endif
+}
+
+/**
+ * @brief Computes the CRC32C (Castagnoli) of a buffer
+ *
+ * @param crc The CRC of the bytes before these ones, or 0 to start
+ * @param data The bytes
+ * @param length The number of bytes
+ * @return The CRC of all the bytes so far
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t length)
+{
+  pthread_once(&crcOnce, initCrc32c);
+  return ~crcUpdate(~crc, (const uint8_t *)data, length);
+}
+
+/**
+ * @brief Checks if CRC32C is computed with the SSE4.2 instruction
+ *
+ * @return True if the processor has SSE4.2, false if the tables are used
+ */
+bool crc32cHardwareAvailable()
+{
+  pthread_once(&crcOnce, initCrc32c);
+  return crcUpdate != crc32cSoftware;
+}
+
+/**
+ * @brief Builds the header of a file
+ *
+ * @param header Receives the BIN_HEADER_SIZE bytes
+ * @param type The record type
+ * @param recordSize The size of a packed record
+ * @param count The number of records
+ * @param blockRecords The number of records per block
+ */
+static void packHeader(uint8_t *header, uint16_t type, uint32_t recordSize, uint64_t count, uint32_t blockRecords)
+{
+  memcpy(header, BIN_MAGIC, 8);
+  putU16(header + 8, BIN_VERSION);
+  putU16(header + 10, type);
+  putU32(header + 12, recordSize);
+  putU64(header + 16, count);
+  putU32(header + 24, blockRecords);
+  putU32(header + 28, crc32c(0, header, 28));
+}
+
+/**
+ * @brief Starts writing a file of records
+ *
+ * The header is written with no records, and rewritten with the final count by closeBinWriter, so the file must be
+ * seekable.
+ *
+ * @param writer A pointer to the writer to be set up
+ * @param file The file, open for writing at its start
+ * @param type The record type
+ * @param recordSize The size of a packed record
+ * @return True if the writer is ready, or false if there was no memory or the header could not be written
+ */
+bool openBinWriter(BinWriter *writer, FILE *file, BinRecordType type, uint32_t recordSize)
+{
+  writer->file = file;
+  writer->type = (uint16_t)type;
+  writer->recordSize = recordSize;
+  writer->blockRecords = recordSize < BIN_BLOCK_BYTES ? BIN_BLOCK_BYTES / recordSize : 1;
+  writer->count = 0;
+  writer->total = 0;
+  writer->failed = false;
+  writer->block = (uint8_t *)malloc(BIN_BLOCK_HEADER_SIZE + (size_t)writer->blockRecords * recordSize);
+  if (writer->block == NULL)
+  {
+    perror("could not allocate memory!");
+    return false;
+  }
+
+  uint8_t header[BIN_HEADER_SIZE];
+  packHeader(header, writer->type, recordSize, 0, writer->blockRecords);
+  if (fwrite(header, BIN_HEADER_SIZE, 1, file) != 1)
+  {
+    free(writer->block);
+    writer->block = NULL;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Writes the current block, if it has records
+ *
+ * @param writer A pointer to the writer
+ */
+static void flushBlock(BinWriter *writer)
+{
+  if (writer->count == 0)
+  {
+    return;
+  }
+
+  size_t bytes = (size_t)writer->count * writer->recordSize;
+  putU32(writer->block, writer->count);
+  putU32(writer->block + 4, crc32c(crc32c(0, writer->block, 4), writer->block + BIN_BLOCK_HEADER_SIZE, bytes));
+  if (fwrite(writer->block, BIN_BLOCK_HEADER_SIZE + bytes, 1, writer->file) != 1)
+  {
+    writer->failed = true;
+  }
+  writer->count = 0;
+}
+
+/**
+ * @brief Adds a packed record to the file
+ *
+ * @param writer A pointer to the writer
+ * @param record The recordSize bytes of the record
+ * @return True if the record was added, false if a write failed
+ */
+bool binWrite(BinWriter *writer, const uint8_t *record)
+{
+  memcpy(writer->block + BIN_BLOCK_HEADER_SIZE + (size_t)writer->count * writer->recordSize, record, writer->recordSize);
+  writer->total++;
+  if (++writer->count == writer->blockRecords)
+  {
+    flushBlock(writer);
+  }
+  return !writer->failed;
+}
+
+/**
+ * @brief Writes the last block and the final header
+ *
+ * The file is not closed.
+ *
+ * @param writer A pointer to the writer
+ * @return True if every record and the header were written, false otherwise
+ */
+bool closeBinWriter(BinWriter *writer)
+{
+  flushBlock(writer);
+  free(writer->block);
+  writer->block = NULL;
+
+  uint8_t header[BIN_HEADER_SIZE];
+  packHeader(header, writer->type, writer->recordSize, writer->total, writer->blockRecords);
+  long end = ftell(writer->file);
+  if (end < 0 || fseek(writer->file, 0, SEEK_SET) != 0 || fwrite(header, BIN_HEADER_SIZE, 1, writer->file) != 1 ||
+      fseek(writer->file, end, SEEK_SET) != 0)
+  {
+    writer->failed = true;
+  }
+  return !writer->failed;
+}
+
+/**
+ * @brief Starts reading a file of records, telling the versioned format from a legacy struct dump
+ *
+ * @param reader A pointer to the reader to be set up
+ * @param file The file, open for reading at its start
+ * @param type The record type expected
+ * @param recordSize The packed record size expected
+ * @return BIN_FORMAT_VERSIONED if the records can be read with binRead, BIN_FORMAT_LEGACY if the file has no header
+ * and was rewound, or BIN_FORMAT_INVALID if the header is damaged or does not match
+ */
+BinFormat openBinReader(BinReader *reader, FILE *file, BinRecordType type, uint32_t recordSize)
+{
+  uint8_t header[BIN_HEADER_SIZE];
+  reader->file = file;
+  reader->block = NULL;
+  reader->count = 0;
+  reader->index = 0;
+  reader->remaining = 0;
+  reader->corrupt = false;
+
+  size_t got = fread(header, 1, BIN_HEADER_SIZE, file);
+  if (got < 8 || memcmp(header, BIN_MAGIC, 8) != 0)
+  {
+    rewind(file);
+    return BIN_FORMAT_LEGACY;
+  }
+
+  if (got < BIN_HEADER_SIZE || getU32(header + 28) != crc32c(0, header, 28) || getU16(header + 8) != BIN_VERSION ||
+      getU16(header + 10) != type || getU32(header + 12) != recordSize || getU32(header + 24) == 0)
+  {
+    fprintf(stderr, "invalid file header\n");
+    return BIN_FORMAT_INVALID;
+  }
+
+  reader->recordSize = recordSize;
+  reader->blockRecords = getU32(header + 24);
+  reader->remaining = getU64(header + 16);
+  reader->block = (uint8_t *)malloc((size_t)reader->blockRecords * recordSize);
+  if (reader->block == NULL)
+  {
+    perror("could not allocate memory!");
+    return BIN_FORMAT_INVALID;
+  }
+  return BIN_FORMAT_VERSIONED;
+}
+
+/**
+ * @brief Reads and checks the next block
+ *
+ * @param reader A pointer to the reader
+ * @return True if a valid block was read, false at the end of the file or if the block is damaged
+ */
+static bool readBlock(BinReader *reader)
+{
+  uint8_t blockHeader[BIN_BLOCK_HEADER_SIZE];
+  if (fread(blockHeader, BIN_BLOCK_HEADER_SIZE, 1, reader->file) != 1)
+  {
+    reader->corrupt = true;
+    return false;
+  }
+
+  uint32_t count = getU32(blockHeader);
+  size_t bytes = (size_t)count * reader->recordSize;
+  if (count == 0 || count > reader->blockRecords || count > reader->remaining ||
+      fread(reader->block, bytes, 1, reader->file) != 1 ||
+      crc32c(crc32c(0, blockHeader, 4), reader->block, bytes) != getU32(blockHeader + 4))
+  {
+    reader->corrupt = true;
+    return false;
+  }
+
+  reader->count = count;
+  reader->index = 0;
+  return true;
+}
+
+/**
+ * @brief Reads the next record
+ *
+ * Records are only handed out from blocks whose CRC matched. When NULL is returned, reader->corrupt tells a damaged
+ * or truncated file from a clean end.
+ *
+ * @param reader A pointer to the reader
+ * @return A pointer to the packed record, valid until the next call, or NULL if there are no more valid records
+ */
+const uint8_t *binRead(BinReader *reader)
+{
+  if (reader->index == reader->count)
+  {
+    if (reader->remaining == 0 || reader->corrupt || !readBlock(reader))
+    {
+      return NULL;
+    }
+  }
+
+  reader->remaining--;
+  return reader->block + (size_t)reader->index++ * reader->recordSize;
+}
+
+/**
+ * @brief Checks that a file without a header can be a dump of structs of a size
+ *
+ * A file whose magic was damaged also looks like a legacy file, so its size is checked before it is read as one.
+ *
+ * @param file The file, which is rewound
+ * @param recordSize The size of the structs
+ * @return True if the file is a whole number of structs, false otherwise
+ */
+bool binLegacySizeMatches(FILE *file, size_t recordSize)
+{
+  bool matches = fseek(file, 0, SEEK_END) == 0 && ftell(file) >= 0 && ftell(file) % recordSize == 0;
+  rewind(file);
+  if (!matches)
+  {
+    fprintf(stderr, "the file is neither in the versioned format nor a dump of %zu byte records\n", recordSize);
+  }
+  return matches;
+}
+
+/**
+ * @brief Frees the buffers of a reader
+ *
+ * The file is not closed.
+ *
+ * @param reader A pointer to the reader
+ */
+void closeBinReader(BinReader *reader)
+{
+  free(reader->block);
+  reader->block = NULL;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file binformat.h
+ * @brief File containing the functions of the versioned binary file format
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#pragma once
+
+#define BIN_MAGIC "AEDSTORE"
+#define BIN_VERSION 1
+#define BIN_HEADER_SIZE 32
+#define BIN_BLOCK_HEADER_SIZE 8
+#define BIN_BLOCK_BYTES 65536 // records are grouped in blocks of about this size, each with its own CRC32C
+
+typedef enum BinRecordType
+{
+  BIN_USERS = 1,
+  BIN_VEHICLES,
+  BIN_RENTS,
+  BIN_VERTICES,
+  BIN_EDGES
+} BinRecordType;
+
+typedef enum BinFormat
+{
+  BIN_FORMAT_VERSIONED, // the file has a valid header and can be read with binRead
+  BIN_FORMAT_LEGACY,    // the file has no header, it is a dump of C structs and was rewound
+  BIN_FORMAT_INVALID    // the header is damaged, or is for another record type, version or size
+} BinFormat;
+
+typedef struct BinWriter
+{
+  FILE *file;
+  uint16_t type;
+  uint32_t recordSize;
+  uint32_t blockRecords;
+  uint8_t *block; // block header followed by the records of the block
+  uint32_t count; // records in the current block
+  uint64_t total;
+  bool failed;
+} BinWriter;
+
+typedef struct BinReader
+{
+  FILE *file;
+  uint32_t recordSize;
+  uint32_t blockRecords;
+  uint8_t *block;
+  uint32_t count; // records in the current block
+  uint32_t index; // next record of the current block
+  uint64_t remaining; // records the header says are left to read
+  bool corrupt;
+} BinReader;
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t length);
+bool crc32cHardwareAvailable();
+bool openBinWriter(BinWriter *writer, FILE *file, BinRecordType type, uint32_t recordSize);
+bool binWrite(BinWriter *writer, const uint8_t *record);
+bool closeBinWriter(BinWriter *writer);
+BinFormat openBinReader(BinReader *reader, FILE *file, BinRecordType type, uint32_t recordSize);
+const uint8_t *binRead(BinReader *reader);
+void closeBinReader(BinReader *reader);
+bool binLegacySizeMatches(FILE *file, size_t recordSize);
+
+/**
+ * @brief Writes a 16 bit number in little-endian order
+ *
+ * @param out Where the bytes are written
+ * @param value The number
+ */
+static inline void putU16(uint8_t *out, uint16_t value)
+{
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+}
+
+/**
+ * @brief Writes a 32 bit number in little-endian order
+ *
+ * @param out Where the bytes are written
+ * @param value The number
+ */
+static inline void putU32(uint8_t *out, uint32_t value)
+{
+  for (int i = 0; i < 4; i++)
+    out[i] = (uint8_t)(value >> (8 * i));
+}
+
+/**
+ * @brief Writes a 64 bit number in little-endian order
+ *
+ * @param out Where the bytes are written
+ * @param value The number
+ */
+static inline void putU64(uint8_t *out, uint64_t value)
+{
+  for (int i = 0; i < 8; i++)
+    out[i] = (uint8_t)(value >> (8 * i));
+}
+
+/**
+ * @brief Writes a float as its IEEE 754 bits in little-endian order
+ *
+ * @param out Where the bytes are written
+ * @param value The number
+ */
+static inline void putF32(uint8_t *out, float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  putU32(out, bits);
+}
+
+/**
+ * @brief Writes a string in a fixed size field, padded with zeros
+ *
+ * @param out Where the bytes are written
+ * @param value The string, cut if it does not fit with its terminator
+ * @param size The size of the field
+ */
+static inline void putString(uint8_t *out, const char *value, size_t size)
+{
+  size_t length = strnlen(value, size - 1);
+  memcpy(out, value, length);
+  memset(out + length, 0, size - length);
+}
+
+/**
+ * @brief Reads a 16 bit number in little-endian order
+ *
+ * @param in The bytes
+ * @return The number
+ */
+static inline uint16_t getU16(const uint8_t *in)
+{
+  return (uint16_t)(in[0] | in[1] << 8);
+}
+
+/**
+ * @brief Reads a 32 bit number in little-endian order
+ *
+ * @param in The bytes
+ * @return The number
+ */
+static inline uint32_t getU32(const uint8_t *in)
+{
+  return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+/**
+ * @brief Reads a 64 bit number in little-endian order
+ *
+ * @param in The bytes
+ * @return The number
+ */
+static inline uint64_t getU64(const uint8_t *in)
+{
+  return (uint64_t)getU32(in) | (uint64_t)getU32(in + 4) << 32;
+}
+
+/**
+ * @brief Reads a float from its IEEE 754 bits in little-endian order
+ *
+ * @param in The bytes
+ * @return The number
+ */
+static inline float getF32(const uint8_t *in)
+{
+  uint32_t bits = getU32(in);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * @brief Reads a string from a fixed size field, always terminating it
+ *
+ * @param out Where the string is written, with room for size bytes
+ * @param in The bytes of the field
+ * @param size The size of the field
+ */
+static inline void getString(char *out, const uint8_t *in, size_t size)
+{
+  memcpy(out, in, size - 1);
+  out[size - 1] = '\0';
+}
@@ -0,0 +1,494 @@
+/**
+ * @file commands.c
+ * @brief File containing the parser and the executor of the text commands shared by the server and the replay
+ *
+ * A command is one line of text: a name in capitals and its arguments separated by spaces. parseCommand turns the
+ * line into a fixed size Command, and executeCommand runs it against the stores and writes the response, one line
+ * that starts with OK or ERR. Parsing touches no store, so it can run on another thread than the execution.
+ * executeWarmCommand answers WALLET and VEHICLE from a warm start image instead, while the stores are being loaded.
+ *
+ *   PING                                   OK
+ *   USER <nif> <wallet>                    OK, creates a user
+ *   CREDIT <nif> <amount>                  OK <balance>, a negative amount debits
+ *   WALLET <nif>                           OK <balance>
+ *   RENT <registration> <nif> <minutes>    OK <rent id> <price>
+ *   RETURN <registration>                  OK, ends the rent and gives back the minutes that were not used
+ *   MOVE <registration> <city cod>         OK, moves a vehicle that is not in use
+ *   VEHICLE <registration>                 OK <registration> <type> <battery> <cost> <in use> <location>
+ *   NEAR <city cod> <radius> <type>        OK <count> <registration>..., at most COMMAND_MAX_FOUND are listed
+ *   ROUTE <origin cod> <destination cod>   OK <distance> <cities> <cod>..., the cods up to COMMAND_MAX_PATH cities
+ *   QUIT                                   OK
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include "./analytics.h"
+#include "./commands.h"
+#include "./rentlog.h"
+#include "./metrics.h"
+#include "./trace.h"
+
+static const char *commandNames[COMMAND_TYPES] = {"PING", "USER", "CREDIT", "WALLET", "RENT", "RETURN",
+                                                  "MOVE", "VEHICLE", "NEAR", "ROUTE", "QUIT", "INVALID"};
+static const int commandArguments[COMMAND_TYPES] = {0, 2, 2, 1, 3, 1, 2, 1, 3, 2, 0, 0};
+
+/**
+ * @brief Gets the name of a command type
+ *
+ * @param type The type
+ * @return The name, as written in a command line
+ */
+const char *commandName(CommandType type)
+{
+  return type >= 0 && type < COMMAND_TYPES ? commandNames[type] : "INVALID";
+}
+
+/**
+ * @brief Parses a decimal integer token
+ *
+ * @param token The token
+ * @param value Receives the integer
+ * @return True if the whole token is an integer that fits an int, false otherwise
+ */
+bool parseInt(char *token, int *value)
+{
+  char *end;
+  errno = 0;
+  long parsed = strtol(token, &end, 10);
+  if (errno != 0 || end == token || *end != '\0' || parsed < INT_MIN || parsed > INT_MAX)
+  {
+    return false;
+  }
+  *value = (int)parsed;
+  return true;
+}
+
+/**
+ * @brief Copies a registration or a vehicle type token
+ *
+ * @param token The token
+ * @param text Receives the token
+ * @return True if the token fits, false otherwise
+ */
+static bool parseText(char *token, char text[50])
+{
+  if (strlen(token) >= 50)
+  {
+    return false;
+  }
+  strcpy(text, token);
+  return true;
+}
+
+/**
+ * @brief Parses a command line
+ *
+ * @param line The line, without its newline, it is not changed
+ * @param length The length of the line
+ * @param command Receives the command, of type COMMAND_INVALID if the line is not a valid command
+ * @return True if the line is a valid command, false otherwise
+ */
+bool parseCommand(const char *line, size_t length, Command *command)
+{
+  char buffer[COMMAND_LINE_SIZE];
+  char *args[4];
+  char *save = NULL;
+  int count = 0;
+
+  command->type = COMMAND_INVALID;
+  command->first = command->second = 0;
+  command->radius = 0;
+  command->text[0] = '\0';
+  if (length >= COMMAND_LINE_SIZE)
+  {
+    return false;
+  }
+  memcpy(buffer, line, length);
+  buffer[length] = '\0';
+
+  char *name = strtok_r(buffer, " \t\r", &save);
+  if (name == NULL)
+  {
+    return false;
+  }
+  while (count < 4 && (args[count] = strtok_r(NULL, " \t\r", &save)) != NULL)
+  {
+    count++;
+  }
+
+  CommandType type = 0;
+  while (type < COMMAND_INVALID && strcmp(name, commandNames[type]) != 0)
+  {
+    type++;
+  }
+  if (type == COMMAND_INVALID || count != commandArguments[type])
+  {
+    return false;
+  }
+
+  bool valid = true;
+  switch (type)
+  {
+  case COMMAND_USER:
+  case COMMAND_CREDIT:
+  case COMMAND_ROUTE:
+    valid = parseInt(args[0], &command->first) && parseInt(args[1], &command->second);
+    break;
+  case COMMAND_WALLET:
+    valid = parseInt(args[0], &command->first);
+    break;
+  case COMMAND_RENT:
+    valid = parseText(args[0], command->text) && parseInt(args[1], &command->first) &&
+            parseInt(args[2], &command->second);
+    break;
+  case COMMAND_RETURN:
+  case COMMAND_VEHICLE:
+    valid = parseText(args[0], command->text);
+    break;
+  case COMMAND_MOVE:
+    valid = parseText(args[0], command->text) && parseInt(args[1], &command->first);
+    break;
+  case COMMAND_NEAR:
+  {
+    char *end;
+    command->radius = strtof(args[1], &end);
+    valid = parseInt(args[0], &command->first) && end != args[1] && *end == '\0' && parseText(args[2], command->text);
+    break;
+  }
+  default:
+    break;
+  }
+  if (valid)
+  {
+    command->type = type;
+  }
+  return valid;
+}
+
+/**
+ * @brief Prepares the stores for running commands
+ *
+ * @param context Receives the stores and a rental engine with one worker
+ * @param vehicles The list of vehicles
+ * @param userStore The user store with the wallets
+ * @param graph The graph of the cities
+ * @param rentStore The rent store, the engine hands out the IDs that follow its own
+ * @return True if the context is ready, false if there was no memory
+ */
+bool initCommandContext(CommandContext *context, VehicleList *vehicles, UserStore *userStore, Vertex *graph, RentStore *rentStore)
+{
+  context->vehicles = vehicles;
+  context->graph = graph;
+  context->userStore = userStore;
+  context->rentStore = rentStore;
+  context->collected = 0;
+  context->rentEngine = createRentEngine(vehicles, userStore, rentStore->nextId, 1);
+  context->worker = context->rentEngine != NULL ? rentEngineWorker(context->rentEngine, 0) : NULL;
+  return context->rentEngine != NULL;
+}
+
+/**
+ * @brief Frees the rental engine of a context, its rents must have been moved to the rent store with settleRents
+ *
+ * @param context A pointer to the context
+ */
+void freeCommandContext(CommandContext *context)
+{
+  destroyRentEngine(context->rentEngine);
+  context->rentEngine = NULL;
+  context->worker = NULL;
+}
+
+/**
+ * @brief Moves the rents of the engine into the rent store and ends the ones whose time is over
+ *
+ * Must be called between commands, on the thread that runs them. An expired rent releases its vehicle, unless the
+ * vehicle was returned and rented again since. It was paid in full when it was made, so no wallet changes.
+ *
+ * @param context A pointer to the context
+ * @param now The current time, in seconds since the epoch
+ * @param expired Receives the number of rents that expired, can be NULL
+ * @return The number of rents moved into the rent store, counting the ones RETURN moved since the last call
+ */
+int settleRents(CommandContext *context, int64_t now, int *expired)
+{
+  int collected = context->collected + rentEngineCollect(context->rentEngine, context->rentStore);
+  context->collected = 0;
+  int count = expireRents(context->rentStore, now, context->vehicles, NULL);
+  if (expired != NULL)
+  {
+    *expired = count;
+  }
+  return collected;
+}
+
+/**
+ * @brief Logs a change to a wallet that no rent made, after the rents made before it
+ *
+ * The rents of the engine are collected first, so the records are in the order the wallets changed.
+ *
+ * @param context A pointer to the context
+ * @param userNif The NIF of the user
+ * @param amount The change made to the wallet
+ * @return True if the change was logged or the rent store has no log, false otherwise
+ */
+static bool logWallet(CommandContext *context, int userNif, int amount)
+{
+  RentLog *log = context->rentStore->log;
+  if (log == NULL)
+  {
+    return true;
+  }
+  context->collected += rentEngineCollect(context->rentEngine, context->rentStore);
+  return rentLogWallet(log, userNif, amount);
+}
+
+/**
+ * @brief Returns a vehicle and ends its rent, giving the minutes that were not used back to the user
+ *
+ * The rents of the engine are collected first, so a rent made earlier in the same turn is in the rent store, and
+ * the open rent is the newest one of the vehicle index. It is removed before the vehicle is released, so a removal
+ * the write-ahead log refuses leaves the vehicle rented. A vehicle in use with no rent in the store is released.
+ *
+ * @param context A pointer to the context
+ * @param vehicleRegistration The registration of the vehicle to be returned
+ * @param now The time the vehicle is returned, in seconds since the epoch
+ * @return RENT_OK if the vehicle was returned, RENT_VEHICLE_NOT_FOUND if it does not exist or is not in use, or
+ * RENT_NOT_LOGGED
+ */
+static RentError returnRent(CommandContext *context, char *vehicleRegistration, int64_t now)
+{
+  Vehicle *vehicle = rentEngineVehicle(context->rentEngine, vehicleRegistration);
+  if (vehicle == NULL || !__atomic_load_n(&vehicle->isInUse, __ATOMIC_ACQUIRE))
+  {
+    return RENT_VEHICLE_NOT_FOUND;
+  }
+
+  context->collected += rentEngineCollect(context->rentEngine, context->rentStore);
+  RentList *node = searchRentsByVehicle(context->rentStore, vehicle->registration);
+  if (node != NULL)
+  {
+    Rent rent = node->rent;
+    int refund = rentRefund(&rent, now);
+    if (!removeRefundedRent(context->rentStore, rent.id, refund))
+    {
+      return RENT_NOT_LOGGED;
+    }
+    if (refund > 0 && userStoreUpdateWallet(context->userStore, rent.userNif, refund))
+    {
+      statsRentBooked(vehicle->location, -refund, 0, rent.startTime);
+    }
+  }
+  rentEngineReturn(context->rentEngine, vehicle->registration);
+  return RENT_OK;
+}
+
+/**
+ * @brief Runs a command and writes its response
+ *
+ * Commands of a context must not run on two threads at once.
+ *
+ * @param context A pointer to the context with the stores
+ * @param command A pointer to the command
+ * @param response Receives the response line with its newline
+ * @param size The size of response, at least COMMAND_RESPONSE_SIZE
+ * @return The length of the response
+ */
+size_t executeCommand(CommandContext *context, Command *command, char *response, size_t size)
+{
+  METRIC_SCOPE(METRIC_EXECUTE_COMMAND);
+  TRACE_FUNCTION();
+  int length = 0;
+  User user;
+
+  switch (command->type)
+  {
+  case COMMAND_PING:
+  case COMMAND_QUIT:
+    length = snprintf(response, size, "OK\n");
+    break;
+  case COMMAND_USER:
+    memset(&user, 0, sizeof(User));
+    user.nif = command->first;
+    user.wallet = command->second;
+    if (command->second < 0)
+      length = snprintf(response, size, "ERR Invalid wallet!\n");
+    else if (userStoreGet(context->userStore, user.nif, NULL))
+      length = snprintf(response, size, "ERR User already exists!\n");
+    else if (!logWallet(context, user.nif, user.wallet))
+      length = snprintf(response, size, "ERR Wallet could not be logged!\n");
+    else if (userStoreInsert(context->userStore, user))
+      length = snprintf(response, size, "OK\n");
+    else
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(RENT_NO_MEMORY));
+    break;
+  case COMMAND_CREDIT:
+    if (!userStoreGet(context->userStore, command->first, NULL))
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(RENT_USER_NOT_FOUND));
+    else if (!userStoreUpdateWallet(context->userStore, command->first, command->second))
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(RENT_INSUFFICIENT_FUNDS));
+    else if (!logWallet(context, command->first, command->second))
+    {
+      // the amount was just applied, so taking it back always fits
+      userStoreUpdateWallet(context->userStore, command->first, -command->second);
+      length = snprintf(response, size, "ERR Wallet could not be logged!\n");
+    }
+    else
+    {
+      userStoreGet(context->userStore, command->first, &user);
+      length = snprintf(response, size, "OK %d\n", user.wallet);
+    }
+    break;
+  case COMMAND_WALLET:
+    if (userStoreGet(context->userStore, command->first, &user))
+      length = snprintf(response, size, "OK %d\n", user.wallet);
+    else
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(RENT_USER_NOT_FOUND));
+    break;
+  case COMMAND_RENT:
+  {
+    Rent rent;
+    RentError error = rentEngineRent(context->worker, command->text, command->first, command->second, &rent);
+    if (error == RENT_OK)
+      length = snprintf(response, size, "OK %lld %d\n", (long long)rent.id, rent.price);
+    else
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(error));
+    break;
+  }
+  case COMMAND_RETURN:
+  {
+    RentError error = returnRent(context, command->text, time(NULL));
+    if (error == RENT_OK)
+      length = snprintf(response, size, "OK\n");
+    else if (error == RENT_NOT_LOGGED)
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(error));
+    else
+      length = snprintf(response, size, "ERR Vehicle is not rented!\n");
+    break;
+  }
+  case COMMAND_MOVE:
+  {
+    Vehicle *vehicle = rentEngineVehicle(context->rentEngine, command->text);
+    Vertex *city = searchVertexCod(context->graph, command->first);
+    if (vehicle == NULL)
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(RENT_VEHICLE_NOT_FOUND));
+    else if (city == NULL)
+      length = snprintf(response, size, "ERR City does not exist!\n");
+    else if (__atomic_load_n(&vehicle->isInUse, __ATOMIC_ACQUIRE))
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(RENT_VEHICLE_IN_USE));
+    else
+    {
+      Vehicle before = *vehicle;
+      strcpy(vehicle->location, city->city);
+      statsVehicleChanged(&before, vehicle);
+      length = snprintf(response, size, "OK\n");
+    }
+    break;
+  }
+  case COMMAND_VEHICLE:
+  {
+    Vehicle *vehicle = rentEngineVehicle(context->rentEngine, command->text);
+    if (vehicle != NULL)
+      length = snprintf(response, size, "OK %s %s %d %d %d %s\n", vehicle->registration, vehicle->type,
+                        vehicle->battery, vehicle->cost, __atomic_load_n(&vehicle->isInUse, __ATOMIC_RELAXED),
+                        vehicle->location);
+    else
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(RENT_VEHICLE_NOT_FOUND));
+    break;
+  }
+  case COMMAND_NEAR:
+  {
+    Vehicle *found[COMMAND_MAX_FOUND];
+    int count = findVehiclesInRadius(context->graph, context->vehicles, command->first, command->radius, command->text,
+                                     found, COMMAND_MAX_FOUND);
+    if (count >= 0)
+    {
+      length = snprintf(response, size, "OK %d", count);
+      for (int i = 0; i < count && i < COMMAND_MAX_FOUND; i++)
+        length += snprintf(response + length, size - length, " %s", found[i]->registration);
+      length += snprintf(response + length, size - length, "\n");
+    }
+    else
+      length = snprintf(response, size, "ERR City does not exist!\n");
+    break;
+  }
+  case COMMAND_ROUTE:
+  {
+    int path[COMMAND_MAX_PATH];
+    int cities;
+    float distance = shortestPath(context->graph, command->first, command->second, path, COMMAND_MAX_PATH, &cities);
+    if (distance >= 0)
+    {
+      length = snprintf(response, size, "OK %.2f %d", distance, cities);
+      for (int i = 0; i < cities && cities <= COMMAND_MAX_PATH; i++)
+        length += snprintf(response + length, size - length, " %d", path[i]);
+      length += snprintf(response + length, size - length, "\n");
+    }
+    else
+      length = snprintf(response, size, "ERR No route!\n");
+    break;
+  }
+  default:
+    length = snprintf(response, size, "ERR unknown or malformed command\n");
+    break;
+  }
+  return (size_t)length < size ? (size_t)length : size - 1;
+}
+
+/**
+ * @brief Answers a lookup from a warm start image, with the same response executeCommand gives
+ *
+ * Only the commands that find a record by its key and change nothing are answered: WALLET and VEHICLE, and PING,
+ * QUIT and the invalid lines, which need no store. The image must hold the stores as they are, with no record of
+ * the rents log after it.
+ *
+ * @param image A pointer to the image
+ * @param command A pointer to the command
+ * @param response Receives the response line with its newline
+ * @param size The size of response, at least COMMAND_RESPONSE_SIZE
+ * @return The length of the response, or 0 if the command needs the stores
+ */
+size_t executeWarmCommand(WarmImage *image, Command *command, char *response, size_t size)
+{
+  TRACE_FUNCTION();
+  int length = 0;
+
+  switch (command->type)
+  {
+  case COMMAND_PING:
+  case COMMAND_QUIT:
+    length = snprintf(response, size, "OK\n");
+    break;
+  case COMMAND_WALLET:
+  {
+    const User *user = warmFindUser(image, command->first);
+    if (user != NULL)
+      length = snprintf(response, size, "OK %d\n", user->wallet);
+    else
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(RENT_USER_NOT_FOUND));
+    break;
+  }
+  case COMMAND_VEHICLE:
+  {
+    const Vehicle *vehicle = warmFindVehicle(image, command->text);
+    if (vehicle != NULL)
+      length = snprintf(response, size, "OK %s %s %d %d %d %s\n", vehicle->registration, vehicle->type,
+                        vehicle->battery, vehicle->cost, vehicle->isInUse, vehicle->location);
+    else
+      length = snprintf(response, size, "ERR %s\n", rentErrorMessage(RENT_VEHICLE_NOT_FOUND));
+    break;
+  }
+  case COMMAND_INVALID:
+    length = snprintf(response, size, "ERR unknown or malformed command\n");
+    break;
+  default:
+    return 0;
+  }
+  return (size_t)length < size ? (size_t)length : size - 1;
+}
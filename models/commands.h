@@ -0,0 +1,66 @@
+/**
+ * @file commands.h
+ * @brief File containing the parser and the executor of the text commands shared by the server and the replay
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "./rentengine.h"
+#include "./routes.h"
+#include "./userstore.h"
+#include "./vehicle.h"
+#include "./warmstart.h"
+#pragma once
+
+#define COMMAND_LINE_SIZE 256     // longest command line, a longer one is invalid
+#define COMMAND_RESPONSE_SIZE 4096 // longest response line, with its newline
+#define COMMAND_MAX_FOUND 32       // vehicles listed in the response of NEAR
+#define COMMAND_MAX_PATH 256       // cities listed in the response of ROUTE
+
+typedef enum CommandType
+{
+  COMMAND_PING,
+  COMMAND_USER,
+  COMMAND_CREDIT,
+  COMMAND_WALLET,
+  COMMAND_RENT,
+  COMMAND_RETURN,
+  COMMAND_MOVE,
+  COMMAND_VEHICLE,
+  COMMAND_NEAR,
+  COMMAND_ROUTE,
+  COMMAND_QUIT,
+  COMMAND_INVALID,
+  COMMAND_TYPES
+} CommandType;
+
+typedef struct Command
+{
+  CommandType type;
+  int first;     // NIF, or the city cod of NEAR and MOVE, or the origin cod of ROUTE
+  int second;    // wallet of USER, amount of CREDIT, minutes of RENT, destination cod of ROUTE
+  float radius;  // of NEAR
+  char text[50]; // registration, or the vehicle type of NEAR
+} Command;
+
+typedef struct CommandContext
+{
+  VehicleList *vehicles; // no vehicle may be added or deleted while commands run
+  Vertex *graph;
+  UserStore *userStore;
+  RentEngine *rentEngine; // rents go to the log of the worker until settleRents
+  RentWorker *worker;
+  RentStore *rentStore; // receives the rents of the engine, and ends them when their time is over
+  int collected;        // rents a RETURN moved into the rent store since the last settleRents
+} CommandContext;
+
+bool initCommandContext(CommandContext *context, VehicleList *vehicles, UserStore *userStore, Vertex *graph, RentStore *rentStore);
+void freeCommandContext(CommandContext *context);
+int settleRents(CommandContext *context, int64_t now, int *expired);
+const char *commandName(CommandType type);
+bool parseInt(char *token, int *value);
+bool parseCommand(const char *line, size_t length, Command *command);
+size_t executeCommand(CommandContext *context, Command *command, char *response, size_t size);
+size_t executeWarmCommand(WarmImage *image, Command *command, char *response, size_t size);
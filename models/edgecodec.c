@@ -0,0 +1,1024 @@
+/**
+ * @file edgecodec.c
+ * @brief File containing the functions of the compressed edge file of the graph
+ *
+ * This file contains the encoder and the decoder of the compressed edge file, which holds every adjacency list of
+ * the graph in one file instead of one AdjFile record of 12 bytes per edge. The lists are sorted by the cod of
+ * their vertex and grouped in blocks of EDGE_BLOCK_VERTICES lists. In a block each list stores the distance from
+ * the cod of the previous list, its degree and the sizes of its targets and weights, then its neighbours in
+ * ascending order: the first one as the distance from the vertex itself, zigzag encoded, and the others as the
+ * distance from the one before, all as varints. Road graphs mostly link nearby cities, so most neighbours take
+ * one or two bytes.
+ *
+ * When the graph has at most EDGE_DICTIONARY_MAX distinct weights they are stored once in a dictionary and each
+ * edge keeps a one byte index, which is exact. Otherwise each weight is rounded to 1 / EDGE_WEIGHT_SCALE and
+ * stored as a varint of its distance from the smallest one.
+ *
+ * The file starts with a header and ends with an index of the blocks, holding the first cod, the position and
+ * the CRC32C of each one, so a single list is found with a binary search over the index and the decoding of one
+ * block. The file is mapped in memory by openEdgeFile and nothing is copied before it is decoded.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "./binformat.h"
+#include "./edgecodec.h"
+#include "./memstats.h"
+#include "./metrics.h"
+#include "./trace.h"
+
+#define WEIGHT_SLOTS (EDGE_DICTIONARY_MAX * 2)
+
+typedef struct EdgePair
+{
+  int target;
+  float weight;
+} EdgePair;
+
+typedef struct WeightSlot // entry of the table that maps the bits of a weight to its index in the dictionary
+{
+  uint32_t bits;
+  int index; // -1 while the slot is free
+} WeightSlot;
+
+/**
+ * @brief Writes a number as a varint, seven bits per byte, lowest bits first
+ *
+ * @param out Where the bytes are written, with room for 10 bytes
+ * @param value The number
+ * @return The number of bytes written
+ */
+static inline size_t putVarint(uint8_t *out, uint64_t value)
+{
+  size_t length = 0;
+  while (value >= 0x80)
+  {
+    out[length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  out[length++] = (uint8_t)value;
+  return length;
+}
+
+/**
+ * @brief Gets the number of bytes of the varint of a number
+ *
+ * @param value The number
+ * @return The number of bytes putVarint writes for it
+ */
+static inline size_t varintLength(uint64_t value)
+{
+  size_t length = 1;
+  while (value >= 0x80)
+  {
+    value >>= 7;
+    length++;
+  }
+  return length;
+}
+
+/**
+ * @brief Reads a varint
+ *
+ * @param in The bytes, moved past the varint
+ * @param end The end of the bytes that can be read
+ * @param value Receives the number
+ * @return True if a whole varint was read, false if the bytes end in the middle of one
+ */
+static inline bool getVarint(const uint8_t **in, const uint8_t *end, uint64_t *value)
+{
+  const uint8_t *p = *in;
+  if (p < end && *p < 0x80)
+  {
+    *value = *p;
+    *in = p + 1;
+    return true;
+  }
+
+  uint64_t result = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7)
+  {
+    uint8_t byte = *p++;
+    result |= (uint64_t)(byte & 0x7f) << shift;
+    if (byte < 0x80)
+    {
+      *value = result;
+      *in = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Reads a varint of up to 8 bytes without branching on its length
+ *
+ * The lengths of the varints of an adjacency list are random, so a branch per byte is mispredicted about once per
+ * varint. Here 8 bytes are loaded at once and the 7 bit groups are gathered with masks and shifts.
+ *
+ * @param in The bytes, moved past the varint
+ * @param end The end of the bytes that can be read
+ * @param limit The end of the mapping, 8 bytes can be loaded from anywhere before limit - 8
+ * @param value Receives the number
+ * @return True if a whole varint was read, false if the bytes end in the middle of one
+ */
+static inline bool getVarintFast(const uint8_t **in, const uint8_t *end, const uint8_t *limit, uint64_t *value)
+{
+  const uint8_t *p = *in;
+  if (limit - p < 8)
+  {
+    return getVarint(in, end, value);
+  }
+
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  uint64_t stops = ~word & 0x8080808080808080ULL;
+  if (stops == 0)
+  {
+    return getVarint(in, end, value);
+  }
+
+  int length = (__builtin_ctzll(stops) >> 3) + 1;
+  word &= stops ^ (stops - 1); // keep the bytes up to the first one without the continuation bit
+  *value = (word & 0x7f) | (word >> 1 & 0x7f << 7) | (word >> 2 & 0x7f << 14) | (word >> 3 & 0x7fULL << 21) |
+           (word >> 4 & 0x7fULL << 28) | (word >> 5 & 0x7fULL << 35) | (word >> 6 & 0x7fULL << 42) |
+           (word >> 7 & 0x7fULL << 49);
+  *in = p + length;
+  return *in <= end;
+}
+
+/**
+ * @brief Maps a signed number to an unsigned one, so small negative numbers stay small
+ *
+ * @param value The number
+ * @return The zigzag encoding of the number
+ */
+static inline uint64_t zigzag(int64_t value)
+{
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+/**
+ * @brief Reverses zigzag
+ *
+ * @param value The zigzag encoding of a number
+ * @return The number
+ */
+static inline int64_t unzigzag(uint64_t value)
+{
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @brief Compares two edges by their target, for qsort
+ */
+static int compareEdges(const void *a, const void *b)
+{
+  int x = ((const EdgePair *)a)->target;
+  int y = ((const EdgePair *)b)->target;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Compares two vertices by their cod, for qsort
+ */
+static int compareVertices(const void *a, const void *b)
+{
+  int x = (*(Vertex *const *)a)->cod;
+  int y = (*(Vertex *const *)b)->cod;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Sorts an adjacency list by target, if it is not sorted yet
+ *
+ * @param targets The targets of the list
+ * @param weights The weights of the list
+ * @param degree The number of edges of the list
+ * @param scratch Room for degree edges
+ */
+static void sortList(int *targets, float *weights, int64_t degree, EdgePair *scratch)
+{
+  int64_t i = 1;
+  while (i < degree && targets[i - 1] <= targets[i])
+  {
+    i++;
+  }
+  if (i >= degree)
+  {
+    return;
+  }
+
+  for (i = 0; i < degree; i++)
+  {
+    scratch[i].target = targets[i];
+    scratch[i].weight = weights[i];
+  }
+  qsort(scratch, degree, sizeof(EdgePair), compareEdges);
+  for (i = 0; i < degree; i++)
+  {
+    targets[i] = scratch[i].target;
+    weights[i] = scratch[i].weight;
+  }
+}
+
+/**
+ * @brief Finds the slot of a weight in the dictionary table
+ *
+ * @param slots The table, of WEIGHT_SLOTS slots
+ * @param bits The bits of the weight
+ * @return The slot of the weight, or the free slot where it belongs
+ */
+static WeightSlot *weightSlot(WeightSlot *slots, uint32_t bits)
+{
+  uint32_t slot = (bits * 2654435761u) >> 23; // 9 bits, WEIGHT_SLOTS is 512
+  while (slots[slot].index >= 0 && slots[slot].bits != bits)
+  {
+    slot = (slot + 1) % WEIGHT_SLOTS;
+  }
+  return &slots[slot];
+}
+
+/**
+ * @brief Rounds a weight to a multiple of 1 / EDGE_WEIGHT_SCALE
+ *
+ * @param weight The weight
+ * @return The weight times EDGE_WEIGHT_SCALE, rounded to the nearest integer
+ */
+static int64_t quantizeWeight(float weight)
+{
+  double scaled = (double)weight * EDGE_WEIGHT_SCALE;
+  return (int64_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+/**
+ * @brief Collects the distinct weights of the graph, while there are at most EDGE_DICTIONARY_MAX
+ *
+ * @param arrays A pointer to the adjacency lists
+ * @param slots Receives the table that maps the bits of a weight to its index
+ * @param dictionary Receives the distinct weights
+ * @param count Receives the number of distinct weights
+ * @return True if the weights fit in the dictionary, false if there are too many of them
+ */
+static bool buildDictionary(EdgeArrays *arrays, WeightSlot *slots, float *dictionary, uint32_t *count)
+{
+  *count = 0;
+  for (int i = 0; i < WEIGHT_SLOTS; i++)
+  {
+    slots[i].index = -1;
+  }
+
+  for (int64_t e = 0; e < arrays->edgeCount; e++)
+  {
+    uint32_t bits;
+    memcpy(&bits, &arrays->weights[e], sizeof(bits));
+    WeightSlot *slot = weightSlot(slots, bits);
+    if (slot->index < 0)
+    {
+      if (*count == EDGE_DICTIONARY_MAX)
+      {
+        return false;
+      }
+      slot->bits = bits;
+      slot->index = (int)*count;
+      dictionary[(*count)++] = arrays->weights[e];
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Encodes the adjacency lists of one block
+ *
+ * @param arrays A pointer to the adjacency lists, sorted
+ * @param first The index of the first vertex of the block
+ * @param last The index after the last vertex of the block
+ * @param coding How the weights are stored
+ * @param slots The dictionary table, for EDGE_WEIGHTS_DICTIONARY
+ * @param weightBase The smallest quantized weight, for EDGE_WEIGHTS_QUANTIZED
+ * @param out Where the block is written, with room for the bound computed by writeEdgeFile
+ * @return The number of bytes of the block
+ */
+static size_t encodeBlock(EdgeArrays *arrays, int first, int last, EdgeWeightCoding coding, WeightSlot *slots, int64_t weightBase, uint8_t *out)
+{
+  size_t length = 0;
+  int previous = arrays->cods[first];
+
+  for (int v = first; v < last; v++)
+  {
+    int cod = arrays->cods[v];
+    int64_t begin = arrays->offsets[v];
+    int64_t degree = arrays->offsets[v + 1] - begin;
+    int *targets = arrays->targets + begin;
+    float *weights = arrays->weights + begin;
+
+    length += putVarint(out + length, (uint64_t)((int64_t)cod - previous));
+    length += putVarint(out + length, (uint64_t)degree);
+    previous = cod;
+    if (degree == 0)
+    {
+      continue;
+    }
+
+    // the sizes of the targets and of the weights let the decoder read both at once, and skip the list
+    uint64_t first = zigzag((int64_t)targets[0] - cod);
+    size_t targetBytes = varintLength(first);
+    size_t weightBytes = 0;
+    for (int64_t e = 1; e < degree; e++)
+    {
+      targetBytes += varintLength((uint64_t)((int64_t)targets[e] - targets[e - 1]));
+    }
+    for (int64_t e = 0; e < degree && coding == EDGE_WEIGHTS_QUANTIZED; e++)
+    {
+      weightBytes += varintLength((uint64_t)(quantizeWeight(weights[e]) - weightBase));
+    }
+    length += putVarint(out + length, targetBytes);
+    if (coding == EDGE_WEIGHTS_QUANTIZED)
+    {
+      length += putVarint(out + length, weightBytes);
+    }
+
+    length += putVarint(out + length, first);
+    for (int64_t e = 1; e < degree; e++)
+    {
+      length += putVarint(out + length, (uint64_t)((int64_t)targets[e] - targets[e - 1]));
+    }
+    for (int64_t e = 0; e < degree; e++)
+    {
+      if (coding == EDGE_WEIGHTS_DICTIONARY)
+      {
+        uint32_t bits;
+        memcpy(&bits, &weights[e], sizeof(bits));
+        out[length++] = (uint8_t)weightSlot(slots, bits)->index;
+      }
+      else
+      {
+        length += putVarint(out + length, (uint64_t)(quantizeWeight(weights[e]) - weightBase));
+      }
+    }
+  }
+  return length;
+}
+
+/**
+ * @brief Builds the adjacency lists of the graph as sorted compressed sparse rows
+ *
+ * @param graph A pointer to the head of the graph
+ * @param arrays Receives the adjacency lists, freed with freeEdgeArrays
+ * @return True if the lists were built, false if there was no memory
+ */
+bool edgeArraysFromGraph(Vertex *graph, EdgeArrays *arrays)
+{
+  int vertexCount = 0;
+  int64_t edgeCount = 0;
+  int64_t maxDegree = 0;
+
+  memset(arrays, 0, sizeof(EdgeArrays));
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+  {
+    int64_t degree = 0;
+    for (Adj *adj = vertex->adjacents; adj != NULL; adj = adj->next)
+    {
+      degree++;
+    }
+    vertexCount++;
+    edgeCount += degree;
+    maxDegree = degree > maxDegree ? degree : maxDegree;
+  }
+
+  Vertex **order = (Vertex **)malloc((vertexCount + 1) * sizeof(Vertex *));
+  EdgePair *scratch = (EdgePair *)malloc((maxDegree + 1) * sizeof(EdgePair));
+  arrays->cods = (int *)malloc((vertexCount + 1) * sizeof(int));
+  arrays->offsets = (int64_t *)malloc((vertexCount + 1) * sizeof(int64_t));
+  arrays->targets = (int *)malloc((edgeCount + 1) * sizeof(int));
+  arrays->weights = (float *)malloc((edgeCount + 1) * sizeof(float));
+  if (order == NULL || scratch == NULL || arrays->cods == NULL || arrays->offsets == NULL || arrays->targets == NULL ||
+      arrays->weights == NULL)
+  {
+    perror("could not allocate memory!");
+    free(order);
+    free(scratch);
+    freeEdgeArrays(arrays);
+    return false;
+  }
+
+  int v = 0;
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+  {
+    order[v++] = vertex;
+  }
+  qsort(order, vertexCount, sizeof(Vertex *), compareVertices);
+
+  int64_t e = 0;
+  for (v = 0; v < vertexCount; v++)
+  {
+    arrays->cods[v] = order[v]->cod;
+    arrays->offsets[v] = e;
+    for (Adj *adj = order[v]->adjacents; adj != NULL; adj = adj->next, e++)
+    {
+      arrays->targets[e] = adj->cod;
+      arrays->weights[e] = adj->dist;
+    }
+    sortList(arrays->targets + arrays->offsets[v], arrays->weights + arrays->offsets[v], e - arrays->offsets[v], scratch);
+  }
+  arrays->offsets[vertexCount] = e;
+  arrays->vertexCount = vertexCount;
+  arrays->edgeCount = edgeCount;
+
+  free(order);
+  free(scratch);
+  return true;
+}
+
+/**
+ * @brief Frees the adjacency lists built by edgeArraysFromGraph or edgeFileDecode
+ *
+ * @param arrays A pointer to the adjacency lists
+ */
+void freeEdgeArrays(EdgeArrays *arrays)
+{
+  free(arrays->cods);
+  free(arrays->offsets);
+  free(arrays->targets);
+  free(arrays->weights);
+  memset(arrays, 0, sizeof(EdgeArrays));
+}
+
+/**
+ * @brief Writes the adjacency lists to a compressed edge file
+ *
+ * The lists that are not sorted by target are sorted in place first.
+ *
+ * @param fileName The path of the file
+ * @param arrays A pointer to the adjacency lists, with the cods in strictly ascending order
+ * @return True if the file was written, false otherwise
+ */
+bool writeEdgeFile(char *fileName, EdgeArrays *arrays)
+{
+  int64_t maxDegree = 0;
+  for (int v = 0; v < arrays->vertexCount; v++)
+  {
+    if (v > 0 && arrays->cods[v] <= arrays->cods[v - 1])
+    {
+      fprintf(stderr, "the vertices of an edge file must be in strictly ascending order of cod\n");
+      return false;
+    }
+    int64_t degree = arrays->offsets[v + 1] - arrays->offsets[v];
+    maxDegree = degree > maxDegree ? degree : maxDegree;
+  }
+
+  WeightSlot slots[WEIGHT_SLOTS];
+  float dictionary[EDGE_DICTIONARY_MAX];
+  uint32_t dictionaryCount;
+  EdgeWeightCoding coding = EDGE_WEIGHTS_QUANTIZED;
+  int64_t weightBase = 0;
+  if (buildDictionary(arrays, slots, dictionary, &dictionaryCount))
+  {
+    coding = EDGE_WEIGHTS_DICTIONARY;
+  }
+  else
+  {
+    dictionaryCount = 0;
+    weightBase = INT64_MAX;
+    for (int64_t e = 0; e < arrays->edgeCount; e++)
+    {
+      int64_t quantized = quantizeWeight(arrays->weights[e]);
+      weightBase = quantized < weightBase ? quantized : weightBase;
+    }
+  }
+
+  uint32_t blockCount = (uint32_t)((arrays->vertexCount + EDGE_BLOCK_VERTICES - 1) / EDGE_BLOCK_VERTICES);
+  EdgePair *scratch = (EdgePair *)malloc((maxDegree + 1) * sizeof(EdgePair));
+  uint8_t *index = (uint8_t *)malloc((size_t)blockCount * EDGE_INDEX_ENTRY_SIZE + 1);
+  size_t capacity = 0;
+  uint8_t *buffer = NULL;
+  if (scratch == NULL || index == NULL)
+  {
+    perror("could not allocate memory!");
+    free(scratch);
+    free(index);
+    return false;
+  }
+
+  FILE *fp = fopen(fileName, "wb");
+  if (fp == NULL)
+  {
+    perror("could not open file");
+    free(scratch);
+    free(index);
+    return false;
+  }
+
+  uint8_t header[EDGE_HEADER_SIZE] = {0};
+  uint8_t packed[EDGE_DICTIONARY_MAX * 4];
+  for (uint32_t i = 0; i < dictionaryCount; i++)
+  {
+    putF32(packed + 4 * i, dictionary[i]);
+  }
+  bool written = fwrite(header, EDGE_HEADER_SIZE, 1, fp) == 1 &&
+                 fwrite(packed, 4, dictionaryCount, fp) == dictionaryCount;
+  uint64_t offset = EDGE_HEADER_SIZE + 4 * (uint64_t)dictionaryCount;
+
+  for (uint32_t b = 0; b < blockCount && written; b++)
+  {
+    int first = (int)b * EDGE_BLOCK_VERTICES;
+    int last = first + EDGE_BLOCK_VERTICES < arrays->vertexCount ? first + EDGE_BLOCK_VERTICES : arrays->vertexCount;
+
+    // four varints per list and at most two per edge
+    size_t bound = 40 * (size_t)(last - first) + 20 * (size_t)(arrays->offsets[last] - arrays->offsets[first]);
+    if (bound > capacity)
+    {
+      uint8_t *grown = (uint8_t *)realloc(buffer, bound);
+      if (grown == NULL)
+      {
+        perror("could not allocate memory!");
+        written = false;
+        break;
+      }
+      buffer = grown;
+      capacity = bound;
+    }
+
+    for (int v = first; v < last; v++)
+    {
+      int64_t begin = arrays->offsets[v];
+      sortList(arrays->targets + begin, arrays->weights + begin, arrays->offsets[v + 1] - begin, scratch);
+    }
+    size_t length = encodeBlock(arrays, first, last, coding, slots, weightBase, buffer);
+    uint8_t *entry = index + (size_t)b * EDGE_INDEX_ENTRY_SIZE;
+    putU32(entry, (uint32_t)arrays->cods[first]);
+    putU32(entry + 4, (uint32_t)(last - first));
+    putU64(entry + 8, offset);
+    putU32(entry + 16, (uint32_t)length);
+    putU32(entry + 20, crc32c(0, buffer, length));
+    written = fwrite(buffer, 1, length, fp) == length;
+    offset += length;
+  }
+
+  size_t indexSize = (size_t)blockCount * EDGE_INDEX_ENTRY_SIZE;
+  written = written && fwrite(index, 1, indexSize, fp) == indexSize;
+
+  memcpy(header, EDGE_MAGIC, 8);
+  putU16(header + 8, EDGE_VERSION);
+  putU16(header + 10, (uint16_t)coding);
+  putU32(header + 12, (uint32_t)arrays->vertexCount);
+  putU64(header + 16, (uint64_t)arrays->edgeCount);
+  putU32(header + 24, blockCount);
+  putU32(header + 28, dictionaryCount);
+  putF32(header + 32, EDGE_WEIGHT_SCALE);
+  putU64(header + 36, offset);
+  putU32(header + 44, crc32c(0, index, indexSize));
+  putU64(header + 48, (uint64_t)weightBase);
+  putU32(header + 56, crc32c(0, packed, 4 * (size_t)dictionaryCount));
+  putU32(header + 60, crc32c(0, header, 60));
+  written = written && fseek(fp, 0, SEEK_SET) == 0 && fwrite(header, EDGE_HEADER_SIZE, 1, fp) == 1;
+  written = fclose(fp) == 0 && written;
+
+  free(buffer);
+  free(scratch);
+  free(index);
+  return written;
+}
+
+/**
+ * @brief Maps a compressed edge file and checks its header and its index
+ *
+ * The blocks are checked when they are decoded.
+ *
+ * @param fileName The path of the file
+ * @return A pointer to the open file, or NULL if it could not be opened or is not a valid edge file
+ */
+EdgeFile *openEdgeFile(char *fileName)
+{
+  EdgeFile *file = (EdgeFile *)calloc(1, sizeof(EdgeFile));
+  if (file == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+
+  struct stat info;
+  file->fd = open(fileName, O_RDONLY);
+  if (file->fd < 0 || fstat(file->fd, &info) != 0 || info.st_size < EDGE_HEADER_SIZE)
+  {
+    if (file->fd >= 0)
+    {
+      close(file->fd);
+    }
+    free(file);
+    return NULL;
+  }
+  file->size = (size_t)info.st_size;
+  void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+  if (data == MAP_FAILED)
+  {
+    perror("could not map the edge file");
+    close(file->fd);
+    free(file);
+    return NULL;
+  }
+  file->data = (const uint8_t *)data;
+
+  const uint8_t *header = file->data;
+  bool valid = memcmp(header, EDGE_MAGIC, 8) == 0 && getU16(header + 8) == EDGE_VERSION &&
+               getU32(header + 60) == crc32c(0, header, 60);
+  uint64_t indexOffset = 0;
+  if (valid)
+  {
+    file->coding = (EdgeWeightCoding)getU16(header + 10);
+    file->vertexCount = getU32(header + 12);
+    file->edgeCount = getU64(header + 16);
+    file->blockCount = getU32(header + 24);
+    file->dictionaryCount = getU32(header + 28);
+    file->scale = getF32(header + 32);
+    indexOffset = getU64(header + 36);
+    file->weightBase = (int64_t)getU64(header + 48);
+    uint64_t dataStart = EDGE_HEADER_SIZE + 4 * (uint64_t)file->dictionaryCount;
+    valid = (file->coding == EDGE_WEIGHTS_DICTIONARY || (file->coding == EDGE_WEIGHTS_QUANTIZED && file->scale > 0)) &&
+            file->dictionaryCount <= EDGE_DICTIONARY_MAX && dataStart <= indexOffset && indexOffset <= file->size &&
+            getU32(header + 56) == crc32c(0, file->data + EDGE_HEADER_SIZE, 4 * (size_t)file->dictionaryCount) &&
+            file->blockCount <= (file->size - indexOffset) / EDGE_INDEX_ENTRY_SIZE &&
+            getU32(header + 44) == crc32c(0, file->data + indexOffset, (size_t)file->blockCount * EDGE_INDEX_ENTRY_SIZE);
+  }
+  if (valid)
+  {
+    file->blocks = (EdgeBlock *)malloc((file->blockCount + 1) * sizeof(EdgeBlock));
+    valid = file->blocks != NULL;
+  }
+  for (uint32_t i = 0; valid && i < file->dictionaryCount; i++)
+  {
+    file->dictionary[i] = getF32(file->data + EDGE_HEADER_SIZE + 4 * i);
+  }
+  for (uint32_t b = 0; valid && b < file->blockCount; b++)
+  {
+    const uint8_t *entry = file->data + indexOffset + (size_t)b * EDGE_INDEX_ENTRY_SIZE;
+    EdgeBlock *block = &file->blocks[b];
+    block->firstCod = (int)getU32(entry);
+    block->vertexCount = getU32(entry + 4);
+    block->offset = getU64(entry + 8);
+    block->length = getU32(entry + 16);
+    block->crc = getU32(entry + 20);
+    valid = block->offset <= indexOffset && block->length <= indexOffset - block->offset &&
+            (b == 0 || block->firstCod > file->blocks[b - 1].firstCod);
+  }
+
+  if (!valid)
+  {
+    fprintf(stderr, "%s is not a valid edge file\n", fileName);
+    closeEdgeFile(file);
+    return NULL;
+  }
+  return file;
+}
+
+/**
+ * @brief Unmaps and closes a compressed edge file
+ *
+ * @param file A pointer to the file, or NULL
+ */
+void closeEdgeFile(EdgeFile *file)
+{
+  if (file == NULL)
+  {
+    return;
+  }
+  munmap((void *)file->data, file->size);
+  close(file->fd);
+  free(file->blocks);
+  free(file);
+}
+
+/**
+ * @brief Decodes the cod and the degree of the next list of a block
+ *
+ * @param in The bytes of the block, moved past the cod and the degree
+ * @param end The end of the block
+ * @param previous The cod of the previous list, or the first cod of the block
+ * @param cod Receives the cod of the list
+ * @param degree Receives the number of edges of the list
+ * @return True if they were decoded, false if the block is damaged
+ */
+static bool decodeListHeader(const uint8_t **in, const uint8_t *end, int previous, int *cod, uint64_t *degree)
+{
+  uint64_t delta;
+  if (!getVarint(in, end, &delta) || !getVarint(in, end, degree) || *degree > (uint64_t)(end - *in))
+  {
+    return false;
+  }
+  *cod = (int)((int64_t)previous + (int64_t)delta);
+  return true;
+}
+
+/**
+ * @brief Decodes, or skips, the edges of a list
+ *
+ * The targets and the weights are read side by side, so the two chains of varints are decoded in parallel.
+ *
+ * @param file A pointer to the edge file
+ * @param in The bytes of the block, moved past the edges
+ * @param end The end of the block
+ * @param cod The cod of the list
+ * @param degree The number of edges of the list
+ * @param targets Receives the targets, or NULL to skip the list
+ * @param weights Receives the weights, ignored when targets is NULL
+ * @return True if the edges were decoded, false if the block is damaged
+ */
+static bool decodeListEdges(EdgeFile *file, const uint8_t **in, const uint8_t *end, int cod, uint64_t degree, int *targets, float *weights)
+{
+  const uint8_t *limit = file->data + file->size;
+  uint64_t targetBytes;
+  uint64_t weightBytes = degree;
+  uint64_t value;
+
+  if (degree == 0)
+  {
+    return true;
+  }
+  if (!getVarint(in, end, &targetBytes) ||
+      (file->coding == EDGE_WEIGHTS_QUANTIZED && !getVarint(in, end, &weightBytes)) ||
+      targetBytes > (uint64_t)(end - *in) || weightBytes > (uint64_t)(end - *in) - targetBytes)
+  {
+    return false;
+  }
+
+  const uint8_t *target = *in;
+  const uint8_t *targetEnd = target + targetBytes;
+  const uint8_t *weight = targetEnd;
+  const uint8_t *weightEnd = weight + weightBytes;
+  *in = weightEnd;
+  if (targets == NULL)
+  {
+    return true;
+  }
+
+  if (!getVarintFast(&target, targetEnd, limit, &value))
+  {
+    return false;
+  }
+  int64_t current = cod + unzigzag(value);
+  targets[0] = (int)current;
+
+  if (file->coding == EDGE_WEIGHTS_DICTIONARY)
+  {
+    for (uint64_t e = 1; e < degree; e++)
+    {
+      if (!getVarintFast(&target, targetEnd, limit, &value))
+      {
+        return false;
+      }
+      current += (int64_t)value;
+      targets[e] = (int)current;
+    }
+    for (uint64_t e = 0; e < degree; e++)
+    {
+      if (weight[e] >= file->dictionaryCount)
+      {
+        return false;
+      }
+      weights[e] = file->dictionary[weight[e]];
+    }
+    return target == targetEnd;
+  }
+
+  double step = 1.0 / file->scale;
+  for (uint64_t e = 0; e < degree; e++)
+  {
+    uint64_t quantized;
+    if ((e > 0 && !getVarintFast(&target, targetEnd, limit, &value)) || !getVarintFast(&weight, weightEnd, limit, &quantized))
+    {
+      return false;
+    }
+    if (e > 0)
+    {
+      current += (int64_t)value;
+      targets[e] = (int)current;
+    }
+    weights[e] = (float)((double)(file->weightBase + (int64_t)quantized) * step);
+  }
+  return target == targetEnd && weight == weightEnd;
+}
+
+/**
+ * @brief Checks the CRC of a block
+ *
+ * @param file A pointer to the edge file
+ * @param block A pointer to the block
+ * @return True if the block is intact, false otherwise
+ */
+static bool checkBlock(EdgeFile *file, EdgeBlock *block)
+{
+  if (crc32c(0, file->data + block->offset, block->length) != block->crc)
+  {
+    fprintf(stderr, "the edge file has a damaged block at byte %llu\n", (unsigned long long)block->offset);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads the adjacency list of one vertex, decoding only the block that holds it
+ *
+ * @param file A pointer to the edge file
+ * @param cod The cod of the vertex
+ * @param targets Receives the targets, in ascending order
+ * @param weights Receives the weights
+ * @param capacity The room in targets and weights; if the list is longer nothing is written
+ * @return The degree of the vertex, or -1 if it is not in the file or its block is damaged
+ */
+int edgeFileNeighbours(EdgeFile *file, int cod, int *targets, float *weights, int capacity)
+{
+  if (file->blockCount == 0 || cod < file->blocks[0].firstCod)
+  {
+    return -1;
+  }
+
+  uint32_t low = 0;
+  uint32_t high = file->blockCount - 1;
+  while (low < high)
+  {
+    uint32_t middle = low + (high - low + 1) / 2;
+    if (file->blocks[middle].firstCod <= cod)
+      low = middle;
+    else
+      high = middle - 1;
+  }
+
+  EdgeBlock *block = &file->blocks[low];
+  if (!checkBlock(file, block))
+  {
+    return -1;
+  }
+
+  const uint8_t *in = file->data + block->offset;
+  const uint8_t *end = in + block->length;
+  int previous = block->firstCod;
+  for (uint32_t v = 0; v < block->vertexCount; v++)
+  {
+    int current;
+    uint64_t degree;
+    if (!decodeListHeader(&in, end, previous, &current, &degree) || current > cod)
+    {
+      return -1;
+    }
+    bool found = current == cod;
+    bool fits = found && degree <= (uint64_t)capacity;
+    if (!decodeListEdges(file, &in, end, current, degree, fits ? targets : NULL, weights))
+    {
+      return -1;
+    }
+    if (found)
+    {
+      return (int)degree;
+    }
+    previous = current;
+  }
+  return -1;
+}
+
+/**
+ * @brief Decodes every adjacency list of the file, checking every block
+ *
+ * @param file A pointer to the edge file
+ * @param arrays Receives the adjacency lists, freed with freeEdgeArrays
+ * @return True if the lists were decoded, false if there was no memory or the file is damaged
+ */
+bool edgeFileDecode(EdgeFile *file, EdgeArrays *arrays)
+{
+  memset(arrays, 0, sizeof(EdgeArrays));
+  madvise((void *)file->data, file->size, MADV_WILLNEED);
+  arrays->cods = (int *)malloc(((size_t)file->vertexCount + 1) * sizeof(int));
+  arrays->offsets = (int64_t *)malloc(((size_t)file->vertexCount + 1) * sizeof(int64_t));
+  arrays->targets = (int *)malloc((file->edgeCount + 1) * sizeof(int));
+  arrays->weights = (float *)malloc((file->edgeCount + 1) * sizeof(float));
+  if (arrays->cods == NULL || arrays->offsets == NULL || arrays->targets == NULL || arrays->weights == NULL)
+  {
+    perror("could not allocate memory!");
+    freeEdgeArrays(arrays);
+    return false;
+  }
+
+  uint32_t v = 0;
+  uint64_t e = 0;
+  bool decoded = true;
+  for (uint32_t b = 0; b < file->blockCount && decoded; b++)
+  {
+    EdgeBlock *block = &file->blocks[b];
+    const uint8_t *in = file->data + block->offset;
+    const uint8_t *end = in + block->length;
+    int previous = block->firstCod;
+
+    decoded = checkBlock(file, block) && block->vertexCount <= file->vertexCount - v;
+    for (uint32_t i = 0; i < block->vertexCount && decoded; i++, v++)
+    {
+      uint64_t degree = 0;
+      decoded = decodeListHeader(&in, end, previous, &arrays->cods[v], &degree) && degree <= file->edgeCount - e &&
+                decodeListEdges(file, &in, end, arrays->cods[v], degree, arrays->targets + e, arrays->weights + e);
+      arrays->offsets[v] = (int64_t)e;
+      previous = arrays->cods[v];
+      e += degree;
+    }
+  }
+
+  if (!decoded || v != file->vertexCount || e != file->edgeCount)
+  {
+    fprintf(stderr, "the edge file is damaged\n");
+    freeEdgeArrays(arrays);
+    return false;
+  }
+  arrays->offsets[v] = (int64_t)e;
+  arrays->vertexCount = (int)v;
+  arrays->edgeCount = (int64_t)e;
+  return true;
+}
+
+/**
+ * @brief Saves every adjacency list of the graph to a compressed edge file
+ *
+ * @param graph A pointer to the head of the graph
+ * @param fileName The path of the file
+ * @return True if the file was written, false otherwise
+ */
+bool saveGraphEdges(Vertex *graph, char *fileName)
+{
+  METRIC_SCOPE(METRIC_SAVE_GRAPH_EDGES);
+  TRACE_FUNCTION();
+  EdgeArrays arrays;
+  if (!edgeArraysFromGraph(graph, &arrays))
+  {
+    return false;
+  }
+  bool written = writeEdgeFile(fileName, &arrays);
+  freeEdgeArrays(&arrays);
+  return written;
+}
+
+/**
+ * @brief Loads the adjacency lists of the vertices of the graph from a compressed edge file
+ *
+ * Lists of cods that are not in the graph are ignored, and the adjacents already in the graph are kept.
+ *
+ * @param graph A pointer to the head of the graph
+ * @param fileName The path of the file
+ * @param res Set to true if the file was read
+ * @return A pointer to the head of the graph
+ */
+Vertex *loadGraphEdges(Vertex *graph, char *fileName, bool *res)
+{
+  METRIC_SCOPE(METRIC_LOAD_GRAPH_EDGES);
+  TRACE_FUNCTION();
+  EdgeArrays arrays;
+  EdgeFile *file = openEdgeFile(fileName);
+
+  *res = false;
+  if (file == NULL)
+  {
+    return graph;
+  }
+  bool decoded = edgeFileDecode(file, &arrays);
+  closeEdgeFile(file);
+  if (!decoded)
+  {
+    return graph;
+  }
+
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+  {
+    int low = 0;
+    int high = arrays.vertexCount - 1;
+    while (low < high)
+    {
+      int middle = low + (high - low) / 2;
+      if (arrays.cods[middle] < vertex->cod)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    if (arrays.vertexCount == 0 || arrays.cods[low] != vertex->cod)
+    {
+      continue;
+    }
+
+    // insertAdj prepends, so the list ends up in ascending order
+    for (int64_t e = arrays.offsets[low + 1] - 1; e >= arrays.offsets[low]; e--)
+    {
+      bool inserted;
+      Adj *adj = createAdj(arrays.targets[e], arrays.weights[e]);
+      vertex->adjacents = insertAdj(vertex->adjacents, adj, &inserted);
+      if (!inserted)
+      {
+        memFree(MEM_EDGES, adj);
+      }
+    }
+  }
+
+  freeEdgeArrays(&arrays);
+  *res = true;
+  return graph;
+}
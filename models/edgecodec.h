@@ -0,0 +1,72 @@
+/**
+ * @file edgecodec.h
+ * @brief File containing the functions of the compressed edge file of the graph
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "./routes.h"
+#pragma once
+
+#define EDGES_FILE "./saved-data/edges.bin"
+#define EDGE_MAGIC "AEDEDGES"
+#define EDGE_VERSION 1
+#define EDGE_HEADER_SIZE 64
+#define EDGE_INDEX_ENTRY_SIZE 24
+#define EDGE_BLOCK_VERTICES 32   // adjacency lists per block, the unit of random access
+#define EDGE_DICTIONARY_MAX 256  // up to this many distinct weights are stored as a one byte index
+#define EDGE_WEIGHT_SCALE 100.0f // otherwise weights are rounded to 1 / EDGE_WEIGHT_SCALE
+
+typedef enum EdgeWeightCoding
+{
+  EDGE_WEIGHTS_DICTIONARY = 1, // exact, one byte per edge
+  EDGE_WEIGHTS_QUANTIZED       // varint of the weight times the scale, minus the smallest one
+} EdgeWeightCoding;
+
+typedef struct EdgeArrays // adjacency lists of the graph as compressed sparse rows
+{
+  int vertexCount;
+  int64_t edgeCount;
+  int *cods;        // ascending
+  int64_t *offsets; // the edges of cods[i] are [offsets[i], offsets[i + 1])
+  int *targets;     // ascending within each list
+  float *weights;
+} EdgeArrays;
+
+typedef struct EdgeBlock
+{
+  int firstCod;
+  uint32_t vertexCount;
+  uint64_t offset;
+  uint32_t length;
+  uint32_t crc; // CRC32C of the bytes of the block
+} EdgeBlock;
+
+typedef struct EdgeFile
+{
+  int fd;
+  const uint8_t *data; // the whole file, mapped read-only
+  size_t size;
+  uint32_t vertexCount;
+  uint64_t edgeCount;
+  EdgeWeightCoding coding;
+  float scale;
+  int64_t weightBase; // smallest quantized weight, the others are stored as their distance from it
+  uint32_t dictionaryCount;
+  float dictionary[EDGE_DICTIONARY_MAX];
+  uint32_t blockCount;
+  EdgeBlock *blocks;
+} EdgeFile;
+
+bool edgeArraysFromGraph(Vertex *graph, EdgeArrays *arrays);
+void freeEdgeArrays(EdgeArrays *arrays);
+bool writeEdgeFile(char *fileName, EdgeArrays *arrays);
+EdgeFile *openEdgeFile(char *fileName);
+void closeEdgeFile(EdgeFile *file);
+int edgeFileNeighbours(EdgeFile *file, int cod, int *targets, float *weights, int capacity);
+bool edgeFileDecode(EdgeFile *file, EdgeArrays *arrays);
+bool saveGraphEdges(Vertex *graph, char *fileName);
+Vertex *loadGraphEdges(Vertex *graph, char *fileName, bool *res);
@@ -0,0 +1,320 @@
+/**
+ * @file graphstore.c
+ * @brief File containing the versioned graph that readers use without locks while writers publish new versions
+ *
+ * The graph functions of routes.c change the vertex and adjacency lists in place, so a route could be computed on a
+ * graph that is half updated. The store keeps the graph as a chain of immutable versions instead (read-copy-update):
+ * a reader pins the current version and computes on it for as long as it likes, while a writer copies the current
+ * version, edits the copy and publishes it with a single atomic exchange. Readers never take a lock and never wait
+ * for a writer; writers wait only for each other.
+ *
+ * A replaced version is freed once no reader can still hold it, found with epochs. Pinning stores the global epoch
+ * in the slot of the reader before reading the current version, and publishing moves the global epoch on after the
+ * exchange, tagging the old version with the epoch it was replaced in. A reader whose slot is empty or holds a later
+ * epoch read the current version after the exchange, so once every slot is empty or later than the tag the old
+ * version is unreachable. The retired versions are reclaimed by the writers after each publish, and by
+ * graphStoreReclaim; a reader that stays pinned only delays the reclaim of the versions it may hold.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./graphstore.h"
+#include "./trace.h"
+
+/**
+ * @brief Creates a store whose first version is a graph
+ *
+ * @param graph The graph, owned by the store from now on and no longer changed in place
+ * @return A pointer to the store, or NULL if there was no memory
+ */
+GraphStore *createGraphStore(Vertex *graph)
+{
+  GraphStore *store = (GraphStore *)aligned_alloc(64, sizeof(GraphStore));
+  GraphVersion *version = (GraphVersion *)malloc(sizeof(GraphVersion));
+  if (store == NULL || version == NULL)
+  {
+    perror("could not allocate memory!");
+    free(store);
+    free(version);
+    return NULL;
+  }
+  memset(store, 0, sizeof(GraphStore));
+  memset(version, 0, sizeof(GraphVersion));
+  version->graph = graph;
+  version->number = 1;
+  store->current = version;
+  store->epoch = 1;
+  store->published = 1;
+  pthread_mutex_init(&store->writeLock, NULL);
+  return store;
+}
+
+/**
+ * @brief Frees a store and every version of its graph, no reader may have a version pinned
+ *
+ * @param store The store, can be NULL
+ */
+void destroyGraphStore(GraphStore *store)
+{
+  if (store == NULL)
+    return;
+  while (store->retired != NULL)
+  {
+    GraphVersion *next = store->retired->nextRetired;
+    destroyRoutes(store->retired->graph);
+    free(store->retired);
+    store->retired = next;
+  }
+  destroyRoutes(store->current->graph);
+  free(store->current);
+  pthread_mutex_destroy(&store->writeLock);
+  free(store);
+}
+
+/**
+ * @brief Takes a free reader slot for the calling thread
+ *
+ * @param store The store
+ * @return A pointer to the reader, or NULL if all GRAPH_MAX_READERS slots are taken
+ */
+GraphReader *graphStoreReader(GraphStore *store)
+{
+  for (int i = 0; i < GRAPH_MAX_READERS; i++)
+  {
+    bool isUsed = false;
+    if (__atomic_compare_exchange_n(&store->readers[i].isUsed, &isUsed, true, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+      return &store->readers[i];
+  }
+  fprintf(stderr, "no free graph reader\n");
+  return NULL;
+}
+
+/**
+ * @brief Gives back a reader slot, with no version pinned
+ *
+ * @param reader The reader, can be NULL
+ */
+void releaseGraphReader(GraphReader *reader)
+{
+  if (reader != NULL)
+    __atomic_store_n(&reader->isUsed, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Pins the current version of the graph, which stays valid and unchanged until unpinGraph
+ *
+ * A reader pins one version at a time. It never blocks, whatever the writers are doing.
+ *
+ * @param store The store
+ * @param reader The reader of the calling thread
+ * @return A pointer to the version, its graph is in version->graph
+ */
+GraphVersion *pinGraph(GraphStore *store, GraphReader *reader)
+{
+  // the epoch is in the slot before the version is read, see the file comment
+  __atomic_store_n(&reader->epoch, __atomic_load_n(&store->epoch, __ATOMIC_ACQUIRE), __ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&reader->pins, 1, __ATOMIC_RELAXED);
+  return __atomic_load_n(&store->current, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Unpins the version pinned by a reader, it must not be used after
+ *
+ * @param reader The reader
+ */
+void unpinGraph(GraphReader *reader)
+{
+  __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Checks if a retired version can no longer be held by any reader
+ *
+ * @param store The store
+ * @param version The version
+ * @return True if the version can be freed, false otherwise
+ */
+static bool isUnreachable(GraphStore *store, GraphVersion *version)
+{
+  for (int i = 0; i < GRAPH_MAX_READERS; i++)
+  {
+    uint64_t epoch = __atomic_load_n(&store->readers[i].epoch, __ATOMIC_SEQ_CST);
+    if (epoch != 0 && epoch <= version->retiredEpoch)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Frees the retired versions no reader can hold, with the write lock held
+ *
+ * @param store The store
+ * @return The number of versions freed
+ */
+static int reclaimVersions(GraphStore *store)
+{
+  int freed = 0;
+  GraphVersion **link = &store->retired;
+  while (*link != NULL)
+  {
+    GraphVersion *version = *link;
+    if (isUnreachable(store, version))
+    {
+      *link = version->nextRetired;
+      destroyRoutes(version->graph);
+      free(version);
+      freed++;
+    }
+    else
+    {
+      link = &version->nextRetired;
+    }
+  }
+  store->retiredCount -= freed;
+  store->reclaimed += freed;
+  return freed;
+}
+
+/**
+ * @brief Publishes a graph as the new version and retires the one it replaces, with the write lock held
+ *
+ * @param store The store
+ * @param graph The graph of the new version
+ * @return True if the graph was published, false if there was no memory
+ */
+static bool publishVersion(GraphStore *store, Vertex *graph)
+{
+  GraphVersion *version = (GraphVersion *)malloc(sizeof(GraphVersion));
+  if (version == NULL)
+  {
+    perror("could not allocate memory!");
+    return false;
+  }
+  memset(version, 0, sizeof(GraphVersion));
+  version->graph = graph;
+  version->number = store->current->number + 1;
+
+  GraphVersion *old = __atomic_exchange_n(&store->current, version, __ATOMIC_SEQ_CST);
+  old->retiredEpoch = __atomic_fetch_add(&store->epoch, 1, __ATOMIC_SEQ_CST);
+  old->nextRetired = store->retired;
+  store->retired = old;
+  store->retiredCount++;
+  store->published++;
+  reclaimVersions(store);
+  return true;
+}
+
+/**
+ * @brief Edits a copy of the current version of the graph and publishes it
+ *
+ * Several changes made in one edit are seen by the readers all at once, and cost a single copy.
+ *
+ * @param store The store
+ * @param edit The function that changes the copy, it may replace the head of the list; when it returns false the
+ * copy is thrown away and nothing is published
+ * @param context The second argument of edit
+ * @return True if a new version was published, false otherwise
+ */
+bool graphStoreEdit(GraphStore *store, GraphEdit edit, void *context)
+{
+  TRACE_FUNCTION();
+  bool res;
+  pthread_mutex_lock(&store->writeLock);
+  Vertex *copy = copyRoutes(store->current->graph, &res);
+  bool isPublished = res && edit(&copy, context) && publishVersion(store, copy);
+  if (!isPublished)
+    destroyRoutes(copy);
+  pthread_mutex_unlock(&store->writeLock);
+  return isPublished;
+}
+
+typedef struct DistanceEdit
+{
+  int origin;
+  int dest;
+  float distance;
+} DistanceEdit;
+
+/**
+ * @brief Edit of graphStoreSetDistance
+ *
+ * @param graph The copy of the graph
+ * @param context A pointer to the DistanceEdit
+ * @return True if both vertices exist, false otherwise
+ */
+static bool setDistance(Vertex **graph, void *context)
+{
+  DistanceEdit *edit = (DistanceEdit *)context;
+  bool res;
+  *graph = setAdjacentDistanceCod(*graph, edit->origin, edit->dest, edit->distance, &res);
+  return res;
+}
+
+/**
+ * @brief Publishes a version with the distance of an edge changed, or the edge added if there was none
+ *
+ * @param store The store
+ * @param origin The code of the vertex the edge starts at
+ * @param dest The code of the vertex the edge ends at
+ * @param distance The distance
+ * @return True if a new version was published, false if a vertex does not exist or there was no memory
+ */
+bool graphStoreSetDistance(GraphStore *store, int origin, int dest, float distance)
+{
+  DistanceEdit edit = {origin, dest, distance};
+  return graphStoreEdit(store, setDistance, &edit);
+}
+
+/**
+ * @brief Publishes a whole graph as the new version, such as one read again with loadGraph and loadAdj
+ *
+ * @param store The store
+ * @param graph The graph, owned by the store from now on and no longer changed in place
+ * @return True if the graph was published, false if there was no memory, the graph is then still the caller's
+ */
+bool graphStorePublish(GraphStore *store, Vertex *graph)
+{
+  pthread_mutex_lock(&store->writeLock);
+  bool isPublished = publishVersion(store, graph);
+  pthread_mutex_unlock(&store->writeLock);
+  return isPublished;
+}
+
+/**
+ * @brief Frees the retired versions that no reader can hold any longer
+ *
+ * The writers already do it after every publish; this is for the versions left behind by readers that were pinned
+ * then.
+ *
+ * @param store The store
+ * @return The number of versions freed
+ */
+int graphStoreReclaim(GraphStore *store)
+{
+  pthread_mutex_lock(&store->writeLock);
+  int freed = reclaimVersions(store);
+  pthread_mutex_unlock(&store->writeLock);
+  return freed;
+}
+
+/**
+ * @brief Reads the counters of a store
+ *
+ * @param store The store
+ * @param stats Receives the counters
+ */
+void readGraphStoreStats(GraphStore *store, GraphStoreStats *stats)
+{
+  memset(stats, 0, sizeof(GraphStoreStats));
+  pthread_mutex_lock(&store->writeLock);
+  stats->current = store->current->number;
+  stats->published = store->published;
+  stats->reclaimed = store->reclaimed;
+  stats->retired = store->retiredCount;
+  pthread_mutex_unlock(&store->writeLock);
+  for (int i = 0; i < GRAPH_MAX_READERS; i++)
+    stats->pins += __atomic_load_n(&store->readers[i].pins, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,64 @@
+/**
+ * @file graphstore.h
+ * @brief File containing the versioned graph that readers use without locks while writers publish new versions
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "./routes.h"
+#pragma once
+
+#define GRAPH_MAX_READERS 64 // reader slots, one per thread that pins versions
+
+typedef struct GraphVersion // an immutable graph, freed once no reader can hold it
+{
+  Vertex *graph;
+  long number;             // 1 for the graph the store was created with
+  uint64_t retiredEpoch;   // epoch the version was replaced in
+  struct GraphVersion *nextRetired;
+} GraphVersion;
+
+typedef struct GraphReader
+{
+  _Alignas(64) uint64_t epoch; // epoch the pinned version was read in, 0 while nothing is pinned
+  bool isUsed;
+  long long pins;
+} GraphReader;
+
+typedef struct GraphStore
+{
+  GraphVersion *current;
+  _Alignas(64) uint64_t epoch;
+  GraphReader readers[GRAPH_MAX_READERS];
+  pthread_mutex_t writeLock; // the writers and the retired versions, never taken by the readers
+  GraphVersion *retired;
+  int retiredCount;
+  long long published;
+  long long reclaimed;
+} GraphStore;
+
+typedef struct GraphStoreStats
+{
+  long current;  // number of the current version
+  long long published;
+  long long reclaimed;
+  int retired;   // versions replaced but still held by a reader, or not reclaimed yet
+  long long pins;
+} GraphStoreStats;
+
+typedef bool (*GraphEdit)(Vertex **graph, void *context);
+
+GraphStore *createGraphStore(Vertex *graph);
+void destroyGraphStore(GraphStore *store);
+GraphReader *graphStoreReader(GraphStore *store);
+void releaseGraphReader(GraphReader *reader);
+GraphVersion *pinGraph(GraphStore *store, GraphReader *reader);
+void unpinGraph(GraphReader *reader);
+bool graphStoreEdit(GraphStore *store, GraphEdit edit, void *context);
+bool graphStoreSetDistance(GraphStore *store, int origin, int dest, float distance);
+bool graphStorePublish(GraphStore *store, Vertex *graph);
+int graphStoreReclaim(GraphStore *store);
+void readGraphStoreStats(GraphStore *store, GraphStoreStats *stats);
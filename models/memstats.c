@@ -0,0 +1,236 @@
+/**
+ * @file memstats.c
+ * @brief File containing the memory accounting of the stores, tagged by subsystem
+ *
+ * The nodes of the graph, fleet, users and rents, the indexes of the rent store and the records returned by the
+ * create functions are allocated with memAlloc or memCalloc under a tag, and freed with memFree under the same tag.
+ * Each tag counts the live and peak bytes and the allocations and frees. The bytes are the ones the allocator
+ * really hands out (malloc_usable_size plus the chunk header), so rounding is counted. Nothing is added to the
+ * allocations, and memory freed with a plain free stays valid; only the counters drift.
+ *
+ * printMemoryReport divides the bytes of each tag by the number of records it holds, and measures how much of the
+ * fixed char arrays of the records is left unused, which is what a release adds or saves per record. The
+ * temporaries that are still live were never freed by the caller of createUser, createVehicle or createRent.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "./memstats.h"
+
+typedef struct MemSlot
+{
+  _Alignas(64) MemCounters counters; // a cache line each, threads allocating under different tags do not collide
+} MemSlot;
+
+static MemSlot memSlots[MEM_TAGS + 1]; // the last slot counts every tag
+static const char *memTagNames[MEM_TAGS] = {"vertices", "edges", "vehicles", "users", "rents", "rent indexes",
+                                            "temporaries"};
+
+/**
+ * @brief Gets the name of a tag
+ *
+ * @param tag The tag
+ * @return The name, or "unknown"
+ */
+const char *memTagName(MemTag tag)
+{
+  return tag >= 0 && tag < MEM_TAGS ? memTagNames[tag] : "unknown";
+}
+
+/**
+ * @brief Adds an allocation or a free to the counters of a slot
+ *
+ * @param counters A pointer to the counters
+ * @param bytes The bytes allocated, negative for a free
+ */
+static void countBytes(MemCounters *counters, int64_t bytes)
+{
+  int64_t live = __atomic_add_fetch(&counters->liveBytes, bytes, __ATOMIC_RELAXED);
+  __atomic_fetch_add(bytes > 0 ? &counters->allocations : &counters->frees, 1, __ATOMIC_RELAXED);
+  int64_t peak = __atomic_load_n(&counters->peakBytes, __ATOMIC_RELAXED);
+  while (live > peak && !__atomic_compare_exchange_n(&counters->peakBytes, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+/**
+ * @brief Gets the bytes an allocation takes from the heap
+ *
+ * @param ptr A pointer returned by malloc or calloc
+ * @return The usable bytes plus the chunk header
+ */
+static int64_t chunkBytes(void *ptr)
+{
+  return (int64_t)(malloc_usable_size(ptr) + sizeof(size_t));
+}
+
+/**
+ * @brief Allocates memory counted under a tag
+ *
+ * @param tag The tag
+ * @param size The bytes to allocate
+ * @return A pointer to the memory, or NULL if there was no memory
+ */
+void *memAlloc(MemTag tag, size_t size)
+{
+  void *ptr = malloc(size);
+  if (ptr != NULL)
+  {
+    countBytes(&memSlots[tag].counters, chunkBytes(ptr));
+    countBytes(&memSlots[MEM_TAGS].counters, chunkBytes(ptr));
+  }
+  return ptr;
+}
+
+/**
+ * @brief Allocates zeroed memory counted under a tag
+ *
+ * @param tag The tag
+ * @param count The number of elements
+ * @param size The bytes of each element
+ * @return A pointer to the memory, or NULL if there was no memory
+ */
+void *memCalloc(MemTag tag, size_t count, size_t size)
+{
+  void *ptr = calloc(count, size);
+  if (ptr != NULL)
+  {
+    countBytes(&memSlots[tag].counters, chunkBytes(ptr));
+    countBytes(&memSlots[MEM_TAGS].counters, chunkBytes(ptr));
+  }
+  return ptr;
+}
+
+/**
+ * @brief Frees memory allocated under a tag
+ *
+ * @param tag The tag it was allocated under
+ * @param ptr A pointer to the memory, NULL does nothing
+ */
+void memFree(MemTag tag, void *ptr)
+{
+  if (ptr == NULL)
+  {
+    return;
+  }
+  countBytes(&memSlots[tag].counters, -chunkBytes(ptr));
+  countBytes(&memSlots[MEM_TAGS].counters, -chunkBytes(ptr));
+  free(ptr);
+}
+
+/**
+ * @brief Reads the counters of a tag
+ *
+ * @param tag The tag, MEM_TAGS for the sum of every tag
+ * @param counters Receives the counters
+ */
+void memCounters(MemTag tag, MemCounters *counters)
+{
+  MemCounters *slot = &memSlots[tag].counters;
+  counters->liveBytes = __atomic_load_n(&slot->liveBytes, __ATOMIC_RELAXED);
+  counters->peakBytes = __atomic_load_n(&slot->peakBytes, __ATOMIC_RELAXED);
+  counters->allocations = __atomic_load_n(&slot->allocations, __ATOMIC_RELAXED);
+  counters->frees = __atomic_load_n(&slot->frees, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Gets the unused bytes of a char array holding a string
+ *
+ * @param text The array
+ * @param size The size of the array
+ * @return The bytes after the terminator
+ */
+static long unusedChars(const char *text, size_t size)
+{
+  return (long)(size - strnlen(text, size) - 1);
+}
+
+/**
+ * @brief Prints a line of the memory report
+ *
+ * @param fp The file
+ * @param tag The tag, MEM_TAGS for the total
+ * @param records The number of records the tag holds
+ * @param structBytes The size of a record, 0 if the records have no fixed size
+ * @param unused The unused bytes of the char arrays of all the records
+ */
+static void printReportLine(FILE *fp, MemTag tag, long records, size_t structBytes, long unused)
+{
+  MemCounters counters;
+  memCounters(tag, &counters);
+  fprintf(fp, "%-13s %14lld %14lld %12lld %12lld %10ld", tag == MEM_TAGS ? "total" : memTagName(tag),
+          (long long)counters.liveBytes, (long long)counters.peakBytes, (long long)counters.allocations,
+          (long long)counters.frees, records);
+  if (records > 0)
+    fprintf(fp, " %12.1f", (double)counters.liveBytes / records);
+  else
+    fprintf(fp, " %12s", "-");
+  if (structBytes > 0)
+    fprintf(fp, " %12zu", structBytes);
+  else
+    fprintf(fp, " %12s", "-");
+  if (records > 0 && structBytes > 0)
+    fprintf(fp, " %14.1f\n", (double)unused / records);
+  else
+    fprintf(fp, " %14s\n", "-");
+}
+
+/**
+ * @brief Prints the memory of each subsystem and its bytes per record
+ *
+ * The bytes per record of the rent indexes are per rent, and the records of the temporaries are the ones never freed.
+ *
+ * @param fp The file, stdout for the console
+ * @param graph A pointer to the head of the graph
+ * @param users A pointer to the head node of the user list
+ * @param vehicles A pointer to the head node of the vehicle list
+ * @param rentStore A pointer to the rent store, or NULL
+ */
+void printMemoryReport(FILE *fp, Vertex *graph, UserList *users, VehicleList *vehicles, RentStore *rentStore)
+{
+  long vertexCount = 0, edgeCount = 0, vehicleCount = 0, userCount = 0, rentCount = 0;
+  long vertexUnused = 0, vehicleUnused = 0, userUnused = 0, rentUnused = 0;
+
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+  {
+    vertexCount++;
+    vertexUnused += unusedChars(vertex->city, sizeof(vertex->city));
+    for (Adj *adj = vertex->adjacents; adj != NULL; adj = adj->next)
+      edgeCount++;
+  }
+  for (VehicleList *node = vehicles; node != NULL; node = node->next)
+  {
+    vehicleCount++;
+    vehicleUnused += unusedChars(node->vehicle.registration, sizeof(node->vehicle.registration)) +
+                     unusedChars(node->vehicle.type, sizeof(node->vehicle.type)) +
+                     unusedChars(node->vehicle.location, sizeof(node->vehicle.location));
+  }
+  for (UserList *node = users; node != NULL; node = node->next)
+  {
+    userCount++;
+    userUnused += unusedChars(node->user.name, sizeof(node->user.name)) +
+                  unusedChars(node->user.email, sizeof(node->user.email)) +
+                  unusedChars(node->user.password, sizeof(node->user.password));
+  }
+  for (RentList *node = rentStore != NULL ? rentStore->head : NULL; node != NULL; node = node->next)
+  {
+    rentCount++;
+    rentUnused += unusedChars(node->rent.vehicleRegistration, sizeof(node->rent.vehicleRegistration));
+  }
+
+  MemCounters temporaries;
+  memCounters(MEM_TEMPORARIES, &temporaries);
+  fprintf(fp, "%-13s %14s %14s %12s %12s %10s %12s %12s %14s\n", "subsystem", "live bytes", "peak bytes", "allocations",
+          "frees", "records", "bytes/record", "struct bytes", "unused chars");
+  printReportLine(fp, MEM_VERTICES, vertexCount, sizeof(Vertex), vertexUnused);
+  printReportLine(fp, MEM_EDGES, edgeCount, sizeof(Adj), 0);
+  printReportLine(fp, MEM_VEHICLES, vehicleCount, sizeof(VehicleList), vehicleUnused);
+  printReportLine(fp, MEM_USERS, userCount, sizeof(UserList), userUnused);
+  printReportLine(fp, MEM_RENTS, rentCount, sizeof(RentList), rentUnused);
+  printReportLine(fp, MEM_RENT_INDEXES, rentCount, 0, 0);
+  printReportLine(fp, MEM_TEMPORARIES, (long)(temporaries.allocations - temporaries.frees), 0, 0);
+  printReportLine(fp, MEM_TAGS, vertexCount + edgeCount + vehicleCount + userCount + rentCount, 0, 0);
+}
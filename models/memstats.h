@@ -0,0 +1,43 @@
+/**
+ * @file memstats.h
+ * @brief File containing the memory accounting of the stores, tagged by subsystem
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "./routes.h"
+#include "./user.h"
+#include "./vehicle.h"
+#include "./rentals.h"
+#pragma once
+
+typedef enum MemTag
+{
+  MEM_VERTICES,
+  MEM_EDGES,
+  MEM_VEHICLES,
+  MEM_USERS,
+  MEM_RENTS,
+  MEM_RENT_INDEXES,
+  MEM_TEMPORARIES, // records returned by createUser, createVehicle and createRent, owned by the caller
+  MEM_TAGS
+} MemTag;
+
+typedef struct MemCounters
+{
+  int64_t liveBytes; // bytes handed out by the allocator and not freed, its chunk headers included
+  int64_t peakBytes;
+  int64_t allocations;
+  int64_t frees;
+} MemCounters;
+
+const char *memTagName(MemTag tag);
+void *memAlloc(MemTag tag, size_t size);
+void *memCalloc(MemTag tag, size_t count, size_t size);
+void memFree(MemTag tag, void *ptr);
+void memCounters(MemTag tag, MemCounters *counters);
+void printMemoryReport(FILE *fp, Vertex *graph, UserList *users, VehicleList *vehicles, RentStore *rentStore);
@@ -0,0 +1,438 @@
+/**
+ * @file metrics.c
+ * @brief File containing the latency histograms and call counters of the hot operations
+ *
+ * Every instrumented function opens a METRIC_SCOPE, which times the call and records it in a log-linear histogram
+ * like the ones of HdrHistogram: values below 16 ns have a bucket each, and every power of two above is split in 16
+ * linear buckets, so a latency is known within 1/16 from nanoseconds to hours with 656 counters per operation.
+ *
+ * Each thread records in its own block of counters, allocated on its first call and never freed, so a call costs
+ * two clock reads and a few stores to memory no other thread writes. Readers merge the blocks of every thread that
+ * ever recorded. The counters are written with relaxed atomic stores, so a read taken while calls are running is
+ * consistent per counter, not across counters.
+ *
+ * The recording is only compiled with -DMETRICS. Without it METRIC_SCOPE expands to nothing, no thread ever
+ * allocates counters and the reading functions report that the metrics are disabled.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include "./metrics.h"
+
+static const char *metricNames[METRIC_OPERATIONS] = {
+    "createRent",
+    "searchUser",
+    "searchVehicle",
+    "searchRentById",
+    "searchRentsByUser",
+    "searchRentsByVehicle",
+    "searchVertex",
+    "searchVertexCod",
+    "userStoreGet",
+    "bestPath",
+    "shortestPath",
+    "isReachable",
+    "checkVehiclesInRadius",
+    "findVehiclesInRadius",
+    "recoverTruck",
+    "executeCommand",
+    "readUsersFromTxt",
+    "setUsersData",
+    "storeUsersInFile",
+    "loadUsersFromPager",
+    "storeUsersInPager",
+    "readVehiclesFromTxt",
+    "setVehiclesData",
+    "storeVehicleListInFile",
+    "loadVehiclesFromPager",
+    "storeVehiclesInPager",
+    "loadRentsFromFile",
+    "storeRentsInFile",
+    "loadRentsFromPager",
+    "storeRentsInPager",
+    "routesReadTxt",
+    "loadGraph",
+    "loadAdj",
+    "saveGraph",
+    "loadGraphFromPager",
+    "saveGraphInPager",
+    "loadGraphEdges",
+    "saveGraphEdges",
+    "openWarmImage",
+    "writeWarmImage",
+    "writeSnapshot",
+};
+
+/**
+ * @brief Gets the name of an operation, the name of the function it times
+ *
+ * @param operation The operation
+ * @return The name, or "unknown"
+ */
+const char *metricName(MetricOperation operation)
+{
+  return operation >= 0 && operation < METRIC_OPERATIONS ? metricNames[operation] : "unknown";
+}
+
+/**
+ * @brief Gets the histogram bucket of a latency
+ *
+ * @param ns The latency in nanoseconds
+ * @return The bucket, from 0 to METRICS_BUCKETS - 1
+ */
+int metricBucket(uint64_t ns)
+{
+  if (ns < METRICS_SUB_BUCKETS)
+  {
+    return (int)ns;
+  }
+  int magnitude = 63 - __builtin_clzll(ns);
+  if (magnitude >= METRICS_MAX_BITS)
+  {
+    return METRICS_BUCKETS - 1;
+  }
+  int shift = magnitude - METRICS_SUB_BUCKET_BITS;
+  return ((shift + 1) << METRICS_SUB_BUCKET_BITS) + (int)((ns >> shift) & (METRICS_SUB_BUCKETS - 1));
+}
+
+/**
+ * @brief Gets the highest latency of a histogram bucket
+ *
+ * @param bucket The bucket
+ * @return The highest latency in nanoseconds that falls in the bucket
+ */
+uint64_t metricBucketHighest(int bucket)
+{
+  if (bucket < METRICS_SUB_BUCKETS)
+  {
+    return (uint64_t)bucket;
+  }
+  int shift = (bucket >> METRICS_SUB_BUCKET_BITS) - 1;
+  uint64_t lowest = (uint64_t)(METRICS_SUB_BUCKETS + (bucket & (METRICS_SUB_BUCKETS - 1))) << shift;
+  return lowest + ((uint64_t)1 << shift) - 1;
+}
+
+/**
+ * @brief Gets a percentile of the latencies of a summary
+ *
+ * @param summary A pointer to the summary
+ * @param percentile The percentile, from 0 to 100
+ * @return The highest latency of the bucket holding the percentile, never above the maximum, or 0 with no calls
+ */
+uint64_t metricPercentile(MetricSummary *summary, double percentile)
+{
+  if (summary->calls == 0)
+  {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)(percentile / 100 * summary->calls + 0.5);
+  uint64_t seen = 0;
+  rank = rank < 1 ? 1 : rank > summary->calls ? summary->calls : rank;
+  for (int b = 0; b < METRICS_BUCKETS; b++)
+  {
+    seen += summary->buckets[b];
+    if (seen >= rank)
+    {
+      uint64_t highest = metricBucketHighest(b);
+      return highest < summary->maxNs ? highest : summary->maxNs;
+    }
+  }
+  return summary->maxNs;
+}
+
+#ifdef METRICS
+
+typedef struct MetricThread
+{
+  MetricSummary operations[METRIC_OPERATIONS]; // only written by the thread that owns the block
+  struct MetricThread *next;
+} MetricThread;
+
+static MetricThread *metricThreads = NULL;
+static __thread MetricThread *localMetrics = NULL;
+static bool dumperStarted = false;
+
+/**
+ * @brief Allocates the counters of the calling thread and links them where the readers find them
+ *
+ * @return A pointer to the counters, or NULL if there was no memory
+ */
+static MetricThread *registerThread()
+{
+  MetricThread *thread = (MetricThread *)calloc(1, sizeof(MetricThread));
+  if (thread == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+  thread->next = __atomic_load_n(&metricThreads, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&metricThreads, &thread->next, thread, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+  localMetrics = thread;
+  return thread;
+}
+
+/**
+ * @brief Tells if the metrics were compiled in
+ *
+ * @return True if the program was built with -DMETRICS, false otherwise
+ */
+bool metricsEnabled()
+{
+  return true;
+}
+
+/**
+ * @brief Records a call of an operation in the counters of the calling thread
+ *
+ * @param operation The operation
+ * @param ns The latency of the call in nanoseconds
+ */
+void metricRecord(MetricOperation operation, uint64_t ns)
+{
+  MetricThread *thread = localMetrics;
+  if (thread == NULL && (thread = registerThread()) == NULL)
+  {
+    return;
+  }
+  MetricSummary *counters = &thread->operations[operation];
+  int bucket = metricBucket(ns);
+  __atomic_store_n(&counters->calls, counters->calls + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&counters->totalNs, counters->totalNs + ns, __ATOMIC_RELAXED);
+  __atomic_store_n(&counters->buckets[bucket], counters->buckets[bucket] + 1, __ATOMIC_RELAXED);
+  if (ns > counters->maxNs)
+  {
+    __atomic_store_n(&counters->maxNs, ns, __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * @brief Merges the counters of an operation from every thread
+ *
+ * @param operation The operation
+ * @param summary Receives the merged counters
+ * @return True if the summary was read, false if the metrics are disabled
+ */
+bool readMetric(MetricOperation operation, MetricSummary *summary)
+{
+  memset(summary, 0, sizeof(MetricSummary));
+  for (MetricThread *thread = __atomic_load_n(&metricThreads, __ATOMIC_ACQUIRE); thread != NULL; thread = thread->next)
+  {
+    MetricSummary *counters = &thread->operations[operation];
+    uint64_t maxNs = __atomic_load_n(&counters->maxNs, __ATOMIC_RELAXED);
+    summary->calls += __atomic_load_n(&counters->calls, __ATOMIC_RELAXED);
+    summary->totalNs += __atomic_load_n(&counters->totalNs, __ATOMIC_RELAXED);
+    summary->maxNs = maxNs > summary->maxNs ? maxNs : summary->maxNs;
+    for (int b = 0; b < METRICS_BUCKETS; b++)
+    {
+      summary->buckets[b] += __atomic_load_n(&counters->buckets[b], __ATOMIC_RELAXED);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Clears the counters of every thread, meant for when no thread is recording
+ */
+void resetMetrics()
+{
+  for (MetricThread *thread = __atomic_load_n(&metricThreads, __ATOMIC_ACQUIRE); thread != NULL; thread = thread->next)
+  {
+    memset(thread->operations, 0, sizeof(thread->operations));
+  }
+}
+
+/**
+ * @brief Writes the calls and latency percentiles of every operation that was called, in microseconds
+ *
+ * @param fp The file, stdout for the console
+ * @return True if the report was written, false otherwise
+ */
+bool dumpMetrics(FILE *fp)
+{
+  MetricSummary *summary = (MetricSummary *)malloc(sizeof(MetricSummary));
+  if (summary == NULL)
+  {
+    perror("could not allocate memory!");
+    return false;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  fprintf(fp, "metrics at %lld\n", (long long)ts.tv_sec);
+  fprintf(fp, "%-24s %12s %12s %12s %12s %12s %12s %12s\n", "operation", "calls", "mean us", "p50 us", "p90 us",
+          "p99 us", "p99.9 us", "max us");
+  for (int operation = 0; operation < METRIC_OPERATIONS; operation++)
+  {
+    readMetric(operation, summary);
+    if (summary->calls == 0)
+    {
+      continue;
+    }
+    fprintf(fp, "%-24s %12llu %12.3f %12.3f %12.3f %12.3f %12.3f %12.3f\n", metricName(operation),
+            (unsigned long long)summary->calls, summary->totalNs / 1e3 / summary->calls,
+            metricPercentile(summary, 50) / 1e3, metricPercentile(summary, 90) / 1e3,
+            metricPercentile(summary, 99) / 1e3, metricPercentile(summary, 99.9) / 1e3, summary->maxNs / 1e3);
+  }
+  free(summary);
+  return fflush(fp) == 0;
+}
+
+/**
+ * @brief Appends the report of dumpMetrics to a file
+ *
+ * @param fileName The path of the file, or NULL for stdout
+ * @return True if the report was written, false otherwise
+ */
+bool dumpMetricsToFile(char *fileName)
+{
+  if (fileName == NULL)
+  {
+    return dumpMetrics(stdout);
+  }
+  FILE *fp = fopen(fileName, "a");
+  if (fp == NULL)
+  {
+    perror("could not open file");
+    return false;
+  }
+  bool written = dumpMetrics(fp);
+  return fclose(fp) == 0 && written;
+}
+
+/**
+ * @brief Waits for SIGUSR1 and dumps the metrics every time it arrives
+ *
+ * @param arg The path of the file, or NULL for stdout
+ * @return NULL
+ */
+static void *dumperThread(void *arg)
+{
+  sigset_t set;
+  int signal;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  while (sigwait(&set, &signal) == 0)
+  {
+    dumpMetricsToFile((char *)arg);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Starts a thread that dumps the metrics on SIGUSR1, as in kill -USR1 <pid>
+ *
+ * SIGUSR1 is blocked in the calling thread and taken with sigwait by the dumper, so the report is not written from
+ * a signal handler. Threads inherit the blocked signal, so this must be called before any other thread is started.
+ *
+ * @param fileName The path of the file the reports are appended to, or NULL for stdout
+ * @return True if the dumper is running, false otherwise
+ */
+bool startMetricsDumper(char *fileName)
+{
+  if (dumperStarted)
+  {
+    return true;
+  }
+  sigset_t set;
+  pthread_t thread;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0 || pthread_create(&thread, NULL, dumperThread, fileName) != 0)
+  {
+    perror("could not start the metrics dumper");
+    return false;
+  }
+  pthread_detach(thread);
+  dumperStarted = true;
+  return true;
+}
+
+#else
+
+// without METRICS nothing is recorded, and the report functions write nothing
+
+/**
+ * @brief Tells if the metrics were compiled in
+ *
+ * @return False, the program was built without METRICS
+ */
+bool metricsEnabled()
+{
+  return false;
+}
+
+/**
+ * @brief Records nothing, the program was built without METRICS
+ *
+ * @param operation The operation that was timed
+ * @param ns The latency of the call in nanoseconds
+ */
+void metricRecord(MetricOperation operation, uint64_t ns)
+{
+  (void)operation;
+  (void)ns;
+}
+
+/**
+ * @brief Reads an empty summary, the program was built without METRICS
+ *
+ * @param operation The operation
+ * @param summary Receives a zeroed summary
+ * @return False, there are no metrics
+ */
+bool readMetric(MetricOperation operation, MetricSummary *summary)
+{
+  (void)operation;
+  memset(summary, 0, sizeof(MetricSummary));
+  return false;
+}
+
+/**
+ * @brief Does nothing, the program was built without METRICS
+ */
+void resetMetrics()
+{
+}
+
+/**
+ * @brief Writes nothing, the program was built without METRICS
+ *
+ * @param fp The file the report would be written to
+ * @return False, there is no report
+ */
+bool dumpMetrics(FILE *fp)
+{
+  (void)fp;
+  return false;
+}
+
+/**
+ * @brief Writes nothing, the program was built without METRICS
+ *
+ * @param fileName The path of the file the report would be appended to, or NULL for stdout
+ * @return False, there is no report
+ */
+bool dumpMetricsToFile(char *fileName)
+{
+  (void)fileName;
+  return false;
+}
+
+/**
+ * @brief Starts no thread, the program was built without METRICS
+ *
+ * @param fileName The path of the file the reports would be appended to, or NULL for stdout
+ * @return False, there is no dumper
+ */
+bool startMetricsDumper(char *fileName)
+{
+  (void)fileName;
+  return false;
+}
+
+#endif
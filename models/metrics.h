@@ -0,0 +1,124 @@
+/**
+ * @file metrics.h
+ * @brief File containing the latency histograms and call counters of the hot operations
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#pragma once
+
+#define METRICS_SUB_BUCKET_BITS 4 // 16 linear buckets per power of two, values are kept within 1/16
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_MAX_BITS 44 // about 4.9 hours in nanoseconds, longer calls fall in the last bucket
+#define METRICS_BUCKETS ((METRICS_MAX_BITS - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS)
+
+typedef enum MetricOperation
+{
+  METRIC_CREATE_RENT,
+  METRIC_SEARCH_USER,
+  METRIC_SEARCH_VEHICLE,
+  METRIC_SEARCH_RENT_BY_ID,
+  METRIC_SEARCH_RENTS_BY_USER,
+  METRIC_SEARCH_RENTS_BY_VEHICLE,
+  METRIC_SEARCH_VERTEX,
+  METRIC_SEARCH_VERTEX_COD,
+  METRIC_USER_STORE_GET,
+  METRIC_BEST_PATH,
+  METRIC_SHORTEST_PATH,
+  METRIC_IS_REACHABLE,
+  METRIC_VEHICLES_IN_RADIUS,
+  METRIC_FIND_VEHICLES_IN_RADIUS,
+  METRIC_RECOVER_TRUCK,
+  METRIC_EXECUTE_COMMAND,
+  METRIC_READ_USERS_TXT,
+  METRIC_LOAD_USERS,
+  METRIC_STORE_USERS,
+  METRIC_LOAD_USERS_PAGER,
+  METRIC_STORE_USERS_PAGER,
+  METRIC_READ_VEHICLES_TXT,
+  METRIC_LOAD_VEHICLES,
+  METRIC_STORE_VEHICLES,
+  METRIC_LOAD_VEHICLES_PAGER,
+  METRIC_STORE_VEHICLES_PAGER,
+  METRIC_LOAD_RENTS,
+  METRIC_STORE_RENTS,
+  METRIC_LOAD_RENTS_PAGER,
+  METRIC_STORE_RENTS_PAGER,
+  METRIC_READ_ROUTES_TXT,
+  METRIC_LOAD_GRAPH,
+  METRIC_LOAD_ADJ,
+  METRIC_SAVE_GRAPH,
+  METRIC_LOAD_GRAPH_PAGER,
+  METRIC_SAVE_GRAPH_PAGER,
+  METRIC_LOAD_GRAPH_EDGES,
+  METRIC_SAVE_GRAPH_EDGES,
+  METRIC_OPEN_WARM_IMAGE,
+  METRIC_WRITE_WARM_IMAGE,
+  METRIC_WRITE_SNAPSHOT,
+  METRIC_OPERATIONS
+} MetricOperation;
+
+typedef struct MetricSummary
+{
+  uint64_t calls;
+  uint64_t totalNs;
+  uint64_t maxNs;
+  uint64_t buckets[METRICS_BUCKETS]; // calls per latency bucket, see metricBucket
+} MetricSummary;
+
+const char *metricName(MetricOperation operation);
+int metricBucket(uint64_t ns);
+uint64_t metricBucketHighest(int bucket);
+uint64_t metricPercentile(MetricSummary *summary, double percentile);
+bool metricsEnabled();
+void metricRecord(MetricOperation operation, uint64_t ns);
+bool readMetric(MetricOperation operation, MetricSummary *summary);
+void resetMetrics();
+bool dumpMetrics(FILE *fp);
+bool dumpMetricsToFile(char *fileName);
+bool startMetricsDumper(char *fileName);
+
+#ifdef METRICS
+
+typedef struct MetricScope
+{
+  MetricOperation operation;
+  uint64_t start;
+} MetricScope;
+
+/**
+ * @brief Gets the time of a monotonic clock in nanoseconds
+ *
+ * @return The time in nanoseconds
+ */
+static inline uint64_t metricsNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Records the call of a scope opened with METRIC_SCOPE, run by the compiler when the scope is left
+ *
+ * @param scope A pointer to the scope
+ */
+static inline void metricScopeEnd(MetricScope *scope)
+{
+  metricRecord(scope->operation, metricsNow() - scope->start);
+}
+
+// times the rest of the enclosing block, every return included, as one call of the operation
+#define METRIC_SCOPE(operation) \
+  MetricScope metricScope __attribute__((cleanup(metricScopeEnd))) = {(operation), metricsNow()}
+
+#else
+
+// built without -DMETRICS the scopes are removed and the hot paths are not touched
+#define METRIC_SCOPE(operation) ((void)0)
+
+#endif
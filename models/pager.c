@@ -0,0 +1,784 @@
+/**
+ * @file pager.c
+ * @brief File containing the functions of the paged storage file
+ *
+ * This file contains a single storage file for every store, split in PAGER_PAGE_SIZE pages. Pages 0 and 1 hold
+ * two copies of the superblock, with the number of pages and, for each table, its chain of pages and its record size.
+ * Every other page starts with a PageHeader and holds fixed size records of one table, and links to the next page of
+ * that table. Pages are read and written whole through a cache of a fixed number of frames, which evicts the least
+ * recently used page that is not pinned, so a table can be far bigger than the cache and is streamed through it with
+ * a cursor.
+ *
+ * The file is changed by shadow paging. A table is replaced whole: pagerClearTable only forgets its pages, and the
+ * new records go to pages that no durable superblock links. A flush writes those pages, waits for them, and only then
+ * writes the superblock into the older of the two slots, with a higher generation and a checksum. The pages of the
+ * cleared tables are reused only after that, so a crash at any point leaves the newest valid superblock pointing at
+ * pages that were never overwritten, and the file opens with either the old or the new tables. The free pages are not
+ * stored: the first allocation after opening the file finds them by walking the chains of the tables.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "./pager.h"
+
+#define PAGE_DATA_SIZE (PAGER_PAGE_SIZE - sizeof(PageHeader))
+
+/**
+ * @brief Gets the bucket of a page in the frame index
+ *
+ * @param pager A pointer to the pager
+ * @param page The page number
+ * @return The index of the bucket
+ */
+static int pageBucket(Pager *pager, uint32_t page)
+{
+  return (int)((page * 2654435761u) & (uint32_t)(pager->bucketCount - 1));
+}
+
+/**
+ * @brief Removes a frame from the LRU list
+ *
+ * @param frame The frame to be removed
+ */
+static void lruRemove(PageFrame *frame)
+{
+  frame->lruPrevious->lruNext = frame->lruNext;
+  frame->lruNext->lruPrevious = frame->lruPrevious;
+  frame->lruPrevious = NULL;
+  frame->lruNext = NULL;
+}
+
+/**
+ * @brief Puts a frame at the most recently used end of the LRU list
+ *
+ * @param pager A pointer to the pager
+ * @param frame The frame to be added
+ */
+static void lruPush(Pager *pager, PageFrame *frame)
+{
+  frame->lruPrevious = &pager->lru;
+  frame->lruNext = pager->lru.lruNext;
+  pager->lru.lruNext->lruPrevious = frame;
+  pager->lru.lruNext = frame;
+}
+
+/**
+ * @brief Computes the FNV-1a checksum of a superblock
+ *
+ * @param super A pointer to the superblock, its checksum field is ignored
+ * @return The checksum of the superblock
+ */
+static uint32_t checksumSuperblock(PagerSuperblock *super)
+{
+  uint32_t saved = super->checksum;
+  uint32_t h = 2166136261u;
+  unsigned char *bytes = (unsigned char *)super;
+
+  super->checksum = 0;
+  for (size_t i = 0; i < sizeof(PagerSuperblock); i++)
+  {
+    h ^= bytes[i];
+    h *= 16777619u;
+  }
+  super->checksum = saved;
+  return h;
+}
+
+/**
+ * @brief Reads the superblock of one slot and checks it
+ *
+ * @param fd The file descriptor of the storage file
+ * @param slot The page of the superblock, 0 or 1
+ * @param super Receives the superblock
+ * @return True if the slot holds a whole superblock of this version with a valid checksum, false otherwise
+ */
+static bool readSuperblock(int fd, uint32_t slot, PagerSuperblock *super)
+{
+  uint8_t page[PAGER_PAGE_SIZE];
+  if (pread(fd, page, PAGER_PAGE_SIZE, (off_t)slot * PAGER_PAGE_SIZE) != PAGER_PAGE_SIZE)
+  {
+    return false;
+  }
+  memcpy(super, page, sizeof(PagerSuperblock));
+  return super->magic == PAGER_MAGIC && super->version == PAGER_VERSION && super->pageSize == PAGER_PAGE_SIZE &&
+         super->pageCount >= PAGER_SUPERBLOCKS && super->checksum == checksumSuperblock(super);
+}
+
+/**
+ * @brief Checks that no superblock was ever written to a file
+ *
+ * A file that crashed before its first flush may already hold table pages, but both slots are still zero.
+ *
+ * @param fd The file descriptor of the file
+ * @return True if both superblock slots are empty or past the end of the file, false otherwise
+ */
+static bool isBlankFile(int fd)
+{
+  uint8_t page[PAGER_SUPERBLOCKS * PAGER_PAGE_SIZE] = {0};
+  if (pread(fd, page, sizeof(page), 0) < 0)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < sizeof(page); i++)
+  {
+    if (page[i] != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Writes the superblock, with the next generation, into the slot that does not hold the durable one
+ *
+ * @param pager A pointer to the pager
+ * @return True if the page was written, false otherwise
+ */
+static bool writeSuperblock(Pager *pager)
+{
+  uint8_t page[PAGER_PAGE_SIZE] = {0};
+  pager->super.generation = pager->durable.generation + 1;
+  pager->super.checksum = checksumSuperblock(&pager->super);
+  memcpy(page, &pager->super, sizeof(PagerSuperblock));
+  pager->pageWrites++;
+  off_t offset = (off_t)(pager->super.generation % PAGER_SUPERBLOCKS) * PAGER_PAGE_SIZE;
+  return pwrite(pager->fd, page, PAGER_PAGE_SIZE, offset) == PAGER_PAGE_SIZE;
+}
+
+/**
+ * @brief Adds a page number to a growing array of pages
+ *
+ * @param pages A pointer to the array
+ * @param count A pointer to the number of pages in the array
+ * @param capacity A pointer to the capacity of the array
+ * @param page The page number
+ * @return True if the page was added, false if there was no memory
+ */
+static bool pushPage(uint32_t **pages, int *count, int *capacity, uint32_t page)
+{
+  if (*count == *capacity)
+  {
+    int grown = *capacity > 0 ? *capacity * 2 : 64;
+    uint32_t *resized = (uint32_t *)realloc(*pages, grown * sizeof(uint32_t));
+    if (resized == NULL)
+    {
+      perror("could not allocate memory!");
+      return false;
+    }
+    *pages = resized;
+    *capacity = grown;
+  }
+  (*pages)[(*count)++] = page;
+  return true;
+}
+
+/**
+ * @brief Opens a storage file, creating it if it does not exist
+ *
+ * @param fileName The path of the file
+ * @param cachePages The number of pages kept in memory
+ * @return A pointer to the pager, or NULL if the file could not be opened, is not a storage file, or there was no
+ * memory
+ */
+Pager *openPager(char *fileName, int cachePages)
+{
+  Pager *pager = (Pager *)calloc(1, sizeof(Pager));
+  if (pager == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+
+  pager->fd = open(fileName, O_RDWR | O_CREAT, 0644);
+  if (pager->fd < 0)
+  {
+    perror("could not open file");
+    free(pager);
+    return NULL;
+  }
+
+  PagerSuperblock slots[PAGER_SUPERBLOCKS];
+  bool isValid[PAGER_SUPERBLOCKS];
+  for (uint32_t slot = 0; slot < PAGER_SUPERBLOCKS; slot++)
+  {
+    isValid[slot] = readSuperblock(pager->fd, slot, &slots[slot]);
+  }
+
+  if (isValid[0] || isValid[1])
+  {
+    // a torn write only ever hits the older slot, the newest valid one is the durable state
+    int current = isValid[0] && (!isValid[1] || slots[0].generation > slots[1].generation) ? 0 : 1;
+    pager->super = slots[current];
+  }
+  else if (isBlankFile(pager->fd))
+  {
+    pager->super.magic = PAGER_MAGIC;
+    pager->super.version = PAGER_VERSION;
+    pager->super.pageSize = PAGER_PAGE_SIZE;
+    pager->super.pageCount = PAGER_SUPERBLOCKS;
+  }
+  else
+  {
+    fprintf(stderr, "%s is not a storage file\n", fileName);
+    close(pager->fd);
+    free(pager);
+    return NULL;
+  }
+  pager->durable = pager->super;
+
+  if (cachePages < 4)
+  {
+    cachePages = 4;
+  }
+  pager->frameCount = cachePages;
+  pager->bucketCount = 1;
+  while (pager->bucketCount < cachePages * 2)
+  {
+    pager->bucketCount <<= 1;
+  }
+
+  pager->frames = (PageFrame *)calloc(cachePages, sizeof(PageFrame));
+  pager->buckets = (PageFrame **)calloc(pager->bucketCount, sizeof(PageFrame *));
+  pager->memory = (uint8_t *)aligned_alloc(PAGER_PAGE_SIZE, (size_t)cachePages * PAGER_PAGE_SIZE);
+  if (pager->frames == NULL || pager->buckets == NULL || pager->memory == NULL)
+  {
+    perror("could not allocate memory!");
+    close(pager->fd);
+    free(pager->frames);
+    free(pager->buckets);
+    free(pager->memory);
+    free(pager);
+    return NULL;
+  }
+
+  pager->lru.lruNext = &pager->lru;
+  pager->lru.lruPrevious = &pager->lru;
+  for (int i = 0; i < cachePages; i++)
+  {
+    pager->frames[i].data = pager->memory + (size_t)i * PAGER_PAGE_SIZE;
+    lruPush(pager, &pager->frames[i]);
+  }
+  return pager;
+}
+
+/**
+ * @brief Writes a frame back to the file if it was changed
+ *
+ * @param pager A pointer to the pager
+ * @param frame The frame to be written
+ * @return True if the page is clean on disk, false if it could not be written
+ */
+static bool writeFrame(Pager *pager, PageFrame *frame)
+{
+  if (!frame->used || !frame->dirty)
+  {
+    return true;
+  }
+
+  if (pwrite(pager->fd, frame->data, PAGER_PAGE_SIZE, (off_t)frame->page * PAGER_PAGE_SIZE) != PAGER_PAGE_SIZE)
+  {
+    perror("could not write page");
+    return false;
+  }
+  pager->pageWrites++;
+  frame->dirty = false;
+  return true;
+}
+
+/**
+ * @brief Writes every changed page and then the superblock, and flushes them to disk
+ *
+ * The pages are on disk before the superblock that links them is written, and the pages of the tables cleared since
+ * the last flush only become free once that superblock is on disk too.
+ *
+ * @param pager A pointer to the pager
+ * @return True if everything was written, false otherwise
+ */
+bool flushPager(Pager *pager)
+{
+  if (memcmp(&pager->super, &pager->durable, sizeof(PagerSuperblock)) == 0 && pager->releasedCount == 0)
+  {
+    return true; // nothing was written since the last flush
+  }
+
+  bool flushed = true;
+  for (int i = 0; i < pager->frameCount; i++)
+  {
+    flushed = writeFrame(pager, &pager->frames[i]) && flushed;
+  }
+  if (!flushed || fdatasync(pager->fd) != 0)
+  {
+    return false;
+  }
+  if (!writeSuperblock(pager) || fdatasync(pager->fd) != 0)
+  {
+    // the durable slot was not touched, the next flush writes the other one again
+    perror("could not write the superblock");
+    return false;
+  }
+
+  pager->durable = pager->super;
+  memset(pager->cleared, 0, sizeof(pager->cleared));
+  for (int i = 0; i < pager->releasedCount; i++)
+  {
+    if (pager->isFreeKnown && !pushPage(&pager->freePages, &pager->freeCount, &pager->freeCapacity,
+                                        pager->releasedPages[i]))
+    {
+      // without memory for the free pages, forget them and find them again on the next allocation
+      pager->isFreeKnown = false;
+      pager->freeCount = 0;
+    }
+  }
+  pager->releasedCount = 0;
+  return true;
+}
+
+/**
+ * @brief Flushes and closes a storage file, freeing the pager
+ *
+ * @param pager A pointer to the pager
+ * @return True if everything was written, false otherwise
+ */
+bool closePager(Pager *pager)
+{
+  if (pager == NULL)
+  {
+    return true;
+  }
+
+  bool flushed = flushPager(pager);
+  close(pager->fd);
+  free(pager->freePages);
+  free(pager->releasedPages);
+  free(pager->frames);
+  free(pager->buckets);
+  free(pager->memory);
+  free(pager);
+  return flushed;
+}
+
+/**
+ * @brief Gets a page into the cache and pins it
+ *
+ * The page stays in memory until it is unpinned with pagerUnpin. A page that is new to the file is not read, it is
+ * given zeroed. Only pages allocated since the last flush may be changed, the others are linked by the durable
+ * superblock.
+ *
+ * @param pager A pointer to the pager
+ * @param page The page number
+ * @param isNew True if the page was just allocated and has nothing on disk
+ * @return A pointer to the PAGER_PAGE_SIZE bytes of the page, or NULL if every frame is pinned or the page could not
+ * be read
+ */
+uint8_t *pagerFetch(Pager *pager, uint32_t page, bool isNew)
+{
+  int bucket = pageBucket(pager, page);
+  for (PageFrame *frame = pager->buckets[bucket]; frame != NULL; frame = frame->hashNext)
+  {
+    if (frame->page == page)
+    {
+      if (frame->pins++ == 0)
+      {
+        lruRemove(frame);
+      }
+      pager->hits++;
+      return frame->data;
+    }
+  }
+
+  PageFrame *victim = pager->lru.lruPrevious;
+  if (victim == &pager->lru)
+  {
+    fprintf(stderr, "every page of the cache is pinned\n");
+    return NULL;
+  }
+  if (!writeFrame(pager, victim))
+  {
+    return NULL;
+  }
+
+  if (victim->used)
+  {
+    PageFrame **link = &pager->buckets[pageBucket(pager, victim->page)];
+    while (*link != victim)
+    {
+      link = &(*link)->hashNext;
+    }
+    *link = victim->hashNext;
+  }
+
+  if (isNew)
+  {
+    memset(victim->data, 0, PAGER_PAGE_SIZE);
+  }
+  else
+  {
+    ssize_t got = pread(pager->fd, victim->data, PAGER_PAGE_SIZE, (off_t)page * PAGER_PAGE_SIZE);
+    if (got < 0)
+    {
+      perror("could not read page");
+      victim->used = false;
+      return NULL;
+    }
+    memset(victim->data + got, 0, PAGER_PAGE_SIZE - got);
+    pager->pageReads++;
+  }
+  pager->misses++;
+
+  lruRemove(victim);
+  victim->page = page;
+  victim->used = true;
+  victim->dirty = isNew;
+  victim->pins = 1;
+  victim->hashNext = pager->buckets[bucket];
+  pager->buckets[bucket] = victim;
+  return victim->data;
+}
+
+/**
+ * @brief Finds the frame that holds a page
+ *
+ * @param pager A pointer to the pager
+ * @param page The page number
+ * @return A pointer to the frame, or NULL if the page is not cached
+ */
+static PageFrame *findFrame(Pager *pager, uint32_t page)
+{
+  PageFrame *frame = pager->buckets[pageBucket(pager, page)];
+  while (frame != NULL && frame->page != page)
+  {
+    frame = frame->hashNext;
+  }
+  return frame;
+}
+
+/**
+ * @brief Unpins a page fetched with pagerFetch
+ *
+ * @param pager A pointer to the pager
+ * @param page The page number
+ * @param dirty True if the page was changed and must be written back
+ */
+void pagerUnpin(Pager *pager, uint32_t page, bool dirty)
+{
+  PageFrame *frame = findFrame(pager, page);
+  if (frame == NULL || frame->pins == 0)
+  {
+    return;
+  }
+
+  frame->dirty = frame->dirty || dirty;
+  if (--frame->pins == 0)
+  {
+    lruPush(pager, frame);
+  }
+}
+
+/**
+ * @brief Finds the free pages of the file: the pages below its size that no table of the durable superblock links
+ *
+ * The pages of the tables cleared since then are left out too, they are released by the next flush.
+ *
+ * @param pager A pointer to the pager
+ * @return True if the free pages are known, false if a page could not be read or there was no memory
+ */
+static bool findFreePages(Pager *pager)
+{
+  PagerSuperblock *durable = &pager->durable;
+  uint64_t linked = 0;
+  for (int table = 0; table < PAGER_TABLES; table++)
+  {
+    linked += durable->tables[table].pageCount;
+  }
+
+  pager->freeCount = 0;
+  if (linked + PAGER_SUPERBLOCKS < durable->pageCount)
+  {
+    bool *isLinked = (bool *)calloc(durable->pageCount, sizeof(bool));
+    if (isLinked == NULL)
+    {
+      perror("could not allocate memory!");
+      return false;
+    }
+    for (int table = 0; table < PAGER_TABLES; table++)
+    {
+      uint32_t page = durable->tables[table].firstPage;
+      while (page != 0 && page < durable->pageCount && !isLinked[page])
+      {
+        uint8_t *data = pagerFetch(pager, page, false);
+        if (data == NULL)
+        {
+          free(isLinked);
+          return false;
+        }
+        isLinked[page] = true;
+        uint32_t next = ((PageHeader *)data)->next;
+        pagerUnpin(pager, page, false);
+        page = next;
+      }
+    }
+    for (uint32_t page = durable->pageCount - 1; page >= PAGER_SUPERBLOCKS; page--)
+    {
+      if (!isLinked[page] && !pushPage(&pager->freePages, &pager->freeCount, &pager->freeCapacity, page))
+      {
+        free(isLinked);
+        return false;
+      }
+    }
+    free(isLinked);
+  }
+  pager->isFreeKnown = true;
+  return true;
+}
+
+/**
+ * @brief Takes a page from the free pages, or grows the file by one page
+ *
+ * The page is returned pinned and zeroed.
+ *
+ * @param pager A pointer to the pager
+ * @param page Receives the page number
+ * @return A pointer to the page, or NULL if it could not be fetched
+ */
+static uint8_t *allocatePage(Pager *pager, uint32_t *page)
+{
+  if (!pager->isFreeKnown && !findFreePages(pager))
+  {
+    return NULL;
+  }
+
+  bool isReused = pager->freeCount > 0;
+  *page = isReused ? pager->freePages[pager->freeCount - 1] : pager->super.pageCount;
+  uint8_t *data = pagerFetch(pager, *page, true);
+  if (data == NULL)
+  {
+    return NULL;
+  }
+  if (isReused)
+  {
+    // the page may still be cached with the records of the table that released it
+    memset(data, 0, PAGER_PAGE_SIZE);
+    findFrame(pager, *page)->dirty = true;
+    pager->freeCount--;
+  }
+  else
+  {
+    pager->super.pageCount++;
+  }
+  return data;
+}
+
+/**
+ * @brief Empties a table, so it can be written again from its first record
+ *
+ * Nothing is written. The pages of the table as it is on disk are released by the next flush; pages it got since the
+ * last flush are linked by no superblock and are free again at once.
+ *
+ * @param pager A pointer to the pager
+ * @param table The table
+ * @param recordSize The size of the records the table will hold from now on
+ * @return True if the table was emptied, false if a page could not be read, there was no memory or the records do not
+ * fit in a page
+ */
+bool pagerClearTable(Pager *pager, PagerTable table, uint32_t recordSize)
+{
+  PagerTableInfo *info = &pager->super.tables[table];
+  if (recordSize == 0 || recordSize > PAGE_DATA_SIZE)
+  {
+    fprintf(stderr, "records of %u bytes do not fit in a page\n", recordSize);
+    return false;
+  }
+
+  bool isDurable = !pager->cleared[table];
+  uint32_t page = info->firstPage;
+  while (page != 0)
+  {
+    uint8_t *data = pagerFetch(pager, page, false);
+    if (data == NULL)
+    {
+      return false;
+    }
+    uint32_t next = ((PageHeader *)data)->next;
+    pagerUnpin(pager, page, false);
+    bool isKept = isDurable ? pushPage(&pager->releasedPages, &pager->releasedCount, &pager->releasedCapacity, page)
+                            : !pager->isFreeKnown ||
+                                  pushPage(&pager->freePages, &pager->freeCount, &pager->freeCapacity, page);
+    if (!isKept)
+    {
+      return false;
+    }
+    page = next;
+  }
+
+  info->firstPage = 0;
+  info->lastPage = 0;
+  info->pageCount = 0;
+  info->recordCount = 0;
+  info->recordSize = recordSize;
+  pager->cleared[table] = true;
+  return true;
+}
+
+/**
+ * @brief Appends a record to the last page of a table, linking a new page when it is full
+ *
+ * @param pager A pointer to the pager
+ * @param table The table, which must have been cleared with pagerClearTable since the last flush
+ * @param record A pointer to the record, of the record size of the table
+ * @return True if the record was added, false otherwise
+ */
+bool pagerAppend(Pager *pager, PagerTable table, const void *record)
+{
+  PagerTableInfo *info = &pager->super.tables[table];
+  if (!pager->cleared[table])
+  {
+    // the last page is linked by the durable superblock and must not change in place
+    fprintf(stderr, "table %d must be cleared before it is written\n", (int)table);
+    return false;
+  }
+  uint32_t perPage = (uint32_t)(PAGE_DATA_SIZE / info->recordSize);
+  uint32_t page = info->lastPage;
+  uint8_t *data = NULL;
+
+  if (page != 0)
+  {
+    data = pagerFetch(pager, page, false);
+    if (data == NULL)
+    {
+      return false;
+    }
+  }
+
+  if (page == 0 || ((PageHeader *)data)->count == perPage)
+  {
+    uint32_t newPage;
+    uint8_t *newData = allocatePage(pager, &newPage);
+    if (newData == NULL)
+    {
+      if (page != 0)
+        pagerUnpin(pager, page, false);
+      return false;
+    }
+    ((PageHeader *)newData)->recordSize = (uint16_t)info->recordSize;
+
+    if (page == 0)
+    {
+      info->firstPage = newPage;
+    }
+    else
+    {
+      ((PageHeader *)data)->next = newPage;
+      pagerUnpin(pager, page, true);
+    }
+    info->lastPage = newPage;
+    info->pageCount++;
+    page = newPage;
+    data = newData;
+  }
+
+  PageHeader *header = (PageHeader *)data;
+  memcpy(data + sizeof(PageHeader) + (size_t)header->count * info->recordSize, record, info->recordSize);
+  header->count++;
+  info->recordCount++;
+  pagerUnpin(pager, page, true);
+  return true;
+}
+
+/**
+ * @brief Gets the number of records of a table
+ *
+ * @param pager A pointer to the pager
+ * @param table The table
+ * @return The number of records
+ */
+uint64_t pagerRecordCount(Pager *pager, PagerTable table)
+{
+  return pager->super.tables[table].recordCount;
+}
+
+/**
+ * @brief Starts reading a table from its first record
+ *
+ * @param pager A pointer to the pager
+ * @param table The table
+ * @param recordSize The record size the caller expects
+ * @param cursor A pointer to the cursor to be set up
+ * @return True if the cursor is ready, false if the table holds records of another size
+ */
+bool pagerOpenCursor(Pager *pager, PagerTable table, uint32_t recordSize, PagerCursor *cursor)
+{
+  PagerTableInfo *info = &pager->super.tables[table];
+  cursor->pager = pager;
+  cursor->frame = NULL;
+  cursor->page = info->firstPage;
+  cursor->index = 0;
+
+  if (info->firstPage != 0 && info->recordSize != recordSize)
+  {
+    fprintf(stderr, "table %d holds records of %u bytes, not %u\n", (int)table, info->recordSize, recordSize);
+    cursor->page = 0;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads the next record of a table
+ *
+ * The current page stays pinned while its records are read, so each record costs a copy, and each page one fetch.
+ *
+ * @param cursor A pointer to the cursor
+ * @param record Receives the record
+ * @return True if a record was read, false at the end of the table or if a page could not be read
+ */
+bool pagerNext(PagerCursor *cursor, void *record)
+{
+  while (cursor->page != 0)
+  {
+    if (cursor->frame == NULL)
+    {
+      if (pagerFetch(cursor->pager, cursor->page, false) == NULL)
+      {
+        cursor->page = 0;
+        return false;
+      }
+      cursor->frame = findFrame(cursor->pager, cursor->page);
+    }
+
+    PageHeader *header = (PageHeader *)cursor->frame->data;
+    if (cursor->index < header->count)
+    {
+      memcpy(record, cursor->frame->data + sizeof(PageHeader) + (size_t)cursor->index * header->recordSize, header->recordSize);
+      cursor->index++;
+      return true;
+    }
+
+    uint32_t next = header->next;
+    pagerUnpin(cursor->pager, cursor->page, false);
+    cursor->frame = NULL;
+    cursor->page = next;
+    cursor->index = 0;
+  }
+  return false;
+}
+
+/**
+ * @brief Stops reading a table, unpinning the current page
+ *
+ * @param cursor A pointer to the cursor
+ */
+void pagerCloseCursor(PagerCursor *cursor)
+{
+  if (cursor->frame != NULL)
+  {
+    pagerUnpin(cursor->pager, cursor->page, false);
+    cursor->frame = NULL;
+  }
+  cursor->page = 0;
+}
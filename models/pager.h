@@ -0,0 +1,114 @@
+/**
+ * @file pager.h
+ * @brief File containing the functions of the paged storage file
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#pragma once
+
+#define PAGER_FILE "./saved-data/store.db"
+#define PAGER_PAGE_SIZE 4096
+#define PAGER_MAGIC 0x3145474150444541ULL // "AEDPAGE1" read as a little-endian number
+#define PAGER_VERSION 2
+#define PAGER_SUPERBLOCKS 2 // pages 0 and 1, written in turns
+#define PAGER_TABLES 8
+#define PAGER_DEFAULT_CACHE_PAGES 1024
+
+typedef enum PagerTable
+{
+  PAGER_USERS,
+  PAGER_VEHICLES,
+  PAGER_RENTS,
+  PAGER_VERTICES,
+  PAGER_EDGES
+} PagerTable;
+
+typedef struct PagerTableInfo
+{
+  uint32_t firstPage; // 0 while the table is empty, pages 0 and 1 are the superblocks
+  uint32_t lastPage;
+  uint32_t recordSize;
+  uint32_t pageCount;
+  uint64_t recordCount;
+  int64_t sequence; // free for the owner of the table, the rents keep their next ID here
+} PagerTableInfo;
+
+typedef struct PagerSuperblock
+{
+  uint64_t magic;
+  uint32_t version;
+  uint32_t pageSize;
+  uint32_t pageCount;
+  uint32_t checksum; // of the whole superblock with this field zeroed
+  uint64_t generation; // incremented by every flush, the valid superblock with the highest one is current
+  PagerTableInfo tables[PAGER_TABLES];
+} PagerSuperblock;
+
+typedef struct PageHeader
+{
+  uint32_t next; // next page of the same table, 0 at the end
+  uint16_t count;
+  uint16_t recordSize;
+} PageHeader;
+
+typedef struct PageFrame PageFrame;
+
+struct PageFrame
+{
+  uint32_t page;
+  bool used;
+  bool dirty;
+  int pins;
+  PageFrame *lruPrevious; // frames that are not pinned, most recently used first
+  PageFrame *lruNext;
+  PageFrame *hashNext;
+  uint8_t *data;
+};
+
+typedef struct Pager
+{
+  int fd;
+  PagerSuperblock super;
+  PagerSuperblock durable; // the last superblock on disk, the pages it links are never overwritten
+  bool cleared[PAGER_TABLES]; // tables emptied since the last flush, only these take appends
+  uint32_t *freePages; // pages no table links, neither in super nor in durable
+  int freeCount;
+  int freeCapacity;
+  uint32_t *releasedPages; // pages of the cleared tables, free once the next flush is durable
+  int releasedCount;
+  int releasedCapacity;
+  bool isFreeKnown; // freePages is filled the first time a page is allocated
+  PageFrame *frames;
+  int frameCount;
+  PageFrame **buckets; // page number index of the frames
+  int bucketCount;
+  PageFrame lru; // sentinel of the LRU list
+  uint8_t *memory;
+  long hits;
+  long misses;
+  long pageReads;
+  long pageWrites;
+} Pager;
+
+typedef struct PagerCursor
+{
+  Pager *pager;
+  PageFrame *frame; // current page, kept pinned
+  uint32_t page;
+  uint16_t index;
+} PagerCursor;
+
+Pager *openPager(char *fileName, int cachePages);
+bool flushPager(Pager *pager);
+bool closePager(Pager *pager);
+uint8_t *pagerFetch(Pager *pager, uint32_t page, bool isNew);
+void pagerUnpin(Pager *pager, uint32_t page, bool dirty);
+bool pagerClearTable(Pager *pager, PagerTable table, uint32_t recordSize);
+bool pagerAppend(Pager *pager, PagerTable table, const void *record);
+uint64_t pagerRecordCount(Pager *pager, PagerTable table);
+bool pagerOpenCursor(Pager *pager, PagerTable table, uint32_t recordSize, PagerCursor *cursor);
+bool pagerNext(PagerCursor *cursor, void *record);
+void pagerCloseCursor(PagerCursor *cursor);
@@ -0,0 +1,465 @@
+/**
+ * @file pricing.c
+ * @brief File containing the functions of the tiered pricing engine
+ *
+ * This file contains a pricing engine for rents. Vehicle types and locations are interned into small integer IDs.
+ * Each type has an unlock fee and up to PRICING_TIERS time tiers with their own price per minute, and each location
+ * a percentage surcharge. compilePricing folds all of that into a flat [type][location] table, so pricing a rent is
+ * one table load and a fixed number of branch-free min/max steps, whether it is done one at a time with priceRent
+ * or over arrays with priceRentBatch.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "./pricing.h"
+
+#define PRICING_INITIAL_NAMES 16
+
+/**
+ * @brief Hashes a name with FNV-1a
+ *
+ * @param name The name to be hashed
+ * @return The hash of the name
+ */
+static uint32_t hashName(const char *name)
+{
+  uint32_t h = 2166136261u;
+  while (*name)
+  {
+    h ^= (unsigned char)*name++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/**
+ * @brief Initializes an empty table of interned names
+ *
+ * @param names A pointer to the table
+ * @return True if the table was initialized, or false if there was no memory
+ */
+static bool initNames(PricingNames *names)
+{
+  names->count = 0;
+  names->capacity = PRICING_INITIAL_NAMES;
+  names->slotCapacity = PRICING_INITIAL_NAMES * 2;
+  names->names = malloc(names->capacity * sizeof(*names->names));
+  names->slots = (int *)calloc(names->slotCapacity, sizeof(int));
+  return names->names != NULL && names->slots != NULL;
+}
+
+/**
+ * @brief Finds the ID of an interned name
+ *
+ * @param names A pointer to the table
+ * @param name The name to be searched for
+ * @return The slot where the name is, or where it would be inserted
+ */
+static int findNameSlot(PricingNames *names, const char *name)
+{
+  int mask = names->slotCapacity - 1;
+  int i = (int)(hashName(name) & mask);
+
+  while (names->slots[i] != 0 && strcmp(names->names[names->slots[i] - 1], name) != 0)
+  {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+/**
+ * @brief Interns a name, giving it the next ID if it is new
+ *
+ * @param names A pointer to the table
+ * @param name The name to be interned
+ * @param isNew Receives whether the name was added
+ * @return The ID of the name, or -1 if there was no memory
+ */
+static int internName(PricingNames *names, const char *name, bool *isNew)
+{
+  int slot = findNameSlot(names, name);
+  *isNew = false;
+
+  if (names->slots[slot] != 0)
+  {
+    return names->slots[slot] - 1;
+  }
+
+  if (names->count == names->capacity)
+  {
+    void *grown = realloc(names->names, names->capacity * 2 * sizeof(*names->names));
+    if (grown == NULL)
+    {
+      perror("could not allocate memory!");
+      return -1;
+    }
+    names->names = grown;
+    names->capacity *= 2;
+  }
+
+  if ((names->count + 1) * 2 > names->slotCapacity)
+  {
+    int *slots = (int *)calloc(names->slotCapacity * 2, sizeof(int));
+    if (slots == NULL)
+    {
+      perror("could not allocate memory!");
+      return -1;
+    }
+    free(names->slots);
+    names->slots = slots;
+    names->slotCapacity *= 2;
+    for (int id = 0; id < names->count; id++)
+    {
+      names->slots[findNameSlot(names, names->names[id])] = id + 1;
+    }
+    slot = findNameSlot(names, name);
+  }
+
+  snprintf(names->names[names->count], PRICING_NAME_SIZE, "%s", name);
+  names->slots[slot] = ++names->count;
+  *isNew = true;
+  return names->count - 1;
+}
+
+/**
+ * @brief Creates an empty pricing engine
+ *
+ * Location ID 0 is the unnamed location with no surcharge, used for vehicles in a city without a surcharge.
+ *
+ * @return A pointer to the engine, or NULL if there was no memory
+ */
+PricingEngine *createPricingEngine()
+{
+  PricingEngine *engine = (PricingEngine *)calloc(1, sizeof(PricingEngine));
+
+  if (engine == NULL || !initNames(&engine->types) || !initNames(&engine->locations))
+  {
+    perror("could not allocate memory!");
+    destroyPricingEngine(engine);
+    return NULL;
+  }
+
+  engine->typeRates = (PricingType *)calloc(engine->types.capacity, sizeof(PricingType));
+  engine->locationSurcharges = (int *)calloc(engine->locations.capacity, sizeof(int));
+  if (engine->typeRates == NULL || engine->locationSurcharges == NULL || addPricingLocation(engine, "", 0) != 0)
+  {
+    perror("could not allocate memory!");
+    destroyPricingEngine(engine);
+    return NULL;
+  }
+
+  return engine;
+}
+
+/**
+ * @brief Frees a pricing engine
+ *
+ * @param engine A pointer to the engine
+ */
+void destroyPricingEngine(PricingEngine *engine)
+{
+  if (engine == NULL)
+  {
+    return;
+  }
+
+  free(engine->types.names);
+  free(engine->types.slots);
+  free(engine->locations.names);
+  free(engine->locations.slots);
+  free(engine->typeRates);
+  free(engine->locationSurcharges);
+  free(engine->table);
+  free(engine);
+}
+
+/**
+ * @brief Adds a vehicle type, or changes the unlock fee of an existing one
+ *
+ * @param engine A pointer to the engine
+ * @param type The name of the type, as in Vehicle.type
+ * @param unlockFee The price charged once per rent
+ * @return The ID of the type, or -1 if there was no memory
+ */
+int addPricingType(PricingEngine *engine, char *type, int unlockFee)
+{
+  bool isNew;
+  int id = internName(&engine->types, type, &isNew);
+
+  if (id < 0)
+  {
+    return -1;
+  }
+
+  if (isNew)
+  {
+    // the names table may have grown, keep the rates the same size
+    PricingType *rates = (PricingType *)realloc(engine->typeRates, engine->types.capacity * sizeof(PricingType));
+    if (rates == NULL)
+    {
+      perror("could not allocate memory!");
+      return -1;
+    }
+    engine->typeRates = rates;
+    memset(&engine->typeRates[id], 0, sizeof(PricingType));
+  }
+  engine->typeRates[id].unlockFee = unlockFee;
+  return id;
+}
+
+/**
+ * @brief Adds a time tier to a vehicle type
+ *
+ * Tiers must be added in ascending order of their first minute and the first one must start at minute 0.
+ * A rent pays each tier's rate for the minutes it spends inside that tier.
+ *
+ * @param engine A pointer to the engine
+ * @param typeId The ID of the type
+ * @param fromMinute The first minute of the tier
+ * @param ratePerMinute The price per minute inside the tier
+ * @return True if the tier was added, or false if it is out of order or there are too many tiers
+ */
+bool addPricingTier(PricingEngine *engine, int typeId, int fromMinute, int ratePerMinute)
+{
+  if (typeId < 0 || typeId >= engine->types.count)
+  {
+    return false;
+  }
+
+  PricingType *rates = &engine->typeRates[typeId];
+  if (rates->tierCount == PRICING_TIERS)
+  {
+    return false;
+  }
+  if (rates->tierCount == 0 ? fromMinute != 0 : fromMinute <= rates->tierStart[rates->tierCount - 1])
+  {
+    return false;
+  }
+
+  rates->tierStart[rates->tierCount] = fromMinute;
+  rates->tierRate[rates->tierCount] = ratePerMinute;
+  rates->tierCount++;
+  return true;
+}
+
+/**
+ * @brief Adds a location, or changes the surcharge of an existing one
+ *
+ * @param engine A pointer to the engine
+ * @param location The name of the location, as in Vehicle.location
+ * @param surchargePercent The percentage added to every price in the location
+ * @return The ID of the location, or -1 if there was no memory
+ */
+int addPricingLocation(PricingEngine *engine, char *location, int surchargePercent)
+{
+  bool isNew;
+  int id = internName(&engine->locations, location, &isNew);
+
+  if (id < 0)
+  {
+    return -1;
+  }
+
+  if (isNew)
+  {
+    int *surcharges = (int *)realloc(engine->locationSurcharges, engine->locations.capacity * sizeof(int));
+    if (surcharges == NULL)
+    {
+      perror("could not allocate memory!");
+      return -1;
+    }
+    engine->locationSurcharges = surcharges;
+  }
+
+  engine->locationSurcharges[id] = surchargePercent;
+  return id;
+}
+
+/**
+ * @brief Gets the ID of a vehicle type
+ *
+ * @param engine A pointer to the engine
+ * @param type The name of the type
+ * @return The ID of the type, or -1 if it is not known
+ */
+int searchPricingType(PricingEngine *engine, char *type)
+{
+  int slot = engine->types.slots[findNameSlot(&engine->types, type)];
+  return slot - 1;
+}
+
+/**
+ * @brief Gets the ID of a location
+ *
+ * @param engine A pointer to the engine
+ * @param location The name of the location
+ * @return The ID of the location, or -1 if it is not known
+ */
+int searchPricingLocation(PricingEngine *engine, char *location)
+{
+  int slot = engine->locations.slots[findNameSlot(&engine->locations, location)];
+  return slot - 1;
+}
+
+/**
+ * @brief Applies a percentage surcharge to a price, rounding half up
+ *
+ * @param price The price
+ * @param percent The surcharge percentage
+ * @return The price with the surcharge
+ */
+static int32_t applySurcharge(int price, int percent)
+{
+  return (int32_t)(((long long)price * (100 + percent) + 50) / 100);
+}
+
+/**
+ * @brief Builds the flat price table from the types, tiers and locations
+ *
+ * Must be called again after any type, tier or location is added or changed.
+ *
+ * @param engine A pointer to the engine
+ * @return True if the table was built, or false if there was no memory
+ */
+bool compilePricing(PricingEngine *engine)
+{
+  int types = engine->types.count;
+  int locations = engine->locations.count;
+  PriceEntry *table = (PriceEntry *)calloc((size_t)types * locations, sizeof(PriceEntry));
+
+  if (table == NULL && types * locations > 0)
+  {
+    perror("could not allocate memory!");
+    return false;
+  }
+
+  for (int t = 0; t < types; t++)
+  {
+    PricingType *rates = &engine->typeRates[t];
+    for (int l = 0; l < locations; l++)
+    {
+      PriceEntry *entry = &table[(size_t)t * locations + l];
+      int surcharge = engine->locationSurcharges[l];
+
+      entry->fee = applySurcharge(rates->unlockFee, surcharge);
+      for (int k = 0; k < PRICING_TIERS; k++)
+      {
+        if (k < rates->tierCount)
+        {
+          entry->start[k] = rates->tierStart[k];
+          entry->length[k] = k + 1 < rates->tierCount && k + 1 < PRICING_TIERS ? rates->tierStart[k + 1] - rates->tierStart[k] : INT_MAX;
+          entry->rate[k] = applySurcharge(rates->tierRate[k], surcharge);
+        }
+        else
+        {
+          // unused tiers never contribute: no minutes fit in them
+          entry->start[k] = INT_MAX;
+          entry->length[k] = 0;
+          entry->rate[k] = 0;
+        }
+      }
+    }
+  }
+
+  free(engine->table);
+  engine->table = table;
+  engine->tableTypes = types;
+  engine->tableLocations = locations;
+  return true;
+}
+
+/**
+ * @brief Prices a rent with a table entry
+ *
+ * The sum is taken in 64 bits, so a very long rent cannot wrap around to a negative price; a price above
+ * INT32_MAX is saturated to INT32_MAX.
+ *
+ * @param entry A pointer to the table entry
+ * @param minutes The length of the rent in minutes
+ * @return The price of the rent
+ */
+static inline int32_t priceEntry(const PriceEntry *entry, int32_t minutes)
+{
+  int64_t price = entry->fee;
+  for (int k = 0; k < PRICING_TIERS; k++)
+  {
+    int32_t inTier = minutes - entry->start[k];
+    inTier = inTier < 0 ? 0 : inTier;
+    inTier = inTier > entry->length[k] ? entry->length[k] : inTier;
+    price += (int64_t)inTier * entry->rate[k];
+  }
+  return (int32_t)(price > INT32_MAX ? INT32_MAX : price);
+}
+
+/**
+ * @brief Prices a single rent
+ *
+ * @param engine A pointer to the compiled engine
+ * @param typeId The ID of the vehicle type
+ * @param locationId The ID of the location
+ * @param timeInMinutes The length of the rent in minutes
+ * @return The price of the rent, or -1 if the IDs are not in the compiled table or the time is negative
+ */
+int priceRent(PricingEngine *engine, int typeId, int locationId, int timeInMinutes)
+{
+  if (typeId < 0 || typeId >= engine->tableTypes || locationId < 0 || locationId >= engine->tableLocations || timeInMinutes < 0)
+  {
+    return -1;
+  }
+  return priceEntry(&engine->table[(size_t)typeId * engine->tableLocations + locationId], timeInMinutes);
+}
+
+/**
+ * @brief Prices an array of rents
+ *
+ * The rents are given as parallel arrays and the loop has no data dependent branches, so the compiler can
+ * vectorize it. The IDs are not checked: every one must be in the compiled table and every time non-negative.
+ *
+ * @param engine A pointer to the compiled engine
+ * @param typeIds The vehicle type ID of each rent
+ * @param locationIds The location ID of each rent
+ * @param minutes The length in minutes of each rent
+ * @param prices Receives the price of each rent
+ * @param count The number of rents
+ */
+void priceRentBatch(PricingEngine *engine, const uint16_t *restrict typeIds, const uint16_t *restrict locationIds, const int32_t *restrict minutes, int32_t *restrict prices, size_t count)
+{
+  const PriceEntry *restrict table = engine->table;
+  const size_t locations = (size_t)engine->tableLocations;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    prices[i] = priceEntry(&table[typeIds[i] * locations + locationIds[i]], minutes[i]);
+  }
+}
+
+/**
+ * @brief Prices a rent of a vehicle
+ *
+ * The vehicle type and location are looked up by name. Vehicles of a type the engine does not know are priced
+ * like calculateRentPrice does, with the vehicle cost per minute, and unknown locations have no surcharge.
+ *
+ * @param engine A pointer to the compiled engine
+ * @param vehicle A pointer to the vehicle
+ * @param timeInMinutes The length of the rent in minutes
+ * @return The price of the rent
+ */
+int priceVehicleRent(PricingEngine *engine, Vehicle *vehicle, int timeInMinutes)
+{
+  int typeId = searchPricingType(engine, vehicle->type);
+  int locationId = searchPricingLocation(engine, vehicle->location);
+
+  if (typeId < 0 || typeId >= engine->tableTypes)
+  {
+    return vehicle->cost * timeInMinutes;
+  }
+  if (locationId < 0 || locationId >= engine->tableLocations)
+  {
+    locationId = 0;
+  }
+  return priceRent(engine, typeId, locationId, timeInMinutes);
+}
@@ -0,0 +1,63 @@
+/**
+ * @file pricing.h
+ * @brief File containing the functions of the tiered pricing engine
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "./vehicle.h"
+#pragma once
+
+#define PRICING_TIERS 4
+#define PRICING_NAME_SIZE 50
+
+typedef struct PricingNames
+{
+  char (*names)[PRICING_NAME_SIZE]; // interned names, the index is the ID
+  int count;
+  int capacity;
+  int *slots; // open addressing table of ID + 1, 0 is empty
+  int slotCapacity;
+} PricingNames;
+
+typedef struct PricingType
+{
+  int unlockFee;
+  int tierCount;
+  int tierStart[PRICING_TIERS]; // first minute of each tier, ascending, the first one is 0
+  int tierRate[PRICING_TIERS];  // price per minute inside each tier
+} PricingType;
+
+typedef struct PriceEntry
+{
+  int32_t start[PRICING_TIERS];  // first minute of each tier
+  int32_t length[PRICING_TIERS]; // minutes in each tier, the last one is open ended
+  int32_t rate[PRICING_TIERS];   // price per minute with the location surcharge applied
+  int32_t fee;                   // unlock fee with the location surcharge applied
+} PriceEntry;
+
+typedef struct PricingEngine
+{
+  PricingNames types;
+  PricingNames locations;
+  PricingType *typeRates;  // indexed by type ID
+  int *locationSurcharges; // percentage, indexed by location ID
+  PriceEntry *table;       // flat [type][location] table built by compilePricing
+  int tableTypes;
+  int tableLocations;
+} PricingEngine;
+
+PricingEngine *createPricingEngine();
+void destroyPricingEngine(PricingEngine *engine);
+int addPricingType(PricingEngine *engine, char *type, int unlockFee);
+bool addPricingTier(PricingEngine *engine, int typeId, int fromMinute, int ratePerMinute);
+int addPricingLocation(PricingEngine *engine, char *location, int surchargePercent);
+int searchPricingType(PricingEngine *engine, char *type);
+int searchPricingLocation(PricingEngine *engine, char *location);
+bool compilePricing(PricingEngine *engine);
+int priceRent(PricingEngine *engine, int typeId, int locationId, int timeInMinutes);
+void priceRentBatch(PricingEngine *engine, const uint16_t *typeIds, const uint16_t *locationIds, const int32_t *minutes, int32_t *prices, size_t count);
+int priceVehicleRent(PricingEngine *engine, Vehicle *vehicle, int timeInMinutes);
@@ -0,0 +1,82 @@
+/**
+ * @file queries.c
+ * @brief File containing the read-only graph and fleet queries that run in batches on a task pool
+ *
+ * A query is a shortest path, a search for vehicles in a radius or a reachability check. The three functions behind
+ * them, shortestPath, findVehiclesInRadius and isReachable, keep their state on the stack and the heap of the call
+ * instead of in the visited flags of the graph, so any number of them can run at once as long as nobody changes the
+ * graph or the vehicle list meanwhile. A batch of queries is split over the workers of a task pool, QUERY_GRAIN
+ * queries to a task, and every query writes only its own results.
+ *
+ * The truck route of recoverTruck is not a query: it moves and recharges the vehicles it collects.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "./queries.h"
+
+typedef struct QueryBatch
+{
+  Vertex *graph;
+  VehicleList *vehicles;
+  Query *queries;
+} QueryBatch;
+
+/**
+ * @brief Runs a query and stores its results in it
+ *
+ * @param graph The graph of the cities
+ * @param vehicles The list of vehicles
+ * @param query A pointer to the query
+ */
+void runQuery(Vertex *graph, VehicleList *vehicles, Query *query)
+{
+  switch (query->type)
+  {
+  case QUERY_ROUTE:
+    query->distance = shortestPath(graph, query->origin, query->dest, query->path, QUERY_MAX_PATH, &query->length);
+    break;
+  case QUERY_NEAR:
+    query->count = findVehiclesInRadius(graph, vehicles, query->origin, query->radius, query->vehicleType,
+                                        query->found, QUERY_MAX_FOUND);
+    break;
+  case QUERY_REACHABLE:
+    query->isReachable = isReachable(graph, query->origin, query->dest);
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief Task function of runQueries: runs one query of the batch
+ *
+ * @param context A pointer to the QueryBatch
+ * @param index The index of the query
+ */
+static void runQueryTask(void *context, int index)
+{
+  QueryBatch *batch = (QueryBatch *)context;
+  runQuery(batch->graph, batch->vehicles, &batch->queries[index]);
+}
+
+/**
+ * @brief Runs a batch of queries on the workers of a pool and waits for them
+ *
+ * The graph and the vehicle list must not change until it returns. To keep routing while the map is being edited,
+ * pin a version of a GraphStore around the call and pass its graph: the whole batch then sees that version.
+ *
+ * @param pool The pool
+ * @param graph The graph of the cities
+ * @param vehicles The list of vehicles
+ * @param queries The queries, each receives its results
+ * @param count The number of queries
+ * @return True if every query ran, false if there was no memory
+ */
+bool runQueries(TaskPool *pool, Vertex *graph, VehicleList *vehicles, Query *queries, int count)
+{
+  QueryBatch batch = {graph, vehicles, queries};
+  return runTasks(pool, runQueryTask, &batch, count, QUERY_GRAIN);
+}
@@ -0,0 +1,42 @@
+/**
+ * @file queries.h
+ * @brief File containing the read-only graph and fleet queries that run in batches on a task pool
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include "./routes.h"
+#include "./taskpool.h"
+#include "./vehicle.h"
+#pragma once
+
+#define QUERY_MAX_FOUND 32 // vehicles kept by a NEAR query, the count goes on past it
+#define QUERY_MAX_PATH 256 // cities kept by a ROUTE query
+#define QUERY_GRAIN 4      // queries a task runs without splitting it
+
+typedef enum QueryType
+{
+  QUERY_ROUTE,     // shortest path from origin to dest
+  QUERY_NEAR,      // vehicles of a type within radius of origin
+  QUERY_REACHABLE, // whether dest can be reached from origin
+  QUERY_TYPES
+} QueryType;
+
+typedef struct Query
+{
+  QueryType type;
+  int origin;
+  int dest;
+  float radius;
+  char vehicleType[50];
+  float distance; // result of ROUTE, -1 without a path
+  int length;     // cities of the path of ROUTE, the cods are kept up to QUERY_MAX_PATH
+  int path[QUERY_MAX_PATH];
+  int count; // result of NEAR, -1 for an unknown city
+  Vehicle *found[QUERY_MAX_FOUND];
+  bool isReachable; // result of REACHABLE
+} Query;
+
+void runQuery(Vertex *graph, VehicleList *vehicles, Query *query);
+bool runQueries(TaskPool *pool, Vertex *graph, VehicleList *vehicles, Query *queries, int count);
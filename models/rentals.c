@@ -6,6 +6,12 @@
  * creating a rent list, printing the rent list, deleting a rent, counting the number of rents, editing a rent,
  * and storing the rents in a binary file.
  *
+ * The rents live in a RentStore: the rent list plus a chained hash index from the rent ID to its node and a
+ * monotonic ID generator that is saved next to the rents, so creating, finding, editing and deleting a rent
+ * does not depend on how many rents there are. Every rent node is also linked into the rents of its user and
+ * of its vehicle, so "show my rentals" and "return vehicle X" only visit the rents they return. When a write-ahead
+ * log is attached to the store every change is also appended to it (see rentlog.c).
+ *
  * @author João Pereira
  * @date 2023-03-18
  */
@@ -16,275 +22,1529 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stddef.h>
+#include <time.h>
+#include "./analytics.h"
+#include "./binformat.h"
 #include "./rentals.h"
+#include "./rentlog.h"
 #include "./user.h"
 #include "./vehicle.h"
+#include "./memstats.h"
+#include "./metrics.h"
+#include "./trace.h"
+
+static RentError addRent(RentStore *rentStore, Rent rent);
 
 /**
- * @brief Creates a new rent
+ * @brief Reserves a vehicle and charges the user for a new rent
  *
- * This function creates a new rent with the given vehicle registration, user NIF, and time in minutes.
- * It also checks if the user and vehicle exist and if the vehicle is available. If any of these conditions
- * are not met, the function returns NULL. Otherwise, it creates a new rent and returns it.
+ * The user and the vehicle are each resolved with a single list scan and the price is taken from the vehicle found.
+ * The vehicle is marked as in use and the wallet is debited as one step: if the debit is refused the vehicle is
+ * released again, so a failure never leaves anything changed. The rent is filled but not added to the store. Its ID
+ * is reserved only after every check and the debit passed, so a refused rent takes no ID; a rent that is later not
+ * added leaves a gap, which is harmless since IDs only need to be unique and increasing.
  *
  * @param vehicleRegistration The registration of the vehicle to be rented
  * @param userNif The NIF of the user renting the vehicle
  * @param timeInMinutes The time in minutes the vehicle will be rented for
  * @param vehicleList The list of vehicles
  * @param userList The list of users
- * @param rentList The list of rents
- * @return A pointer to the newly created rent, or NULL if any of the conditions are not met
+ * @param rentStore The rent store, used to generate the rent ID
+ * @param rent A pointer where the new rent is written
+ * @return RENT_OK if the vehicle was reserved and paid, or the reason it was not
  */
-Rent *createRent(char *vehicleRegistration, int userNif, int timeInMinutes, VehicleList *vehicleList, UserList *userList, RentList **rentList)
+static RentError beginRent(char *vehicleRegistration, int userNif, int timeInMinutes, VehicleList *vehicleList, UserList *userList, RentStore *rentStore, Rent *rent)
 {
-  Rent *rent = (Rent *)malloc(sizeof(Rent));
-  printf("Creating rent...\n");
-  bool userExists = searchUserByNif(userList, userNif);
+  if (timeInMinutes <= 0)
+  {
+    return RENT_INVALID_TIME;
+  }
 
-  if (!userExists)
+  User *user = searchUser(userList, userNif);
+  if (user == NULL)
   {
-    perror("User does not exist!");
-    return NULL;
+    return RENT_USER_NOT_FOUND;
   }
 
-  bool vehicleExists = searchVehicleByRegistration(vehicleList, vehicleRegistration);
+  Vehicle *vehicle = searchVehicle(vehicleList, vehicleRegistration);
+  if (vehicle == NULL)
+  {
+    return RENT_VEHICLE_NOT_FOUND;
+  }
 
-  if (!vehicleExists)
+  if (vehicle->isInUse)
   {
-    perror("Vehicle does not exist!");
-    return NULL;
+    return RENT_VEHICLE_IN_USE;
   }
 
-  bool isAvailable = isVehicleAvailable(vehicleList, vehicleRegistration);
+  long long price = (long long)vehicle->cost * timeInMinutes;
+  if (price > INT_MAX)
+  {
+    return RENT_INSUFFICIENT_FUNDS;
+  }
 
-  if (!isAvailable)
+  vehicle->isInUse = true;
+  if (!applyWalletDelta(&user->wallet, -(int)price))
   {
-    perror("Vehicle is not available!");
-    return NULL;
+    vehicle->isInUse = false;
+    return RENT_INSUFFICIENT_FUNDS;
   }
 
-  rent->id = countRents(*rentList);
-  strcpy(rent->vehicleRegistration, vehicleRegistration);
+  rent->id = nextRentId(rentStore);
+  strcpy(rent->vehicleRegistration, vehicle->registration);
   rent->userNif = userNif;
   rent->timeInMinutes = timeInMinutes;
-  int price = calculateRentPrice(vehicleList, vehicleRegistration, timeInMinutes);
+  rent->price = (int)price;
+  rent->startTime = time(NULL);
+  rent->endTime = rent->startTime + (int64_t)timeInMinutes * 60;
 
-  // edit vehicle availability
-  bool availabilityChanged = editVehicleAvailability(vehicleList, vehicleRegistration, false);
-  if (!availabilityChanged)
+  statsVehicleAvailability(vehicle, true);
+  statsRentBooked(vehicle->location, rent->price, 1, rent->startTime);
+  return RENT_OK;
+}
+
+/**
+ * @brief Undoes a rent started by beginRent
+ *
+ * @param rent The rent to be undone
+ * @param vehicleList The list of vehicles
+ * @param userList The list of users
+ */
+static void rollbackRent(Rent *rent, VehicleList *vehicleList, UserList *userList)
+{
+  Vehicle *vehicle = searchVehicle(vehicleList, rent->vehicleRegistration);
+  User *user = searchUser(userList, rent->userNif);
+
+  if (user != NULL)
+  {
+    applyWalletDelta(&user->wallet, rent->price);
+  }
+  if (vehicle != NULL)
+  {
+    vehicle->isInUse = false;
+    statsVehicleAvailability(vehicle, false);
+    statsRentBooked(vehicle->location, -rent->price, -1, rent->startTime);
+  }
+}
+
+/**
+ * @brief Rents a vehicle to a user as a single transaction
+ *
+ * This function checks the user and the vehicle, computes the price, marks the vehicle as in use, debits the
+ * wallet and adds the rent to the store. Either every step is applied or none is: if any of them fails the
+ * previous ones are rolled back. Nothing is printed, the outcome is reported by the returned code.
+ *
+ * @param vehicleRegistration The registration of the vehicle to be rented
+ * @param userNif The NIF of the user renting the vehicle
+ * @param timeInMinutes The time in minutes the vehicle will be rented for
+ * @param vehicleList The list of vehicles
+ * @param userList The list of users
+ * @param rentStore The rent store where the rent is added
+ * @param rent A pointer where the new rent is written, only changed when RENT_OK is returned
+ * @return RENT_OK if the rent was created, or the reason it was not
+ */
+RentError rentVehicle(char *vehicleRegistration, int userNif, int timeInMinutes, VehicleList *vehicleList, UserList *userList, RentStore *rentStore, Rent *rent)
+{
+  Rent newRent;
+  RentError error = beginRent(vehicleRegistration, userNif, timeInMinutes, vehicleList, userList, rentStore, &newRent);
+
+  if (error != RENT_OK)
+  {
+    return error;
+  }
+
+  error = addRent(rentStore, newRent);
+  if (error != RENT_OK)
+  {
+    rollbackRent(&newRent, vehicleList, userList);
+    return error;
+  }
+
+  *rent = newRent;
+  return RENT_OK;
+}
+
+/**
+ * @brief Gets a readable message for a rent error code
+ *
+ * @param error The error code
+ * @return The message describing the error
+ */
+const char *rentErrorMessage(RentError error)
+{
+  switch (error)
+  {
+  case RENT_OK:
+    return "Rent created!";
+  case RENT_USER_NOT_FOUND:
+    return "User does not exist!";
+  case RENT_VEHICLE_NOT_FOUND:
+    return "Vehicle does not exist!";
+  case RENT_VEHICLE_IN_USE:
+    return "Vehicle is not available!";
+  case RENT_INSUFFICIENT_FUNDS:
+    return "Could not pay!";
+  case RENT_INVALID_TIME:
+    return "Invalid rent time!";
+  case RENT_NO_MEMORY:
+    return "could not allocate memory!";
+  case RENT_NOT_LOGGED:
+    return "Rent could not be logged!";
+  case RENT_DUPLICATE_ID:
+    return "Rent ID already exists!";
+  }
+  return "Unknown rent error!";
+}
+
+/**
+ * @brief Creates a new rent
+ *
+ * This function creates a new rent with the given vehicle registration, user NIF, and time in minutes.
+ * It also checks if the user and vehicle exist and if the vehicle is available. If any of these conditions
+ * are not met, the function returns NULL and nothing is changed. Otherwise, it marks the vehicle as in use,
+ * charges the user and returns the new rent, which the caller adds to the store with createRentList.
+ *
+ * @param vehicleRegistration The registration of the vehicle to be rented
+ * @param userNif The NIF of the user renting the vehicle
+ * @param timeInMinutes The time in minutes the vehicle will be rented for
+ * @param vehicleList The list of vehicles
+ * @param userList The list of users
+ * @param rentStore The rent store, used to generate the rent ID
+ * @return A pointer to the newly created rent, or NULL if any of the conditions are not met
+ */
+Rent *createRent(char *vehicleRegistration, int userNif, int timeInMinutes, VehicleList *vehicleList, UserList *userList, RentStore *rentStore)
+{
+  METRIC_SCOPE(METRIC_CREATE_RENT);
+  TRACE_FUNCTION();
+  Rent newRent;
+  RentError error = beginRent(vehicleRegistration, userNif, timeInMinutes, vehicleList, userList, rentStore, &newRent);
+
+  if (error != RENT_OK)
   {
-    printf("Could not change vehicle availability!");
+    printf("%s\n", rentErrorMessage(error));
     return NULL;
   }
-  // update user wallet
-  bool payed = updateUserWallet(userList, userNif, -price);
-  printf("Price: %d\n", price);
 
-  if (!payed)
+  Rent *rent = (Rent *)memAlloc(MEM_TEMPORARIES, sizeof(Rent));
+  if (rent == NULL)
   {
-    printf("Could not pay!");
+    perror("could not allocate memory!");
+    rollbackRent(&newRent, vehicleList, userList);
     return NULL;
   }
 
+  *rent = newRent;
   printf("Rent created!\n");
-
   return rent;
 }
 
 /**
- * @brief Creates a new node in the rent list
+ * @brief Mixes a rent ID into a well distributed hash
  *
- * This function creates a new node in the rent list with the given rent. It returns true if the node was
- * successfully created, or false otherwise.
+ * @param id The rent ID
+ * @return The hash of the ID
+ */
+static uint64_t hashRentId(int64_t id)
+{
+  uint64_t h = (uint64_t)id;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/**
+ * @brief Creates an empty rent store
  *
- * @param headNode A pointer to the head node of the rent list
- * @param rent The rent to be added to the list
- * @return True if the node was successfully created, or false otherwise
+ * @return A pointer to the rent store, or NULL if there was no memory
  */
-bool createRentList(RentList **headNode, Rent rent)
+RentStore *createRentStore()
 {
-  RentList *new_node = (RentList *)malloc(sizeof(RentList));
+  RentStore *rentStore = (RentStore *)memAlloc(MEM_RENT_INDEXES, sizeof(RentStore));
 
-  if (new_node == NULL)
+  if (rentStore == NULL)
   {
     perror("could not allocate memory!");
-    return headNode;
+    return NULL;
   }
 
-  new_node->rent = rent;
-  new_node->next = *headNode;
-  *headNode = new_node;
-  return true;
+  rentStore->buckets = (RentList **)memCalloc(MEM_RENT_INDEXES, RENT_INDEX_INITIAL_BUCKETS, sizeof(RentList *));
+  rentStore->users = (RentUserSlot *)memCalloc(MEM_RENT_INDEXES, RENT_KEY_INDEX_INITIAL_CAPACITY, sizeof(RentUserSlot));
+  rentStore->vehicles = (RentVehicleSlot *)memCalloc(MEM_RENT_INDEXES, RENT_KEY_INDEX_INITIAL_CAPACITY, sizeof(RentVehicleSlot));
+  if (rentStore->buckets == NULL || rentStore->users == NULL || rentStore->vehicles == NULL)
+  {
+    perror("could not allocate memory!");
+    memFree(MEM_RENT_INDEXES, rentStore->buckets);
+    memFree(MEM_RENT_INDEXES, rentStore->users);
+    memFree(MEM_RENT_INDEXES, rentStore->vehicles);
+    memFree(MEM_RENT_INDEXES, rentStore);
+    return NULL;
+  }
+
+  rentStore->head = NULL;
+  rentStore->log = NULL;
+  rentStore->sequence = 0;
+  rentStore->generation = 0;
+  rentStore->bucketCount = RENT_INDEX_INITIAL_BUCKETS;
+  rentStore->userCapacity = RENT_KEY_INDEX_INITIAL_CAPACITY;
+  rentStore->userCount = 0;
+  rentStore->vehicleCapacity = RENT_KEY_INDEX_INITIAL_CAPACITY;
+  rentStore->vehicleCount = 0;
+  rentStore->count = 0;
+  rentStore->nextId = 0;
+  initTimerWheel(&rentStore->timers, time(NULL));
+  return rentStore;
 }
 
 /**
- * @brief Prints the rent list
- *
- * This function prints the rent list, showing the ID, vehicle registration, user NIF, and time in minutes
- * for each rent in the list.
+ * @brief Frees the rent store, its rents and its index
  *
- * @param headNode A pointer to the head node of the rent list
+ * @param rentStore A pointer to the rent store
  */
-void printRentList(RentList *headNode)
+void destroyRentStore(RentStore *rentStore)
 {
-  RentList *current = headNode;
+  if (rentStore == NULL)
+  {
+    return;
+  }
+
+  RentList *current = rentStore->head;
   while (current != NULL)
   {
-    printf("\n--------------------");
-    printf("\nRent:\n");
-    printf("id: %d", current->rent.id);
-    printf("\nvehicleRegistration: %s", current->rent.vehicleRegistration);
-    printf("\nuserNif: %d", current->rent.userNif);
-    printf("\ntimeInMinutes: %d", current->rent.timeInMinutes);
-    printf("\n--------------------\n");
-    current = current->next;
+    RentList *next = current->next;
+    memFree(MEM_RENTS, current);
+    current = next;
   }
-  printf("\n");
+
+  memFree(MEM_RENT_INDEXES, rentStore->buckets);
+  memFree(MEM_RENT_INDEXES, rentStore->users);
+  memFree(MEM_RENT_INDEXES, rentStore->vehicles);
+  memFree(MEM_RENT_INDEXES, rentStore);
 }
 
 /**
- * @brief Deletes a rent from the rent list
+ * @brief Generates the ID for a new rent
  *
- * This function deletes a rent from the rent list with the given ID and vehicle registration. It also changes
- * the availability of the vehicle to true. It returns true if the rent was successfully deleted, or false
- * otherwise.
+ * IDs only grow, so an ID is never handed out twice even after rents are deleted.
  *
- * @param headNode A pointer to the head node of the rent list
- * @param id The ID of the rent to be deleted
- * @param vehicleRegistration The registration of the vehicle to be returned
- * @param vehicleList The list of vehicles
- * @return True if the rent was successfully deleted, or false otherwise
+ * @param rentStore A pointer to the rent store
+ * @return The new rent ID
  */
-bool deleteRent(RentList **headNode, int id, char *vehicleRegistration, VehicleList *vehicleList)
+int64_t nextRentId(RentStore *rentStore)
 {
-  RentList *current = *headNode;
-  RentList *previous = NULL;
+  return rentStore->nextId++;
+}
 
-  while (current != NULL)
+/**
+ * @brief Doubles the number of buckets of the ID index
+ *
+ * @param rentStore A pointer to the rent store
+ * @return True if the index was grown, or false if there was no memory
+ */
+static bool growRentIndex(RentStore *rentStore)
+{
+  int bucketCount = rentStore->bucketCount * 2;
+  RentList **buckets = (RentList **)memCalloc(MEM_RENT_INDEXES, bucketCount, sizeof(RentList *));
+
+  if (buckets == NULL)
   {
-    if (current->rent.id == id)
+    perror("could not allocate memory!");
+    return false;
+  }
+
+  for (int i = 0; i < rentStore->bucketCount; i++)
+  {
+    RentList *current = rentStore->buckets[i];
+    while (current != NULL)
     {
-      if (previous == NULL)
-      {
-        *headNode = current->next;
-      }
-      else
-      {
-        previous->next = current->next;
-      }
-      free(current);
-      // change the vehicle availability
-      bool availabilityChanged = editVehicleAvailability(vehicleList, vehicleRegistration, true);
-      if (!availabilityChanged)
-      {
-        perror("Could not change vehicle availability!");
-        return NULL;
-      }
-      return true;
+      RentList *next = current->nextById;
+      int bucket = (int)(hashRentId(current->rent.id) & (bucketCount - 1));
+      current->nextById = buckets[bucket];
+      buckets[bucket] = current;
+      current = next;
     }
-    previous = current;
-    current = current->next;
   }
-  return false;
+
+  memFree(MEM_RENT_INDEXES, rentStore->buckets);
+  rentStore->buckets = buckets;
+  rentStore->bucketCount = bucketCount;
+  return true;
 }
 
 /**
- * @brief Counts the number of rents in the rent list
+ * @brief Searches for a rent by its ID using the ID index
  *
- * This function counts the number of rents in the rent list and returns the count.
+ * @param rentStore A pointer to the rent store
+ * @param id The ID of the rent to be searched for
+ * @return A pointer to the node of the rent, or NULL if it was not found
+ */
+RentList *searchRentById(RentStore *rentStore, int64_t id)
+{
+  METRIC_SCOPE(METRIC_SEARCH_RENT_BY_ID);
+  TRACE_FUNCTION();
+  RentList *current = rentStore->buckets[hashRentId(id) & (rentStore->bucketCount - 1)];
+  while (current != NULL && current->rent.id != id)
+  {
+    current = current->nextById;
+  }
+  return current;
+}
+
+/**
+ * @brief Hashes a user NIF for the user index
  *
- * @param headNode A pointer to the head node of the rent list
- * @return The number of rents in the rent list
+ * @param nif The NIF to be hashed
+ * @return The hash of the NIF
  */
-int countRents(RentList *headNode)
+static uint32_t hashUserNif(int nif)
 {
-  int count = 0;
-  RentList *current = headNode;
-  while (current != NULL)
+  uint32_t h = (uint32_t)nif;
+  h ^= h >> 16;
+  h *= 0x7feb352d;
+  h ^= h >> 15;
+  return h;
+}
+
+/**
+ * @brief Hashes a vehicle registration with FNV-1a for the vehicle index
+ *
+ * @param registration The registration to be hashed
+ * @return The hash of the registration
+ */
+static uint32_t hashRegistration(const char *registration)
+{
+  uint32_t h = 2166136261u;
+  while (*registration)
   {
-    count++;
-    current = current->next;
+    h ^= (unsigned char)*registration++;
+    h *= 16777619u;
   }
-  return count;
+  return h;
 }
 
 /**
- * @brief Edits a rent in the rent list
+ * @brief Finds the slot of a user in the user index, optionally adding it
  *
- * This function edits a rent in the rent list with the given ID. It replaces the rent with the given rent
- * parameter. It returns true if the rent was successfully edited, or false otherwise.
+ * Slots are never removed: a user without rents keeps a slot with a NULL head, so the index only grows with
+ * the number of distinct users that ever rented.
  *
- * @param headNode A pointer to the head node of the rent list
- * @param id The ID of the rent to be edited
- * @param rent The new rent to replace the old one
- * @return True if the rent was successfully edited, or false otherwise
+ * @param rentStore A pointer to the rent store
+ * @param nif The NIF of the user
+ * @param create Whether a missing user gets a new slot
+ * @return A pointer to the slot, or NULL if it does not exist (or there was no memory to create it)
  */
-bool editRent(RentList *headNode, int id, Rent rent)
+static RentUserSlot *findUserSlot(RentStore *rentStore, int nif, bool create)
 {
-  RentList *current = headNode;
-  while (current != NULL)
+  if (create && (rentStore->userCount + 1) * 4 > rentStore->userCapacity * 3)
   {
-    if (current->rent.id == id)
+    int capacity = rentStore->userCapacity * 2;
+    RentUserSlot *users = (RentUserSlot *)memCalloc(MEM_RENT_INDEXES, capacity, sizeof(RentUserSlot));
+    if (users == NULL)
     {
-      current->rent = rent;
-      return true;
+      perror("could not allocate memory!");
+      return NULL;
     }
-    current = current->next;
+    for (int i = 0; i < rentStore->userCapacity; i++)
+    {
+      if (rentStore->users[i].used)
+      {
+        int j = (int)(hashUserNif(rentStore->users[i].nif) & (capacity - 1));
+        while (users[j].used)
+          j = (j + 1) & (capacity - 1);
+        users[j] = rentStore->users[i];
+      }
+    }
+    memFree(MEM_RENT_INDEXES, rentStore->users);
+    rentStore->users = users;
+    rentStore->userCapacity = capacity;
+  }
+
+  int mask = rentStore->userCapacity - 1;
+  int i = (int)(hashUserNif(nif) & mask);
+  while (rentStore->users[i].used)
+  {
+    if (rentStore->users[i].nif == nif)
+      return &rentStore->users[i];
+    i = (i + 1) & mask;
+  }
+
+  if (!create)
+  {
+    return NULL;
   }
-  return false;
+
+  rentStore->users[i].used = true;
+  rentStore->users[i].nif = nif;
+  rentStore->users[i].head = NULL;
+  rentStore->userCount++;
+  return &rentStore->users[i];
 }
 
 /**
- * @brief Stores the rents in a binary file
+ * @brief Finds the slot of a vehicle in the vehicle index, optionally adding it
  *
- * This function stores the rents in a binary file named "rents.bin" in the "saved-data" directory. It returns
- * true if the rents were successfully stored, or false otherwise.
+ * Like the user index, slots are kept once created.
  *
- * @param headNode A pointer to the head node of the rent list
- * @return True if the rents were successfully stored, or false otherwise
+ * @param rentStore A pointer to the rent store
+ * @param registration The registration of the vehicle
+ * @param create Whether a missing vehicle gets a new slot
+ * @return A pointer to the slot, or NULL if it does not exist (or there was no memory to create it)
  */
-bool storeRentsInBin(RentList *headNode)
+static RentVehicleSlot *findVehicleSlot(RentStore *rentStore, const char *registration, bool create)
 {
-  FILE *pFile = NULL;
-  RentList *current_node = headNode;
-
-  pFile = fopen("./saved-data/rents.bin", "wb");
+  if (create && (rentStore->vehicleCount + 1) * 4 > rentStore->vehicleCapacity * 3)
+  {
+    int capacity = rentStore->vehicleCapacity * 2;
+    RentVehicleSlot *vehicles = (RentVehicleSlot *)memCalloc(MEM_RENT_INDEXES, capacity, sizeof(RentVehicleSlot));
+    if (vehicles == NULL)
+    {
+      perror("could not allocate memory!");
+      return NULL;
+    }
+    for (int i = 0; i < rentStore->vehicleCapacity; i++)
+    {
+      if (rentStore->vehicles[i].used)
+      {
+        int j = (int)(hashRegistration(rentStore->vehicles[i].registration) & (capacity - 1));
+        while (vehicles[j].used)
+          j = (j + 1) & (capacity - 1);
+        vehicles[j] = rentStore->vehicles[i];
+      }
+    }
+    memFree(MEM_RENT_INDEXES, rentStore->vehicles);
+    rentStore->vehicles = vehicles;
+    rentStore->vehicleCapacity = capacity;
+  }
 
-  if (pFile == NULL)
+  int mask = rentStore->vehicleCapacity - 1;
+  int i = (int)(hashRegistration(registration) & mask);
+  while (rentStore->vehicles[i].used)
   {
-    perror("could not open file");
-    return false;
+    if (strcmp(rentStore->vehicles[i].registration, registration) == 0)
+      return &rentStore->vehicles[i];
+    i = (i + 1) & mask;
   }
 
-  while (current_node != NULL)
+  if (!create)
   {
-    fwrite(&current_node->rent, sizeof(Rent), 1, pFile);
-    current_node = current_node->next;
+    return NULL;
   }
 
-  fclose(pFile);
-  return true;
+  rentStore->vehicles[i].used = true;
+  strcpy(rentStore->vehicles[i].registration, registration);
+  rentStore->vehicles[i].head = NULL;
+  rentStore->vehicleCount++;
+  return &rentStore->vehicles[i];
 }
 
 /**
- * @brief Calculates the rent price for a given vehicle registration and time in minutes.
+ * @brief Makes sure the user and vehicle of a rent have a slot in their indexes
  *
- * @param vehicleList A pointer to the head of the linked list of vehicles.
- * @param vehicleRegistration The registration number of the vehicle to calculate the rent price for.
- * @param timeInMinutes The time in minutes that the vehicle was rented for.
+ * Called before a rent is linked, so linking itself can never fail half way.
  *
- * @return The calculated rent price for the given vehicle and time in minutes. Returns 0 if the vehicle is not found in the list.
+ * @param rentStore A pointer to the rent store
+ * @param rent The rent to be linked
+ * @return True if both slots exist, or false if there was no memory
  */
-int calculateRentPrice(VehicleList *vehicleList, char *vehicleRegistration, int timeInMinutes)
+static bool reserveRentKeys(RentStore *rentStore, Rent *rent)
 {
-  VehicleList *current = vehicleList;
-  while (current != NULL)
+  return findUserSlot(rentStore, rent->userNif, true) != NULL && findVehicleSlot(rentStore, rent->vehicleRegistration, true) != NULL;
+}
+
+/**
+ * @brief Links a rent node at the head of the rents of its user and of its vehicle
+ *
+ * The slots must have been reserved with reserveRentKeys.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param node The node to be linked
+ */
+static void linkRentKeys(RentStore *rentStore, RentList *node)
+{
+  RentUserSlot *user = findUserSlot(rentStore, node->rent.userNif, false);
+  RentVehicleSlot *vehicle = findVehicleSlot(rentStore, node->rent.vehicleRegistration, false);
+
+  node->previousByUser = NULL;
+  node->nextByUser = user->head;
+  if (user->head != NULL)
+    user->head->previousByUser = node;
+  user->head = node;
+
+  node->previousByVehicle = NULL;
+  node->nextByVehicle = vehicle->head;
+  if (vehicle->head != NULL)
+    vehicle->head->previousByVehicle = node;
+  vehicle->head = node;
+}
+
+/**
+ * @brief Unlinks a rent node from the rents of its user and of its vehicle
+ *
+ * @param rentStore A pointer to the rent store
+ * @param node The node to be unlinked
+ */
+static void unlinkRentKeys(RentStore *rentStore, RentList *node)
+{
+  if (node->previousByUser != NULL)
+    node->previousByUser->nextByUser = node->nextByUser;
+  else
+    findUserSlot(rentStore, node->rent.userNif, false)->head = node->nextByUser;
+  if (node->nextByUser != NULL)
+    node->nextByUser->previousByUser = node->previousByUser;
+
+  if (node->previousByVehicle != NULL)
+    node->previousByVehicle->nextByVehicle = node->nextByVehicle;
+  else
+    findVehicleSlot(rentStore, node->rent.vehicleRegistration, false)->head = node->nextByVehicle;
+  if (node->nextByVehicle != NULL)
+    node->nextByVehicle->previousByVehicle = node->previousByVehicle;
+}
+
+/**
+ * @brief Gets the rents of a user
+ *
+ * The rents are linked through RentList.nextByUser, newest first.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param userNif The NIF of the user
+ * @return A pointer to the newest rent of the user, or NULL if they have none
+ */
+RentList *searchRentsByUser(RentStore *rentStore, int userNif)
+{
+  METRIC_SCOPE(METRIC_SEARCH_RENTS_BY_USER);
+  TRACE_FUNCTION();
+  RentUserSlot *user = findUserSlot(rentStore, userNif, false);
+  return user != NULL ? user->head : NULL;
+}
+
+/**
+ * @brief Gets the rents of a vehicle
+ *
+ * The rents are linked through RentList.nextByVehicle, newest first, so the open rent of a vehicle is the
+ * one returned.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param vehicleRegistration The registration of the vehicle
+ * @return A pointer to the newest rent of the vehicle, or NULL if it has none
+ */
+RentList *searchRentsByVehicle(RentStore *rentStore, char *vehicleRegistration)
+{
+  METRIC_SCOPE(METRIC_SEARCH_RENTS_BY_VEHICLE);
+  TRACE_FUNCTION();
+  RentVehicleSlot *vehicle = findVehicleSlot(rentStore, vehicleRegistration, false);
+  return vehicle != NULL ? vehicle->head : NULL;
+}
+
+/**
+ * @brief Removes a rent node from the ID index
+ *
+ * @param rentStore A pointer to the rent store
+ * @param node The node to be removed
+ */
+static void unindexRent(RentStore *rentStore, RentList *node)
+{
+  RentList **link = &rentStore->buckets[hashRentId(node->rent.id) & (rentStore->bucketCount - 1)];
+  while (*link != NULL && *link != node)
   {
-    if (strcmp(current->vehicle.registration, vehicleRegistration) == 0)
-    {
-      return current->vehicle.cost * timeInMinutes;
-    }
-    current = current->next;
+    link = &(*link)->nextById;
+  }
+  if (*link != NULL)
+  {
+    *link = node->nextById;
   }
-  return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Adds a rent to the store and tells why it could not
+ *
+ * A rent with an ID that is already in the store is refused, and the ID generator is moved past the ID of every
+ * rent added, so loaded rents are never reused. If the store has a write-ahead log the rent is logged before it is
+ * added, and refused if it cannot be.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param rent The rent to be added
+ * @return RENT_OK if the rent was added, RENT_DUPLICATE_ID, RENT_NO_MEMORY or RENT_NOT_LOGGED otherwise
+ */
+static RentError addRent(RentStore *rentStore, Rent rent)
+{
+  if (searchRentById(rentStore, rent.id) != NULL)
+  {
+    return RENT_DUPLICATE_ID;
+  }
+
+  if (rentStore->count >= rentStore->bucketCount && !growRentIndex(rentStore))
+  {
+    return RENT_NO_MEMORY;
+  }
+
+  if (!reserveRentKeys(rentStore, &rent))
+  {
+    return RENT_NO_MEMORY;
+  }
+
+  RentList *new_node = (RentList *)memAlloc(MEM_RENTS, sizeof(RentList));
+
+  if (new_node == NULL)
+  {
+    perror("could not allocate memory!");
+    return RENT_NO_MEMORY;
+  }
+
+  // the rent was paid when it was made, the record debits the price again on replay
+  if (rentStore->log != NULL && !rentLogAppend(rentStore->log, RENT_LOG_CREATE, &rent, -rent.price))
+  {
+    memFree(MEM_RENTS, new_node);
+    return RENT_NOT_LOGGED;
+  }
+
+  new_node->rent = rent;
+  new_node->previous = NULL;
+  new_node->next = rentStore->head;
+  if (rentStore->head != NULL)
+  {
+    rentStore->head->previous = new_node;
+  }
+  rentStore->head = new_node;
+
+  int bucket = (int)(hashRentId(rent.id) & (rentStore->bucketCount - 1));
+  new_node->nextById = rentStore->buckets[bucket];
+  rentStore->buckets[bucket] = new_node;
+  linkRentKeys(rentStore, new_node);
+
+  new_node->timer.previous = NULL;
+  if (rent.endTime > 0)
+  {
+    timerWheelAdd(&rentStore->timers, &new_node->timer, rent.endTime);
+  }
+
+  rentStore->count++;
+  if (rent.id >= rentStore->nextId)
+  {
+    rentStore->nextId = rent.id + 1;
+  }
+  return RENT_OK;
+}
+
+/**
+ * @brief Creates a new node in the rent list
+ *
+ * This function creates a new node in the rent list with the given rent and adds it to the ID, user and
+ * vehicle indexes, see addRent.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param rent The rent to be added to the list
+ * @return True if the node was successfully created, or false otherwise
+ */
+bool createRentList(RentStore *rentStore, Rent rent)
+{
+  return addRent(rentStore, rent) == RENT_OK;
+}
+
+/**
+ * @brief Prints a rent
+ *
+ * @param rent A pointer to the rent
+ */
+static void printRent(Rent *rent)
+{
+  printf("\n--------------------");
+  printf("\nRent:\n");
+  printf("id: %" PRId64, rent->id);
+  printf("\nvehicleRegistration: %s", rent->vehicleRegistration);
+  printf("\nuserNif: %d", rent->userNif);
+  printf("\ntimeInMinutes: %d", rent->timeInMinutes);
+  printf("\nprice: %d", rent->price);
+  printf("\nstartTime: %" PRId64, rent->startTime);
+  printf("\nendTime: %" PRId64, rent->endTime);
+  printf("\n--------------------\n");
+}
+
+/**
+ * @brief Prints the rent list
+ *
+ * This function prints the rent list, showing the ID, vehicle registration, user NIF, and time in minutes
+ * for each rent in the list.
+ *
+ * @param headNode A pointer to the head node of the rent list
+ */
+void printRentList(RentList *headNode)
+{
+  RentList *current = headNode;
+  while (current != NULL)
+  {
+    printRent(&current->rent);
+    current = current->next;
+  }
+  printf("\n");
+}
+
+/**
+ * @brief Removes a rent from the rent store without touching the vehicle
+ *
+ * The rent is found through the ID index and unlinked in place, so the cost does not depend on the number of
+ * rents. If the store has a write-ahead log the removal is logged first, and nothing is removed if it cannot be.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param id The ID of the rent to be removed
+ * @return True if the rent was removed, or false if it was not found or could not be logged
+ */
+bool removeRent(RentStore *rentStore, int64_t id)
+{
+  return removeRefundedRent(rentStore, id, 0);
+}
+
+/**
+ * @brief Removes a rent that ended early from the rent store, logging the refund given back with it
+ *
+ * Like removeRent, but the record of the removal carries the refund, so a replay gives it back too. The caller
+ * gives the refund to the user once the rent is removed.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param id The ID of the rent to be removed
+ * @param refund The part of the price given back to the user
+ * @return True if the rent was removed, or false if it was not found or could not be logged
+ */
+bool removeRefundedRent(RentStore *rentStore, int64_t id, int refund)
+{
+  RentList *current = searchRentById(rentStore, id);
+
+  if (current == NULL)
+  {
+    return false;
+  }
+
+  if (rentStore->log != NULL && !rentLogAppend(rentStore->log, RENT_LOG_DELETE, &current->rent, refund))
+  {
+    return false;
+  }
+
+  unindexRent(rentStore, current);
+  unlinkRentKeys(rentStore, current);
+  timerWheelRemove(&rentStore->timers, &current->timer);
+  if (current->previous == NULL)
+  {
+    rentStore->head = current->next;
+  }
+  else
+  {
+    current->previous->next = current->next;
+  }
+  if (current->next != NULL)
+  {
+    current->next->previous = current->previous;
+  }
+  rentStore->count--;
+  memFree(MEM_RENTS, current);
+  return true;
+}
+
+/**
+ * @brief Deletes a rent from the rent list
+ *
+ * This function deletes a rent from the rent list with the given ID and marks the vehicle of the rent as no
+ * longer in use. It returns true if the rent was successfully deleted, or false otherwise.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param id The ID of the rent to be deleted
+ * @param vehicleList The list of vehicles
+ * @return True if the rent was successfully deleted, or false otherwise
+ */
+bool deleteRent(RentStore *rentStore, int64_t id, VehicleList *vehicleList)
+{
+  RentList *current = searchRentById(rentStore, id);
+
+  if (current == NULL)
+  {
+    return false;
+  }
+
+  char vehicleRegistration[50];
+  strcpy(vehicleRegistration, current->rent.vehicleRegistration);
+  if (!removeRent(rentStore, id))
+  {
+    return false;
+  }
+
+  // change the vehicle availability
+  bool availabilityChanged = editVehicleAvailability(vehicleList, vehicleRegistration, false);
+  if (!availabilityChanged)
+  {
+    perror("Could not change vehicle availability!");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Returns a vehicle, ending its open rent
+ *
+ * The open rent is found through the vehicle index, so the caller does not need to know its ID.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param vehicleRegistration The registration of the vehicle to be returned
+ * @param vehicleList The list of vehicles
+ * @return True if the vehicle had an open rent and it was ended, or false otherwise
+ */
+bool returnVehicle(RentStore *rentStore, char *vehicleRegistration, VehicleList *vehicleList)
+{
+  RentList *rent = searchRentsByVehicle(rentStore, vehicleRegistration);
+
+  if (rent == NULL)
+  {
+    return false;
+  }
+  return deleteRent(rentStore, rent->rent.id, vehicleList);
+}
+
+/**
+ * @brief Computes the part of the price of a rent that is given back when it ends early
+ *
+ * The minutes started before the end are charged, at least one, at the price per minute that was paid.
+ *
+ * @param rent A pointer to the rent
+ * @param now The time the rent ends, in seconds since the epoch
+ * @return The amount to give back to the user, 0 if the whole time was used
+ */
+int rentRefund(Rent *rent, int64_t now)
+{
+  if (rent->startTime <= 0 || rent->timeInMinutes <= 0)
+  {
+    return 0;
+  }
+
+  int64_t usedMinutes = (now - rent->startTime + 59) / 60;
+  if (usedMinutes < 1)
+    usedMinutes = 1;
+  if (usedMinutes >= rent->timeInMinutes)
+  {
+    return 0;
+  }
+  return rent->price - (int)((int64_t)rent->price * usedMinutes / rent->timeInMinutes);
+}
+
+/**
+ * @brief Ends a rent, settling the wallet of the user for the time actually used
+ *
+ * The rent was paid up front for its whole time. The minutes started before now are charged, at the price per
+ * minute that was paid, and the rest is given back to the user. The rent is removed first, so a rent that cannot
+ * be removed (its removal could not be logged) is neither refunded nor released.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param id The ID of the rent to be ended
+ * @param now The time the rent ends, in seconds since the epoch
+ * @param vehicleList The list of vehicles
+ * @param userList The list of users
+ * @return True if the rent was ended, or false if it was not found or its vehicle is not in the list
+ */
+bool endRent(RentStore *rentStore, int64_t id, int64_t now, VehicleList *vehicleList, UserList *userList)
+{
+  RentList *current = searchRentById(rentStore, id);
+
+  if (current == NULL)
+  {
+    return false;
+  }
+
+  Rent rent = current->rent;
+  int refund = rentRefund(&rent, now);
+  if (!removeRefundedRent(rentStore, id, refund))
+  {
+    return false;
+  }
+
+  User *user = searchUser(userList, rent.userNif);
+  if (user != NULL && refund > 0)
+  {
+    applyWalletDelta(&user->wallet, refund);
+    Vehicle *vehicle = searchVehicle(vehicleList, rent.vehicleRegistration);
+    if (vehicle != NULL)
+      statsRentBooked(vehicle->location, -refund, 0, rent.startTime);
+  }
+
+  return editVehicleAvailability(vehicleList, rent.vehicleRegistration, false);
+}
+
+/**
+ * @brief Ends every rent whose time is over
+ *
+ * The rents are taken from the timer wheel of the store, so only the rents that are due are visited. Each one is
+ * ended with endRent at its own end time, so it is charged in full and the vehicle is released. A rent that is not
+ * the newest of its vehicle (the rental engine keeps the rents of returned vehicles) is only removed, so it does not
+ * release the vehicle from the rent that holds it now. A rent the write-ahead log could not remove stays in the store
+ * with its timer scheduled again, so it is retried on the next call and is not counted until then.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param now The current time, in seconds since the epoch
+ * @param vehicleList The list of vehicles
+ * @param userList The list of users, can be NULL when no rent can end early
+ * @return The number of rents that expired and were removed from the store
+ */
+int expireRents(RentStore *rentStore, int64_t now, VehicleList *vehicleList, UserList *userList)
+{
+  TimerNode *timer = timerWheelAdvance(&rentStore->timers, now);
+  int expired = 0;
+
+  while (timer != NULL)
+  {
+    TimerNode *next = timer->next;
+    RentList *node = (RentList *)((char *)timer - offsetof(RentList, timer));
+    int64_t id = node->rent.id;
+    if (node->previousByVehicle == NULL)
+    {
+      endRent(rentStore, id, node->rent.endTime, vehicleList, userList);
+    }
+    else
+    {
+      // a newer rent holds the vehicle: it was returned and rented again, and this rent only has to go
+      removeRent(rentStore, id);
+    }
+
+    if (searchRentById(rentStore, id) == node)
+    {
+      // the log refused the removal, so the rent is still in the store and is tried again on the next advance
+      timerWheelAdd(&rentStore->timers, &node->timer, node->rent.endTime);
+    }
+    else
+    {
+      expired++;
+    }
+    timer = next;
+  }
+  return expired;
+}
+
+/**
+ * @brief Prints the rents of a user
+ *
+ * Only the rents of the user are visited, through the user index.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param userNif The NIF of the user
+ */
+void printUserRents(RentStore *rentStore, int userNif)
+{
+  RentList *current = searchRentsByUser(rentStore, userNif);
+  while (current != NULL)
+  {
+    printRent(&current->rent);
+    current = current->nextByUser;
+  }
+  printf("\n");
+}
+
+/**
+ * @brief Counts the number of rents in the rent list
+ *
+ * This function counts the number of rents in the rent list and returns the count.
+ *
+ * @param headNode A pointer to the head node of the rent list
+ * @return The number of rents in the rent list
+ */
+int countRents(RentList *headNode)
+{
+  int count = 0;
+  RentList *current = headNode;
+  while (current != NULL)
+  {
+    count++;
+    current = current->next;
+  }
+  return count;
+}
+
+/**
+ * @brief Edits a rent in the rent list
+ *
+ * This function edits a rent in the rent list with the given ID. It replaces the rent with the given rent
+ * parameter, keeping the ID so the rent stays in the same place of the ID index, and moves it to the rents of
+ * its new user or vehicle if they changed. It returns true if the rent was successfully edited, or false
+ * otherwise. If the store has a write-ahead log the new rent is logged first, and nothing changes if it cannot be.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param id The ID of the rent to be edited
+ * @param rent The new rent to replace the old one
+ * @return True if the rent was successfully edited, or false otherwise
+ */
+bool editRent(RentStore *rentStore, int64_t id, Rent rent)
+{
+  RentList *current = searchRentById(rentStore, id);
+
+  if (current == NULL)
+  {
+    return false;
+  }
+
+  rent.id = id;
+  bool keysChanged = rent.userNif != current->rent.userNif || strcmp(rent.vehicleRegistration, current->rent.vehicleRegistration) != 0;
+
+  if (keysChanged && !reserveRentKeys(rentStore, &rent))
+  {
+    return false;
+  }
+
+  if (rentStore->log != NULL && !rentLogAppend(rentStore->log, RENT_LOG_EDIT, &rent, 0))
+  {
+    return false;
+  }
+
+  if (keysChanged)
+  {
+    unlinkRentKeys(rentStore, current);
+  }
+
+  if (rent.endTime != current->rent.endTime)
+  {
+    timerWheelRemove(&rentStore->timers, &current->timer);
+    if (rent.endTime > 0)
+    {
+      timerWheelAdd(&rentStore->timers, &current->timer, rent.endTime);
+    }
+  }
+
+  current->rent = rent;
+
+  if (keysChanged)
+  {
+    linkRentKeys(rentStore, current);
+  }
+  return true;
+}
+
+/**
+ * @brief Packs a rent into its RENT_RECORD_SIZE bytes in rents.bin
+ *
+ * @param rent A pointer to the rent
+ * @param out Receives the record
+ */
+static void packRent(const Rent *rent, uint8_t *out)
+{
+  putU64(out, (uint64_t)rent->id);
+  putString(out + 8, rent->vehicleRegistration, 50);
+  putU32(out + 58, (uint32_t)rent->userNif);
+  putU32(out + 62, (uint32_t)rent->timeInMinutes);
+  putU32(out + 66, (uint32_t)rent->price);
+  putU64(out + 70, (uint64_t)rent->startTime);
+  putU64(out + 78, (uint64_t)rent->endTime);
+}
+
+/**
+ * @brief Unpacks a rent from its record in rents.bin
+ *
+ * @param in The record
+ * @param rent Receives the rent
+ */
+static void unpackRent(const uint8_t *in, Rent *rent)
+{
+  memset(rent, 0, sizeof(Rent));
+  rent->id = (int64_t)getU64(in);
+  getString(rent->vehicleRegistration, in + 8, 50);
+  rent->userNif = (int)getU32(in + 58);
+  rent->timeInMinutes = (int)getU32(in + 62);
+  rent->price = (int)getU32(in + 66);
+  rent->startTime = (int64_t)getU64(in + 70);
+  rent->endTime = (int64_t)getU64(in + 78);
+}
+
+/**
+ * @brief Reads a rent from one of the struct dumps written before the versioned format
+ *
+ * Three layouts were written: 64 bytes with an int ID, 72 bytes with an int64_t ID, and the Rent struct with the
+ * price and times. The fields are in the byte order of this machine.
+ *
+ * @param in The bytes of the record
+ * @param size The size of the records of the file
+ * @param rent Receives the rent
+ * @return True if the record looks like a rent, false otherwise
+ */
+static bool unpackLegacyRent(const uint8_t *in, size_t size, Rent *rent)
+{
+  memset(rent, 0, sizeof(Rent));
+  if (size == sizeof(Rent))
+  {
+    memcpy(rent, in, sizeof(Rent));
+  }
+  else if (size == 72)
+  {
+    memcpy(&rent->id, in, sizeof(int64_t));
+    memcpy(rent->vehicleRegistration, in + 8, 50);
+    memcpy(&rent->userNif, in + 60, sizeof(int));
+    memcpy(&rent->timeInMinutes, in + 64, sizeof(int));
+  }
+  else
+  {
+    int id;
+    memcpy(&id, in, sizeof(int));
+    rent->id = id;
+    memcpy(rent->vehicleRegistration, in + 4, 50);
+    memcpy(&rent->userNif, in + 56, sizeof(int));
+    memcpy(&rent->timeInMinutes, in + 60, sizeof(int));
+  }
+  return rent->id >= 0 && rent->timeInMinutes >= 0 && memchr(rent->vehicleRegistration, '\0', 50) != NULL;
+}
+
+/**
+ * @brief Reads the rents of a file written before the versioned format
+ *
+ * The record size is not stored in those files, so it is taken from the layouts that divide the file size and
+ * whose records all look like rents, trying the newest layout first.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param pFile The file, at its start
+ */
+static void loadLegacyRents(RentStore *rentStore, FILE *pFile)
+{
+  size_t sizes[] = {sizeof(Rent), 72, 64};
+  Rent rent;
+
+  if (fseek(pFile, 0, SEEK_END) != 0)
+  {
+    return;
+  }
+  long length = ftell(pFile);
+  rewind(pFile);
+  if (length <= 0)
+  {
+    return;
+  }
+
+  uint8_t *data = (uint8_t *)malloc(length);
+  if (data == NULL || fread(data, length, 1, pFile) != 1)
+  {
+    free(data);
+    return;
+  }
+
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    size_t size = sizes[s];
+    bool fits = length % size == 0;
+    for (long offset = 0; fits && offset < length; offset += size)
+    {
+      fits = unpackLegacyRent(data + offset, size, &rent);
+    }
+    if (fits)
+    {
+      for (long offset = 0; offset < length; offset += size)
+      {
+        unpackLegacyRent(data + offset, size, &rent);
+        createRentList(rentStore, rent);
+      }
+      break;
+    }
+  }
+  free(data);
+}
+
+/**
+ * @brief Stores the rents in a binary file
+ *
+ * This function stores the rents in a binary file named "rents.bin" in the "saved-data" directory, and the next
+ * rent ID in "rents-seq.bin", so IDs keep growing after a restart even if the newest rents were deleted. It returns
+ * true if the rents were successfully stored, or false otherwise.
+ *
+ * @param rentStore A pointer to the rent store
+ * @return True if the rents were successfully stored, or false otherwise
+ */
+bool storeRentsInBin(RentStore *rentStore)
+{
+  TRACE_FUNCTION();
+  return storeRentsInFile(rentStore, RENTS_FILE, RENTS_SEQ_FILE);
+}
+
+/**
+ * @brief Gets the generation of the next rent files written from a store
+ *
+ * The generation is the time in nanoseconds, raised above the previous one of the store, not a counter: a snapshot
+ * child writes the files from its copy of the store, so a counter of the parent would give its next files the number
+ * the child already used.
+ *
+ * @param rentStore A pointer to the rent store
+ * @return The generation
+ */
+static int64_t nextGeneration(RentStore *rentStore)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  int64_t generation = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  return generation > rentStore->generation ? generation : rentStore->generation + 1;
+}
+
+/**
+ * @brief Stores the rents and the next rent ID in the given files
+ *
+ * Both files are flushed to disk before returning, so they can be renamed over a previous snapshot. The sequence
+ * file also keeps the number of the last record of the write-ahead log the rents hold, and a new generation of the
+ * files, which the warm start image written with them keeps too.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param fileName The path of the file that receives the rents
+ * @param seqFileName The path of the file that receives the next rent ID and the number of the last log record
+ * @return True if the rents were successfully stored, or false otherwise
+ */
+bool storeRentsInFile(RentStore *rentStore, char *fileName, char *seqFileName)
+{
+  METRIC_SCOPE(METRIC_STORE_RENTS);
+  TRACE_FUNCTION();
+  FILE *pFile = NULL;
+  RentList *current_node = rentStore->head;
+
+  pFile = fopen(fileName, "wb");
+
+  if (pFile == NULL)
+  {
+    perror("could not open file");
+    return false;
+  }
+
+  BinWriter writer;
+  uint8_t record[RENT_RECORD_SIZE];
+  bool opened = openBinWriter(&writer, pFile, BIN_RENTS, RENT_RECORD_SIZE);
+  bool stored = opened;
+
+  while (current_node != NULL && stored)
+  {
+    packRent(&current_node->rent, record);
+    stored = binWrite(&writer, record);
+    current_node = current_node->next;
+  }
+
+  stored = opened && closeBinWriter(&writer) && stored;
+  stored = fflush(pFile) == 0 && fsync(fileno(pFile)) == 0 && stored;
+  fclose(pFile);
+
+  pFile = fopen(seqFileName, "wb");
+
+  if (pFile == NULL)
+  {
+    perror("could not open file");
+    return false;
+  }
+
+  rentStore->generation = nextGeneration(rentStore);
+  stored = fwrite(&rentStore->nextId, sizeof(int64_t), 1, pFile) == 1 && stored;
+  stored = fwrite(&rentStore->sequence, sizeof(int64_t), 1, pFile) == 1 && stored;
+  stored = fwrite(&rentStore->generation, sizeof(int64_t), 1, pFile) == 1 && stored;
+  stored = fflush(pFile) == 0 && fsync(fileno(pFile)) == 0 && stored;
+  fclose(pFile);
+  return stored;
+}
+
+/**
+ * @brief Reads the rents from the binary files into a rent store
+ *
+ * This function reads every rent stored by storeRentsInBin and adds it to the rent store, then restores the ID
+ * generator. If the sequence file is missing the generator continues after the highest ID read.
+ *
+ * @param rentStore A pointer to the rent store
+ * @return A pointer to the rent store, or NULL if the rents file could not be opened
+ */
+RentStore *setRentsData(RentStore *rentStore)
+{
+  return loadRentsFromFile(rentStore, RENTS_FILE, RENTS_SEQ_FILE);
+}
+
+/**
+ * @brief Reads the rents and the next rent ID from the given files into a rent store
+ *
+ * Files in the versioned format are checked block by block, and the struct dumps written before it are still read.
+ * A file with a damaged header is refused.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param fileName The path of the file with the rents
+ * @param seqFileName The path of the file with the next rent ID and the number of the last log record
+ * @return A pointer to the rent store, or NULL if the rents file could not be opened
+ */
+RentStore *loadRentsFromFile(RentStore *rentStore, char *fileName, char *seqFileName)
+{
+  METRIC_SCOPE(METRIC_LOAD_RENTS);
+  TRACE_FUNCTION();
+  FILE *pFile = fopen(fileName, "rb");
+
+  if (pFile == NULL)
+  {
+    perror("Could not open file");
+    return NULL;
+  }
+
+  Rent rent;
+  BinReader reader;
+  BinFormat format = openBinReader(&reader, pFile, BIN_RENTS, RENT_RECORD_SIZE);
+
+  if (format == BIN_FORMAT_LEGACY)
+  {
+    loadLegacyRents(rentStore, pFile);
+  }
+  else if (format == BIN_FORMAT_VERSIONED)
+  {
+    const uint8_t *record;
+    while ((record = binRead(&reader)) != NULL)
+    {
+      unpackRent(record, &rent);
+      createRentList(rentStore, rent);
+    }
+    if (reader.corrupt)
+    {
+      fprintf(stderr, "%s is damaged, only the rents before the damage were read\n", fileName);
+    }
+  }
+  closeBinReader(&reader);
+
+  fclose(pFile);
+  if (format == BIN_FORMAT_INVALID)
+  {
+    return NULL;
+  }
+
+  pFile = fopen(seqFileName, "rb");
+  if (pFile != NULL)
+  {
+    int64_t nextId;
+    int64_t sequence;
+    if (fread(&nextId, sizeof(int64_t), 1, pFile) == 1 && nextId > rentStore->nextId)
+    {
+      rentStore->nextId = nextId;
+    }
+    // a file written before the log records were numbered has no number, and the whole log is replayed
+    if (fread(&sequence, sizeof(int64_t), 1, pFile) == 1)
+    {
+      rentStore->sequence = sequence;
+    }
+    int64_t generation;
+    rentStore->generation = fread(&generation, sizeof(int64_t), 1, pFile) == 1 ? generation : 0;
+    fclose(pFile);
+  }
+
+  return rentStore;
+}
+
+/**
+ * @brief Reads the generation of the rent files without reading the rents
+ *
+ * @param fileName The path of the file with the rents
+ * @param seqFileName The path of the file with the next rent ID, the number of the last log record and the generation
+ * @return The generation, 0 if neither file exists, or -1 if the files have no generation
+ */
+int64_t rentFilesGeneration(char *fileName, char *seqFileName)
+{
+  int64_t fields[3];
+  FILE *pFile = fopen(seqFileName, "rb");
+
+  if (pFile == NULL)
+  {
+    return access(fileName, F_OK) == 0 ? -1 : 0;
+  }
+  bool hasGeneration = fread(fields, sizeof(int64_t), 3, pFile) == 3;
+  fclose(pFile);
+  return hasGeneration ? fields[2] : -1;
+}
+
+/**
+ * @brief Stores the rents in the rents table of a storage file
+ *
+ * The previous rents of the table are replaced, and the next rent ID is kept in the sequence of the table. Nothing
+ * reaches the disk until the pager is flushed.
+ *
+ * @param pager A pointer to the storage file
+ * @param rentStore A pointer to the rent store
+ * @return True if the rents were successfully stored, or false otherwise
+ */
+bool storeRentsInPager(Pager *pager, RentStore *rentStore)
+{
+  METRIC_SCOPE(METRIC_STORE_RENTS_PAGER);
+  TRACE_FUNCTION();
+  if (!pagerClearTable(pager, PAGER_RENTS, sizeof(Rent)))
+  {
+    return false;
+  }
+
+  for (RentList *current = rentStore->head; current != NULL; current = current->next)
+  {
+    if (!pagerAppend(pager, PAGER_RENTS, &current->rent))
+    {
+      return false;
+    }
+  }
+  pager->super.tables[PAGER_RENTS].sequence = rentStore->nextId;
+  return true;
+}
+
+/**
+ * @brief Reads the rents table of a storage file into a rent store
+ *
+ * @param pager A pointer to the storage file
+ * @param rentStore A pointer to the rent store
+ * @return A pointer to the rent store, or NULL if the table could not be read
+ */
+RentStore *loadRentsFromPager(Pager *pager, RentStore *rentStore)
+{
+  METRIC_SCOPE(METRIC_LOAD_RENTS_PAGER);
+  TRACE_FUNCTION();
+  PagerCursor cursor;
+  Rent rent;
+
+  if (!pagerOpenCursor(pager, PAGER_RENTS, sizeof(Rent), &cursor))
+  {
+    return NULL;
+  }
+  while (pagerNext(&cursor, &rent))
+  {
+    createRentList(rentStore, rent);
+  }
+  pagerCloseCursor(&cursor);
+
+  if (pager->super.tables[PAGER_RENTS].sequence > rentStore->nextId)
+  {
+    rentStore->nextId = pager->super.tables[PAGER_RENTS].sequence;
+  }
+  return rentStore;
+}
+
+/**
+ * @brief Reads one rent from the rents table of a storage file, without loading the table
+ *
+ * The table is streamed through the cache of the pager, so it works with any number of rents and a cache of a few
+ * pages.
+ *
+ * @param pager A pointer to the storage file
+ * @param id The ID of the rent
+ * @param rent Receives the rent
+ * @return True if the rent was found, false otherwise
+ */
+bool findRentInPager(Pager *pager, int64_t id, Rent *rent)
+{
+  PagerCursor cursor;
+  bool found = false;
+
+  if (!pagerOpenCursor(pager, PAGER_RENTS, sizeof(Rent), &cursor))
+  {
+    return false;
+  }
+  while (!found && pagerNext(&cursor, rent))
+  {
+    found = rent->id == id;
+  }
+  pagerCloseCursor(&cursor);
+  return found;
+}
+
+/**
+ * @brief Calculates the rent price for a given vehicle registration and time in minutes.
+ *
+ * @param vehicleList A pointer to the head of the linked list of vehicles.
+ * @param vehicleRegistration The registration number of the vehicle to calculate the rent price for.
+ * @param timeInMinutes The time in minutes that the vehicle was rented for.
+ *
+ * @return The calculated rent price for the given vehicle and time in minutes. Returns 0 if the vehicle is not found in the list.
+ */
+int calculateRentPrice(VehicleList *vehicleList, char *vehicleRegistration, int timeInMinutes)
+{
+  Vehicle *vehicle = searchVehicle(vehicleList, vehicleRegistration);
+  if (vehicle == NULL)
+  {
+    return 0;
+  }
+  return vehicle->cost * timeInMinutes;
+}
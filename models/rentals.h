@@ -7,31 +7,119 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "./pager.h"
+#include "./timerwheel.h"
 #include "./user.h"
 #include "./vehicle.h"
 #pragma once
 
+#define RENT_INDEX_INITIAL_BUCKETS 64
+#define RENT_KEY_INDEX_INITIAL_CAPACITY 64
+#define RENTS_FILE "./saved-data/rents.bin"
+#define RENTS_SEQ_FILE "./saved-data/rents-seq.bin"
+#define RENT_RECORD_SIZE 86 // packed size of a Rent in rents.bin
+
 typedef struct RentList RentList;
+typedef struct RentLog RentLog;
+
+typedef enum RentError
+{
+  RENT_OK,
+  RENT_USER_NOT_FOUND,
+  RENT_VEHICLE_NOT_FOUND,
+  RENT_VEHICLE_IN_USE,
+  RENT_INSUFFICIENT_FUNDS,
+  RENT_INVALID_TIME,
+  RENT_NO_MEMORY,
+  RENT_NOT_LOGGED,  // the write-ahead log refused the rent, after a failed write or sync
+  RENT_DUPLICATE_ID // a rent with the same ID is already in the store
+} RentError;
 
 typedef struct Rent
 {
-  int id;
+  int64_t id;
   char vehicleRegistration[50];
   int userNif;
   int timeInMinutes;
+  int price;         // charged up front, settled when the rent ends
+  int64_t startTime; // seconds since the epoch
+  int64_t endTime;   // seconds since the epoch, 0 if the rent never expires on its own
 } Rent;
 
 struct RentList
 {
   Rent rent;
   RentList *next;
+  RentList *previous; // lets a rent found through the index be unlinked in O(1)
+  RentList *nextById; // next rent in the same bucket of the ID index
+  RentList *nextByUser; // next rent of the same user
+  RentList *previousByUser;
+  RentList *nextByVehicle; // next rent of the same vehicle
+  RentList *previousByVehicle;
+  TimerNode timer; // fires at rent.endTime
 };
 
-Rent *createRent(char *vehicleRegistration, int userNif, int timeInMinutes, VehicleList *vehicleList, UserList *userList, RentList **rentList);
+typedef struct RentUserSlot
+{
+  bool used;
+  int nif;
+  RentList *head; // newest rent of the user, NULL once they have none
+} RentUserSlot;
+
+typedef struct RentVehicleSlot
+{
+  bool used;
+  char registration[50];
+  RentList *head; // newest rent of the vehicle, NULL once it has none
+} RentVehicleSlot;
+
+typedef struct RentStore
+{
+  RentList *head;
+  RentList **buckets; // ID index, chained through RentList.nextById
+  int bucketCount;    // always a power of two
+  RentUserSlot *users; // userNif index, open addressing
+  int userCapacity;
+  int userCount;
+  RentVehicleSlot *vehicles; // vehicleRegistration index, open addressing
+  int vehicleCapacity;
+  int vehicleCount;
+  int count;
+  int64_t nextId;     // monotonic, never reused even after a rent is deleted
+  int64_t sequence;   // of the last record of the write-ahead log held by the store, kept in the snapshots
+  int64_t generation; // of the rent files last written or read, a warm start image keeps the one written with it
+  RentLog *log;       // write-ahead log that receives every change, or NULL
+  TimerWheel timers; // one tick per second, holds every rent with an endTime
+} RentStore;
+
+RentStore *createRentStore();
+void destroyRentStore(RentStore *rentStore);
+int64_t nextRentId(RentStore *rentStore);
+RentList *searchRentById(RentStore *rentStore, int64_t id);
+RentList *searchRentsByUser(RentStore *rentStore, int userNif);
+RentList *searchRentsByVehicle(RentStore *rentStore, char *vehicleRegistration);
+RentError rentVehicle(char *vehicleRegistration, int userNif, int timeInMinutes, VehicleList *vehicleList, UserList *userList, RentStore *rentStore, Rent *rent);
+const char *rentErrorMessage(RentError error);
+Rent *createRent(char *vehicleRegistration, int userNif, int timeInMinutes, VehicleList *vehicleList, UserList *userList, RentStore *rentStore);
 void printRentList(RentList *headNode);
-bool createRentList(RentList **headNode, Rent rent);
+bool createRentList(RentStore *rentStore, Rent rent);
 int countRents(RentList *headNode);
-bool deleteRent(RentList **headNode, int id, char *vehicleRegistration, VehicleList *vehicleList);
-bool editRent(RentList *headNode, int id, Rent rent);
-bool storeRentsInBin(RentList *headNode);
+bool removeRent(RentStore *rentStore, int64_t id);
+bool removeRefundedRent(RentStore *rentStore, int64_t id, int refund);
+bool deleteRent(RentStore *rentStore, int64_t id, VehicleList *vehicleList);
+bool returnVehicle(RentStore *rentStore, char *vehicleRegistration, VehicleList *vehicleList);
+int rentRefund(Rent *rent, int64_t now);
+bool endRent(RentStore *rentStore, int64_t id, int64_t now, VehicleList *vehicleList, UserList *userList);
+int expireRents(RentStore *rentStore, int64_t now, VehicleList *vehicleList, UserList *userList);
+void printUserRents(RentStore *rentStore, int userNif);
+bool editRent(RentStore *rentStore, int64_t id, Rent rent);
+bool storeRentsInBin(RentStore *rentStore);
+RentStore *setRentsData(RentStore *rentStore);
+bool storeRentsInFile(RentStore *rentStore, char *fileName, char *seqFileName);
+RentStore *loadRentsFromFile(RentStore *rentStore, char *fileName, char *seqFileName);
+int64_t rentFilesGeneration(char *fileName, char *seqFileName);
+bool storeRentsInPager(Pager *pager, RentStore *rentStore);
+RentStore *loadRentsFromPager(Pager *pager, RentStore *rentStore);
+bool findRentInPager(Pager *pager, int64_t id, Rent *rent);
 int calculateRentPrice(VehicleList *vehicleList, char *vehicleRegistration, int timeInMinutes);
\ No newline at end of file
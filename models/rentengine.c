@@ -0,0 +1,341 @@
+/**
+ * @file rentengine.c
+ * @brief File containing the functions of the concurrent rental engine
+ *
+ * This file contains a rental path that many threads can use at the same time. Vehicles are found through a
+ * registration index built once from the vehicle list and claimed with a compare-and-swap on isInUse, so two
+ * threads can never rent the same vehicle. Wallets are debited through the user store, and every worker appends
+ * its rents to its own log with IDs taken from a private block, so the only shared write per rent is the claim.
+ * The logs are moved into a RentStore with rentEngineCollect once the workers are done.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "./analytics.h"
+#include "./rentengine.h"
+
+/**
+ * @brief Hashes a registration with FNV-1a
+ *
+ * @param registration The registration to be hashed
+ * @return The hash of the registration
+ */
+static uint32_t hashRegistration(const char *registration)
+{
+  uint32_t h = 2166136261u;
+  while (*registration)
+  {
+    h ^= (unsigned char)*registration++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/**
+ * @brief Creates a rental engine over a vehicle list and a user store
+ *
+ * The vehicles are not copied: the engine indexes the vehicles of the list, so the list must not have vehicles
+ * added or deleted while the engine is in use.
+ *
+ * @param vehicleList The list of vehicles
+ * @param userStore The user store with the wallets to debit
+ * @param firstId The first rent ID to be handed out, usually nextRentId of the rent store
+ * @param workerCount The number of worker threads that will use the engine
+ * @return A pointer to the engine, or NULL if there was no memory
+ */
+RentEngine *createRentEngine(VehicleList *vehicleList, UserStore *userStore, int64_t firstId, int workerCount)
+{
+  RentEngine *engine = (RentEngine *)aligned_alloc(64, sizeof(RentEngine));
+  if (engine == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+  memset(engine, 0, sizeof(RentEngine));
+
+  int count = 0;
+  for (VehicleList *current = vehicleList; current != NULL; current = current->next)
+  {
+    count++;
+  }
+
+  engine->vehicleCapacity = 16;
+  while (engine->vehicleCapacity < count * 2)
+  {
+    engine->vehicleCapacity *= 2;
+  }
+
+  engine->vehicles = (Vehicle **)calloc(engine->vehicleCapacity, sizeof(Vehicle *));
+  engine->workers = (RentWorker *)aligned_alloc(64, workerCount * sizeof(RentWorker));
+  if (engine->vehicles == NULL || engine->workers == NULL)
+  {
+    perror("could not allocate memory!");
+    free(engine->vehicles);
+    free(engine->workers);
+    free(engine);
+    return NULL;
+  }
+
+  for (VehicleList *current = vehicleList; current != NULL; current = current->next)
+  {
+    int mask = engine->vehicleCapacity - 1;
+    int i = (int)(hashRegistration(current->vehicle.registration) & mask);
+    while (engine->vehicles[i] != NULL && strcmp(engine->vehicles[i]->registration, current->vehicle.registration) != 0)
+    {
+      i = (i + 1) & mask;
+    }
+    // like the list lookups, the first vehicle with a repeated registration wins
+    if (engine->vehicles[i] == NULL)
+    {
+      engine->vehicles[i] = &current->vehicle;
+    }
+  }
+
+  memset(engine->workers, 0, workerCount * sizeof(RentWorker));
+  for (int i = 0; i < workerCount; i++)
+  {
+    engine->workers[i].engine = engine;
+  }
+
+  engine->userStore = userStore;
+  engine->workerCount = workerCount;
+  engine->nextIdBlock = firstId;
+  return engine;
+}
+
+/**
+ * @brief Frees the engine and the rents that were not collected
+ *
+ * @param engine A pointer to the engine
+ */
+void destroyRentEngine(RentEngine *engine)
+{
+  if (engine == NULL)
+  {
+    return;
+  }
+
+  for (int i = 0; i < engine->workerCount; i++)
+  {
+    free(engine->workers[i].log);
+  }
+  free(engine->workers);
+  free(engine->vehicles);
+  free(engine);
+}
+
+/**
+ * @brief Gets the worker state for a thread
+ *
+ * Each thread must use its own worker, a worker is not safe to share.
+ *
+ * @param engine A pointer to the engine
+ * @param index The index of the worker, from 0 to the worker count
+ * @return A pointer to the worker, or NULL if the index is out of range
+ */
+RentWorker *rentEngineWorker(RentEngine *engine, int index)
+{
+  if (index < 0 || index >= engine->workerCount)
+  {
+    return NULL;
+  }
+  return &engine->workers[index];
+}
+
+/**
+ * @brief Finds a vehicle through the registration index of the engine
+ *
+ * @param engine A pointer to the engine
+ * @param registration The registration of the vehicle
+ * @return A pointer to the vehicle, or NULL if it was not found
+ */
+Vehicle *rentEngineVehicle(RentEngine *engine, char *registration)
+{
+  int mask = engine->vehicleCapacity - 1;
+  int i = (int)(hashRegistration(registration) & mask);
+
+  while (engine->vehicles[i] != NULL)
+  {
+    if (strcmp(engine->vehicles[i]->registration, registration) == 0)
+    {
+      return engine->vehicles[i];
+    }
+    i = (i + 1) & mask;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Appends a rent to the log of a worker
+ *
+ * @param worker A pointer to the worker
+ * @param rent The rent to be appended
+ * @return True if the rent was appended, or false if there was no memory
+ */
+static bool appendRentLog(RentWorker *worker, Rent *rent)
+{
+  if (worker->logCount == worker->logCapacity)
+  {
+    int capacity = worker->logCapacity == 0 ? RENT_LOG_INITIAL_CAPACITY : worker->logCapacity * 2;
+    Rent *log = (Rent *)realloc(worker->log, capacity * sizeof(Rent));
+    if (log == NULL)
+    {
+      perror("could not allocate memory!");
+      return false;
+    }
+    worker->log = log;
+    worker->logCapacity = capacity;
+  }
+
+  worker->log[worker->logCount++] = *rent;
+  return true;
+}
+
+/**
+ * @brief Rents a vehicle from a worker thread
+ *
+ * The vehicle is claimed with a compare-and-swap from available to in use, then the wallet is debited with
+ * userStoreDebitIfSufficient. If the debit is refused the vehicle is released again. Safe to call from many
+ * threads at once as long as each one uses its own worker.
+ *
+ * @param worker A pointer to the worker of the calling thread
+ * @param vehicleRegistration The registration of the vehicle to be rented
+ * @param userNif The NIF of the user renting the vehicle
+ * @param timeInMinutes The time in minutes the vehicle will be rented for
+ * @param rent A pointer where the new rent is written, can be NULL
+ * @return RENT_OK if the rent was created, or the reason it was not
+ */
+RentError rentEngineRent(RentWorker *worker, char *vehicleRegistration, int userNif, int timeInMinutes, Rent *rent)
+{
+  RentEngine *engine = worker->engine;
+
+  if (timeInMinutes <= 0)
+  {
+    return RENT_INVALID_TIME;
+  }
+
+  Vehicle *vehicle = rentEngineVehicle(engine, vehicleRegistration);
+  if (vehicle == NULL)
+  {
+    return RENT_VEHICLE_NOT_FOUND;
+  }
+
+  long long price = (long long)vehicle->cost * timeInMinutes;
+  if (price > INT_MAX)
+  {
+    return RENT_INSUFFICIENT_FUNDS;
+  }
+
+  bool available = false;
+  if (!__atomic_compare_exchange_n(&vehicle->isInUse, &available, true, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+  {
+    return RENT_VEHICLE_IN_USE;
+  }
+
+  if (!userStoreDebitIfSufficient(engine->userStore, userNif, (int)price))
+  {
+    __atomic_store_n(&vehicle->isInUse, false, __ATOMIC_RELEASE);
+    return userStoreGet(engine->userStore, userNif, NULL) ? RENT_INSUFFICIENT_FUNDS : RENT_USER_NOT_FOUND;
+  }
+
+  if (worker->nextId == worker->lastId)
+  {
+    worker->nextId = __atomic_fetch_add(&engine->nextIdBlock, RENT_ID_BLOCK, __ATOMIC_RELAXED);
+    worker->lastId = worker->nextId + RENT_ID_BLOCK;
+  }
+
+  Rent newRent;
+  newRent.id = worker->nextId;
+  strcpy(newRent.vehicleRegistration, vehicle->registration);
+  newRent.userNif = userNif;
+  newRent.timeInMinutes = timeInMinutes;
+  newRent.price = (int)price;
+  newRent.startTime = time(NULL);
+  newRent.endTime = newRent.startTime + (int64_t)timeInMinutes * 60;
+
+  if (!appendRentLog(worker, &newRent))
+  {
+    userStoreUpdateWallet(engine->userStore, userNif, (int)price);
+    __atomic_store_n(&vehicle->isInUse, false, __ATOMIC_RELEASE);
+    return RENT_NO_MEMORY;
+  }
+
+  worker->nextId++;
+  statsVehicleAvailability(vehicle, true);
+  statsRentBooked(vehicle->location, (int)price, 1, newRent.startTime);
+  if (rent != NULL)
+  {
+    *rent = newRent;
+  }
+  return RENT_OK;
+}
+
+/**
+ * @brief Returns a rented vehicle, making it available again
+ *
+ * @param engine A pointer to the engine
+ * @param vehicleRegistration The registration of the vehicle to be returned
+ * @return True if the vehicle was in use and was released, false otherwise
+ */
+bool rentEngineReturn(RentEngine *engine, char *vehicleRegistration)
+{
+  Vehicle *vehicle = rentEngineVehicle(engine, vehicleRegistration);
+  if (vehicle == NULL)
+  {
+    return false;
+  }
+
+  bool inUse = true;
+  if (!__atomic_compare_exchange_n(&vehicle->isInUse, &inUse, false, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+  {
+    return false;
+  }
+  statsVehicleAvailability(vehicle, false);
+  return true;
+}
+
+/**
+ * @brief Moves the rents logged by every worker into a rent store
+ *
+ * Must only be called while no worker is renting, and can be called as often as needed. The logs are emptied, except
+ * for the rents the write-ahead log of the store could not take, which are tried again on the next call, and the ID
+ * generator of the store is moved past every ID reserved by the engine.
+ *
+ * @param engine A pointer to the engine
+ * @param rentStore The rent store that receives the rents
+ * @return The number of rents added to the store
+ */
+int rentEngineCollect(RentEngine *engine, RentStore *rentStore)
+{
+  int collected = 0;
+
+  for (int i = 0; i < engine->workerCount; i++)
+  {
+    RentWorker *worker = &engine->workers[i];
+    int kept = 0;
+    for (int j = 0; j < worker->logCount; j++)
+    {
+      if (createRentList(rentStore, worker->log[j]))
+      {
+        collected++;
+      }
+      else if (rentStore->log != NULL && searchRentById(rentStore, worker->log[j].id) == NULL)
+      {
+        // the write-ahead log of the store refused it: keep it for the next collect
+        worker->log[kept++] = worker->log[j];
+      }
+    }
+    worker->logCount = kept;
+  }
+
+  if (engine->nextIdBlock > rentStore->nextId)
+  {
+    rentStore->nextId = engine->nextIdBlock;
+  }
+  return collected;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file rentengine.h
+ * @brief File containing the functions of the concurrent rental engine
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "./rentals.h"
+#include "./userstore.h"
+#pragma once
+
+#define RENT_ID_BLOCK 1024
+#define RENT_LOG_INITIAL_CAPACITY 1024
+
+typedef struct RentEngine RentEngine;
+
+typedef struct RentWorker
+{
+  _Alignas(64) RentEngine *engine;
+  Rent *log; // rents created by this worker, only touched by its thread
+  int logCount;
+  int logCapacity;
+  int64_t nextId; // block of IDs reserved from the engine
+  int64_t lastId;
+} RentWorker;
+
+struct RentEngine
+{
+  Vehicle **vehicles; // registration index, read only once the engine is created
+  int vehicleCapacity;
+  UserStore *userStore;
+  RentWorker *workers;
+  int workerCount;
+  _Alignas(64) int64_t nextIdBlock;
+};
+
+RentEngine *createRentEngine(VehicleList *vehicleList, UserStore *userStore, int64_t firstId, int workerCount);
+void destroyRentEngine(RentEngine *engine);
+RentWorker *rentEngineWorker(RentEngine *engine, int index);
+Vehicle *rentEngineVehicle(RentEngine *engine, char *registration);
+RentError rentEngineRent(RentWorker *worker, char *vehicleRegistration, int userNif, int timeInMinutes, Rent *rent);
+bool rentEngineReturn(RentEngine *engine, char *vehicleRegistration);
+int rentEngineCollect(RentEngine *engine, RentStore *rentStore);
@@ -0,0 +1,483 @@
+/**
+ * @file rentlog.c
+ * @brief File containing the functions to manage the write-ahead log of the rent store
+ *
+ * This file contains the implementation of a write-ahead log for the rents. Once a log is attached to a rent
+ * store, createRentList, editRent and removeRent append one record per change before they apply it, and refuse
+ * the change when the record cannot be written. Records are grouped and written with a single fdatasync every
+ * syncEvery records (or on rentLogSync), so a crash loses at most the changes of the last unfinished batch, and
+ * every checkpointEvery records the store is snapshotted into rents.bin and the log is truncated, so recovery never
+ * replays more than that.
+ *
+ * A record also carries what the change did outside the store: the vehicle a new rent claims, the vehicle an ended
+ * rent releases, and the change to the wallet of the user, so replaying it restores the users and the vehicles too.
+ * Every record is numbered, and the snapshots keep the number of the last record they hold, so the replay skips
+ * the records a snapshot already holds and no wallet is changed twice.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "./rentlog.h"
+
+/**
+ * @brief Computes the FNV-1a checksum of a log record
+ *
+ * @param record A pointer to the record, its checksum field is ignored
+ * @return The checksum of the record
+ */
+static uint32_t checksumRecord(RentLogRecord *record)
+{
+  uint32_t saved = record->checksum;
+  uint32_t h = 2166136261u;
+  unsigned char *bytes = (unsigned char *)record;
+
+  record->checksum = 0;
+  for (size_t i = 0; i < sizeof(RentLogRecord); i++)
+  {
+    h ^= bytes[i];
+    h *= 16777619u;
+  }
+  record->checksum = saved;
+  return h;
+}
+
+/**
+ * @brief Makes a rename in the saved-data directory durable
+ *
+ * @return True if the directory was synced, false otherwise
+ */
+static bool syncDataDirectory()
+{
+  int fd = open("./saved-data", O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+}
+
+/**
+ * @brief Applies a record of the log to the rent store and to the vehicle and the wallet it changed
+ *
+ * @param rentStore A pointer to the rent store
+ * @param record A pointer to the record
+ * @param vehicleList The list of vehicles, can be NULL
+ * @param userList A pointer to the head node of the list of users, can be NULL
+ */
+static void applyRecord(RentStore *rentStore, RentLogRecord *record, VehicleList *vehicleList, UserList **userList)
+{
+  Rent *rent = &record->rent;
+
+  switch (record->operation)
+  {
+  case RENT_LOG_CREATE:
+    createRentList(rentStore, *rent);
+    if (vehicleList != NULL)
+      editVehicleAvailability(vehicleList, rent->vehicleRegistration, true);
+    break;
+  case RENT_LOG_EDIT:
+    editRent(rentStore, rent->id, *rent);
+    break;
+  case RENT_LOG_DELETE:
+    removeRent(rentStore, rent->id);
+    if (vehicleList != NULL && searchRentsByVehicle(rentStore, rent->vehicleRegistration) == NULL)
+      editVehicleAvailability(vehicleList, rent->vehicleRegistration, false);
+    break;
+  }
+
+  if (userList == NULL || (record->walletDelta == 0 && record->operation != RENT_LOG_WALLET))
+  {
+    return;
+  }
+  User *user = searchUser(*userList, rent->userNif);
+  if (user != NULL)
+  {
+    // the records are in the order the wallets changed, so every delta was accepted at this balance
+    applyWalletDelta(&user->wallet, record->walletDelta);
+  }
+  else if (record->operation == RENT_LOG_WALLET)
+  {
+    User created;
+    memset(&created, 0, sizeof(User));
+    created.nif = rent->userNif;
+    created.wallet = record->walletDelta;
+    createUserList(userList, created);
+  }
+}
+
+/**
+ * @brief Replays the write-ahead log on top of the rents already in a store
+ *
+ * The store must hold a snapshot of the rents that is not older than the last checkpoint: rents.bin, or a warm start
+ * image of the same generation, and the users and the vehicles must come from the same snapshot. Only the records after
+ * RentStore.sequence are applied. A torn or corrupted record at the end of the log (from a crash during a write) ends
+ * the replay, and the log is truncated there so new records are appended after the last valid one. Must be called
+ * before openRentLog.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param vehicleList The list of vehicles the rents claim and release, can be NULL
+ * @param userList A pointer to the head node of the list of users whose wallets changed, can be NULL
+ * @return The number of log records replayed, or -1 if the log could not be read
+ */
+long replayRentLog(RentStore *rentStore, VehicleList *vehicleList, UserList **userList)
+{
+  RentLog *log = rentStore->log;
+  rentStore->log = NULL; // replayed changes must not be logged again
+
+  int fd = open(RENT_LOG_FILE, O_RDWR);
+  if (fd < 0)
+  {
+    rentStore->log = log;
+    return errno == ENOENT ? 0 : -1;
+  }
+
+  long replayed = 0;
+  long long valid = 0;
+  RentLogRecord record;
+
+  while (pread(fd, &record, sizeof(RentLogRecord), valid) == sizeof(RentLogRecord) && record.checksum == checksumRecord(&record))
+  {
+    valid += sizeof(RentLogRecord);
+    if (record.sequence <= rentStore->sequence)
+    {
+      // the snapshot was taken after this record
+      continue;
+    }
+    applyRecord(rentStore, &record, vehicleList, userList);
+    rentStore->sequence = record.sequence;
+    replayed++;
+  }
+
+  if (ftruncate(fd, valid) != 0)
+  {
+    perror("could not truncate the rents log");
+  }
+  close(fd);
+
+  rentStore->log = log;
+  return replayed;
+}
+
+/**
+ * @brief Loads the rents snapshot and replays the write-ahead log on top of it
+ *
+ * Must be called before openRentLog.
+ *
+ * @param rentStore A pointer to an empty rent store
+ * @param vehicleList The list of vehicles the rents claim and release, can be NULL
+ * @param userList A pointer to the head node of the list of users whose wallets changed, can be NULL
+ * @return The number of log records replayed, or -1 if the log could not be read
+ */
+long recoverRents(RentStore *rentStore, VehicleList *vehicleList, UserList **userList)
+{
+  RentLog *log = rentStore->log;
+  rentStore->log = NULL;
+  if (access(RENTS_FILE, F_OK) == 0)
+  {
+    loadRentsFromFile(rentStore, RENTS_FILE, RENTS_SEQ_FILE);
+  }
+  rentStore->log = log;
+  return replayRentLog(rentStore, vehicleList, userList);
+}
+
+/**
+ * @brief Opens the write-ahead log and attaches it to a rent store
+ *
+ * From now on every change to the store is appended to the log. Call recoverRents first, otherwise the records
+ * already in the log are lost at the next checkpoint.
+ *
+ * @param rentStore A pointer to the rent store
+ * @param syncEvery The number of records grouped in each fdatasync, 1 makes every change durable on return
+ * @param checkpointEvery The number of records after which the store is snapshotted and the log truncated
+ * @return A pointer to the log, or NULL if it could not be opened
+ */
+RentLog *openRentLog(RentStore *rentStore, int syncEvery, long checkpointEvery)
+{
+  RentLog *log = (RentLog *)calloc(1, sizeof(RentLog));
+
+  if (log == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+
+  log->syncEvery = syncEvery > 0 ? syncEvery : RENT_LOG_SYNC_EVERY;
+  log->checkpointEvery = checkpointEvery > 0 ? checkpointEvery : RENT_LOG_CHECKPOINT_EVERY;
+  log->pendingCapacity = log->syncEvery;
+  log->pending = (RentLogRecord *)malloc(log->pendingCapacity * sizeof(RentLogRecord));
+  log->fd = open(RENT_LOG_FILE, O_WRONLY | O_CREAT, 0644);
+
+  if (log->pending == NULL || log->fd < 0)
+  {
+    perror("could not open the rents log");
+    if (log->fd >= 0)
+      close(log->fd);
+    free(log->pending);
+    free(log);
+    return NULL;
+  }
+
+  log->size = lseek(log->fd, 0, SEEK_END);
+  log->records = log->size / sizeof(RentLogRecord);
+  log->rentStore = rentStore;
+  rentStore->log = log;
+  return log;
+}
+
+/**
+ * @brief Appends a change to the log
+ *
+ * The record is buffered and written with the next batch. When the batch is full it is flushed, and if that fails
+ * the record is dropped again so the caller can refuse the change; the records of earlier calls stay buffered for
+ * the next flush. The store is snapshotted when the log reaches the checkpoint size, before the record is added,
+ * because at that point every logged change is already applied to the store. The record takes the next number of
+ * the store, which the caller applies the change to.
+ *
+ * @param log A pointer to the log
+ * @param operation The kind of change
+ * @param rent The rent after the change (or the removed rent)
+ * @param walletDelta The change made to the wallet of rent->userNif with the change
+ * @return True if the record was accepted, false if the flush of its batch failed
+ */
+bool rentLogAppend(RentLog *log, RentLogOperation operation, Rent *rent, int walletDelta)
+{
+  if (log->records >= log->checkpointEvery)
+  {
+    // a failed checkpoint is tried again on the next append, the log only grows meanwhile
+    rentLogCheckpoint(log);
+  }
+
+  RentLogRecord *record = &log->pending[log->pendingCount++];
+  memset(record, 0, sizeof(RentLogRecord));
+  record->operation = operation;
+  record->sequence = log->rentStore->sequence + 1;
+  record->walletDelta = walletDelta;
+  record->rent = *rent;
+  record->checksum = checksumRecord(record);
+
+  if (log->pendingCount >= log->syncEvery && !rentLogSync(log))
+  {
+    log->pendingCount--;
+    return false;
+  }
+  log->rentStore->sequence = record->sequence;
+  return true;
+}
+
+/**
+ * @brief Appends a change to a wallet that no rent made
+ *
+ * @param log A pointer to the log
+ * @param userNif The NIF of the user, who is created with walletDelta in the wallet on replay if it does not exist
+ * @param walletDelta The change made to the wallet
+ * @return True if the record was accepted, false if the flush of its batch failed
+ */
+bool rentLogWallet(RentLog *log, int userNif, int walletDelta)
+{
+  Rent rent;
+  memset(&rent, 0, sizeof(Rent));
+  rent.userNif = userNif;
+  return rentLogAppend(log, RENT_LOG_WALLET, &rent, walletDelta);
+}
+
+/**
+ * @brief Writes the buffered records and waits until they are on disk
+ *
+ * @param log A pointer to the log
+ * @return True if every buffered record is durable, false otherwise
+ */
+bool rentLogSync(RentLog *log)
+{
+  if (log->pendingCount == 0)
+  {
+    return true;
+  }
+
+  size_t length = log->pendingCount * sizeof(RentLogRecord);
+  size_t written = 0;
+  char *bytes = (char *)log->pending;
+
+  // always write at the known end, so a failed batch is simply overwritten by the next one
+  while (written < length)
+  {
+    ssize_t n = pwrite(log->fd, bytes + written, length - written, log->size + written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+    {
+      perror("could not write the rents log");
+      return false;
+    }
+    written += n;
+  }
+
+  if (fdatasync(log->fd) != 0)
+  {
+    perror("could not sync the rents log");
+    return false;
+  }
+
+  log->size += length;
+  log->records += log->pendingCount;
+  log->pendingCount = 0;
+  return true;
+}
+
+/**
+ * @brief Snapshots the rent store into rents.bin and truncates the log
+ *
+ * The snapshot is written to temporary files that are renamed over the previous ones, so a crash at any point
+ * leaves either the old snapshot with the whole log or the new snapshot.
+ *
+ * @param log A pointer to the log
+ * @return True if the checkpoint was taken, false otherwise
+ */
+bool rentLogCheckpoint(RentLog *log)
+{
+  if (!rentLogSync(log))
+  {
+    return false;
+  }
+
+  if (!storeRentsInFile(log->rentStore, RENTS_FILE ".tmp", RENTS_SEQ_FILE ".tmp"))
+  {
+    return false;
+  }
+
+  if (rename(RENTS_FILE ".tmp", RENTS_FILE) != 0 || rename(RENTS_SEQ_FILE ".tmp", RENTS_SEQ_FILE) != 0 || !syncDataDirectory())
+  {
+    perror("could not replace the rents snapshot");
+    return false;
+  }
+
+  if (ftruncate(log->fd, 0) != 0 || fdatasync(log->fd) != 0)
+  {
+    perror("could not truncate the rents log");
+    return false;
+  }
+
+  log->size = 0;
+  log->records = 0;
+  return true;
+}
+
+/**
+ * @brief Drops the records up to a number, once a snapshot of every store holds them
+ *
+ * The records after it are copied to a new log that is renamed over this one, so a crash leaves either log, and the
+ * replay skips the records the snapshot holds in both.
+ *
+ * @param log A pointer to the log
+ * @param sequence The number of the last record the snapshot holds
+ * @return True if the log was cut, false otherwise
+ */
+bool rentLogTrim(RentLog *log, int64_t sequence)
+{
+  if (!rentLogSync(log))
+  {
+    return false;
+  }
+
+  int fd = open(RENT_LOG_FILE, O_RDONLY);
+  if (fd < 0)
+  {
+    perror("could not open the rents log");
+    return false;
+  }
+
+  // the records are numbered one after the other, so the first one to keep is found from the first record
+  RentLogRecord record;
+  long long keep = 0;
+  if (log->size > 0 && pread(fd, &record, sizeof(RentLogRecord), 0) == sizeof(RentLogRecord) &&
+      record.sequence <= sequence)
+  {
+    keep = (sequence - record.sequence + 1) * (long long)sizeof(RentLogRecord);
+    if (keep < log->size && (pread(fd, &record, sizeof(RentLogRecord), keep) != sizeof(RentLogRecord) ||
+                             record.sequence != sequence + 1))
+    {
+      fprintf(stderr, "the rents log is not numbered in order, it is not cut\n");
+      close(fd);
+      return false;
+    }
+  }
+
+  if (keep == 0)
+  {
+    close(fd);
+    return true;
+  }
+  if (keep >= log->size)
+  {
+    close(fd);
+    if (ftruncate(log->fd, 0) != 0 || fdatasync(log->fd) != 0)
+    {
+      perror("could not truncate the rents log");
+      return false;
+    }
+    log->size = 0;
+    log->records = 0;
+    return true;
+  }
+
+  int out = open(RENT_LOG_FILE ".tmp", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  char buffer[65536];
+  bool copied = out >= 0;
+  for (long long offset = keep; copied && offset < log->size;)
+  {
+    size_t length = log->size - offset < (long long)sizeof(buffer) ? (size_t)(log->size - offset) : sizeof(buffer);
+    ssize_t n = pread(fd, buffer, length, offset);
+    copied = n > 0 && write(out, buffer, n) == n;
+    offset += n;
+  }
+  close(fd);
+
+  if (!copied || fdatasync(out) != 0 || rename(RENT_LOG_FILE ".tmp", RENT_LOG_FILE) != 0 || !syncDataDirectory())
+  {
+    perror("could not cut the rents log");
+    if (out >= 0)
+    {
+      close(out);
+      unlink(RENT_LOG_FILE ".tmp");
+    }
+    return false;
+  }
+
+  close(log->fd);
+  log->fd = out;
+  log->size -= keep;
+  log->records = log->size / sizeof(RentLogRecord);
+  return true;
+}
+
+/**
+ * @brief Flushes the log, detaches it from the rent store and frees it
+ *
+ * @param log A pointer to the log
+ * @return True if every record was flushed, false otherwise
+ */
+bool closeRentLog(RentLog *log)
+{
+  if (log == NULL)
+  {
+    return true;
+  }
+
+  bool synced = rentLogSync(log);
+  if (log->rentStore->log == log)
+  {
+    log->rentStore->log = NULL;
+  }
+  close(log->fd);
+  free(log->pending);
+  free(log);
+  return synced;
+}
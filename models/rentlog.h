@@ -0,0 +1,59 @@
+/**
+ * @file rentlog.h
+ * @brief File containing the functions to manage the write-ahead log of the rent store
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include "./user.h"
+#include "./vehicle.h"
+#include "./rentals.h"
+#pragma once
+
+#define RENT_LOG_FILE "./saved-data/rents.wal"
+#define RENT_LOG_SYNC_EVERY 64
+#define RENT_LOG_CHECKPOINT_EVERY 100000
+#define RENT_LOG_NEVER_CHECKPOINT LONG_MAX // the owner snapshots every store and cuts the log with rentLogTrim
+
+typedef enum RentLogOperation
+{
+  RENT_LOG_CREATE = 1, // the rent was made: its vehicle is claimed and its price is debited
+  RENT_LOG_EDIT,
+  RENT_LOG_DELETE, // the rent ended: its vehicle is released unless a newer rent holds it, walletDelta is the refund
+  RENT_LOG_WALLET  // a wallet changed without a rent, only rent.userNif is set, the user is created if it is new
+} RentLogOperation;
+
+typedef struct RentLogRecord
+{
+  int32_t operation;
+  uint32_t checksum;   // of the whole record with this field set to zero
+  int64_t sequence;    // RentStore.sequence once the change is applied, one more than the record before
+  int32_t walletDelta; // change made to the wallet of rent.userNif with the change
+  Rent rent;
+} RentLogRecord;
+
+struct RentLog
+{
+  RentStore *rentStore;
+  int fd;
+  long long size;         // bytes of the log that are known to be on disk
+  RentLogRecord *pending; // records waiting for the next batched fdatasync
+  int pendingCount;
+  int pendingCapacity;
+  int syncEvery;
+  long records; // records in the log since the last checkpoint
+  long checkpointEvery;
+};
+
+long replayRentLog(RentStore *rentStore, VehicleList *vehicleList, UserList **userList);
+long recoverRents(RentStore *rentStore, VehicleList *vehicleList, UserList **userList);
+RentLog *openRentLog(RentStore *rentStore, int syncEvery, long checkpointEvery);
+bool rentLogAppend(RentLog *log, RentLogOperation operation, Rent *rent, int walletDelta);
+bool rentLogWallet(RentLog *log, int userNif, int walletDelta);
+bool rentLogSync(RentLog *log);
+bool rentLogCheckpoint(RentLog *log);
+bool rentLogTrim(RentLog *log, int64_t sequence);
+bool closeRentLog(RentLog *log);
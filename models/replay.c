@@ -0,0 +1,426 @@
+/**
+ * @file replay.c
+ * @brief File containing the replay of command files through a parser thread and an executor thread
+ *
+ * A command file has one command per line, in the format of commands.c; blank lines and lines that start with #
+ * are skipped. The file is mapped and parsed by its own thread into batches of REPLAY_BATCH fixed size commands,
+ * which go through a bounded queue to the calling thread, the executor, so the text is parsed while the previous
+ * batches run and the lock is taken once per batch, not per command. Each command type is timed while it runs.
+ *
+ * The responses can be written to a file, one line per command, and a file written that way by an earlier run can
+ * be given back as the expected responses: each response is then compared with the line of the same command. A
+ * replay changes the stores it runs against, so an expected file only matches a run that starts from the same data.
+ * After every batch the rents of the engine are moved into the rent store and the ones whose time is over end, as
+ * between two turns of the server; rents from the data that ended before the replay starts expire at the first
+ * batch.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "./replay.h"
+#include "./trace.h"
+
+typedef struct ReplayItem
+{
+  Command command;
+  long line;            // line of the command in the command file, from 1
+  const char *expected; // expected response, without its newline, NULL when the expected file has no more lines
+  int expectedLength;
+} ReplayItem;
+
+typedef struct ReplayBatch
+{
+  int count;
+  ReplayItem items[REPLAY_BATCH];
+} ReplayBatch;
+
+typedef struct ReplayQueue
+{
+  ReplayBatch *batches; // ring of REPLAY_QUEUE_BATCHES
+  long produced;        // batches published by the parser
+  long consumed;        // batches released by the executor
+  bool finished;        // the parser published its last batch
+  pthread_mutex_t lock;
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+  const char *commands; // mapped command file
+  size_t commandsSize;
+  const char *expected; // mapped expected file, or NULL
+  size_t expectedSize;
+  long long extraExpected; // lines of the expected file after the last command
+  long long parserWaits;
+  long long executorWaits;
+  double parseSeconds;
+} ReplayQueue;
+
+/**
+ * @brief Gets a clock in seconds
+ *
+ * @param clock CLOCK_MONOTONIC for the wall time, CLOCK_THREAD_CPUTIME_ID for the CPU time of the calling thread
+ * @return The time in seconds
+ */
+static double clockSeconds(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Maps a whole file for reading
+ *
+ * @param fileName The path of the file
+ * @param size Receives the size of the file
+ * @return A pointer to the contents, an empty string for an empty file, or NULL if the file could not be mapped
+ */
+static const char *mapFile(char *fileName, size_t *size)
+{
+  int fd = open(fileName, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    perror("Could not open file");
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  *size = (size_t)st.st_size;
+  if (*size == 0)
+  {
+    close(fd);
+    return "";
+  }
+  void *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping stays valid
+  if (data == MAP_FAILED)
+  {
+    perror("could not map the file");
+    return NULL;
+  }
+  madvise(data, *size, MADV_SEQUENTIAL);
+  return (const char *)data;
+}
+
+/**
+ * @brief Unmaps a file mapped with mapFile
+ *
+ * @param data The contents
+ * @param size The size of the file
+ */
+static void unmapFile(const char *data, size_t size)
+{
+  if (data != NULL && size > 0)
+    munmap((void *)data, size);
+}
+
+/**
+ * @brief Finds the next line of a mapped file
+ *
+ * @param data The contents
+ * @param size The size of the contents
+ * @param offset The offset of the line, moved past it and its newline
+ * @param length Receives the length of the line, without its newline
+ * @return A pointer to the line, or NULL at the end of the file
+ */
+static const char *nextLine(const char *data, size_t size, size_t *offset, size_t *length)
+{
+  if (*offset >= size)
+    return NULL;
+  const char *line = data + *offset;
+  const char *end = memchr(line, '\n', size - *offset);
+  *length = end != NULL ? (size_t)(end - line) : size - *offset;
+  *offset += *length + 1;
+  return line;
+}
+
+/**
+ * @brief Checks if a command line is skipped: blank or a comment
+ *
+ * @param line The line
+ * @param length The length of the line
+ * @return True if the line is skipped, false otherwise
+ */
+static bool isSkipped(const char *line, size_t length)
+{
+  size_t i = 0;
+  while (i < length && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r'))
+    i++;
+  return i == length || line[i] == '#';
+}
+
+/**
+ * @brief Publishes the batch the parser filled and waits for a free one
+ *
+ * @param queue A pointer to the queue
+ * @param isLast True for the last batch of the file
+ */
+static void publishBatch(ReplayQueue *queue, bool isLast)
+{
+  pthread_mutex_lock(&queue->lock);
+  queue->produced++;
+  queue->finished = isLast;
+  pthread_cond_signal(&queue->notEmpty);
+  while (!isLast && queue->produced - queue->consumed == REPLAY_QUEUE_BATCHES)
+  {
+    queue->parserWaits++;
+    pthread_cond_wait(&queue->notFull, &queue->lock);
+  }
+  pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief The parser thread: splits the command file into lines, parses them and publishes them in batches
+ *
+ * @param arg A pointer to the ReplayQueue
+ * @return NULL
+ */
+static void *parseCommands(void *arg)
+{
+  ReplayQueue *queue = (ReplayQueue *)arg;
+  double start = clockSeconds(CLOCK_THREAD_CPUTIME_ID);
+  size_t offset = 0, expectedOffset = 0, length, expectedLength = 0;
+  const char *line;
+  long number = 0;
+
+  // the ring has a free slot before the first batch, publishBatch waits for one before returning
+  ReplayBatch *batch = &queue->batches[0];
+  batch->count = 0;
+  while ((line = nextLine(queue->commands, queue->commandsSize, &offset, &length)) != NULL)
+  {
+    number++;
+    if (isSkipped(line, length))
+      continue;
+
+    ReplayItem *item = &batch->items[batch->count++];
+    parseCommand(line, length, &item->command);
+    item->line = number;
+    item->expected = NULL;
+    if (queue->expected != NULL)
+    {
+      item->expected = nextLine(queue->expected, queue->expectedSize, &expectedOffset, &expectedLength);
+      item->expectedLength = (int)expectedLength;
+    }
+
+    if (batch->count == REPLAY_BATCH)
+    {
+      TRACE_SCOPE("publishBatch");
+      publishBatch(queue, false);
+      batch = &queue->batches[queue->produced % REPLAY_QUEUE_BATCHES];
+      batch->count = 0;
+    }
+  }
+
+  while (queue->expected != NULL && nextLine(queue->expected, queue->expectedSize, &expectedOffset, &expectedLength) != NULL)
+    queue->extraExpected++;
+  queue->parseSeconds = clockSeconds(CLOCK_THREAD_CPUTIME_ID) - start;
+  publishBatch(queue, true);
+  return NULL;
+}
+
+/**
+ * @brief Runs the commands of a batch
+ *
+ * @param context A pointer to the context with the stores
+ * @param batch A pointer to the batch
+ * @param responses The file that receives the responses, or NULL
+ * @param report A pointer to the report
+ */
+static void executeBatch(CommandContext *context, ReplayBatch *batch, FILE *responses, ReplayReport *report)
+{
+  char response[COMMAND_RESPONSE_SIZE];
+  struct timespec before, after;
+
+  for (int i = 0; i < batch->count; i++)
+  {
+    ReplayItem *item = &batch->items[i];
+    ReplayTypeReport *type = &report->types[item->command.type];
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    size_t length = executeCommand(context, &item->command, response, sizeof(response));
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    type->nanoseconds += (after.tv_sec - before.tv_sec) * 1000000000LL + (after.tv_nsec - before.tv_nsec);
+    type->commands++;
+    type->refused += response[0] == 'E';
+    report->commands++;
+
+    if (responses != NULL)
+      fwrite(response, 1, length, responses);
+    if (report->isVerified)
+    {
+      size_t compared = length - 1; // without the newline
+      const char *expected = item->expected;
+      int expectedLength = item->expectedLength;
+      if (expected != NULL && expectedLength > 0 && expected[expectedLength - 1] == '\r')
+        expectedLength--;
+      if (expected == NULL || (size_t)expectedLength != compared || memcmp(expected, response, compared) != 0)
+      {
+        if (report->mismatches < REPLAY_MAX_MISMATCHES)
+          fprintf(stderr, "line %ld (%s): expected \"%.*s\", got \"%.*s\"\n", item->line,
+                  commandName(item->command.type), expected != NULL ? expectedLength : 0,
+                  expected != NULL ? expected : "", (int)compared, response);
+        type->mismatches++;
+        report->mismatches++;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Starts the parser and runs the batches it publishes until it finishes
+ *
+ * @param context A pointer to the context with the stores
+ * @param queue A pointer to the queue, with the mapped files
+ * @param responses The file that receives the responses, or NULL
+ * @param report A pointer to the report
+ * @return True if the parser could be started, false otherwise
+ */
+static bool runReplay(CommandContext *context, ReplayQueue *queue, FILE *responses, ReplayReport *report)
+{
+  pthread_t parser;
+  double start = clockSeconds(CLOCK_MONOTONIC);
+  double cpuStart = clockSeconds(CLOCK_THREAD_CPUTIME_ID);
+  if (pthread_create(&parser, NULL, parseCommands, queue) != 0)
+  {
+    perror("could not start the parser");
+    return false;
+  }
+
+  while (true)
+  {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->consumed == queue->produced && !queue->finished)
+    {
+      queue->executorWaits++;
+      pthread_cond_wait(&queue->notEmpty, &queue->lock);
+    }
+    bool isEmpty = queue->consumed == queue->produced;
+    pthread_mutex_unlock(&queue->lock);
+    if (isEmpty)
+      break;
+
+    executeBatch(context, &queue->batches[queue->consumed % REPLAY_QUEUE_BATCHES], responses, report);
+    int expired;
+    report->rents += settleRents(context, time(NULL), &expired);
+    report->expired += expired;
+
+    pthread_mutex_lock(&queue->lock);
+    queue->consumed++;
+    pthread_cond_signal(&queue->notFull);
+    pthread_mutex_unlock(&queue->lock);
+  }
+  pthread_join(parser, NULL);
+
+  report->seconds = clockSeconds(CLOCK_MONOTONIC) - start;
+  report->executeSeconds = clockSeconds(CLOCK_THREAD_CPUTIME_ID) - cpuStart;
+  report->parseSeconds = queue->parseSeconds;
+  report->parserWaits = queue->parserWaits;
+  report->executorWaits = queue->executorWaits;
+  if (report->isVerified && queue->extraExpected > 0)
+  {
+    fprintf(stderr, "the expected file has %lld lines after the last command\n", queue->extraExpected);
+    report->mismatches += queue->extraExpected;
+  }
+  return true;
+}
+
+/**
+ * @brief Replays a command file against the stores of a context
+ *
+ * The file is parsed on a new thread while the calling thread runs the commands, in the order of the file.
+ *
+ * @param context A pointer to the context with the stores
+ * @param commandFile The path of the command file
+ * @param expectedFile The path of a file with the expected responses, or NULL to not verify them
+ * @param responseFile The path of a file that receives the responses, or NULL
+ * @param report Receives the counts and times of the replay
+ * @return True if the files could be read and written, false otherwise, the mismatches are in the report
+ */
+bool replayCommands(CommandContext *context, char *commandFile, char *expectedFile, char *responseFile, ReplayReport *report)
+{
+  ReplayQueue queue = {0};
+  FILE *responses = NULL;
+  bool ok = false;
+
+  memset(report, 0, sizeof(ReplayReport));
+  report->isVerified = expectedFile != NULL;
+  queue.commands = mapFile(commandFile, &queue.commandsSize);
+  queue.expected = expectedFile != NULL ? mapFile(expectedFile, &queue.expectedSize) : NULL;
+  queue.batches = (ReplayBatch *)malloc(REPLAY_QUEUE_BATCHES * sizeof(ReplayBatch));
+  if (queue.batches == NULL)
+  {
+    perror("could not allocate memory!");
+  }
+  if (responseFile != NULL)
+  {
+    responses = fopen(responseFile, "w");
+    if (responses == NULL)
+      perror("Could not open file");
+    else
+      setvbuf(responses, NULL, _IOFBF, 1 << 20);
+  }
+
+  if (queue.commands != NULL && (expectedFile == NULL || queue.expected != NULL) && queue.batches != NULL &&
+      (responseFile == NULL || responses != NULL))
+  {
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.notEmpty, NULL);
+    pthread_cond_init(&queue.notFull, NULL);
+    ok = runReplay(context, &queue, responses, report);
+    pthread_mutex_destroy(&queue.lock);
+    pthread_cond_destroy(&queue.notEmpty);
+    pthread_cond_destroy(&queue.notFull);
+  }
+
+  if (responses != NULL && fclose(responses) != 0)
+  {
+    perror("could not write the responses");
+    ok = false;
+  }
+  unmapFile(queue.commands, queue.commandsSize);
+  unmapFile(queue.expected, queue.expectedSize);
+  free(queue.batches);
+  return ok;
+}
+
+/**
+ * @brief Prints the commands, refusals, mismatches and throughput of each command type of a replay
+ *
+ * The throughput of a type is its commands over the time spent running them, the one of the total is over the
+ * whole replay, parsing and waiting included.
+ *
+ * @param fp The file, stdout for the console
+ * @param report A pointer to the report
+ */
+void printReplayReport(FILE *fp, ReplayReport *report)
+{
+  char mismatches[32];
+  long long refused = 0;
+
+  fprintf(fp, "%-10s %12s %12s %12s %14s %10s\n", "command", "commands", "refused", "mismatches", "per second",
+          "mean us");
+  for (int type = 0; type < COMMAND_TYPES; type++)
+  {
+    ReplayTypeReport *line = &report->types[type];
+    refused += line->refused;
+    if (line->commands == 0)
+      continue;
+    snprintf(mismatches, sizeof(mismatches), report->isVerified ? "%lld" : "-", line->mismatches);
+    fprintf(fp, "%-10s %12lld %12lld %12s %14.0f %10.3f\n", commandName(type), line->commands, line->refused,
+            mismatches, line->nanoseconds > 0 ? line->commands / (line->nanoseconds / 1e9) : 0,
+            line->nanoseconds / 1e3 / line->commands);
+  }
+  snprintf(mismatches, sizeof(mismatches), report->isVerified ? "%lld" : "-", report->mismatches);
+  fprintf(fp, "%-10s %12lld %12lld %12s %14.0f\n", "total", report->commands, refused, mismatches,
+          report->seconds > 0 ? report->commands / report->seconds : 0);
+  fprintf(fp, "%.3f s, parser %.3f s of CPU, executor %.3f s of CPU, the parser waited %lld times and the executor "
+              "%lld times\n",
+          report->seconds, report->parseSeconds, report->executeSeconds, report->parserWaits, report->executorWaits);
+}
@@ -0,0 +1,41 @@
+/**
+ * @file replay.h
+ * @brief File containing the replay of command files through a parser thread and an executor thread
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "./commands.h"
+#pragma once
+
+#define REPLAY_BATCH 256         // commands handed from the parser to the executor at once
+#define REPLAY_QUEUE_BATCHES 32  // batches the parser can be ahead of the executor
+#define REPLAY_MAX_MISMATCHES 10 // mismatches printed, the others are only counted
+
+typedef struct ReplayTypeReport
+{
+  long long commands;
+  long long refused; // answered with ERR
+  long long mismatches;
+  long long nanoseconds; // spent executing
+} ReplayTypeReport;
+
+typedef struct ReplayReport
+{
+  ReplayTypeReport types[COMMAND_TYPES];
+  long long commands;
+  long long mismatches; // responses that differ from the expected file, and lines missing from either file
+  bool isVerified;      // an expected file was given
+  double seconds;        // from the start of the parser to the last command
+  double parseSeconds;   // CPU time of the parser thread
+  double executeSeconds; // CPU time of the executor thread
+  long long parserWaits;   // times the parser found the queue full
+  long long executorWaits; // times the executor found the queue empty
+  long long rents;         // moved into the rent store of the context
+  long long expired;       // rents ended because their time was over
+} ReplayReport;
+
+bool replayCommands(CommandContext *context, char *commandFile, char *expectedFile, char *responseFile, ReplayReport *report);
+void printReplayReport(FILE *fp, ReplayReport *report);
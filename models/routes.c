@@ -9,7 +9,11 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include "./binformat.h"
 #include "./routes.h"
+#include "./memstats.h"
+#include "./metrics.h"
+#include "./trace.h"
 
 #pragma region GRAPH
 
@@ -32,7 +36,7 @@ Vertex *createRoute()
  */
 Vertex *createRouteVertex(char *city, int cod)
 {
-  Vertex *new = (Vertex *)calloc(1, sizeof(Vertex));
+  Vertex *new = (Vertex *)memCalloc(MEM_VERTICES, 1, sizeof(Vertex));
   if (new == NULL)
     return NULL;
   new->cod = cod;
@@ -112,13 +116,52 @@ Vertex *destroyRoutes(Vertex *g)
     if (g->next)
       aux = g->next;
     g->adjacents = destroyAdj(g->adjacents);
-    free(g);
+    memFree(MEM_VERTICES, g);
     g = aux;
     aux = NULL;
   }
   return g;
 }
 
+/**
+ * @brief Copies the graph and its adjacency lists, keeping the order of both.
+ *
+ * @param g Pointer to the starting vertex of the graph.
+ * @param res Pointer to a variable that stores the result of the copy, false if there was no memory.
+ * @return Pointer to the starting vertex of the copy, NULL if the graph is empty or there was no memory.
+ */
+Vertex *copyRoutes(Vertex *g, bool *res)
+{
+  Vertex *copy = NULL;
+  Vertex **lastVertex = &copy;
+  *res = true;
+  for (Vertex *aux = g; aux != NULL; aux = aux->next)
+  {
+    Vertex *vertex = createRouteVertex(aux->city, aux->cod);
+    if (vertex == NULL)
+    {
+      *res = false;
+      return destroyRoutes(copy);
+    }
+    *lastVertex = vertex;
+    lastVertex = &vertex->next;
+
+    Adj **lastAdj = &vertex->adjacents;
+    for (Adj *adj = aux->adjacents; adj != NULL; adj = adj->next)
+    {
+      Adj *newAdj = createAdj(adj->cod, adj->dist);
+      if (newAdj == NULL)
+      {
+        *res = false;
+        return destroyRoutes(copy);
+      }
+      *lastAdj = newAdj;
+      lastAdj = &newAdj->next;
+    }
+  }
+  return copy;
+}
+
 /**
  * @brief Gets the identifier code of a vertex from the city name.
  *
@@ -147,11 +190,11 @@ int searchCodVertex(Vertex *g, char *city)
  */
 Vertex *searchVertex(Vertex *g, char *city)
 {
-  if (g == NULL)
-    return NULL;
-  if (strcmp(g->city, city) == 0)
-    return g;
-  return (searchVertex(g->next, city));
+  METRIC_SCOPE(METRIC_SEARCH_VERTEX);
+  TRACE_FUNCTION();
+  while (g != NULL && strcmp(g->city, city) != 0)
+    g = g->next;
+  return g;
 }
 
 /**
@@ -163,11 +206,11 @@ Vertex *searchVertex(Vertex *g, char *city)
  */
 Vertex *searchVertexCod(Vertex *g, int cod)
 {
-  if (g == NULL)
-    return NULL;
-  if (g->cod == cod)
-    return g;
-  return (searchVertexCod(g->next, cod));
+  METRIC_SCOPE(METRIC_SEARCH_VERTEX_COD);
+  TRACE_FUNCTION();
+  while (g != NULL && g->cod != cod)
+    g = g->next;
+  return g;
 }
 
 /**
@@ -200,7 +243,7 @@ Vertex *resetVisitedVertex(Vertex *g)
  */
 Adj *createAdj(int cod, float valuedistance)
 {
-  Adj *new = (Adj *)calloc(1, sizeof(Adj));
+  Adj *new = (Adj *)memCalloc(MEM_EDGES, 1, sizeof(Adj));
   if (new == NULL)
     return NULL;
   new->cod = cod;
@@ -275,6 +318,36 @@ Vertex *insertAdjacentVertexCod(Vertex *g, int codOrigin, int codDest, float val
   return g;
 }
 
+/**
+ * @brief Sets the distance of the edge between two vertices given their codes, inserting the edge if there is none.
+ *
+ * @param g Pointer to the starting vertex of the graph.
+ * @param codOrigin Code of the source vertex.
+ * @param codDest Code of the destination vertex.
+ * @param valuedistance Distance of the edge.
+ * @param res Pointer to a variable that stores the result, false if a vertex does not exist.
+ * @return Pointer to the starting vertex of the graph.
+ */
+Vertex *setAdjacentDistanceCod(Vertex *g, int codOrigin, int codDest, float valuedistance, bool *res)
+{
+  *res = false;
+
+  Vertex *o = searchVertexCod(g, codOrigin);
+  if (o == NULL || searchVertexCod(g, codDest) == NULL)
+    return g;
+
+  for (Adj *adj = o->adjacents; adj != NULL; adj = adj->next)
+  {
+    if (adj->cod == codDest)
+    {
+      adj->dist = valuedistance;
+      *res = true;
+      return g;
+    }
+  }
+  return insertAdjacentVertexCod(g, codOrigin, codDest, valuedistance, res);
+}
+
 #pragma region GERE_LISTA_ADJACENCIAS
 
 /**
@@ -352,7 +425,7 @@ Adj *destroyAdj(Adj *h)
   {
     if (h->next != NULL)
       aux = h->next;
-    free(h);
+    memFree(MEM_EDGES, h);
     h = aux;
     aux = NULL;
   }
@@ -462,6 +535,8 @@ bool depthFirstSearchNamesRec(Vertex *g, char *src, char *dest)
  */
 Best bestPath(Vertex *g, int n, int v)
 {
+  METRIC_SCOPE(METRIC_BEST_PATH);
+  TRACE_FUNCTION();
 
   int cost[MAX][MAX], distance[MAX], pred[MAX];
   int visited[MAX], count, mindistance, nextnode, i;
@@ -555,10 +630,294 @@ void showAllPath(Best b, int n, int v)
     }
 }
 
+typedef struct PathEntry // entry of the frontier heap of shortestPath
+{
+  float distance;
+  int cod;
+} PathEntry;
+
+/**
+ * @brief Pushes an entry into the frontier heap of shortestPath
+ *
+ * @param heap The heap, with room for one more entry
+ * @param count The number of entries in the heap, incremented
+ * @param entry The entry
+ */
+static void pushPathEntry(PathEntry *heap, int *count, PathEntry entry)
+{
+  int i = (*count)++;
+  while (i > 0 && heap[(i - 1) / 2].distance > entry.distance)
+  {
+    heap[i] = heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  heap[i] = entry;
+}
+
+/**
+ * @brief Pops the entry with the smallest distance from the frontier heap of shortestPath
+ *
+ * @param heap The heap, not empty
+ * @param count The number of entries in the heap, decremented
+ * @return The entry
+ */
+static PathEntry popPathEntry(PathEntry *heap, int *count)
+{
+  PathEntry top = heap[0];
+  PathEntry last = heap[--(*count)];
+  int i = 0;
+  while (2 * i + 1 < *count)
+  {
+    int child = 2 * i + 1;
+    if (child + 1 < *count && heap[child + 1].distance < heap[child].distance)
+      child++;
+    if (heap[child].distance >= last.distance)
+      break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+  return top;
+}
+
+/**
+ * @brief Finds the shortest path between two vertices with Dijkstra's algorithm and a binary heap
+ *
+ * Unlike bestPath it works on graphs of any size and with any cods that are not negative, and it stops as soon as the
+ * destination is reached. The path is written from the origin to the destination; when it has more vertices than
+ * the capacity only its length is set.
+ *
+ * @param g The head of the vertex list.
+ * @param origin The code of the vertex the path starts at.
+ * @param dest The code of the vertex the path ends at.
+ * @param path Receives the codes of the vertices of the path, can be NULL.
+ * @param capacity The number of codes path has room for.
+ * @param length Receives the number of vertices of the path, 0 if there is none.
+ * @return The distance of the path, or -1 if there is no path or a vertex does not exist.
+ */
+float shortestPath(Vertex *g, int origin, int dest, int *path, int capacity, int *length)
+{
+  METRIC_SCOPE(METRIC_SHORTEST_PATH);
+  TRACE_FUNCTION();
+  int maxCod = -1, edgeCount = 0;
+  *length = 0;
+  for (Vertex *aux = g; aux != NULL; aux = aux->next)
+  {
+    if (aux->cod > maxCod)
+      maxCod = aux->cod;
+    for (Adj *adj = aux->adjacents; adj != NULL; adj = adj->next)
+      edgeCount++;
+  }
+  if (origin < 0 || dest < 0 || origin > maxCod || dest > maxCod)
+    return -1;
+
+  Vertex **vertices = (Vertex **)calloc(maxCod + 1, sizeof(Vertex *));
+  float *distance = (float *)malloc((maxCod + 1) * sizeof(float));
+  int *pred = (int *)malloc((maxCod + 1) * sizeof(int));
+  PathEntry *heap = (PathEntry *)malloc((edgeCount + 1) * sizeof(PathEntry));
+  if (vertices == NULL || distance == NULL || pred == NULL || heap == NULL)
+  {
+    perror("could not allocate memory!");
+    free(vertices);
+    free(distance);
+    free(pred);
+    free(heap);
+    return -1;
+  }
+  for (Vertex *aux = g; aux != NULL; aux = aux->next)
+    if (aux->cod >= 0 && vertices[aux->cod] == NULL)
+      vertices[aux->cod] = aux;
+  for (int i = 0; i <= maxCod; i++)
+  {
+    distance[i] = -1;
+    pred[i] = -1;
+  }
+
+  // an edge is pushed at most once, when it improves the distance of its target, so the heap never overflows
+  int count = 0;
+  float found = -1;
+  if (vertices[origin] != NULL && vertices[dest] != NULL)
+  {
+    distance[origin] = 0;
+    pushPathEntry(heap, &count, (PathEntry){0, origin});
+  }
+  while (count > 0)
+  {
+    PathEntry entry = popPathEntry(heap, &count);
+    if (entry.distance > distance[entry.cod])
+      continue; // already settled through a shorter path
+    if (entry.cod == dest)
+    {
+      found = entry.distance;
+      break;
+    }
+    for (Adj *adj = vertices[entry.cod]->adjacents; adj != NULL; adj = adj->next)
+    {
+      if (adj->cod < 0 || adj->cod > maxCod || vertices[adj->cod] == NULL)
+        continue;
+      float through = entry.distance + adj->dist;
+      if (distance[adj->cod] < 0 || through < distance[adj->cod])
+      {
+        distance[adj->cod] = through;
+        pred[adj->cod] = entry.cod;
+        pushPathEntry(heap, &count, (PathEntry){through, adj->cod});
+      }
+    }
+  }
+
+  if (found >= 0)
+  {
+    for (int cod = dest; cod != -1; cod = cod == origin ? -1 : pred[cod])
+      (*length)++;
+    if (path != NULL && *length <= capacity)
+    {
+      int i = *length;
+      for (int cod = dest; cod != -1; cod = cod == origin ? -1 : pred[cod])
+        path[--i] = cod;
+    }
+  }
+  free(vertices);
+  free(distance);
+  free(pred);
+  free(heap);
+  return found;
+}
+
+/**
+ * @brief Checks if there is a path between two vertices with a breadth-first search
+ *
+ * Unlike depthFirstSearchRec it keeps its visited flags to itself instead of using the ones of the graph, so it can
+ * run on several threads at once while the graph is not changed.
+ *
+ * @param g The head of the vertex list.
+ * @param origin The code of the origin vertex.
+ * @param dest The code of the destination vertex.
+ * @return True if both vertices exist and dest can be reached from origin, false otherwise.
+ */
+bool isReachable(Vertex *g, int origin, int dest)
+{
+  METRIC_SCOPE(METRIC_IS_REACHABLE);
+  TRACE_FUNCTION();
+  int maxCod = -1;
+  for (Vertex *aux = g; aux != NULL; aux = aux->next)
+    if (aux->cod > maxCod)
+      maxCod = aux->cod;
+  if (origin < 0 || dest < 0 || origin > maxCod || dest > maxCod)
+    return false;
+
+  Vertex **vertices = (Vertex **)calloc(maxCod + 1, sizeof(Vertex *));
+  bool *visited = (bool *)calloc(maxCod + 1, sizeof(bool));
+  int *queue = (int *)malloc((maxCod + 1) * sizeof(int));
+  if (vertices == NULL || visited == NULL || queue == NULL)
+  {
+    perror("could not allocate memory!");
+    free(vertices);
+    free(visited);
+    free(queue);
+    return false;
+  }
+  for (Vertex *aux = g; aux != NULL; aux = aux->next)
+    if (aux->cod >= 0 && vertices[aux->cod] == NULL)
+      vertices[aux->cod] = aux;
+
+  // a cod is queued at most once, when it is first visited, so the queue never overflows
+  int head = 0, tail = 0;
+  bool found = false;
+  if (vertices[origin] != NULL && vertices[dest] != NULL)
+  {
+    visited[origin] = true;
+    queue[tail++] = origin;
+  }
+  while (head < tail && !found)
+  {
+    int cod = queue[head++];
+    found = cod == dest;
+    for (Adj *adj = vertices[cod]->adjacents; adj != NULL && !found; adj = adj->next)
+    {
+      if (adj->cod < 0 || adj->cod > maxCod || vertices[adj->cod] == NULL || visited[adj->cod])
+        continue;
+      visited[adj->cod] = true;
+      queue[tail++] = adj->cod;
+    }
+  }
+  free(vertices);
+  free(visited);
+  free(queue);
+  return found;
+}
+
 #pragma endregion
 
 #pragma region FILES
 
+/**
+ * @brief PackVertex - Function that packs a vertex into its VERTEX_RECORD_SIZE bytes in the vertices file
+ * @param v: The vertex to be packed
+ * @param out: Receives the record
+ */
+static void packVertex(const VertexFile *v, uint8_t *out)
+{
+  putU32(out, (uint32_t)v->cod);
+  putString(out + 4, v->city, N);
+}
+
+/**
+ * @brief PackEdge - Function that packs an adjacency into its EDGE_RECORD_SIZE bytes in an adjacency file
+ * @param a: The adjacency to be packed
+ * @param out: Receives the record
+ */
+static void packEdge(const AdjFile *a, uint8_t *out)
+{
+  putU32(out, (uint32_t)a->codOrigin);
+  putU32(out + 4, (uint32_t)a->codDestiny);
+  putF32(out + 8, a->weight);
+}
+
+/**
+ * @brief NextVertex - Function that reads the next vertex of a vertices file, in either format
+ * @param fp: The file
+ * @param reader: The reader set up by openBinReader
+ * @param format: The format of the file
+ * @param v: Receives the vertex
+ * @return: true if a vertex was read, false at the end of the file
+ */
+static bool nextVertex(FILE *fp, BinReader *reader, BinFormat format, VertexFile *v)
+{
+  // files written before the versioned format are a dump of VertexFile structs
+  if (format == BIN_FORMAT_LEGACY)
+    return fread(v, 1, sizeof(VertexFile), fp) == sizeof(VertexFile);
+
+  const uint8_t *record = format == BIN_FORMAT_VERSIONED ? binRead(reader) : NULL;
+  if (record == NULL)
+    return false;
+  v->cod = (int)getU32(record);
+  getString(v->city, record + 4, N);
+  return true;
+}
+
+/**
+ * @brief NextEdge - Function that reads the next adjacency of an adjacency file, in either format
+ * @param fp: The file
+ * @param reader: The reader set up by openBinReader
+ * @param format: The format of the file
+ * @param a: Receives the adjacency
+ * @return: true if an adjacency was read, false at the end of the file
+ */
+static bool nextEdge(FILE *fp, BinReader *reader, BinFormat format, AdjFile *a)
+{
+  // files written before the versioned format are a dump of AdjFile structs
+  if (format == BIN_FORMAT_LEGACY)
+    return fread(a, 1, sizeof(AdjFile), fp) == sizeof(AdjFile);
+
+  const uint8_t *record = format == BIN_FORMAT_VERSIONED ? binRead(reader) : NULL;
+  if (record == NULL)
+    return false;
+  a->codOrigin = (int)getU32(record);
+  a->codDestiny = (int)getU32(record + 4);
+  a->weight = getF32(record + 8);
+  return true;
+}
+
 /**
  * @brief SaveGraph - Function that saves the graph to a binary file
  * @param h: Head of the linked list of vertices in the graph
@@ -566,6 +925,32 @@ void showAllPath(Best b, int n, int v)
  * @return: 1 if the graph was successfully saved, -1 if the file could not be opened, -2 if the head of the linked list is NULL
  */
 int saveGraph(Vertex *h, char *fileName)
+{
+  METRIC_SCOPE(METRIC_SAVE_GRAPH);
+  TRACE_FUNCTION();
+  int res = saveVertices(h, fileName);
+  if (res < 0)
+    return res;
+  // Pode gravar de imediato as adjacencias!
+  for (Vertex *aux = h; aux != NULL; aux = aux->next)
+  {
+    if (aux->adjacents)
+    {
+      char filePath[100];
+      sprintf(filePath, ADJ_FILE_FORMAT, aux->city);
+      saveAdj(aux->adjacents, filePath, aux->cod);
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief SaveVertices - Function that saves the vertices of the graph to a binary file, without their adjacency lists
+ * @param h: Head of the linked list of vertices in the graph
+ * @param fileName: Name of the file to save the vertices to
+ * @return: 1 if the vertices were successfully saved, -1 if the file could not be written, -2 if the head of the linked list is NULL
+ */
+int saveVertices(Vertex *h, char *fileName)
 {
   if (h == NULL)
     return -2;
@@ -575,21 +960,24 @@ int saveGraph(Vertex *h, char *fileName)
     return -1;
   Vertex *aux = h;
   VertexFile auxFile;
+  BinWriter writer;
+  uint8_t record[VERTEX_RECORD_SIZE];
+  if (!openBinWriter(&writer, fp, BIN_VERTICES, VERTEX_RECORD_SIZE))
+  {
+    fclose(fp);
+    return -1;
+  }
   while (aux != NULL)
   {
     auxFile.cod = aux->cod;
     strcpy(auxFile.city, aux->city);
-    fwrite(&auxFile, 1, sizeof(VertexFile), fp);
-    // Pode gravar de imediato as adjacencias!
-    if (aux->adjacents)
-    {
-      char filePath[100];
-      sprintf(filePath, "./saved-data/vertex-adj/%s.bin", aux->city);
-      saveAdj(aux->adjacents, filePath, aux->cod);
-    }
+    packVertex(&auxFile, record);
+    binWrite(&writer, record);
     aux = aux->next;
   }
-  fclose(fp);
+  bool written = closeBinWriter(&writer);
+  if (fclose(fp) != 0 || !written)
+    return -1;
   return 1;
 }
 
@@ -610,15 +998,25 @@ int saveAdj(Adj *h, char *fileName, int codVertexOrigin)
     return -1;
   Adj *aux = h;
   AdjFile auxFile;
+  BinWriter writer;
+  uint8_t record[EDGE_RECORD_SIZE];
+  if (!openBinWriter(&writer, fp, BIN_EDGES, EDGE_RECORD_SIZE))
+  {
+    fclose(fp);
+    return -1;
+  }
   while (aux)
   {
     auxFile.codDestiny = aux->cod;
     auxFile.codOrigin = codVertexOrigin;
     auxFile.weight = aux->dist;
-    fwrite(&auxFile, 1, sizeof(AdjFile), fp);
+    packEdge(&auxFile, record);
+    binWrite(&writer, record);
     aux = aux->next;
   }
-  fclose(fp);
+  bool written = closeBinWriter(&writer);
+  if (fclose(fp) != 0 || !written)
+    return -1;
   return 1;
 }
 
@@ -631,17 +1029,24 @@ int saveAdj(Adj *h, char *fileName, int codVertexOrigin)
  */
 Vertex *loadGraph(Vertex *h, char *fileName, bool *res)
 {
+  METRIC_SCOPE(METRIC_LOAD_GRAPH);
+  TRACE_FUNCTION();
   *res = false;
   FILE *fp = fopen(fileName, "rb");
   if (fp == NULL)
     return NULL;
   VertexFile aux;
   Vertex *new;
-  while (fread(&aux, 1, sizeof(VertexFile), fp))
+  BinReader reader;
+  BinFormat format = openBinReader(&reader, fp, BIN_VERTICES, VERTEX_RECORD_SIZE);
+  if (format == BIN_FORMAT_LEGACY && !binLegacySizeMatches(fp, sizeof(VertexFile)))
+    format = BIN_FORMAT_INVALID;
+  while (nextVertex(fp, &reader, format, &aux))
   {
     new = createRouteVertex(aux.city, aux.cod);
     h = insertRouteVertex(h, new, res);
   }
+  closeBinReader(&reader);
   fclose(fp);
   return h;
 }
@@ -654,6 +1059,8 @@ Vertex *loadGraph(Vertex *h, char *fileName, bool *res)
  */
 Vertex *loadAdj(Vertex *g, bool *res)
 {
+  METRIC_SCOPE(METRIC_LOAD_ADJ);
+  TRACE_FUNCTION();
   *res = false;
   FILE *fp;
   if (g == NULL)
@@ -663,14 +1070,19 @@ Vertex *loadAdj(Vertex *g, bool *res)
   while (auxGraph)
   {
     char filePath[100];
-    sprintf(filePath, "./saved-data/vertex-adj/%s.bin", auxGraph->city);
+    sprintf(filePath, ADJ_FILE_FORMAT, auxGraph->city);
     fp = fopen(filePath, "rb");
     if (fp != NULL)
     {
-      while (fread(&aux, 1, sizeof(AdjFile), fp))
+      BinReader reader;
+      BinFormat format = openBinReader(&reader, fp, BIN_EDGES, EDGE_RECORD_SIZE);
+      if (format == BIN_FORMAT_LEGACY && !binLegacySizeMatches(fp, sizeof(AdjFile)))
+        format = BIN_FORMAT_INVALID;
+      while (nextEdge(fp, &reader, format, &aux))
       {
         g = insertAdjacentVertexCod(g, aux.codOrigin, aux.codDestiny, aux.weight, res);
       }
+      closeBinReader(&reader);
       fclose(fp);
     }
     auxGraph = auxGraph->next;
@@ -678,6 +1090,75 @@ Vertex *loadAdj(Vertex *g, bool *res)
   return g;
 }
 
+/**
+ * @brief SaveGraphInPager - Function that saves the graph to the vertices and edges tables of a storage file
+ * @param pager: The storage file
+ * @param h: Head of the linked list of vertices in the graph
+ * @return: true if the graph was stored, false otherwise. Nothing reaches the disk until the pager is flushed
+ */
+bool saveGraphInPager(Pager *pager, Vertex *h)
+{
+  METRIC_SCOPE(METRIC_SAVE_GRAPH_PAGER);
+  TRACE_FUNCTION();
+  if (!pagerClearTable(pager, PAGER_VERTICES, sizeof(VertexFile)) || !pagerClearTable(pager, PAGER_EDGES, sizeof(AdjFile)))
+    return false;
+
+  VertexFile auxFile;
+  AdjFile adjFile;
+  memset(&auxFile, 0, sizeof(VertexFile));
+  for (Vertex *aux = h; aux != NULL; aux = aux->next)
+  {
+    auxFile.cod = aux->cod;
+    strcpy(auxFile.city, aux->city);
+    if (!pagerAppend(pager, PAGER_VERTICES, &auxFile))
+      return false;
+    for (Adj *adj = aux->adjacents; adj != NULL; adj = adj->next)
+    {
+      adjFile.codOrigin = aux->cod;
+      adjFile.codDestiny = adj->cod;
+      adjFile.weight = adj->dist;
+      if (!pagerAppend(pager, PAGER_EDGES, &adjFile))
+        return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief LoadGraphFromPager - Function that loads a graph and its adjacencies from a storage file
+ * @param pager: The storage file
+ * @param h: Head of the linked list of vertices in the graph
+ * @param res: Pointer to a boolean variable that will be set to true if the graph was successfully loaded
+ * @return: Head of the linked list of vertices in the loaded graph
+ */
+Vertex *loadGraphFromPager(Pager *pager, Vertex *h, bool *res)
+{
+  METRIC_SCOPE(METRIC_LOAD_GRAPH_PAGER);
+  TRACE_FUNCTION();
+  *res = false;
+  PagerCursor cursor;
+  VertexFile aux;
+  AdjFile adj;
+
+  if (!pagerOpenCursor(pager, PAGER_VERTICES, sizeof(VertexFile), &cursor))
+    return h;
+  Vertex *new;
+  while (pagerNext(&cursor, &aux))
+  {
+    new = createRouteVertex(aux.city, aux.cod);
+    if (new != NULL)
+      h = insertRouteVertex(h, new, res);
+  }
+  pagerCloseCursor(&cursor);
+
+  if (!pagerOpenCursor(pager, PAGER_EDGES, sizeof(AdjFile), &cursor))
+    return h;
+  while (pagerNext(&cursor, &adj))
+    h = insertAdjacentVertexCod(h, adj.codOrigin, adj.codDestiny, adj.weight, res);
+  pagerCloseCursor(&cursor);
+  return h;
+}
+
 #pragma endregion
 
 /**
@@ -690,6 +1171,8 @@ Vertex *loadAdj(Vertex *g, bool *res)
  */
 Vertex *routesReadTxt(Vertex *g, bool *res, int *tot)
 {
+  METRIC_SCOPE(METRIC_READ_ROUTES_TXT);
+  TRACE_FUNCTION();
   *res = false;
   FILE *fp;
 
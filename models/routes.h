@@ -12,8 +12,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <locale.h>
+#include "./pager.h"
 
 #define N 50
+#define VERTEX_RECORD_SIZE 54 // packed size of a VertexFile
+#define EDGE_RECORD_SIZE 12   // packed size of an AdjFile
+#define GRAPH_FILE "./saved-data/Vertexs.bin"
+#define ADJ_FILE_FORMAT "./saved-data/vertex-adj/%s.bin" // adjacency list of the city given to sprintf
 
 typedef struct Adj // adjacents
 {
@@ -64,6 +69,7 @@ int searchCodVertex(Vertex *g, char *city);
 Vertex *searchVertex(Vertex *g, char *city);
 Vertex *searchVertexCod(Vertex *g, int cod);
 Vertex *destroyRoutes(Vertex *g);
+Vertex *copyRoutes(Vertex *g, bool *res);
 
 #pragma endregion
 
@@ -71,6 +77,7 @@ Vertex *destroyRoutes(Vertex *g);
 
 Vertex *insertAdjacentVertex(Vertex *g, char *origem, char *dest, float valuedistance, bool *res);
 Vertex *insertAdjacentVertexCod(Vertex *g, int origem, int dest, float valuedistance, bool *res);
+Vertex *setAdjacentDistanceCod(Vertex *g, int codOrigin, int codDest, float valuedistance, bool *res);
 
 #pragma region LIST_ADJACENTS
 
@@ -96,15 +103,20 @@ Vertex *resetVisitedVertex(Vertex *g);
 
 Best bestPath(Vertex *g, int n, int v);
 void showAllPath(Best b, int n, int v);
+float shortestPath(Vertex *g, int origin, int dest, int *path, int capacity, int *length);
+bool isReachable(Vertex *g, int origin, int dest);
 
 #pragma endregion
 
 #pragma region SAVING
 
 int saveGraph(Vertex *h, char *fileName);
+int saveVertices(Vertex *h, char *fileName);
 int saveAdj(Adj *h, char *fileName, int cod);
 Vertex *loadGraph(Vertex *h, char *fileName, bool *res);
 Vertex *loadAdj(Vertex *g, bool *res);
 Vertex *routesReadTxt(Vertex *g, bool *res, int *tot);
+bool saveGraphInPager(Pager *pager, Vertex *h);
+Vertex *loadGraphFromPager(Pager *pager, Vertex *h, bool *res);
 
 #pragma endregion
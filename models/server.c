@@ -0,0 +1,630 @@
+/**
+ * @file server.c
+ * @brief File containing the event-loop server of the rental, search, wallet and routing operations
+ *
+ * The server listens on a Unix domain socket, or on a TCP port of the loopback address, and serves every connection
+ * from one thread with epoll. Each request is a command line, parsed and run by the functions of commands.c, and
+ * each response is one line that starts with OK or ERR, so a client can pipeline as many requests as it likes: the
+ * requests of a connection are answered in order. QUIT closes the connection once its responses are sent.
+ *
+ * Rents go through the rental engine of the command context, with the vehicles of the list and the wallets of the
+ * user store, and are moved into the rent store after every turn of the event loop, which also ends the rents whose
+ * time is over. The loop turns at least every SERVER_TICK_MS, even when no request comes. When the rent store has a
+ * write-ahead log it is synced at the end of the turn too, so a crash loses at most the rents of the turn that was
+ * being served. Every SERVER_SNAPSHOT_SECONDS a background snapshot of the users, vehicles and rents is started
+ * between turns, and once it is written the log is cut to the records after it, so the users and the vehicles are
+ * saved while serving and the log stays short.
+ *
+ * The server listens before the stores exist: a loader thread builds them while the event loop already takes
+ * connections. Until it is done the lookups are answered from the warm start image, when the caller has one that
+ * holds the stores as they are, and every other request waits in the input of its connection, so the requests of a
+ * connection are still answered in order; the loop answers the waiting ones as soon as the loader signals it.
+ *
+ * Backpressure is per connection: once SERVER_OUTPUT_HIGH bytes of responses are waiting to be sent, the connection
+ * is neither read nor answered until the client takes them, so a client that does not read cannot make the server
+ * buffer without end. When SERVER_MAX_CONNECTIONS are open, new connections wait in the listen backlog until one
+ * closes.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include "./memstats.h"
+#include "./rentlog.h"
+#include "./server.h"
+
+/**
+ * @brief Opens the listening socket of an address
+ *
+ * @param server A pointer to the server, receives the socket and the path of a Unix socket
+ * @param address A port of the loopback address, or the path of a Unix domain socket
+ * @return True if the socket is listening, false otherwise
+ */
+static bool listenServer(Server *server, char *address)
+{
+  int port;
+  server->isUnix = !parseInt(address, &port) || port <= 0 || port > 65535;
+  if (server->isUnix)
+  {
+    struct sockaddr_un un = {0};
+    un.sun_family = AF_UNIX;
+    if (strlen(address) >= sizeof(un.sun_path))
+    {
+      fprintf(stderr, "socket path too long: %s\n", address);
+      return false;
+    }
+    strcpy(un.sun_path, address);
+    strcpy(server->path, address);
+    unlink(address); // left behind by a server that did not stop cleanly
+    server->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listenFd < 0 || bind(server->listenFd, (struct sockaddr *)&un, sizeof(un)) != 0)
+    {
+      perror("could not bind the socket");
+      return false;
+    }
+  }
+  else
+  {
+    struct sockaddr_in in = {0};
+    int reuse = 1;
+    in.sin_family = AF_INET;
+    in.sin_port = htons((uint16_t)port);
+    in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server->listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listenFd < 0 || setsockopt(server->listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(server->listenFd, (struct sockaddr *)&in, sizeof(in)) != 0)
+    {
+      perror("could not bind the socket");
+      return false;
+    }
+  }
+  if (listen(server->listenFd, SOMAXCONN) != 0)
+  {
+    perror("could not listen");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Runs the loader of a server, then wakes the event loop
+ *
+ * @param argument A pointer to the server
+ * @return NULL
+ */
+static void *runLoader(void *argument)
+{
+  Server *server = (Server *)argument;
+  uint64_t done = 1;
+
+  server->loaded = server->loader(&server->stores, server->loaderArgument);
+  if (write(server->loadedFd, &done, sizeof(done)) != sizeof(done))
+  {
+    perror("could not wake the event loop");
+  }
+  return NULL;
+}
+
+/**
+ * @brief Creates a server listening on an address, and starts the thread that loads its stores
+ *
+ * SIGINT and SIGTERM are blocked in the calling thread and taken by the event loop, so the server must be created
+ * before any other thread is started, or those threads must block them too; the loader thread blocks them already.
+ *
+ * @param address A port of the loopback address, like "7070", or the path of a Unix domain socket
+ * @param image The warm start image that answers the lookups until the stores are loaded, or NULL, closed by the
+ * server
+ * @param loader The function that builds the stores, no vehicle may be added or deleted once the server runs
+ * @param argument The argument of the loader
+ * @return A pointer to the server, or NULL if it could not listen or there was no memory
+ */
+Server *createServer(char *address, WarmImage *image, ServerLoader loader, void *argument)
+{
+  Server *server = (Server *)calloc(1, sizeof(Server));
+  if (server == NULL)
+  {
+    perror("could not allocate memory!");
+    closeWarmImage(image);
+    return NULL;
+  }
+  server->listenFd = server->epollFd = server->signalFd = server->loadedFd = -1;
+  server->image = image;
+  server->loader = loader;
+  server->loaderArgument = argument;
+  server->snapshot.fd = -1;
+
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGTERM);
+  struct epoll_event listenEvent = {.events = EPOLLIN, .data.ptr = &server->listenFd};
+  struct epoll_event signalEvent = {.events = EPOLLIN, .data.ptr = &server->signalFd};
+  struct epoll_event loadedEvent = {.events = EPOLLIN, .data.ptr = &server->loadedFd};
+  if (!listenServer(server, address) || pthread_sigmask(SIG_BLOCK, &set, NULL) != 0 ||
+      (server->signalFd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC)) < 0 ||
+      (server->loadedFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 ||
+      (server->epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+      epoll_ctl(server->epollFd, EPOLL_CTL_ADD, server->listenFd, &listenEvent) != 0 ||
+      epoll_ctl(server->epollFd, EPOLL_CTL_ADD, server->signalFd, &signalEvent) != 0 ||
+      epoll_ctl(server->epollFd, EPOLL_CTL_ADD, server->loadedFd, &loadedEvent) != 0)
+  {
+    if (server->listenFd >= 0 && server->epollFd < 0)
+      perror("could not start the event loop");
+    destroyServer(server);
+    return NULL;
+  }
+  if (pthread_create(&server->loaderThread, NULL, runLoader, server) != 0)
+  {
+    perror("could not start the loader thread");
+    destroyServer(server);
+    return NULL;
+  }
+  server->loading = true;
+  server->accepting = true;
+  return server;
+}
+
+/**
+ * @brief Closes a connection and starts accepting again if the server was full
+ *
+ * @param server A pointer to the server
+ * @param connection A pointer to the connection, freed
+ */
+static void closeConnection(Server *server, ServerConnection *connection)
+{
+  close(connection->fd); // also removes it from the epoll set
+  if (connection->previous != NULL)
+    connection->previous->next = connection->next;
+  else
+    server->connections = connection->next;
+  if (connection->next != NULL)
+    connection->next->previous = connection->previous;
+  free(connection);
+  server->connectionCount--;
+  server->stats.closed++;
+  if (!server->accepting && server->epollFd >= 0)
+  {
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = &server->listenFd};
+    server->accepting = epoll_ctl(server->epollFd, EPOLL_CTL_MOD, server->listenFd, &event) == 0;
+  }
+}
+
+/**
+ * @brief Accepts the connections waiting in the backlog
+ *
+ * @param server A pointer to the server
+ */
+static void acceptConnections(Server *server)
+{
+  while (server->connectionCount < SERVER_MAX_CONNECTIONS)
+  {
+    int fd = accept(server->listenFd, NULL, NULL);
+    if (fd < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED)
+        perror("could not accept a connection");
+      return;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    ServerConnection *connection = (ServerConnection *)malloc(sizeof(ServerConnection));
+    if (connection == NULL)
+    {
+      perror("could not allocate memory!");
+      close(fd);
+      return;
+    }
+    if (!server->isUnix)
+    {
+      int noDelay = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    connection->fd = fd;
+    connection->events = EPOLLIN;
+    connection->peerClosed = connection->closing = false;
+    connection->inputLength = connection->outputStart = connection->outputLength = 0;
+    struct epoll_event event = {.events = connection->events, .data.ptr = connection};
+    if (epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+      perror("could not add a connection");
+      close(fd);
+      free(connection);
+      continue;
+    }
+    connection->previous = NULL;
+    connection->next = server->connections;
+    if (server->connections != NULL)
+      server->connections->previous = connection;
+    server->connections = connection;
+    server->connectionCount++;
+    server->stats.accepted++;
+  }
+
+  // full, the next connections wait in the backlog until closeConnection listens again
+  struct epoll_event event = {.events = 0, .data.ptr = &server->listenFd};
+  if (epoll_ctl(server->epollFd, EPOLL_CTL_MOD, server->listenFd, &event) == 0)
+  {
+    server->accepting = false;
+    server->stats.full++;
+  }
+}
+
+/**
+ * @brief Answers the complete request lines of the input of a connection while its output has room
+ *
+ * @param server A pointer to the server
+ * @param connection A pointer to the connection
+ */
+static void answerRequests(Server *server, ServerConnection *connection)
+{
+  int start = 0;
+  while (!connection->closing && connection->outputLength <= SERVER_OUTPUT_HIGH)
+  {
+    if (connection->outputStart + connection->outputLength + COMMAND_RESPONSE_SIZE > (int)sizeof(connection->output))
+    {
+      memmove(connection->output, connection->output + connection->outputStart, connection->outputLength);
+      connection->outputStart = 0;
+    }
+    char *response = connection->output + connection->outputStart + connection->outputLength;
+    char *end = memchr(connection->input + start, '\n', connection->inputLength - start);
+    if (end == NULL)
+    {
+      if (start == 0 && connection->inputLength == SERVER_INPUT_SIZE)
+      {
+        // a line longer than the input buffer can never be answered
+        connection->outputLength += sprintf(response, "ERR request too long\n");
+        connection->closing = true;
+        connection->inputLength = 0;
+        server->stats.requests++;
+        server->stats.refused++;
+      }
+      break;
+    }
+    char *line = connection->input + start;
+
+    Command command;
+    size_t length;
+    parseCommand(line, end - line, &command);
+    if (server->ready)
+    {
+      length = executeCommand(&server->context, &command, response, COMMAND_RESPONSE_SIZE);
+    }
+    else if (server->image != NULL && (length = executeWarmCommand(server->image, &command, response,
+                                                                   COMMAND_RESPONSE_SIZE)) > 0)
+    {
+      server->stats.warm++;
+    }
+    else
+    {
+      // waits in the input until the stores are loaded, with the requests after it
+      break;
+    }
+    start = (int)(end - connection->input) + 1;
+    connection->outputLength += (int)length;
+    connection->closing = command.type == COMMAND_QUIT;
+    server->stats.requests++;
+    server->stats.refused += response[0] == 'E';
+  }
+
+  if (start > 0)
+  {
+    memmove(connection->input, connection->input + start, connection->inputLength - start);
+    connection->inputLength -= start;
+  }
+}
+
+/**
+ * @brief Sends the output of a connection until it is empty or the socket is full
+ *
+ * @param connection A pointer to the connection
+ * @return False if the connection failed and must be closed, true otherwise
+ */
+static bool sendResponses(ServerConnection *connection)
+{
+  while (connection->outputLength > 0)
+  {
+    ssize_t sent = send(connection->fd, connection->output + connection->outputStart, connection->outputLength,
+                        MSG_NOSIGNAL);
+    if (sent < 0)
+    {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    connection->outputStart += (int)sent;
+    connection->outputLength -= (int)sent;
+  }
+  connection->outputStart = 0;
+  return true;
+}
+
+/**
+ * @brief Handles the events of a connection: reads, answers and sends, then updates its epoll interest
+ *
+ * @param server A pointer to the server
+ * @param connection A pointer to the connection
+ * @param events The events epoll reported
+ */
+static void serveConnection(Server *server, ServerConnection *connection, uint32_t events)
+{
+  if (events & EPOLLERR)
+  {
+    closeConnection(server, connection);
+    return;
+  }
+  if ((events & (EPOLLIN | EPOLLHUP)) && connection->inputLength < SERVER_INPUT_SIZE && !connection->peerClosed)
+  {
+    ssize_t received = recv(connection->fd, connection->input + connection->inputLength,
+                            SERVER_INPUT_SIZE - connection->inputLength, 0);
+    if (received == 0)
+    {
+      connection->peerClosed = true;
+    }
+    else if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+      closeConnection(server, connection);
+      return;
+    }
+    else if (received > 0)
+    {
+      connection->inputLength += (int)received;
+    }
+  }
+
+  // answering and sending alternate while the socket takes responses, so a connection paused by backpressure
+  // answers the requests it buffered as soon as the client reads
+  while (true)
+  {
+    answerRequests(server, connection);
+    int pending = connection->outputLength;
+    if (!sendResponses(connection))
+    {
+      closeConnection(server, connection);
+      return;
+    }
+    if (connection->outputLength == pending || connection->closing)
+      break;
+  }
+
+  // the requests of a client that shut down its side while the stores were loaded are still answered
+  bool done = connection->closing || (connection->peerClosed && server->ready);
+  if (done && connection->outputLength == 0)
+  {
+    closeConnection(server, connection);
+    return;
+  }
+
+  uint32_t wanted = 0;
+  bool isReading = (connection->events & EPOLLIN) != 0;
+  int resumeAt = isReading ? SERVER_OUTPUT_HIGH : SERVER_OUTPUT_LOW;
+  if (!done && !connection->peerClosed && connection->inputLength < SERVER_INPUT_SIZE &&
+      connection->outputLength <= resumeAt)
+    wanted |= EPOLLIN;
+  if (connection->outputLength > 0)
+    wanted |= EPOLLOUT;
+  if (wanted != connection->events)
+  {
+    if (isReading && !(wanted & EPOLLIN) && !done && !connection->peerClosed)
+      server->stats.paused++;
+    struct epoll_event event = {.events = wanted, .data.ptr = connection};
+    epoll_ctl(server->epollFd, EPOLL_CTL_MOD, connection->fd, &event);
+    connection->events = wanted;
+  }
+}
+
+/**
+ * @brief Moves the rents of the engine into the rent store, ends the expired ones and syncs the write-ahead log,
+ * between two turns
+ *
+ * @param server A pointer to the server
+ */
+static void commitRents(Server *server)
+{
+  if (!server->ready)
+  {
+    return;
+  }
+  int expired;
+  server->collected += settleRents(&server->context, time(NULL), &expired);
+  server->stats.expired += expired;
+  if (server->rentStore->log != NULL)
+  {
+    rentLogSync(server->rentStore->log);
+  }
+}
+
+/**
+ * @brief Collects the background snapshot that finished, and starts the next one when it is due, between two turns
+ *
+ * The snapshot starts right after the rents of the turn were moved into the rent store and logged, so it holds every
+ * record of the log up to RentStore.sequence, and those records are cut from the log once it is written. A failed
+ * snapshot leaves the log whole.
+ *
+ * @param server A pointer to the server
+ */
+static void snapshotStores(Server *server)
+{
+  if (!server->ready)
+  {
+    return;
+  }
+  SnapshotReport report;
+  if (snapshotFinished(&server->snapshot, &report))
+  {
+    RentLog *log = server->rentStore->log;
+    if (report.ok && (log == NULL || rentLogTrim(log, server->snapshotSequence)))
+      server->stats.snapshots++;
+    else
+      server->stats.snapshotsFailed++;
+  }
+
+  time_t now = time(NULL);
+  if (server->snapshot.pid != 0 || now < server->nextSnapshot)
+  {
+    return;
+  }
+  server->nextSnapshot = now + SERVER_SNAPSHOT_SECONDS;
+
+  // the child gets its own copy of the list, the one of the server is freed once it is started
+  UserList *users = NULL;
+  userStoreToList(server->context.userStore, &users);
+  server->snapshotSequence = server->rentStore->sequence;
+  if (!startSnapshot(&server->snapshot, SNAPSHOT_DIRECTORY, users, server->context.vehicles, server->rentStore, NULL))
+  {
+    server->stats.snapshotsFailed++;
+  }
+  while (users != NULL)
+  {
+    UserList *next = users->next;
+    memFree(MEM_USERS, users);
+    users = next;
+  }
+}
+
+/**
+ * @brief Waits for the loader thread that signaled it is done, and hands its stores to the command context
+ *
+ * The warm start image is closed, and the requests that waited for the stores are answered.
+ *
+ * @param server A pointer to the server
+ * @return True if the stores were loaded, false if the loader failed or there was no memory
+ */
+static bool finishLoading(Server *server)
+{
+  pthread_join(server->loaderThread, NULL);
+  server->loading = false;
+  epoll_ctl(server->epollFd, EPOLL_CTL_DEL, server->loadedFd, NULL);
+  closeWarmImage(server->image);
+  server->image = NULL;
+  if (!server->loaded || !initCommandContext(&server->context, server->stores.vehicles, server->stores.userStore,
+                                             server->stores.graph, server->stores.rentStore))
+  {
+    return false;
+  }
+  server->rentStore = server->stores.rentStore;
+  server->ready = true;
+  server->nextSnapshot = time(NULL) + SERVER_SNAPSHOT_SECONDS;
+
+  ServerConnection *next;
+  for (ServerConnection *connection = server->connections; connection != NULL; connection = next)
+  {
+    next = connection->next;
+    serveConnection(server, connection, 0);
+  }
+  return true;
+}
+
+/**
+ * @brief Runs the event loop until SIGINT or SIGTERM
+ *
+ * The connections still open when the loop stops are closed by destroyServer.
+ *
+ * @param server A pointer to the server
+ * @return True if the loop was stopped by a signal, false if epoll failed or the stores could not be loaded
+ */
+bool runServer(Server *server)
+{
+  struct epoll_event events[SERVER_EVENTS];
+
+  while (true)
+  {
+    int count = epoll_wait(server->epollFd, events, SERVER_EVENTS, SERVER_TICK_MS);
+    if (count < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("could not wait for events");
+      return false;
+    }
+    for (int i = 0; i < count; i++)
+    {
+      if (events[i].data.ptr == &server->signalFd)
+      {
+        struct signalfd_siginfo info;
+        while (read(server->signalFd, &info, sizeof(info)) == sizeof(info))
+          ;
+        return true;
+      }
+      else if (events[i].data.ptr == &server->listenFd)
+      {
+        acceptConnections(server);
+      }
+      else if (events[i].data.ptr == &server->loadedFd)
+      {
+        if (!finishLoading(server))
+        {
+          fprintf(stderr, "could not load the stores\n");
+          return false;
+        }
+      }
+      else
+      {
+        serveConnection(server, (ServerConnection *)events[i].data.ptr, events[i].events);
+      }
+    }
+    commitRents(server);
+    snapshotStores(server);
+  }
+}
+
+/**
+ * @brief Closes the server and its connections, and moves the rents of the engine still left into the rent store
+ *
+ * A loader thread still running is waited for, so the caller may use or free the stores it built. A background
+ * snapshot still running is waited for too, so the snapshot the caller takes next does not write the same files at
+ * the same time.
+ *
+ * @param server A pointer to the server
+ * @return The number of rents the server added to the rent store
+ */
+int destroyServer(Server *server)
+{
+  if (server == NULL)
+  {
+    return 0;
+  }
+  while (server->connections != NULL)
+  {
+    closeConnection(server, server->connections);
+  }
+  if (server->epollFd >= 0)
+    close(server->epollFd);
+  if (server->signalFd >= 0)
+    close(server->signalFd);
+  if (server->loading)
+    pthread_join(server->loaderThread, NULL);
+  if (server->loadedFd >= 0)
+    close(server->loadedFd);
+  closeWarmImage(server->image);
+  if (server->listenFd >= 0)
+  {
+    close(server->listenFd);
+    if (server->isUnix)
+      unlink(server->path);
+  }
+  SnapshotReport report;
+  if (server->snapshot.pid != 0 && waitSnapshot(&server->snapshot, &report))
+  {
+    server->stats.snapshots++;
+  }
+  int collected = server->collected;
+  if (server->ready)
+  {
+    collected += settleRents(&server->context, time(NULL), NULL);
+    freeCommandContext(&server->context);
+  }
+  free(server);
+  return collected;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file server.h
+ * @brief File containing the event-loop server of the rental, search, wallet and routing operations
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include "./commands.h"
+#include "./rentals.h"
+#include "./snapshot.h"
+#include "./warmstart.h"
+#pragma once
+
+#define SERVER_ADDRESS "./saved-data/server.sock"
+#define SERVER_MAX_CONNECTIONS 1024
+#define SERVER_EVENTS 64
+#define SERVER_INPUT_SIZE 16384   // a request line must fit, a longer one closes the connection
+#define SERVER_OUTPUT_HIGH 65536  // a connection with this many response bytes unsent stops being read
+#define SERVER_OUTPUT_LOW 16384   // and is read again once they drop to this many
+#define SERVER_TICK_MS 1000       // longest wait of the event loop, the rents that are over expire between turns
+#define SERVER_SNAPSHOT_SECONDS 60 // a background snapshot of the stores is started this often
+
+typedef struct ServerConnection ServerConnection;
+
+typedef struct ServerStores // built by the loader of the server
+{
+  VehicleList *vehicles;
+  UserStore *userStore;
+  RentStore *rentStore;
+  Vertex *graph;
+} ServerStores;
+
+typedef bool (*ServerLoader)(ServerStores *stores, void *argument); // runs on its own thread, true if it built them
+
+struct ServerConnection
+{
+  int fd;
+  uint32_t events; // the epoll interest of the connection
+  bool peerClosed; // the client shut down its side, the responses of its requests are still sent
+  bool closing;    // close once the output is sent, after QUIT or a line that is too long
+  int inputLength;
+  int outputStart;
+  int outputLength;
+  char input[SERVER_INPUT_SIZE];
+  char output[SERVER_OUTPUT_HIGH + COMMAND_RESPONSE_SIZE];
+  ServerConnection *next; // list of the open connections of the server
+  ServerConnection *previous;
+};
+
+typedef struct ServerStats
+{
+  long long requests;
+  long long refused;  // requests answered with ERR
+  long long accepted; // connections
+  long long closed;
+  long long paused; // times a connection stopped being read because its responses were not being taken
+  long long full;   // times the server stopped accepting because it had SERVER_MAX_CONNECTIONS
+  long long expired; // rents ended because their time was over
+  long long warm;    // requests answered from the warm start image while the stores were loaded
+  long long snapshots;       // background snapshots written
+  long long snapshotsFailed; // background snapshots that failed, the log keeps their records
+} ServerStats;
+
+typedef struct Server
+{
+  int listenFd;
+  int epollFd;
+  int signalFd; // SIGINT and SIGTERM stop the loop
+  bool isUnix;
+  char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+  bool accepting;
+  ServerConnection *connections;
+  int connectionCount;
+  WarmImage *image;         // answers the lookups while the stores are loaded, or NULL
+  ServerLoader loader;
+  void *loaderArgument;
+  pthread_t loaderThread;
+  int loadedFd;             // eventfd the loader thread signals once it is done
+  bool loading;             // the loader thread runs, the requests the image cannot answer wait
+  bool loaded;              // the loader built the stores
+  bool ready;               // the context has the stores and runs the requests
+  ServerStores stores;
+  CommandContext context;
+  RentStore *rentStore;     // receives the rents of the context after every turn of the loop
+  int collected;            // rents moved into the rent store so far
+  Snapshot snapshot;        // background snapshot of the users, vehicles and rents, at most one at a time
+  int64_t snapshotSequence; // number of the last log record the running snapshot holds
+  time_t nextSnapshot;
+  ServerStats stats;
+} Server;
+
+Server *createServer(char *address, WarmImage *image, ServerLoader loader, void *argument);
+bool runServer(Server *server);
+int destroyServer(Server *server);
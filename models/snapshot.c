@@ -0,0 +1,478 @@
+/**
+ * @file snapshot.c
+ * @brief File containing the functions to save every store in the background
+ *
+ * This file contains the implementation of the background snapshots. startSnapshot forks the process: the child
+ * gets a copy-on-write view of the users, vehicles, rents and graph as they were at the fork, writes every store
+ * to temporary files, syncs them and renames them over the previous ones, while the parent returns at once and
+ * keeps changing its own copy of the lists. The child sends its report through a pipe, which the parent collects
+ * with snapshotFinished, between requests, or with waitSnapshot.
+ *
+ * Every file is written to a temporary and synced, and listed in a manifest. Renaming the manifest into place commits
+ * the snapshot, and only then are the files renamed over the previous ones and the manifest removed. A snapshot that
+ * fails before the commit leaves the previous one untouched; a crash after it leaves the manifest, and
+ * recoverSnapshot, run before anything reads the directory, renames the rest, so the files are never a mix of two
+ * snapshots. The compressed edge file is written with the adjacency lists, so both always hold the same roads. The
+ * warm start image is part of the snapshot, so a restart can map it instead of rebuilding the stores, and renaming it
+ * does not disturb a process that still has the previous image mapped.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "./warmstart.h"
+#include "./edgecodec.h"
+#include "./snapshot.h"
+#include "./metrics.h"
+#include "./trace.h"
+
+#define SNAPSHOT_PATH_SIZE 512
+
+/**
+ * @brief Gets the current time in seconds from a monotonic clock
+ *
+ * @return The current time in seconds
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Builds the path of a file of the snapshot
+ *
+ * @param path Receives the path, with room for SNAPSHOT_PATH_SIZE bytes
+ * @param directory The directory of the snapshot
+ * @param name The name of the file in the directory
+ * @param temporary True for the temporary file that is renamed over the final one
+ * @return True if the path fits, false otherwise
+ */
+static bool snapshotPath(char *path, char *directory, char *name, bool temporary)
+{
+  int length = snprintf(path, SNAPSHOT_PATH_SIZE, "%s/%s%s", directory, name, temporary ? ".tmp" : "");
+  if (length < 0 || length >= SNAPSHOT_PATH_SIZE)
+  {
+    fprintf(stderr, "the path of %s in %s is too long\n", name, directory);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Flushes a directory, making the renames and removals in it durable
+ *
+ * @param path The path of the directory
+ * @return True if the directory was synced, false otherwise
+ */
+static bool syncDirectory(char *path)
+{
+  int fd = open(path, O_RDONLY);
+  bool synced = fd >= 0 && fsync(fd) == 0;
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  return synced;
+}
+
+/**
+ * @brief Flushes a temporary file of the snapshot to disk, adds its size to the report and lists it in the manifest
+ *
+ * @param directory The directory of the snapshot
+ * @param name The name of the file in the directory
+ * @param manifest The manifest being written
+ * @param report A pointer to the report
+ * @return True if the file was synced and listed, false otherwise
+ */
+static bool addFile(char *directory, char *name, FILE *manifest, SnapshotReport *report)
+{
+  char path[SNAPSHOT_PATH_SIZE];
+  if (!snapshotPath(path, directory, name, true))
+  {
+    return false;
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat info;
+  bool synced = fstat(fd, &info) == 0 && fsync(fd) == 0;
+  close(fd);
+  if (!synced || fprintf(manifest, "%s\n", name) < 0)
+  {
+    return false;
+  }
+  report->bytes += info.st_size;
+  report->files++;
+  return true;
+}
+
+/**
+ * @brief Writes and syncs the temporary files of the graph, listing each one in the manifest
+ *
+ * @param directory The directory of the snapshot
+ * @param graph A pointer to the head of the graph
+ * @param manifest The manifest being written
+ * @param report A pointer to the report that receives the sizes of the files
+ * @return True if every file was written, false otherwise
+ */
+static bool writeGraphFiles(char *directory, Vertex *graph, FILE *manifest, SnapshotReport *report)
+{
+  char path[SNAPSHOT_PATH_SIZE];
+
+  if (!snapshotPath(path, directory, "vertex-adj", false) || (mkdir(path, 0755) != 0 && errno != EEXIST))
+  {
+    perror("could not create the adjacency directory");
+    return false;
+  }
+  if (!snapshotPath(path, directory, "Vertexs.bin", true) || saveVertices(graph, path) < 0 ||
+      !addFile(directory, "Vertexs.bin", manifest, report))
+  {
+    return false;
+  }
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+  {
+    if (vertex->adjacents != NULL)
+    {
+      char name[SNAPSHOT_PATH_SIZE];
+      snprintf(name, sizeof(name), "vertex-adj/%.*s.bin", N, vertex->city);
+      if (!snapshotPath(path, directory, name, true) || saveAdj(vertex->adjacents, path, vertex->cod) < 0 ||
+          !addFile(directory, name, manifest, report))
+      {
+        return false;
+      }
+    }
+  }
+
+  // the same roads as vertex-adj, in the file the loaders read first
+  return snapshotPath(path, directory, "edges.bin", true) && saveGraphEdges(graph, path) &&
+         addFile(directory, "edges.bin", manifest, report);
+}
+
+/**
+ * @brief Writes and syncs the temporary files of every store, listing each one in the manifest
+ *
+ * @param directory The directory of the snapshot
+ * @param users A pointer to the head node of the user list
+ * @param vehicles A pointer to the head node of the vehicle list
+ * @param rentStore A pointer to the rent store, or NULL to leave the rents out
+ * @param graph A pointer to the head of the graph, or NULL to leave the graph out
+ * @param manifest The manifest being written
+ * @param report A pointer to the report that receives the sizes of the files
+ * @return True if every file was written, false otherwise
+ */
+static bool writeFiles(char *directory, UserList *users, VehicleList *vehicles, RentStore *rentStore, Vertex *graph,
+                       FILE *manifest, SnapshotReport *report)
+{
+  char path[SNAPSHOT_PATH_SIZE];
+  char seqPath[SNAPSHOT_PATH_SIZE];
+
+  if (!snapshotPath(path, directory, "users.bin", true) || !storeUsersInFile(users, path) ||
+      !addFile(directory, "users.bin", manifest, report))
+  {
+    return false;
+  }
+
+  if (!snapshotPath(path, directory, "vehicles.bin", true) || !storeVehicleListInFile(vehicles, path) ||
+      !addFile(directory, "vehicles.bin", manifest, report))
+  {
+    return false;
+  }
+
+  if (rentStore != NULL)
+  {
+    if (!snapshotPath(path, directory, "rents.bin", true) || !snapshotPath(seqPath, directory, "rents-seq.bin", true) ||
+        !storeRentsInFile(rentStore, path, seqPath) || !addFile(directory, "rents.bin", manifest, report) ||
+        !addFile(directory, "rents-seq.bin", manifest, report))
+    {
+      return false;
+    }
+  }
+
+  if (graph != NULL && !writeGraphFiles(directory, graph, manifest, report))
+  {
+    return false;
+  }
+
+  // written last, with the generation storeRentsInFile just gave the rent files
+  return snapshotPath(path, directory, "warm.img", true) && writeWarmImage(path, users, vehicles, rentStore, graph) &&
+         addFile(directory, "warm.img", manifest, report);
+}
+
+/**
+ * @brief Renames every temporary file listed in the manifest over the previous snapshot, then removes the manifest
+ *
+ * A file whose temporary is gone was already renamed, so this can run again after a crash in the middle of it.
+ *
+ * @param directory The directory of the snapshot
+ * @return True if every file was renamed and the manifest removed, false otherwise
+ */
+static bool applyManifest(char *directory)
+{
+  char manifestPath[SNAPSHOT_PATH_SIZE];
+  char name[SNAPSHOT_PATH_SIZE];
+  char temporary[SNAPSHOT_PATH_SIZE];
+  char path[SNAPSHOT_PATH_SIZE];
+
+  if (!snapshotPath(manifestPath, directory, SNAPSHOT_MANIFEST, false))
+  {
+    return false;
+  }
+  FILE *manifest = fopen(manifestPath, "r");
+  if (manifest == NULL)
+  {
+    perror("could not open the snapshot manifest");
+    return false;
+  }
+
+  bool committed = true;
+  bool hasAdjacents = false;
+  while (committed && fgets(name, sizeof(name), manifest) != NULL)
+  {
+    name[strcspn(name, "\n")] = '\0';
+    committed = snapshotPath(temporary, directory, name, true) && snapshotPath(path, directory, name, false);
+    if (committed && rename(temporary, path) != 0 && errno != ENOENT)
+    {
+      perror("could not replace the snapshot file");
+      committed = false;
+    }
+    hasAdjacents = hasAdjacents || strncmp(name, "vertex-adj/", 11) == 0;
+  }
+  fclose(manifest);
+
+  if (committed && hasAdjacents)
+  {
+    committed = snapshotPath(path, directory, "vertex-adj", false) && syncDirectory(path);
+  }
+  // the renames must be durable before the manifest that redoes them is gone
+  committed = committed && syncDirectory(directory) && unlink(manifestPath) == 0 && syncDirectory(directory);
+  return committed;
+}
+
+/**
+ * @brief Finishes a snapshot that was committed but not yet renamed into place when the process stopped
+ *
+ * Must run before the files of the directory are read. The temporary files of a snapshot that never reached its
+ * commit are left, the next snapshot overwrites them.
+ *
+ * @param directory The directory of the snapshot
+ * @return True if the directory holds a whole snapshot, false if the pending one could not be finished
+ */
+bool recoverSnapshot(char *directory)
+{
+  char path[SNAPSHOT_PATH_SIZE];
+  if (!snapshotPath(path, directory, SNAPSHOT_MANIFEST, false))
+  {
+    return false;
+  }
+  if (access(path, F_OK) != 0)
+  {
+    return true;
+  }
+  return applyManifest(directory);
+}
+
+/**
+ * @brief Commits the snapshot: puts its manifest in place, then renames the files it lists
+ *
+ * The rename of the manifest is the commit point. Before it, the previous snapshot is untouched; after it, a crash
+ * leaves the manifest, and recoverSnapshot renames the rest of the files.
+ *
+ * @param directory The directory of the snapshot
+ * @param manifest The manifest, already listing every file
+ * @return True if the snapshot was committed and every file renamed, false otherwise
+ */
+static bool commitFiles(char *directory, FILE *manifest)
+{
+  char temporary[SNAPSHOT_PATH_SIZE];
+  char path[SNAPSHOT_PATH_SIZE];
+
+  bool written = fflush(manifest) == 0 && fsync(fileno(manifest)) == 0;
+  if (!written || !snapshotPath(temporary, directory, SNAPSHOT_MANIFEST, true) ||
+      !snapshotPath(path, directory, SNAPSHOT_MANIFEST, false) || rename(temporary, path) != 0 ||
+      !syncDirectory(directory))
+  {
+    perror("could not commit the snapshot");
+    return false;
+  }
+  return applyManifest(directory);
+}
+
+/**
+ * @brief Writes every store to a directory, replacing the previous snapshot
+ *
+ * The files have the names used by the stores in saved-data, so SNAPSHOT_DIRECTORY replaces the files read at
+ * start up. This is what the child of startSnapshot runs, and it can also be called directly to save in the
+ * foreground.
+ *
+ * @param directory The directory of the snapshot, which must exist
+ * @param users A pointer to the head node of the user list
+ * @param vehicles A pointer to the head node of the vehicle list
+ * @param rentStore A pointer to the rent store, or NULL to leave the rents out
+ * @param graph A pointer to the head of the graph, or NULL to leave the graph out
+ * @param report A pointer to the report that receives the duration and the bytes written
+ * @return True if the snapshot was written, false otherwise
+ */
+bool writeSnapshot(char *directory, UserList *users, VehicleList *vehicles, RentStore *rentStore, Vertex *graph, SnapshotReport *report)
+{
+  METRIC_SCOPE(METRIC_WRITE_SNAPSHOT);
+  TRACE_FUNCTION();
+  double start = now();
+
+  memset(report, 0, sizeof(SnapshotReport));
+  char path[SNAPSHOT_PATH_SIZE];
+  // a snapshot committed before a crash is finished first, its files must not be mixed with the new ones
+  if (!recoverSnapshot(directory) || !snapshotPath(path, directory, SNAPSHOT_MANIFEST, true))
+  {
+    report->seconds = now() - start;
+    return false;
+  }
+  FILE *manifest = fopen(path, "w");
+  if (manifest == NULL)
+  {
+    perror("could not create the snapshot manifest");
+    report->seconds = now() - start;
+    return false;
+  }
+  report->ok = writeFiles(directory, users, vehicles, rentStore, graph, manifest, report) &&
+               commitFiles(directory, manifest);
+  fclose(manifest);
+  report->seconds = now() - start;
+  return report->ok;
+}
+
+/**
+ * @brief Starts writing a snapshot of every store in a child process
+ *
+ * The snapshot holds the lists as they are when this function is called; changes made after it returns are left
+ * for the next one. Like the stores themselves, it must be called from the thread that owns the lists, and only
+ * one snapshot runs at a time.
+ *
+ * @param snapshot A pointer to the snapshot, zeroed before the first use
+ * @param directory The directory of the snapshot, which must exist
+ * @param users A pointer to the head node of the user list
+ * @param vehicles A pointer to the head node of the vehicle list
+ * @param rentStore A pointer to the rent store, or NULL to leave the rents out
+ * @param graph A pointer to the head of the graph, or NULL to leave the graph out
+ * @return True if the child was started, false if a snapshot is already running or the fork failed
+ */
+bool startSnapshot(Snapshot *snapshot, char *directory, UserList *users, VehicleList *vehicles, RentStore *rentStore, Vertex *graph)
+{
+  if (snapshot->pid != 0)
+  {
+    return false;
+  }
+
+  int fds[2];
+  if (pipe(fds) != 0)
+  {
+    perror("could not create the snapshot pipe");
+    return false;
+  }
+
+  // anything still buffered would be written again by the child
+  fflush(stdout);
+  fflush(stderr);
+
+  double start = now();
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    perror("could not start the snapshot");
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0)
+  {
+    SnapshotReport report;
+    close(fds[0]);
+    writeSnapshot(directory, users, vehicles, rentStore, graph, &report);
+    bool sent = write(fds[1], &report, sizeof(report)) == sizeof(report);
+    _exit(report.ok && sent ? 0 : 1);
+  }
+
+  snapshot->forkSeconds = now() - start;
+  close(fds[1]);
+  snapshot->pid = pid;
+  snapshot->fd = fds[0];
+  return true;
+}
+
+/**
+ * @brief Reads the report of a child that exited
+ *
+ * @param snapshot A pointer to the snapshot
+ * @param status The exit status of the child
+ * @param report A pointer to the report that receives the one of the child
+ */
+static void collectReport(Snapshot *snapshot, int status, SnapshotReport *report)
+{
+  if (read(snapshot->fd, report, sizeof(SnapshotReport)) != sizeof(SnapshotReport))
+  {
+    memset(report, 0, sizeof(SnapshotReport));
+  }
+  report->ok = report->ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  close(snapshot->fd);
+  snapshot->pid = 0;
+  snapshot->fd = -1;
+}
+
+/**
+ * @brief Checks, without waiting, if the running snapshot is done
+ *
+ * @param snapshot A pointer to the snapshot
+ * @param report A pointer to the report that receives the duration and the bytes written
+ * @return True if a snapshot finished and the report was filled, false if it is still running or none was started
+ */
+bool snapshotFinished(Snapshot *snapshot, SnapshotReport *report)
+{
+  int status;
+
+  if (snapshot->pid == 0 || waitpid(snapshot->pid, &status, WNOHANG) != snapshot->pid)
+  {
+    return false;
+  }
+  collectReport(snapshot, status, report);
+  return true;
+}
+
+/**
+ * @brief Waits for the running snapshot to finish
+ *
+ * @param snapshot A pointer to the snapshot
+ * @param report A pointer to the report that receives the duration and the bytes written
+ * @return True if the snapshot was written, false if it failed or none was started
+ */
+bool waitSnapshot(Snapshot *snapshot, SnapshotReport *report)
+{
+  int status;
+
+  if (snapshot->pid == 0)
+  {
+    return false;
+  }
+  while (waitpid(snapshot->pid, &status, 0) < 0)
+  {
+    if (errno != EINTR)
+    {
+      perror("could not wait for the snapshot");
+      return false;
+    }
+  }
+  collectReport(snapshot, status, report);
+  return report->ok;
+}
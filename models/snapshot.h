@@ -0,0 +1,38 @@
+/**
+ * @file snapshot.h
+ * @brief File containing the functions to save every store in the background
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "./user.h"
+#include "./vehicle.h"
+#include "./rentals.h"
+#include "./routes.h"
+#pragma once
+
+#define SNAPSHOT_DIRECTORY "./saved-data"
+#define SNAPSHOT_MANIFEST "snapshot.commit" // in the directory while a committed snapshot is being renamed into place
+
+typedef struct SnapshotReport
+{
+  bool ok;          // every file was written, synced and renamed
+  double seconds;   // time the child took, from the fork to the last rename
+  long long bytes;  // bytes of the files written
+  int files;
+} SnapshotReport;
+
+typedef struct Snapshot
+{
+  pid_t pid;           // child writing the snapshot, 0 when none is running
+  int fd;              // read end of the pipe that receives the report of the child
+  double forkSeconds;  // time the serving process spent in fork
+} Snapshot;
+
+bool recoverSnapshot(char *directory);
+bool writeSnapshot(char *directory, UserList *users, VehicleList *vehicles, RentStore *rentStore, Vertex *graph, SnapshotReport *report);
+bool startSnapshot(Snapshot *snapshot, char *directory, UserList *users, VehicleList *vehicles, RentStore *rentStore, Vertex *graph);
+bool snapshotFinished(Snapshot *snapshot, SnapshotReport *report);
+bool waitSnapshot(Snapshot *snapshot, SnapshotReport *report);
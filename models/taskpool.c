@@ -0,0 +1,530 @@
+/**
+ * @file taskpool.c
+ * @brief File containing the work-stealing thread pool that runs batches of independent tasks
+ *
+ * A batch calls a function once for every index of a range. It starts as a single task with the whole range, which
+ * the worker that takes it splits in halves, pushing the upper half onto its own deque and going on with the lower
+ * one until a task is no larger than the grain of the batch. The deques are Chase-Lev deques: the owner pushes and
+ * pops at the bottom without locks, while idle workers steal from the top of a random victim with a compare-and-swap,
+ * so they take the largest halves left and split them in turn. A batch submitted from a thread that is not a worker
+ * goes through a small queue under the lock of the pool, the only lock on the way of a task.
+ *
+ * Workers that find no task after TASK_SPIN_ROUNDS rounds sleep on a condition variable, and a worker that pushes a
+ * task wakes one of them. A worker that waits for a batch runs tasks in the meantime instead of blocking, so batches
+ * can be submitted from inside a task.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "./taskpool.h"
+#include "./trace.h"
+
+static __thread TaskWorker *currentWorker = NULL; // worker of the calling thread, NULL outside the pools
+
+/**
+ * @brief Writes a task into a slot of a deque, a field at a time so a thief reading the slot never races with it
+ *
+ * @param slot The slot
+ * @param task The task
+ */
+static void storeTask(Task *slot, Task task)
+{
+  __atomic_store_n(&slot->batch, task.batch, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->begin, task.begin, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->end, task.end, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Reads a task from a slot of a deque, a thief keeps it only if its compare-and-swap on top succeeds after
+ *
+ * @param slot The slot
+ * @return The task
+ */
+static Task loadTask(Task *slot)
+{
+  Task task;
+  task.batch = __atomic_load_n(&slot->batch, __ATOMIC_RELAXED);
+  task.begin = __atomic_load_n(&slot->begin, __ATOMIC_RELAXED);
+  task.end = __atomic_load_n(&slot->end, __ATOMIC_RELAXED);
+  return task;
+}
+
+/**
+ * @brief Pushes a task at the bottom of a deque, only called by its owner
+ *
+ * @param deque The deque
+ * @param task The task
+ * @return True if the task was pushed, false if the deque is full
+ */
+static bool pushTask(TaskDeque *deque, Task task)
+{
+  long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+  long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+  if (bottom - top >= TASK_DEQUE_SIZE)
+    return false;
+  storeTask(&deque->tasks[bottom & (TASK_DEQUE_SIZE - 1)], task);
+  __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE); // publishes the task to the thieves
+  return true;
+}
+
+/**
+ * @brief Pops the task at the bottom of a deque, only called by its owner
+ *
+ * @param deque The deque
+ * @param task Receives the task
+ * @return True if there was a task, false if the deque is empty or a thief took its last task
+ */
+static bool popTask(TaskDeque *deque, Task *task)
+{
+  long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  long top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+  if (top > bottom)
+  {
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return false;
+  }
+  *task = loadTask(&deque->tasks[bottom & (TASK_DEQUE_SIZE - 1)]);
+  if (top == bottom)
+  {
+    // the last task, the thieves may be after it too
+    bool isTaken = __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return isTaken;
+  }
+  return true;
+}
+
+/**
+ * @brief Steals the task at the top of a deque
+ *
+ * @param deque The deque of another worker
+ * @param task Receives the task
+ * @return True if a task was stolen, false if the deque is empty or another thread took the task first
+ */
+static bool stealTask(TaskDeque *deque, Task *task)
+{
+  long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+  if (top >= bottom)
+    return false;
+  *task = loadTask(&deque->tasks[top & (TASK_DEQUE_SIZE - 1)]);
+  return __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Checks if a deque has tasks, without taking any
+ *
+ * @param deque The deque
+ * @return True if the deque has tasks, false otherwise
+ */
+static bool hasTasks(TaskDeque *deque)
+{
+  return __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE) > __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Wakes a sleeping worker, if there is one, after a task was pushed
+ *
+ * The fence pairs with the one of a worker that is going to sleep: either the worker sees the new task, or the
+ * pusher sees the worker counted in sleeping and signals it under the lock.
+ *
+ * @param pool The pool
+ */
+static void wakeWorker(TaskPool *pool)
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&pool->sleeping, __ATOMIC_RELAXED) > 0)
+  {
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+/**
+ * @brief Adds a task to the queue of the tasks submitted from outside the workers, with the lock of the pool held
+ *
+ * @param pool The pool
+ * @param task The task
+ * @return True if the task was queued, false if there was no memory
+ */
+static bool injectTask(TaskPool *pool, Task task)
+{
+  if (pool->injectedCount == pool->injectedCapacity)
+  {
+    int capacity = pool->injectedCapacity * 2;
+    Task *injected = (Task *)malloc(capacity * sizeof(Task));
+    if (injected == NULL)
+    {
+      perror("could not allocate memory!");
+      return false;
+    }
+    for (int i = 0; i < pool->injectedCount; i++)
+      injected[i] = pool->injected[(pool->injectedHead + i) % pool->injectedCapacity];
+    free(pool->injected);
+    pool->injected = injected;
+    pool->injectedHead = 0;
+    pool->injectedCapacity = capacity;
+  }
+  pool->injected[(pool->injectedHead + pool->injectedCount) % pool->injectedCapacity] = task;
+  __atomic_store_n(&pool->injectedCount, pool->injectedCount + 1, __ATOMIC_RELAXED); // read without the lock by takeInjected
+  return true;
+}
+
+/**
+ * @brief Takes a task from the queue of the tasks submitted from outside the workers
+ *
+ * @param pool The pool
+ * @param task Receives the task
+ * @return True if there was a task, false otherwise
+ */
+static bool takeInjected(TaskPool *pool, Task *task)
+{
+  if (__atomic_load_n(&pool->injectedCount, __ATOMIC_RELAXED) == 0)
+    return false;
+  pthread_mutex_lock(&pool->lock);
+  bool isTaken = pool->injectedCount > 0;
+  if (isTaken)
+  {
+    *task = pool->injected[pool->injectedHead];
+    pool->injectedHead = (pool->injectedHead + 1) % pool->injectedCapacity;
+    __atomic_store_n(&pool->injectedCount, pool->injectedCount - 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return isTaken;
+}
+
+/**
+ * @brief Finds a task for a worker: from its own deque, then the injected ones, then from the other workers
+ *
+ * @param worker The worker
+ * @param task Receives the task
+ * @return True if a task was found, false otherwise
+ */
+static bool findTask(TaskWorker *worker, Task *task)
+{
+  TaskPool *pool = worker->pool;
+  if (popTask(&worker->deque, task) || takeInjected(pool, task))
+    return true;
+  int start = pool->workerCount > 1 ? rand_r(&worker->seed) % pool->workerCount : 0;
+  for (int i = 0; i < pool->workerCount; i++)
+  {
+    TaskWorker *victim = &pool->workers[(start + i) % pool->workerCount];
+    if (victim != worker && stealTask(&victim->deque, task))
+    {
+      worker->stolen++;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Runs a task, splitting it first until it is no larger than the grain of its batch
+ *
+ * @param worker The worker
+ * @param task The task
+ */
+static void runTask(TaskWorker *worker, Task task)
+{
+  TaskBatch *batch = task.batch;
+  while (task.end - task.begin > batch->grain)
+  {
+    int middle = task.begin + (task.end - task.begin) / 2;
+    if (!pushTask(&worker->deque, (Task){batch, middle, task.end}))
+      break; // the deque is full, the rest runs here
+    worker->splits++;
+    task.end = middle;
+    wakeWorker(worker->pool);
+  }
+
+  for (int i = task.begin; i < task.end; i++)
+    batch->function(batch->context, i);
+  worker->executed += task.end - task.begin;
+
+  if (__atomic_sub_fetch(&batch->remaining, task.end - task.begin, __ATOMIC_ACQ_REL) == 0)
+  {
+    pthread_mutex_lock(&batch->lock);
+    batch->finished = true;
+    pthread_cond_broadcast(&batch->done);
+    pthread_mutex_unlock(&batch->lock);
+  }
+}
+
+/**
+ * @brief Checks if a worker going to sleep would miss a task, with the lock of the pool held
+ *
+ * @param pool The pool
+ * @return True if there is a task somewhere or the pool is stopping, false otherwise
+ */
+static bool hasWork(TaskPool *pool)
+{
+  if (pool->stopping || pool->injectedCount > 0)
+    return true;
+  for (int i = 0; i < pool->workerCount; i++)
+    if (hasTasks(&pool->workers[i].deque))
+      return true;
+  return false;
+}
+
+/**
+ * @brief The thread of a worker: runs the tasks it finds and sleeps when there are none, until the pool stops
+ *
+ * @param arg A pointer to the TaskWorker
+ * @return NULL
+ */
+static void *runWorker(void *arg)
+{
+  TaskWorker *worker = (TaskWorker *)arg;
+  TaskPool *pool = worker->pool;
+  Task task;
+  int idle = 0;
+  currentWorker = worker;
+
+  while (true)
+  {
+    if (findTask(worker, &task))
+    {
+      runTask(worker, task);
+      idle = 0;
+      continue;
+    }
+    if (++idle < TASK_SPIN_ROUNDS)
+    {
+      sched_yield();
+      continue;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); // pairs with the one of wakeWorker
+    bool isStopping = pool->stopping;
+    if (!hasWork(pool))
+    {
+      TRACE_SCOPE("taskWorkerSleep");
+      worker->sleeps++;
+      pthread_cond_wait(&pool->wake, &pool->lock);
+      isStopping = pool->stopping;
+    }
+    __atomic_sub_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool->lock);
+    idle = 0;
+    if (isStopping)
+      break;
+  }
+  currentWorker = NULL;
+  return NULL;
+}
+
+/**
+ * @brief Stops the workers of a pool and waits for their threads to end
+ *
+ * @param pool The pool
+ * @param started The number of workers whose threads were started
+ */
+static void stopWorkers(TaskPool *pool, int started)
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i = 0; i < started; i++)
+    pthread_join(pool->workers[i].thread, NULL);
+}
+
+/**
+ * @brief Frees a pool whose workers were stopped
+ *
+ * @param pool The pool
+ */
+static void freeTaskPool(TaskPool *pool)
+{
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wake);
+  free(pool->injected);
+  free(pool->workers);
+  free(pool);
+}
+
+/**
+ * @brief Creates a pool and starts its workers
+ *
+ * @param workerCount The number of worker threads, usually the number of cores
+ * @return A pointer to the pool, or NULL if there was no memory or a thread could not be started
+ */
+TaskPool *createTaskPool(int workerCount)
+{
+  if (workerCount < 1)
+    return NULL;
+  TaskPool *pool = (TaskPool *)malloc(sizeof(TaskPool));
+  TaskWorker *workers = (TaskWorker *)aligned_alloc(64, workerCount * sizeof(TaskWorker));
+  Task *injected = (Task *)malloc(TASK_INJECTED_INITIAL * sizeof(Task));
+  if (pool == NULL || workers == NULL || injected == NULL)
+  {
+    perror("could not allocate memory!");
+    free(pool);
+    free(workers);
+    free(injected);
+    return NULL;
+  }
+  memset(pool, 0, sizeof(TaskPool));
+  memset(workers, 0, workerCount * sizeof(TaskWorker));
+  pool->workers = workers;
+  pool->injected = injected;
+  pool->injectedCapacity = TASK_INJECTED_INITIAL;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+
+  // the workers steal from each other from the start, so they are all set up before the first one runs
+  pool->workerCount = workerCount;
+  for (int i = 0; i < workerCount; i++)
+  {
+    workers[i].pool = pool;
+    workers[i].index = i;
+    workers[i].seed = 1234 + i;
+  }
+  for (int i = 0; i < workerCount; i++)
+  {
+    if (pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]) != 0)
+    {
+      perror("could not start a worker");
+      stopWorkers(pool, i);
+      freeTaskPool(pool);
+      return NULL;
+    }
+  }
+  return pool;
+}
+
+/**
+ * @brief Stops the workers of a pool and frees it, every batch submitted to it must have been waited for
+ *
+ * @param pool The pool, can be NULL
+ */
+void destroyTaskPool(TaskPool *pool)
+{
+  if (pool == NULL)
+    return;
+  stopWorkers(pool, pool->workerCount);
+  freeTaskPool(pool);
+}
+
+/**
+ * @brief Submits a batch of calls of a function, function(context, index) for every index from 0 to count - 1
+ *
+ * The calls run on the workers in no particular order, so they must not depend on each other. Every submitted batch
+ * must be waited for with waitTasks, which also releases it.
+ *
+ * @param pool The pool
+ * @param batch Receives the state of the batch, it must stay valid until waitTasks returns
+ * @param function The function
+ * @param context The first argument of every call
+ * @param count The number of calls
+ * @param grain The number of calls a task runs without splitting it further, at least 1
+ * @return True if the batch was submitted, false if there was no memory, the batch is then already finished
+ */
+bool submitTasks(TaskPool *pool, TaskBatch *batch, TaskFunction function, void *context, int count, int grain)
+{
+  batch->function = function;
+  batch->context = context;
+  batch->grain = grain > 0 ? grain : 1;
+  batch->remaining = count > 0 ? count : 0;
+  batch->finished = batch->remaining == 0;
+  pthread_mutex_init(&batch->lock, NULL);
+  pthread_cond_init(&batch->done, NULL);
+  if (batch->finished)
+    return true;
+
+  Task task = {batch, 0, count};
+  if (currentWorker != NULL && currentWorker->pool == pool && pushTask(&currentWorker->deque, task))
+  {
+    wakeWorker(pool);
+    return true;
+  }
+  pthread_mutex_lock(&pool->lock);
+  bool isInjected = injectTask(pool, task);
+  if (isInjected)
+    pthread_cond_signal(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  if (!isInjected)
+    batch->finished = true;
+  return isInjected;
+}
+
+/**
+ * @brief Waits until every call of a batch ran and releases the batch
+ *
+ * Called from a worker, it runs tasks until then instead of blocking the worker.
+ *
+ * @param pool The pool the batch was submitted to
+ * @param batch The batch
+ */
+void waitTasks(TaskPool *pool, TaskBatch *batch)
+{
+  TaskWorker *worker = currentWorker != NULL && currentWorker->pool == pool ? currentWorker : NULL;
+  Task task;
+  pthread_mutex_lock(&batch->lock);
+  while (!batch->finished)
+  {
+    if (worker != NULL)
+    {
+      pthread_mutex_unlock(&batch->lock);
+      if (findTask(worker, &task))
+        runTask(worker, task);
+      else
+        sched_yield();
+      pthread_mutex_lock(&batch->lock);
+    }
+    else
+    {
+      pthread_cond_wait(&batch->done, &batch->lock);
+    }
+  }
+  pthread_mutex_unlock(&batch->lock);
+  pthread_mutex_destroy(&batch->lock);
+  pthread_cond_destroy(&batch->done);
+}
+
+/**
+ * @brief Runs a batch of calls of a function on a pool and waits for them, see submitTasks
+ *
+ * @param pool The pool
+ * @param function The function
+ * @param context The first argument of every call
+ * @param count The number of calls
+ * @param grain The number of calls a task runs without splitting it further
+ * @return True if every call ran, false if there was no memory
+ */
+bool runTasks(TaskPool *pool, TaskFunction function, void *context, int count, int grain)
+{
+  TaskBatch batch;
+  bool isSubmitted = submitTasks(pool, &batch, function, context, count, grain);
+  waitTasks(pool, &batch);
+  return isSubmitted;
+}
+
+/**
+ * @brief Sums the counters of the workers of a pool, exact only while no batch is running
+ *
+ * @param pool The pool
+ * @param stats Receives the sums
+ */
+void readTaskPoolStats(TaskPool *pool, TaskPoolStats *stats)
+{
+  memset(stats, 0, sizeof(TaskPoolStats));
+  for (int i = 0; i < pool->workerCount; i++)
+  {
+    TaskWorker *worker = &pool->workers[i];
+    stats->executed += __atomic_load_n(&worker->executed, __ATOMIC_RELAXED);
+    stats->stolen += __atomic_load_n(&worker->stolen, __ATOMIC_RELAXED);
+    stats->splits += __atomic_load_n(&worker->splits, __ATOMIC_RELAXED);
+    stats->sleeps += __atomic_load_n(&worker->sleeps, __ATOMIC_RELAXED);
+  }
+}
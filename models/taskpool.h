@@ -0,0 +1,85 @@
+/**
+ * @file taskpool.h
+ * @brief File containing the work-stealing thread pool that runs batches of independent tasks
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <pthread.h>
+#pragma once
+
+#define TASK_DEQUE_SIZE 4096  // tasks a worker can hold, a power of two
+#define TASK_SPIN_ROUNDS 64   // rounds an idle worker looks for tasks before it sleeps
+#define TASK_INJECTED_INITIAL 64
+
+typedef void (*TaskFunction)(void *context, int index);
+
+typedef struct TaskBatch // calls of a function over a range of indexes, owned by the caller until waitTasks returns
+{
+  TaskFunction function;
+  void *context;
+  int grain;     // indexes a task runs without splitting it
+  int remaining; // indexes not run yet
+  bool finished; // set under the lock once remaining is 0
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+} TaskBatch;
+
+typedef struct Task // the indexes [begin, end) of a batch
+{
+  TaskBatch *batch;
+  int begin;
+  int end;
+} Task;
+
+typedef struct TaskDeque // Chase-Lev deque, the owner pushes and pops at the bottom and the thieves steal at the top
+{
+  _Alignas(64) long top;
+  _Alignas(64) long bottom;
+  Task tasks[TASK_DEQUE_SIZE];
+} TaskDeque;
+
+typedef struct TaskPool TaskPool;
+
+typedef struct TaskWorker
+{
+  _Alignas(64) TaskPool *pool;
+  pthread_t thread;
+  int index;
+  unsigned int seed; // of the choice of the worker to steal from
+  long long executed; // indexes run
+  long long stolen;   // tasks taken from other workers
+  long long splits;   // tasks split in two
+  long long sleeps;
+  TaskDeque deque;
+} TaskWorker;
+
+struct TaskPool
+{
+  TaskWorker *workers;
+  int workerCount;
+  pthread_mutex_t lock; // the injected tasks, the sleeping workers and stopping
+  pthread_cond_t wake;
+  Task *injected; // ring of the tasks submitted from threads that are not workers
+  int injectedHead;
+  int injectedCount;
+  int injectedCapacity;
+  int sleeping;
+  bool stopping;
+};
+
+typedef struct TaskPoolStats
+{
+  long long executed;
+  long long stolen;
+  long long splits;
+  long long sleeps;
+} TaskPoolStats;
+
+TaskPool *createTaskPool(int workerCount);
+void destroyTaskPool(TaskPool *pool);
+bool submitTasks(TaskPool *pool, TaskBatch *batch, TaskFunction function, void *context, int count, int grain);
+void waitTasks(TaskPool *pool, TaskBatch *batch);
+bool runTasks(TaskPool *pool, TaskFunction function, void *context, int count, int grain);
+void readTaskPoolStats(TaskPool *pool, TaskPoolStats *stats);
@@ -0,0 +1,227 @@
+/**
+ * @file timerwheel.c
+ * @brief File containing the functions of the hierarchical timer wheel
+ *
+ * This file contains a timer wheel with TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots. Level 0 has one slot
+ * per tick, and each slot of level n covers a whole turn of level n - 1. A timer is put in the lowest level whose
+ * range reaches its tick, and is moved down a level each time the wheel below finishes a turn, so adding or
+ * removing a timer is O(1) and each tick only touches the slot that is due, plus an amortized O(1) of cascading.
+ * The timer nodes are embedded in the caller's structures, so the wheel never allocates.
+ *
+ * @author João Pereira
+ */
+
+#include <stddef.h>
+#include "./timerwheel.h"
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/**
+ * @brief Makes a list empty
+ *
+ * @param head The sentinel of the list
+ */
+static void clearList(TimerNode *head)
+{
+  head->next = head;
+  head->previous = head;
+}
+
+/**
+ * @brief Appends a node to a list
+ *
+ * @param head The sentinel of the list
+ * @param node The node to be appended
+ */
+static void appendNode(TimerNode *head, TimerNode *node)
+{
+  node->next = head;
+  node->previous = head->previous;
+  head->previous->next = node;
+  head->previous = node;
+}
+
+/**
+ * @brief Initializes an empty timer wheel
+ *
+ * @param wheel A pointer to the wheel
+ * @param now The current tick
+ */
+void initTimerWheel(TimerWheel *wheel, int64_t now)
+{
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+  {
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+    {
+      clearList(&wheel->slots[level][slot]);
+    }
+  }
+  clearList(&wheel->due);
+  wheel->now = now;
+  wheel->count = 0;
+}
+
+/**
+ * @brief Puts a node in the slot its tick falls in, relative to the current tick
+ *
+ * @param wheel A pointer to the wheel
+ * @param node The node to be placed
+ */
+static void placeNode(TimerWheel *wheel, TimerNode *node)
+{
+  int64_t delta = node->expires - wheel->now;
+
+  if (delta <= 0)
+  {
+    appendNode(&wheel->due, node);
+    return;
+  }
+
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (int64_t)1 << (TIMER_WHEEL_BITS * (level + 1)))
+  {
+    level++;
+  }
+
+  // past the range of the top level the timer waits in the last slot it can reach and is placed again there
+  int64_t tick = node->expires;
+  int64_t range = (int64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+  if (delta >= range)
+  {
+    tick = wheel->now + range - 1;
+  }
+  appendNode(&wheel->slots[level][(tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK], node);
+}
+
+/**
+ * @brief Schedules a timer
+ *
+ * A timer for a tick that already passed is returned by the next timerWheelAdvance.
+ *
+ * @param wheel A pointer to the wheel
+ * @param node The timer, which must not be scheduled
+ * @param expires The tick the timer is due on
+ */
+void timerWheelAdd(TimerWheel *wheel, TimerNode *node, int64_t expires)
+{
+  node->expires = expires;
+  placeNode(wheel, node);
+  wheel->count++;
+}
+
+/**
+ * @brief Cancels a timer
+ *
+ * @param wheel A pointer to the wheel
+ * @param node The timer, ignored if it is not scheduled
+ */
+void timerWheelRemove(TimerWheel *wheel, TimerNode *node)
+{
+  if (node->previous == NULL)
+  {
+    return;
+  }
+
+  node->previous->next = node->next;
+  node->next->previous = node->previous;
+  node->next = NULL;
+  node->previous = NULL;
+  wheel->count--;
+}
+
+/**
+ * @brief Checks if a timer is scheduled
+ *
+ * @param node The timer
+ * @return True if the timer is in the wheel, false otherwise
+ */
+bool timerScheduled(TimerNode *node)
+{
+  return node->previous != NULL;
+}
+
+/**
+ * @brief Moves every timer of a slot to the lower levels
+ *
+ * @param wheel A pointer to the wheel
+ * @param head The sentinel of the slot
+ */
+static void cascadeSlot(TimerWheel *wheel, TimerNode *head)
+{
+  TimerNode *node = head->next;
+  clearList(head);
+
+  while (node != head)
+  {
+    TimerNode *next = node->next;
+    placeNode(wheel, node);
+    node = next;
+  }
+}
+
+/**
+ * @brief Moves every timer of a list to the end of the expired timers
+ *
+ * @param wheel A pointer to the wheel
+ * @param head The sentinel of the list
+ * @param last A pointer to the last expired timer, updated
+ * @param first A pointer to the first expired timer, updated
+ */
+static void expireList(TimerWheel *wheel, TimerNode *head, TimerNode **first, TimerNode **last)
+{
+  TimerNode *node = head->next;
+  clearList(head);
+
+  while (node != head)
+  {
+    TimerNode *next = node->next;
+    node->next = NULL;
+    node->previous = NULL;
+    if (*last == NULL)
+      *first = node;
+    else
+      (*last)->next = node;
+    *last = node;
+    wheel->count--;
+    node = next;
+  }
+}
+
+/**
+ * @brief Advances the wheel to a tick and takes out the timers that became due
+ *
+ * The timers are returned unscheduled, chained through TimerNode.next in the order they expired, so the caller can
+ * free or reschedule each one while walking the chain. An empty wheel jumps straight to the tick.
+ *
+ * @param wheel A pointer to the wheel
+ * @param now The current tick
+ * @return The first expired timer, or NULL if none expired
+ */
+TimerNode *timerWheelAdvance(TimerWheel *wheel, int64_t now)
+{
+  TimerNode *first = NULL;
+  TimerNode *last = NULL;
+
+  expireList(wheel, &wheel->due, &first, &last);
+
+  while (wheel->now < now)
+  {
+    if (wheel->count == 0)
+    {
+      wheel->now = now;
+      break;
+    }
+
+    int64_t tick = ++wheel->now;
+    for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+    {
+      if ((tick & (((int64_t)1 << (TIMER_WHEEL_BITS * level)) - 1)) == 0)
+      {
+        cascadeSlot(wheel, &wheel->slots[level][(tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK]);
+      }
+    }
+    expireList(wheel, &wheel->slots[0][tick & TIMER_WHEEL_MASK], &first, &last);
+    expireList(wheel, &wheel->due, &first, &last);
+  }
+  return first;
+}
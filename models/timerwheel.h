@@ -0,0 +1,37 @@
+/**
+ * @file timerwheel.h
+ * @brief File containing the functions of the hierarchical timer wheel
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#pragma once
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+
+typedef struct TimerNode TimerNode;
+
+struct TimerNode
+{
+  TimerNode *next;
+  TimerNode *previous; // NULL while the node is not scheduled
+  int64_t expires;     // tick the timer is due on
+};
+
+typedef struct TimerWheel
+{
+  TimerNode slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; // circular lists, each slot is its own sentinel
+  TimerNode due;                                          // timers added for a tick that already passed
+  int64_t now;                                            // last tick processed
+  long count;
+} TimerWheel;
+
+void initTimerWheel(TimerWheel *wheel, int64_t now);
+void timerWheelAdd(TimerWheel *wheel, TimerNode *node, int64_t expires);
+void timerWheelRemove(TimerWheel *wheel, TimerNode *node);
+bool timerScheduled(TimerNode *node);
+TimerNode *timerWheelAdvance(TimerWheel *wheel, int64_t now);
@@ -0,0 +1,224 @@
+/**
+ * @file trace.c
+ * @brief File containing the functions to trace the operations into a Chrome trace_event file
+ *
+ * A TRACE_SCOPE records a begin event where it is declared and an end event when its block is left, so a slow call
+ * can be seen in context with whatever the other threads were doing at the same time. The events go to a ring
+ * buffer of the calling thread, allocated on its first event, so recording takes no lock and touches no memory
+ * other threads write. When a ring is full the oldest events are overwritten, keeping the last TRACE_RING_EVENTS.
+ *
+ * Tracing is switched on and off while the program runs. When it is off a scope costs one load and one branch.
+ * When it is on an event costs a timestamp and two stores: on x86-64 the timestamp is the TSC, converted to time
+ * when the trace is flushed, elsewhere it is the monotonic clock.
+ *
+ * flushTrace writes the events held by every ring in the JSON trace_event format, which Perfetto
+ * (ui.perfetto.dev) and chrome://tracing open. It is meant to run after stopTracing; while tracing is on, a
+ * thread that records a whole ring of events during the flush can overwrite the oldest events being written.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include "./trace.h"
+
+typedef struct TraceBuffer
+{
+  TraceEvent events[TRACE_RING_EVENTS];
+  uint64_t head; // events ever recorded, only written by the thread that owns the buffer
+  int tid;
+  struct TraceBuffer *next;
+} TraceBuffer;
+
+bool tracingActive = false;
+static TraceBuffer *traceBuffers = NULL;
+static __thread TraceBuffer *localTrace = NULL;
+static uint64_t baseTicks = 0; // a timestamp and the monotonic time it was read at, taken by the first startTracing
+static uint64_t baseNs = 0;
+static pthread_mutex_t flushLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Gets the time of a monotonic clock in nanoseconds
+ *
+ * @return The time in nanoseconds
+ */
+static uint64_t monotonicNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Gets the timestamp of an event
+ *
+ * @return The TSC on x86-64, the monotonic time in nanoseconds elsewhere
+ */
+static inline uint64_t traceTicks()
+{
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  return monotonicNs();
+#endif
+}
+
+/**
+ * @brief Allocates the ring of the calling thread and links it where flushTrace finds it
+ *
+ * @return A pointer to the ring, or NULL if there was no memory
+ */
+static TraceBuffer *registerTraceThread()
+{
+  TraceBuffer *buffer = (TraceBuffer *)malloc(sizeof(TraceBuffer));
+  if (buffer == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+  buffer->head = 0;
+  buffer->tid = (int)syscall(SYS_gettid);
+  buffer->next = __atomic_load_n(&traceBuffers, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&traceBuffers, &buffer->next, buffer, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+  localTrace = buffer;
+  return buffer;
+}
+
+/**
+ * @brief Switches tracing on
+ *
+ * @return True if tracing is on
+ */
+bool startTracing()
+{
+  pthread_mutex_lock(&flushLock);
+  if (baseNs == 0)
+  {
+    baseTicks = traceTicks();
+    baseNs = monotonicNs();
+  }
+  pthread_mutex_unlock(&flushLock);
+  __atomic_store_n(&tracingActive, true, __ATOMIC_RELAXED);
+  return true;
+}
+
+/**
+ * @brief Switches tracing off, scopes that already began still record their end event
+ */
+void stopTracing()
+{
+  __atomic_store_n(&tracingActive, false, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Records an event in the ring of the calling thread
+ *
+ * @param name The name of the scope, a string that lives as long as the program
+ * @param isEnd True for an end event, false for a begin event
+ */
+void traceRecord(const char *name, bool isEnd)
+{
+  TraceBuffer *buffer = localTrace;
+  if (buffer == NULL && (buffer = registerTraceThread()) == NULL)
+  {
+    return;
+  }
+  uint64_t head = buffer->head;
+  TraceEvent *event = &buffer->events[head & (TRACE_RING_EVENTS - 1)];
+  event->ticks = traceTicks() << 1 | isEnd;
+  event->name = name;
+  __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Writes a string as a JSON string
+ *
+ * @param fp The file
+ * @param text The string
+ */
+static void writeJsonString(FILE *fp, const char *text)
+{
+  fputc('"', fp);
+  for (; *text; text++)
+  {
+    if (*text == '"' || *text == '\\')
+      fputc('\\', fp);
+    if ((unsigned char)*text >= 0x20)
+      fputc(*text, fp);
+  }
+  fputc('"', fp);
+}
+
+/**
+ * @brief Writes the events held by the ring of every thread to a trace_event JSON file
+ *
+ * End events whose begin was overwritten are left out, so every thread starts at depth zero.
+ *
+ * @param fileName The path of the file, TRACE_FILE for the default
+ * @return True if the file was written, false otherwise
+ */
+bool flushTrace(char *fileName)
+{
+  pthread_mutex_lock(&flushLock);
+  if (baseNs == 0)
+  {
+    pthread_mutex_unlock(&flushLock);
+    return false;
+  }
+
+  // the TSC rate is measured over the whole time since tracing first started, at least 10 ms
+  uint64_t ticks, ns;
+  while ((ns = monotonicNs()) - baseNs < 10000000)
+  {
+    struct timespec pause = {0, 1000000};
+    nanosleep(&pause, NULL);
+  }
+  ticks = traceTicks();
+  double nsPerTick = (double)(ns - baseNs) / (double)(ticks - baseTicks);
+
+  FILE *fp = fopen(fileName, "w");
+  if (fp == NULL)
+  {
+    perror("could not open file");
+    pthread_mutex_unlock(&flushLock);
+    return false;
+  }
+  int pid = (int)getpid();
+  bool first = true;
+  fprintf(fp, "{\"traceEvents\":[");
+  for (TraceBuffer *buffer = __atomic_load_n(&traceBuffers, __ATOMIC_ACQUIRE); buffer != NULL; buffer = buffer->next)
+  {
+    uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+    uint64_t start = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+    long depth = 0;
+    for (uint64_t i = start; i < head; i++)
+    {
+      TraceEvent event = buffer->events[i & (TRACE_RING_EVENTS - 1)];
+      bool isEnd = event.ticks & 1;
+      if (isEnd && depth == 0)
+      {
+        continue;
+      }
+      depth += isEnd ? -1 : 1;
+      double us = (baseNs + ((double)(event.ticks >> 1) - (double)baseTicks) * nsPerTick) / 1e3;
+      fprintf(fp, "%s\n{\"name\":", first ? "" : ",");
+      writeJsonString(fp, event.name);
+      fprintf(fp, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", isEnd ? 'E' : 'B', us, pid, buffer->tid);
+      first = false;
+    }
+  }
+  fprintf(fp, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  bool written = !ferror(fp);
+  written = fclose(fp) == 0 && written;
+  pthread_mutex_unlock(&flushLock);
+  return written;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file trace.h
+ * @brief File containing the functions to trace the operations into a Chrome trace_event file
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#pragma once
+
+#define TRACE_FILE "./trace.json"
+#define TRACE_RING_EVENTS 65536 // events kept per thread, a power of two, the oldest are overwritten
+
+typedef struct TraceEvent
+{
+  uint64_t ticks;   // timestamp << 1, the low bit is set on an end event
+  const char *name; // a string that lives as long as the program, a literal or __func__
+} TraceEvent;
+
+typedef struct TraceScope
+{
+  const char *name; // NULL if tracing was off when the scope began
+} TraceScope;
+
+extern bool tracingActive;
+
+bool startTracing();
+void stopTracing();
+void traceRecord(const char *name, bool isEnd);
+bool flushTrace(char *fileName);
+
+/**
+ * @brief Records the begin event of a scope if tracing is on
+ *
+ * @param name The name of the scope
+ * @return The scope, to be ended by traceScopeEnd
+ */
+static inline TraceScope traceBegin(const char *name)
+{
+  TraceScope scope = {NULL};
+  if (__atomic_load_n(&tracingActive, __ATOMIC_RELAXED))
+  {
+    traceRecord(name, false);
+    scope.name = name;
+  }
+  return scope;
+}
+
+/**
+ * @brief Records the end event of a scope opened with TRACE_SCOPE, run by the compiler when the scope is left
+ *
+ * @param scope A pointer to the scope
+ */
+static inline void traceScopeEnd(TraceScope *scope)
+{
+  if (scope->name != NULL)
+  {
+    traceRecord(scope->name, true);
+  }
+}
+
+// records a begin event now and the end event when the enclosing block is left, every return included
+#define TRACE_SCOPE(name) TraceScope traceScope __attribute__((cleanup(traceScopeEnd))) = traceBegin(name)
+#define TRACE_FUNCTION() TRACE_SCOPE(__func__)
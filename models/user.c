@@ -13,7 +13,48 @@
 #include <string.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <limits.h>
+#include "./binformat.h"
 #include "./user.h"
+#include "./memstats.h"
+#include "./metrics.h"
+#include "./trace.h"
+
+/**
+ * @brief Packs a user into its USER_RECORD_SIZE bytes in users.bin
+ *
+ * @param user A pointer to the user
+ * @param out Receives the record
+ */
+static void packUser(const User *user, uint8_t *out)
+{
+  putU32(out, (uint32_t)user->nif);
+  putString(out + 4, user->name, 50);
+  putString(out + 54, user->email, 50);
+  putU32(out + 104, (uint32_t)user->phone);
+  putU32(out + 108, (uint32_t)user->zip);
+  putString(out + 112, user->password, 50);
+  putU32(out + 162, (uint32_t)user->wallet);
+  out[166] = user->isManager ? 1 : 0;
+}
+
+/**
+ * @brief Unpacks a user from its record in users.bin
+ *
+ * @param in The record
+ * @param user Receives the user
+ */
+static void unpackUser(const uint8_t *in, User *user)
+{
+  user->nif = (int)getU32(in);
+  getString(user->name, in + 4, 50);
+  getString(user->email, in + 54, 50);
+  user->phone = (int)getU32(in + 104);
+  user->zip = (int)getU32(in + 108);
+  getString(user->password, in + 112, 50);
+  user->wallet = (int)getU32(in + 162);
+  user->isManager = in[166] != 0;
+}
 
 /**
  * @brief Reads users from a text file and creates a user list
@@ -25,6 +66,8 @@
  */
 UserList *readUsersFromTxt(UserList **headNode)
 {
+  METRIC_SCOPE(METRIC_READ_USERS_TXT);
+  TRACE_FUNCTION();
   FILE *pFile = NULL;
 
   pFile = fopen("./initial-data/users.txt", "r");
@@ -57,15 +100,19 @@ UserList *readUsersFromTxt(UserList **headNode)
  * into a User struct. It then calls the createUserList function to create a new node
  * in the linked list for each user. The headNode pointer is updated to point to the
  * first node in the list. If the file cannot be opened, NULL is returned.
+ * Files in the versioned format are checked block by block, and files written before it
+ * are still read as a dump of User structs. A file with a damaged header is refused.
  *
  * Return: A pointer to the head node of the linked list.
  */
 UserList *setUsersData(UserList **headNode)
 {
+  METRIC_SCOPE(METRIC_LOAD_USERS);
+  TRACE_FUNCTION();
   FILE *pFile = NULL;
 
   // Open the binary file for reading
-  pFile = fopen("./saved-data/users.bin", "rb");
+  pFile = fopen(USERS_FILE, "rb");
 
   // Check if the file was opened successfully
   if (pFile == NULL)
@@ -75,14 +122,43 @@ UserList *setUsersData(UserList **headNode)
   }
 
   User user;
-  // Read each user record from the file and create a new node in the linked list
-  while (fread(&user, sizeof(User), 1, pFile) == 1)
+  BinReader reader;
+  BinFormat format = openBinReader(&reader, pFile, BIN_USERS, USER_RECORD_SIZE);
+  if (format == BIN_FORMAT_LEGACY && !binLegacySizeMatches(pFile, sizeof(User)))
   {
-    createUserList(headNode, user);
+    format = BIN_FORMAT_INVALID;
+  }
+
+  if (format == BIN_FORMAT_LEGACY)
+  {
+    // Files written before the versioned format are a dump of the User structs
+    while (fread(&user, sizeof(User), 1, pFile) == 1)
+    {
+      createUserList(headNode, user);
+    }
+  }
+  else if (format == BIN_FORMAT_VERSIONED)
+  {
+    // Read each user record from the file and create a new node in the linked list
+    const uint8_t *record;
+    while ((record = binRead(&reader)) != NULL)
+    {
+      unpackUser(record, &user);
+      createUserList(headNode, user);
+    }
+    if (reader.corrupt)
+    {
+      fprintf(stderr, "%s is damaged, only the users before the damage were read\n", USERS_FILE);
+    }
   }
+  closeBinReader(&reader);
 
   // Close the file
   fclose(pFile);
+  if (format == BIN_FORMAT_INVALID)
+  {
+    return NULL;
+  }
 
   // Return a pointer to the head node of the linked list
   return *headNode;
@@ -105,7 +181,7 @@ UserList *setUsersData(UserList **headNode)
  */
 User *createUser(int nif, char name[50], char email[50], int phone, int zip, char password[50], int wallet, bool isManager)
 {
-  User *user = (User *)malloc(sizeof(User));
+  User *user = (User *)memAlloc(MEM_TEMPORARIES, sizeof(User));
   user->nif = nif;
   strcpy(user->name, name);
   strcpy(user->email, email);
@@ -128,7 +204,7 @@ User *createUser(int nif, char name[50], char email[50], int phone, int zip, cha
  */
 bool createUserList(UserList **headNode, User user)
 {
-  UserList *new_node = (UserList *)malloc(sizeof(UserList));
+  UserList *new_node = (UserList *)memAlloc(MEM_USERS, sizeof(UserList));
 
   if (new_node == NULL)
   {
@@ -221,7 +297,7 @@ bool deleteUser(UserList **usersList, int nif)
       {
         previous->next = current->next;
       }
-      free(current);
+      memFree(MEM_USERS, current);
       current = NULL;
       return true;
     }
@@ -235,17 +311,32 @@ bool deleteUser(UserList **usersList, int nif)
 /**
  * @brief Stores the user list in a binary file
  *
- * This function stores the user list in a binary file.
+ * This function stores the user list in a binary file, in the versioned format of binformat.h.
  *
  * @param headNode A pointer to the head node of the user list
  * @return A boolean indicating whether the user list was successfully stored or not
  */
 bool storeUsersInBin(UserList *headNode)
 {
+  TRACE_FUNCTION();
+  return storeUsersInFile(headNode, USERS_FILE);
+}
+
+/**
+ * @brief Stores the user list in the given binary file
+ *
+ * @param headNode A pointer to the head node of the user list
+ * @param fileName The path of the file that receives the users
+ * @return A boolean indicating whether the user list was successfully stored or not
+ */
+bool storeUsersInFile(UserList *headNode, char *fileName)
+{
+  METRIC_SCOPE(METRIC_STORE_USERS);
+  TRACE_FUNCTION();
   FILE *pFile = NULL;
   UserList *current_node = headNode;
 
-  pFile = fopen("./saved-data/users.bin", "wb");
+  pFile = fopen(fileName, "wb");
 
   if (pFile == NULL)
   {
@@ -253,16 +344,105 @@ bool storeUsersInBin(UserList *headNode)
     return false;
   }
 
-  while (current_node != NULL)
+  BinWriter writer;
+  uint8_t record[USER_RECORD_SIZE];
+  bool opened = openBinWriter(&writer, pFile, BIN_USERS, USER_RECORD_SIZE);
+  bool stored = opened;
+
+  while (current_node != NULL && stored)
   {
-    fwrite(&current_node->user, sizeof(User), 1, pFile);
+    packUser(&current_node->user, record);
+    stored = binWrite(&writer, record);
     current_node = current_node->next;
   }
 
-  fclose(pFile);
+  stored = opened && closeBinWriter(&writer) && stored;
+  stored = fclose(pFile) == 0 && stored;
+  return stored;
+}
+
+/**
+ * @brief Stores the user list in the users table of a storage file
+ *
+ * The previous users of the table are replaced. Nothing reaches the disk until the pager is flushed.
+ *
+ * @param pager A pointer to the storage file
+ * @param headNode A pointer to the head node of the user list
+ * @return A boolean indicating whether the user list was successfully stored or not
+ */
+bool storeUsersInPager(Pager *pager, UserList *headNode)
+{
+  METRIC_SCOPE(METRIC_STORE_USERS_PAGER);
+  TRACE_FUNCTION();
+  if (!pagerClearTable(pager, PAGER_USERS, sizeof(User)))
+  {
+    return false;
+  }
+
+  for (UserList *current = headNode; current != NULL; current = current->next)
+  {
+    if (!pagerAppend(pager, PAGER_USERS, &current->user))
+    {
+      return false;
+    }
+  }
   return true;
 }
 
+/**
+ * @brief Reads the users table of a storage file into the user list
+ *
+ * @param pager A pointer to the storage file
+ * @param headNode A pointer to the head node of the user list
+ * @return A pointer to the head node of the user list, or NULL if the table could not be read
+ */
+UserList *loadUsersFromPager(Pager *pager, UserList **headNode)
+{
+  METRIC_SCOPE(METRIC_LOAD_USERS_PAGER);
+  TRACE_FUNCTION();
+  PagerCursor cursor;
+  User user;
+
+  if (!pagerOpenCursor(pager, PAGER_USERS, sizeof(User), &cursor))
+  {
+    return NULL;
+  }
+  while (pagerNext(&cursor, &user))
+  {
+    createUserList(headNode, user);
+  }
+  pagerCloseCursor(&cursor);
+  return *headNode;
+}
+
+/**
+ * @brief Reads one user from the users table of a storage file, without loading the table
+ *
+ * The table is streamed through the cache of the pager, so it works with any number of users and a cache of a few
+ * pages.
+ *
+ * @param pager A pointer to the storage file
+ * @param nif The NIF of the user
+ * @param user Receives the user
+ * @return True if the user was found, false otherwise
+ */
+bool findUserInPager(Pager *pager, int nif, User *user)
+{
+  PagerCursor cursor;
+  bool found = false;
+
+  if (!pagerOpenCursor(pager, PAGER_USERS, sizeof(User), &cursor))
+  {
+    return false;
+  }
+  while (!found && pagerNext(&cursor, user))
+  {
+    found = user->nif == nif;
+  }
+  pagerCloseCursor(&cursor);
+  return found;
+}
+
 /**
  * @brief Searches for a user in the list with the given NIF
  *
@@ -291,9 +471,37 @@ bool searchUserByNif(UserList *headNode, int nif)
   return false;
 }
 
+/**
+ * @brief Finds a user in the list with the given NIF
+ *
+ * Unlike searchUserByNif this function does not print the list and gives access to the user itself.
+ *
+ * @param headNode A pointer to the head node of the user list
+ * @param nif The NIF of the user to be searched for
+ * @return A pointer to the user in the list, or NULL if it was not found
+ */
+User *searchUser(UserList *headNode, int nif)
+{
+  METRIC_SCOPE(METRIC_SEARCH_USER);
+  TRACE_FUNCTION();
+  UserList *current = headNode;
+  while (current != NULL)
+  {
+    if (current->user.nif == nif)
+    {
+      return &current->user;
+    }
+    current = current->next;
+  }
+  return NULL;
+}
+
 /**
  * @brief Updates the wallet of a user with the given NIF.
  *
+ * The balance is changed through applyWalletDelta, so a concurrent update of the same wallet can never
+ * observe (or leave behind) a temporarily negative balance.
+ *
  * @param headNode A pointer to the head node of the user list.
  * @param nif The NIF of the user whose wallet will be updated.
  * @param wallet The amount to add to the user's wallet.
@@ -307,15 +515,200 @@ bool updateUserWallet(UserList *headNode, int nif, int wallet)
   {
     if (current->user.nif == nif)
     {
-      current->user.wallet += wallet;
-      if (current->user.wallet < 0)
+      return applyWalletDelta(&current->user.wallet, wallet);
+    }
+    current = current->next;
+  }
+  return false;
+}
+
+/**
+ * @brief Atomically adds a delta to a wallet balance if the result stays non-negative.
+ *
+ * This is the "debit if balance >= amount" primitive: the new balance is computed from the value read and
+ * only published with a compare-and-swap, so two threads debiting the same wallet can never overdraw it.
+ * A negative delta is a debit, a positive one a credit.
+ *
+ * @param wallet A pointer to the wallet balance to be changed.
+ * @param delta The amount to add to the balance.
+ *
+ * @return true if the balance was changed, false if it would become negative or overflow.
+ */
+bool applyWalletDelta(int *wallet, int delta)
+{
+  return applyWalletDeltaStatus(wallet, delta) == WALLET_UPDATED;
+}
+
+/**
+ * @brief Atomically adds a delta to a wallet balance, like applyWalletDelta, and tells why it was refused.
+ *
+ * @param wallet A pointer to the wallet balance to be changed.
+ * @param delta The amount to add to the balance.
+ *
+ * @return WALLET_UPDATED if the balance was changed, WALLET_NEGATIVE_BALANCE if it would become negative, or
+ * WALLET_OVERFLOW if it would be above INT_MAX.
+ */
+WalletStatus applyWalletDeltaStatus(int *wallet, int delta)
+{
+  int current = __atomic_load_n(wallet, __ATOMIC_RELAXED);
+  long long updated;
+
+  do
+  {
+    updated = (long long)current + delta;
+    if (updated < 0)
+    {
+      return WALLET_NEGATIVE_BALANCE;
+    }
+    if (updated > INT_MAX)
+    {
+      return WALLET_OVERFLOW;
+    }
+  } while (!__atomic_compare_exchange_n(wallet, &current, (int)updated, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+  return WALLET_UPDATED;
+}
+
+typedef struct WalletBatchItem
+{
+  int nif;
+  int index; // position in the caller's array, keeps deltas of the same NIF in order
+} WalletBatchItem;
+
+/**
+ * @brief Orders batch items by NIF and then by their position in the batch.
+ *
+ * @param a A pointer to the first item
+ * @param b A pointer to the second item
+ * @return A negative, zero or positive value, as qsort expects
+ */
+static int compareWalletBatchItems(const void *a, const void *b)
+{
+  const WalletBatchItem *x = (const WalletBatchItem *)a;
+  const WalletBatchItem *y = (const WalletBatchItem *)b;
+
+  if (x->nif != y->nif)
+  {
+    return x->nif < y->nif ? -1 : 1;
+  }
+  return x->index - y->index;
+}
+
+/**
+ * @brief Finds the first batch item with a given NIF.
+ *
+ * @param items The batch items sorted by compareWalletBatchItems
+ * @param count The number of items
+ * @param nif The NIF to be searched for
+ * @return The index of the first item with the NIF, or -1 if there is none
+ */
+static int lowerBoundWalletBatch(WalletBatchItem *items, int count, int nif)
+{
+  int low = 0;
+  int high = count;
+
+  while (low < high)
+  {
+    int middle = low + (high - low) / 2;
+    if (items[middle].nif < nif)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  return low < count && items[low].nif == nif ? low : -1;
+}
+
+/**
+ * @brief Applies a batch of wallet deltas in a single pass over the user list
+ *
+ * The deltas are sorted by NIF, then the list is walked once and every user looks up its deltas with a binary search,
+ * so the cost is O((users + count) log count) instead of one list scan per delta. Deltas for the same NIF are applied
+ * in the order they appear in the batch, each one with the same rules as updateUserWallet. The walk stops as soon as
+ * every NIF in the batch has been found.
+ *
+ * @param headNode A pointer to the head node of the user list
+ * @param deltas The (nif, delta) pairs to be applied
+ * @param count The number of pairs
+ * @param status An array of count elements that receives the outcome of each pair, can be NULL
+ * @param rejected An array of count elements that receives the indexes of the pairs refused because the balance
+ * would be negative or overflow, in the order their users appear in the list, can be NULL
+ * @return The number of pairs refused because the balance would be negative or overflow, or -1 if there was no
+ * memory
+ */
+int updateUserWalletBatch(UserList *headNode, WalletDelta *deltas, int count, WalletStatus *status, int *rejected)
+{
+  if (count <= 0)
+  {
+    return 0;
+  }
+
+  WalletBatchItem *items = (WalletBatchItem *)malloc(count * sizeof(WalletBatchItem));
+  bool *applied = (bool *)calloc(count, sizeof(bool));
+
+  if (items == NULL || applied == NULL)
+  {
+    perror("could not allocate memory!");
+    free(items);
+    free(applied);
+    return -1;
+  }
+
+  int pending = 0;
+  for (int i = 0; i < count; i++)
+  {
+    items[i].nif = deltas[i].nif;
+    items[i].index = i;
+    if (status != NULL)
+    {
+      status[i] = WALLET_USER_NOT_FOUND;
+    }
+  }
+
+  qsort(items, count, sizeof(WalletBatchItem), compareWalletBatchItems);
+
+  for (int i = 0; i < count; i++)
+  {
+    if (i == 0 || items[i].nif != items[i - 1].nif)
+    {
+      pending++;
+    }
+  }
+
+  int rejectedCount = 0;
+  UserList *current = headNode;
+  while (current != NULL && pending > 0)
+  {
+    int first = lowerBoundWalletBatch(items, count, current->user.nif);
+
+    // only the first user with a repeated NIF is updated, like updateUserWallet does
+    if (first >= 0 && !applied[first])
+    {
+      for (int i = first; i < count && items[i].nif == current->user.nif; i++)
       {
-        current->user.wallet -= wallet;
-        return false;
+        int index = items[i].index;
+        WalletStatus outcome = applyWalletDeltaStatus(&current->user.wallet, deltas[index].delta);
+
+        if (status != NULL)
+        {
+          status[index] = outcome;
+        }
+        if (outcome != WALLET_UPDATED)
+        {
+          if (rejected != NULL)
+          {
+            rejected[rejectedCount] = index;
+          }
+          rejectedCount++;
+        }
       }
-      return true;
+      applied[first] = true;
+      pending--;
     }
     current = current->next;
   }
-  return false;
-}
\ No newline at end of file
+
+  free(items);
+  free(applied);
+  return rejectedCount;
+}
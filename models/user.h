@@ -7,8 +7,12 @@
  */
 
 #include <stdbool.h>
+#include "./pager.h"
 #pragma once
 
+#define USERS_FILE "./saved-data/users.bin"
+#define USER_RECORD_SIZE 167 // packed size of a User in users.bin
+
 typedef struct UserList UserList;
 
 typedef struct
@@ -23,6 +27,20 @@ typedef struct
   bool isManager;
 } User;
 
+typedef struct WalletDelta
+{
+  int nif;
+  int delta;
+} WalletDelta;
+
+typedef enum WalletStatus
+{
+  WALLET_UPDATED,
+  WALLET_USER_NOT_FOUND,
+  WALLET_NEGATIVE_BALANCE,
+  WALLET_OVERFLOW // the balance would be above INT_MAX
+} WalletStatus;
+
 struct UserList
 {
   User user;
@@ -37,5 +55,13 @@ void printUserList(UserList *headNode);
 bool editUser(UserList *usersList, int nif, User user);
 bool deleteUser(UserList **usersList, int nif);
 bool storeUsersInBin(UserList *headNode);
+bool storeUsersInFile(UserList *headNode, char *fileName);
+bool storeUsersInPager(Pager *pager, UserList *headNode);
+UserList *loadUsersFromPager(Pager *pager, UserList **headNode);
+bool findUserInPager(Pager *pager, int nif, User *user);
 bool searchUserByNif(UserList *headNode, int nif);
-bool updateUserWallet(UserList *headNode, int nif, int wallet);
\ No newline at end of file
+User *searchUser(UserList *headNode, int nif);
+bool updateUserWallet(UserList *headNode, int nif, int wallet);
+bool applyWalletDelta(int *wallet, int delta);
+WalletStatus applyWalletDeltaStatus(int *wallet, int delta);
+int updateUserWalletBatch(UserList *headNode, WalletDelta *deltas, int count, WalletStatus *status, int *rejected);
\ No newline at end of file
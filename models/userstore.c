@@ -0,0 +1,440 @@
+/**
+ * @file userstore.c
+ * @brief File containing the functions to manage the sharded, thread-safe user store
+ *
+ * This file contains the implementation of a user store split in USER_STORE_SHARDS shards by the hash of the NIF.
+ * Each shard keeps a linear probing table behind its own read-write lock, so lookups on different shards never
+ * contend. Wallet changes only need the shard read lock: the balance itself is updated with applyWalletDelta,
+ * which makes "debit if balance >= amount" a single compare-and-swap.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "./userstore.h"
+#include "./metrics.h"
+#include "./trace.h"
+
+/**
+ * @brief Mixes a NIF into a well distributed 32 bit hash.
+ *
+ * @param nif The NIF to be hashed
+ * @return The hash of the NIF
+ */
+static uint32_t hashNif(int nif)
+{
+  uint32_t h = (uint32_t)nif;
+  h ^= h >> 16;
+  h *= 0x7feb352d;
+  h ^= h >> 15;
+  h *= 0x846ca68b;
+  h ^= h >> 16;
+  return h;
+}
+
+/**
+ * @brief Gets the shard responsible for a NIF.
+ *
+ * The low bits of the hash select the shard and the high bits the slot inside it, so both stay independent.
+ *
+ * @param store A pointer to the user store
+ * @param hash The hash of the NIF
+ * @return A pointer to the shard
+ */
+static UserShard *shardFor(UserStore *store, uint32_t hash)
+{
+  return &store->shards[hash % USER_STORE_SHARDS];
+}
+
+/**
+ * @brief Finds the slot of a NIF inside a shard.
+ *
+ * The caller must hold the shard lock.
+ *
+ * @param shard A pointer to the shard
+ * @param hash The hash of the NIF
+ * @param nif The NIF to be searched for
+ * @return The index of the slot holding the user, or of the empty slot where it would be inserted
+ */
+static int findSlot(UserShard *shard, uint32_t hash, int nif)
+{
+  int mask = shard->capacity - 1;
+  int i = (int)(hash >> 8) & mask;
+
+  while (shard->slots[i] != NULL && shard->slots[i]->nif != nif)
+  {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+/**
+ * @brief Doubles the capacity of a shard and rehashes its users.
+ *
+ * The caller must hold the shard write lock.
+ *
+ * @param shard A pointer to the shard
+ * @return true if the shard was grown, false if there was no memory
+ */
+static bool growShard(UserShard *shard)
+{
+  int oldCapacity = shard->capacity;
+  User **oldSlots = shard->slots;
+  User **slots = (User **)calloc(oldCapacity * 2, sizeof(User *));
+
+  if (slots == NULL)
+  {
+    perror("could not allocate memory!");
+    return false;
+  }
+
+  shard->slots = slots;
+  shard->capacity = oldCapacity * 2;
+
+  for (int i = 0; i < oldCapacity; i++)
+  {
+    if (oldSlots[i] != NULL)
+    {
+      shard->slots[findSlot(shard, hashNif(oldSlots[i]->nif), oldSlots[i]->nif)] = oldSlots[i];
+    }
+  }
+
+  free(oldSlots);
+  return true;
+}
+
+/**
+ * @brief Creates an empty user store
+ *
+ * @return A pointer to the user store, or NULL if there was no memory
+ */
+UserStore *createUserStore()
+{
+  UserStore *store = (UserStore *)aligned_alloc(64, sizeof(UserStore));
+
+  if (store == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+
+  memset(store, 0, sizeof(UserStore));
+
+  for (int i = 0; i < USER_STORE_SHARDS; i++)
+  {
+    UserShard *shard = &store->shards[i];
+    shard->slots = (User **)calloc(USER_SHARD_INITIAL_CAPACITY, sizeof(User *));
+    shard->capacity = USER_SHARD_INITIAL_CAPACITY;
+    shard->count = 0;
+    pthread_rwlock_init(&shard->lock, NULL);
+
+    if (shard->slots == NULL)
+    {
+      perror("could not allocate memory!");
+      destroyUserStore(store);
+      return NULL;
+    }
+  }
+
+  return store;
+}
+
+/**
+ * @brief Frees the user store and every user in it
+ *
+ * @param store A pointer to the user store
+ */
+void destroyUserStore(UserStore *store)
+{
+  if (store == NULL)
+  {
+    return;
+  }
+
+  for (int i = 0; i < USER_STORE_SHARDS; i++)
+  {
+    UserShard *shard = &store->shards[i];
+    if (shard->slots != NULL)
+    {
+      for (int j = 0; j < shard->capacity; j++)
+      {
+        free(shard->slots[j]);
+      }
+      free(shard->slots);
+      pthread_rwlock_destroy(&shard->lock);
+    }
+  }
+
+  free(store);
+}
+
+/**
+ * @brief Creates a user store with a copy of every user in a user list
+ *
+ * If the list has repeated NIFs only the first one is kept, like the lookups on the list do.
+ *
+ * @param headNode A pointer to the head node of the user list
+ * @return A pointer to the user store, or NULL if there was no memory
+ */
+UserStore *userStoreFromList(UserList *headNode)
+{
+  UserStore *store = createUserStore();
+
+  if (store == NULL)
+  {
+    return NULL;
+  }
+
+  UserList *current = headNode;
+  while (current != NULL)
+  {
+    userStoreInsert(store, current->user);
+    current = current->next;
+  }
+
+  return store;
+}
+
+/**
+ * @brief Copies every user of the store into a user list
+ *
+ * The users are added to the head of the list with createUserList, so the list can be stored with storeUsersInBin.
+ *
+ * @param store A pointer to the user store
+ * @param headNode A pointer to the head node of the user list
+ * @return A pointer to the head node of the user list
+ */
+UserList *userStoreToList(UserStore *store, UserList **headNode)
+{
+  for (int i = 0; i < USER_STORE_SHARDS; i++)
+  {
+    UserShard *shard = &store->shards[i];
+    pthread_rwlock_rdlock(&shard->lock);
+    for (int j = 0; j < shard->capacity; j++)
+    {
+      if (shard->slots[j] != NULL)
+      {
+        User user = *shard->slots[j];
+        user.wallet = __atomic_load_n(&shard->slots[j]->wallet, __ATOMIC_ACQUIRE);
+        createUserList(headNode, user);
+      }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+  }
+
+  return *headNode;
+}
+
+/**
+ * @brief Inserts a copy of a user in the store
+ *
+ * @param store A pointer to the user store
+ * @param user The user to be inserted
+ * @return true if the user was inserted, false if the NIF already exists or there was no memory
+ */
+bool userStoreInsert(UserStore *store, User user)
+{
+  uint32_t hash = hashNif(user.nif);
+  UserShard *shard = shardFor(store, hash);
+  bool inserted = false;
+
+  pthread_rwlock_wrlock(&shard->lock);
+
+  // keep the load factor under 3/4 so the probe sequences stay short
+  if ((shard->count + 1) * 4 > shard->capacity * 3 && !growShard(shard))
+  {
+    pthread_rwlock_unlock(&shard->lock);
+    return false;
+  }
+
+  int slot = findSlot(shard, hash, user.nif);
+  if (shard->slots[slot] == NULL)
+  {
+    User *record = (User *)malloc(sizeof(User));
+    if (record == NULL)
+    {
+      perror("could not allocate memory!");
+    }
+    else
+    {
+      *record = user;
+      shard->slots[slot] = record;
+      shard->count++;
+      inserted = true;
+    }
+  }
+
+  pthread_rwlock_unlock(&shard->lock);
+  return inserted;
+}
+
+/**
+ * @brief Removes a user from the store
+ *
+ * Uses backward shift deletion, so the table never needs tombstones.
+ *
+ * @param store A pointer to the user store
+ * @param nif The NIF of the user to be removed
+ * @return true if the user was removed, false if it was not found
+ */
+bool userStoreRemove(UserStore *store, int nif)
+{
+  uint32_t hash = hashNif(nif);
+  UserShard *shard = shardFor(store, hash);
+
+  pthread_rwlock_wrlock(&shard->lock);
+
+  int mask = shard->capacity - 1;
+  int hole = findSlot(shard, hash, nif);
+
+  if (shard->slots[hole] == NULL)
+  {
+    pthread_rwlock_unlock(&shard->lock);
+    return false;
+  }
+
+  free(shard->slots[hole]);
+  shard->slots[hole] = NULL;
+  shard->count--;
+
+  // move back every following user whose home slot is not between the hole and its current slot
+  int i = (hole + 1) & mask;
+  while (shard->slots[i] != NULL)
+  {
+    int home = (int)(hashNif(shard->slots[i]->nif) >> 8) & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask))
+    {
+      shard->slots[hole] = shard->slots[i];
+      shard->slots[i] = NULL;
+      hole = i;
+    }
+    i = (i + 1) & mask;
+  }
+
+  pthread_rwlock_unlock(&shard->lock);
+  return true;
+}
+
+/**
+ * @brief Gets a copy of a user from the store
+ *
+ * @param store A pointer to the user store
+ * @param nif The NIF of the user to be searched for
+ * @param user A pointer where the user is copied to, can be NULL to only check if it exists
+ * @return true if the user was found, false otherwise
+ */
+bool userStoreGet(UserStore *store, int nif, User *user)
+{
+  METRIC_SCOPE(METRIC_USER_STORE_GET);
+  TRACE_FUNCTION();
+  uint32_t hash = hashNif(nif);
+  UserShard *shard = shardFor(store, hash);
+
+  pthread_rwlock_rdlock(&shard->lock);
+
+  User *record = shard->slots[findSlot(shard, hash, nif)];
+  if (record != NULL && user != NULL)
+  {
+    *user = *record;
+    user->wallet = __atomic_load_n(&record->wallet, __ATOMIC_ACQUIRE);
+  }
+
+  pthread_rwlock_unlock(&shard->lock);
+  return record != NULL;
+}
+
+/**
+ * @brief Counts the users in the store
+ *
+ * @param store A pointer to the user store
+ * @return The number of users in the store
+ */
+int userStoreCount(UserStore *store)
+{
+  int count = 0;
+  for (int i = 0; i < USER_STORE_SHARDS; i++)
+  {
+    pthread_rwlock_rdlock(&store->shards[i].lock);
+    count += store->shards[i].count;
+    pthread_rwlock_unlock(&store->shards[i].lock);
+  }
+  return count;
+}
+
+/**
+ * @brief Updates the wallet of a user in the store
+ *
+ * Same semantics as updateUserWallet: the amount is added and the update is refused if the balance would be negative.
+ * Only the shard read lock is taken, so wallet updates on the same shard run in parallel.
+ *
+ * @param store A pointer to the user store
+ * @param nif The NIF of the user whose wallet will be updated
+ * @param wallet The amount to add to the user's wallet
+ * @return true if the wallet was updated, false if the user was not found or the balance would be negative
+ */
+bool userStoreUpdateWallet(UserStore *store, int nif, int wallet)
+{
+  uint32_t hash = hashNif(nif);
+  UserShard *shard = shardFor(store, hash);
+  bool updated = false;
+
+  pthread_rwlock_rdlock(&shard->lock);
+
+  User *record = shard->slots[findSlot(shard, hash, nif)];
+  if (record != NULL)
+  {
+    updated = applyWalletDelta(&record->wallet, wallet);
+  }
+
+  pthread_rwlock_unlock(&shard->lock);
+  return updated;
+}
+
+/**
+ * @brief Debits an amount from a wallet only if the balance covers it
+ *
+ * @param store A pointer to the user store
+ * @param nif The NIF of the user to be debited
+ * @param amount The amount to debit, must not be negative
+ * @return true if the amount was debited, false if the user was not found or the balance is not enough
+ */
+bool userStoreDebitIfSufficient(UserStore *store, int nif, int amount)
+{
+  if (amount < 0)
+  {
+    return false;
+  }
+  return userStoreUpdateWallet(store, nif, -amount);
+}
+
+/**
+ * @brief Sums the balance of every wallet in the store
+ *
+ * Each shard is read under its lock, but concurrent wallet updates on other shards may still be in flight,
+ * so the total is only exact when the store is quiescent.
+ *
+ * @param store A pointer to the user store
+ * @return The sum of every wallet balance
+ */
+long long userStoreTotalBalance(UserStore *store)
+{
+  long long total = 0;
+  for (int i = 0; i < USER_STORE_SHARDS; i++)
+  {
+    UserShard *shard = &store->shards[i];
+    pthread_rwlock_rdlock(&shard->lock);
+    for (int j = 0; j < shard->capacity; j++)
+    {
+      if (shard->slots[j] != NULL)
+      {
+        total += __atomic_load_n(&shard->slots[j]->wallet, __ATOMIC_ACQUIRE);
+      }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+  }
+  return total;
+}
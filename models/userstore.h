@@ -0,0 +1,39 @@
+/**
+ * @file userstore.h
+ * @brief File containing the functions to manage the sharded, thread-safe user store
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "./user.h"
+#pragma once
+
+#define USER_STORE_SHARDS 64
+#define USER_SHARD_INITIAL_CAPACITY 16
+
+typedef struct UserShard
+{
+  _Alignas(64) pthread_rwlock_t lock; // protects the slots table, not the wallets
+  User **slots;                       // open addressing table of heap allocated users
+  int capacity;                       // always a power of two
+  int count;
+} UserShard;
+
+typedef struct UserStore
+{
+  UserShard shards[USER_STORE_SHARDS];
+} UserStore;
+
+UserStore *createUserStore();
+void destroyUserStore(UserStore *store);
+UserStore *userStoreFromList(UserList *headNode);
+UserList *userStoreToList(UserStore *store, UserList **headNode);
+bool userStoreInsert(UserStore *store, User user);
+bool userStoreRemove(UserStore *store, int nif);
+bool userStoreGet(UserStore *store, int nif, User *user);
+int userStoreCount(UserStore *store);
+bool userStoreUpdateWallet(UserStore *store, int nif, int wallet);
+bool userStoreDebitIfSufficient(UserStore *store, int nif, int amount);
+long long userStoreTotalBalance(UserStore *store);
@@ -15,7 +15,12 @@
 #include <string.h>
 #include <stdbool.h>
 #include <limits.h>
+#include "./analytics.h"
+#include "./binformat.h"
 #include "./vehicle.h"
+#include "./memstats.h"
+#include "./metrics.h"
+#include "./trace.h"
 
 /**
  * @brief Reads vehicles from a text file and creates a vehicle list.
@@ -28,6 +33,8 @@
  */
 VehicleList *readVehiclesFromTxt(VehicleList **headNode)
 {
+  METRIC_SCOPE(METRIC_READ_VEHICLES_TXT);
+  TRACE_FUNCTION();
   FILE *pFile = NULL;
 
   pFile = fopen("./initial-data/vehicles.txt", "r");
@@ -67,7 +74,7 @@ VehicleList *readVehiclesFromTxt(VehicleList **headNode)
  */
 Vehicle *createVehicle(char *registration, char *type, int battery, int cost, bool isInUse, char *location, Vertex *graf)
 {
-  Vehicle *vehicle = (Vehicle *)malloc(sizeof(Vehicle));
+  Vehicle *vehicle = (Vehicle *)memAlloc(MEM_TEMPORARIES, sizeof(Vehicle));
   strcpy(vehicle->registration, registration);
   strcpy(vehicle->type, type);
   vehicle->battery = battery;
@@ -79,6 +86,7 @@ Vehicle *createVehicle(char *registration, char *type, int battery, int cost, bo
   if (searchCodVertex(graf, location) < 0)
   {
     printf("\nThe location '%s' is not in the graph of routes!\n", location);
+    memFree(MEM_TEMPORARIES, vehicle);
     return NULL;
   }
 
@@ -98,7 +106,7 @@ Vehicle *createVehicle(char *registration, char *type, int battery, int cost, bo
  */
 bool createVehicleList(VehicleList **headNode, Vehicle vehicle)
 {
-  VehicleList *newVehicle = (VehicleList *)malloc(sizeof(VehicleList));
+  VehicleList *newVehicle = (VehicleList *)memAlloc(MEM_VEHICLES, sizeof(VehicleList));
   if (newVehicle == NULL)
   {
     perror("could not allocate memory!");
@@ -108,6 +116,7 @@ bool createVehicleList(VehicleList **headNode, Vehicle vehicle)
   newVehicle->next = *headNode;
 
   *headNode = newVehicle;
+  statsVehicleAdded(&newVehicle->vehicle);
   return true;
 }
 
@@ -188,7 +197,9 @@ bool editVehicle(VehicleList *headNode, char *registration, Vehicle vehicle)
   {
     if (strcmp(current->vehicle.registration, registration) == 0)
     {
+      Vehicle before = current->vehicle;
       current->vehicle = vehicle;
+      statsVehicleChanged(&before, &current->vehicle);
       return true;
     }
     current = current->next;
@@ -223,7 +234,8 @@ bool deleteVehicle(VehicleList **headNode, char *registration)
       {
         previous->next = current->next;
       }
-      free(current);
+      statsVehicleRemoved(&current->vehicle);
+      memFree(MEM_VEHICLES, current);
       return true;
     }
     previous = current;
@@ -232,10 +244,42 @@ bool deleteVehicle(VehicleList **headNode, char *registration)
   return false;
 }
 
+/**
+ * @brief Packs a vehicle into its VEHICLE_RECORD_SIZE bytes in vehicles.bin.
+ *
+ * @param vehicle A pointer to the vehicle.
+ * @param out Receives the record.
+ */
+static void packVehicle(const Vehicle *vehicle, uint8_t *out)
+{
+  putString(out, vehicle->registration, 50);
+  putString(out + 50, vehicle->type, 50);
+  putU32(out + 100, (uint32_t)vehicle->battery);
+  putU32(out + 104, (uint32_t)vehicle->cost);
+  out[108] = vehicle->isInUse ? 1 : 0;
+  putString(out + 109, vehicle->location, 50);
+}
+
+/**
+ * @brief Unpacks a vehicle from its record in vehicles.bin.
+ *
+ * @param in The record.
+ * @param vehicle Receives the vehicle.
+ */
+static void unpackVehicle(const uint8_t *in, Vehicle *vehicle)
+{
+  getString(vehicle->registration, in, 50);
+  getString(vehicle->type, in + 50, 50);
+  vehicle->battery = (int)getU32(in + 100);
+  vehicle->cost = (int)getU32(in + 104);
+  vehicle->isInUse = in[108] != 0;
+  getString(vehicle->location, in + 109, 50);
+}
+
 /**
  * @brief Stores the vehicle list in a binary file.
  *
- * This function stores the vehicles in the linked list in a binary file.
+ * This function stores the vehicles in the linked list in a binary file, in the versioned format of binformat.h.
  * The function takes a pointer to the head node of the list as a parameter.
  * The function returns true if the list was successfully stored in the file, false otherwise.
  *
@@ -244,10 +288,25 @@ bool deleteVehicle(VehicleList **headNode, char *registration)
  */
 bool storeVehicleListInBin(VehicleList *headNode)
 {
+  TRACE_FUNCTION();
+  return storeVehicleListInFile(headNode, VEHICLES_FILE);
+}
+
+/**
+ * @brief Stores the vehicle list in the given binary file.
+ *
+ * @param headNode A pointer to the head node of the vehicle list.
+ * @param fileName The path of the file that receives the vehicles.
+ * @return true if the vehicle list was successfully stored, false otherwise.
+ */
+bool storeVehicleListInFile(VehicleList *headNode, char *fileName)
+{
+  METRIC_SCOPE(METRIC_STORE_VEHICLES);
+  TRACE_FUNCTION();
   FILE *pFile = NULL;
   VehicleList *current_node = headNode;
 
-  pFile = fopen("./saved-data/vehicles.bin", "wb");
+  pFile = fopen(fileName, "wb");
 
   if (pFile == NULL)
   {
@@ -255,16 +314,160 @@ bool storeVehicleListInBin(VehicleList *headNode)
     return false;
   }
 
-  while (current_node != NULL)
+  BinWriter writer;
+  uint8_t record[VEHICLE_RECORD_SIZE];
+  bool opened = openBinWriter(&writer, pFile, BIN_VEHICLES, VEHICLE_RECORD_SIZE);
+  bool stored = opened;
+
+  while (current_node != NULL && stored)
   {
-    fwrite(&current_node->vehicle, sizeof(Vehicle), 1, pFile);
+    packVehicle(&current_node->vehicle, record);
+    stored = binWrite(&writer, record);
     current_node = current_node->next;
   }
 
+  stored = opened && closeBinWriter(&writer) && stored;
+  stored = fclose(pFile) == 0 && stored;
+  return stored;
+}
+
+/**
+ * @brief Reads the vehicles from the binary file into the vehicle list.
+ *
+ * Files in the versioned format are checked block by block, and files written before it are still read as a dump
+ * of Vehicle structs. A file with a damaged header is refused.
+ *
+ * @param headNode A pointer to the head node of the vehicle list.
+ * @return The head node of the vehicle list, or NULL if the file could not be opened or is not a vehicles file.
+ */
+VehicleList *setVehiclesData(VehicleList **headNode)
+{
+  METRIC_SCOPE(METRIC_LOAD_VEHICLES);
+  TRACE_FUNCTION();
+  FILE *pFile = fopen(VEHICLES_FILE, "rb");
+
+  if (pFile == NULL)
+  {
+    perror("Could not open file");
+    return NULL;
+  }
+
+  Vehicle vehicle;
+  BinReader reader;
+  BinFormat format = openBinReader(&reader, pFile, BIN_VEHICLES, VEHICLE_RECORD_SIZE);
+  if (format == BIN_FORMAT_LEGACY && !binLegacySizeMatches(pFile, sizeof(Vehicle)))
+  {
+    format = BIN_FORMAT_INVALID;
+  }
+
+  if (format == BIN_FORMAT_LEGACY)
+  {
+    while (fread(&vehicle, sizeof(Vehicle), 1, pFile) == 1)
+    {
+      createVehicleList(headNode, vehicle);
+    }
+  }
+  else if (format == BIN_FORMAT_VERSIONED)
+  {
+    const uint8_t *record;
+    while ((record = binRead(&reader)) != NULL)
+    {
+      unpackVehicle(record, &vehicle);
+      createVehicleList(headNode, vehicle);
+    }
+    if (reader.corrupt)
+    {
+      fprintf(stderr, "%s is damaged, only the vehicles before the damage were read\n", VEHICLES_FILE);
+    }
+  }
+  closeBinReader(&reader);
+
   fclose(pFile);
+  return format == BIN_FORMAT_INVALID ? NULL : *headNode;
+}
+
+/**
+ * @brief Stores the vehicle list in the vehicles table of a storage file.
+ *
+ * The previous vehicles of the table are replaced. Nothing reaches the disk until the pager is flushed.
+ *
+ * @param pager A pointer to the storage file.
+ * @param headNode A pointer to the head node of the vehicle list.
+ * @return True if the list was successfully stored, false otherwise.
+ */
+bool storeVehiclesInPager(Pager *pager, VehicleList *headNode)
+{
+  METRIC_SCOPE(METRIC_STORE_VEHICLES_PAGER);
+  TRACE_FUNCTION();
+  if (!pagerClearTable(pager, PAGER_VEHICLES, sizeof(Vehicle)))
+  {
+    return false;
+  }
+
+  for (VehicleList *current = headNode; current != NULL; current = current->next)
+  {
+    if (!pagerAppend(pager, PAGER_VEHICLES, &current->vehicle))
+    {
+      return false;
+    }
+  }
   return true;
 }
 
+/**
+ * @brief Reads the vehicles table of a storage file into the vehicle list.
+ *
+ * @param pager A pointer to the storage file.
+ * @param headNode A pointer to the head node of the vehicle list.
+ * @return The head node of the vehicle list, or NULL if the table could not be read.
+ */
+VehicleList *loadVehiclesFromPager(Pager *pager, VehicleList **headNode)
+{
+  METRIC_SCOPE(METRIC_LOAD_VEHICLES_PAGER);
+  TRACE_FUNCTION();
+  PagerCursor cursor;
+  Vehicle vehicle;
+
+  if (!pagerOpenCursor(pager, PAGER_VEHICLES, sizeof(Vehicle), &cursor))
+  {
+    return NULL;
+  }
+  while (pagerNext(&cursor, &vehicle))
+  {
+    createVehicleList(headNode, vehicle);
+  }
+  pagerCloseCursor(&cursor);
+  return *headNode;
+}
+
+/**
+ * @brief Reads one vehicle from the vehicles table of a storage file, without loading the table
+ *
+ * The table is streamed through the cache of the pager, so it works with any number of vehicles and a cache of a few
+ * pages.
+ *
+ * @param pager A pointer to the storage file
+ * @param registration The registration of the vehicle
+ * @param vehicle Receives the vehicle
+ * @return True if the vehicle was found, false otherwise
+ */
+bool findVehicleInPager(Pager *pager, char *registration, Vehicle *vehicle)
+{
+  PagerCursor cursor;
+  bool found = false;
+
+  if (!pagerOpenCursor(pager, PAGER_VEHICLES, sizeof(Vehicle), &cursor))
+  {
+    return false;
+  }
+  while (!found && pagerNext(&cursor, vehicle))
+  {
+    found = strcmp(vehicle->registration, registration) == 0;
+  }
+  pagerCloseCursor(&cursor);
+  return found;
+}
+
 /**
  * @brief Searches for a vehicle by registration number.
  *
@@ -290,6 +493,32 @@ bool searchVehicleByRegistration(VehicleList *headNode, char *registration)
   return false;
 }
 
+/**
+ * @brief Finds a vehicle by registration number.
+ *
+ * This function searches for a vehicle with the given registration number in the list and gives access to the vehicle itself,
+ * so the caller can read and change it without scanning the list again.
+ *
+ * @param headNode A pointer to the head node of the vehicle list.
+ * @param registration The registration number of the vehicle to be searched.
+ * @return A pointer to the vehicle in the list, or NULL if it was not found.
+ */
+Vehicle *searchVehicle(VehicleList *headNode, char *registration)
+{
+  METRIC_SCOPE(METRIC_SEARCH_VEHICLE);
+  TRACE_FUNCTION();
+  VehicleList *current = headNode;
+  while (current != NULL)
+  {
+    if (strcmp(current->vehicle.registration, registration) == 0)
+    {
+      return &current->vehicle;
+    }
+    current = current->next;
+  }
+  return NULL;
+}
+
 /**
  * @brief Checks if a vehicle is available.
  *
@@ -338,7 +567,12 @@ bool editVehicleAvailability(VehicleList *headNode, char *registration, bool isI
   {
     if (strcmp(current->vehicle.registration, registration) == 0)
     {
+      bool changed = current->vehicle.isInUse != isInUse;
       current->vehicle.isInUse = isInUse;
+      if (changed)
+      {
+        statsVehicleAvailability(&current->vehicle, isInUse);
+      }
       return true;
     }
     current = current->next;
@@ -404,6 +638,8 @@ VehicleList *sortVehiclesByLocation(VehicleList *headNode, char *location)
  */
 void *checkVehiclesInRadius(Vertex *g, VehicleList *vl, int city, float radius, char type[])
 {
+  METRIC_SCOPE(METRIC_VEHICLES_IN_RADIUS);
+  TRACE_FUNCTION();
   if (radius < 0)
   {
     return NULL;
@@ -543,6 +779,110 @@ void showVehicleByTypeOnLocation(VehicleList *head, char location[], char type[]
   }
 }
 
+typedef struct RadiusSearch // state of one findVehiclesInRadius, so searches on other threads do not share it
+{
+  VehicleList *vehicles;
+  Vertex **vertices; // first vertex of each cod, like searchVertexCod
+  bool *visited;     // by cod, instead of the visited flags of the graph
+  int maxCod;
+  char *type;
+  Vehicle **found;
+  int capacity;
+  int count;
+} RadiusSearch;
+
+/**
+ * @brief Collects the vehicles of a type in the cities within a distance of a city, the way traverseGraph visits them
+ *
+ * @param search A pointer to the state of the search, its count is incremented for every vehicle even past the capacity
+ * @param current_node Pointer to the current node being visited
+ * @param remaining_distance The remaining distance that can be traveled from the starting city
+ */
+static void collectVehiclesInRadius(RadiusSearch *search, Vertex *current_node, float remaining_distance)
+{
+  search->visited[current_node->cod] = true;
+
+  for (VehicleList *current = search->vehicles; current != NULL; current = current->next)
+  {
+    if (strcmp(current->vehicle.location, current_node->city) == 0 && strcmp(current->vehicle.type, search->type) == 0)
+    {
+      if (search->count < search->capacity)
+      {
+        search->found[search->count] = &current->vehicle;
+      }
+      search->count++;
+    }
+  }
+
+  for (Adj *edge = current_node->adjacents; edge != NULL; edge = edge->next)
+  {
+    if (edge->cod < 0 || edge->cod > search->maxCod)
+      continue;
+    Vertex *adjacentNode = search->vertices[edge->cod];
+    if (adjacentNode != NULL && !search->visited[edge->cod] && edge->dist <= remaining_distance)
+    {
+      collectVehiclesInRadius(search, adjacentNode, remaining_distance - edge->dist);
+    }
+  }
+}
+
+/**
+ * @brief Finds the vehicles of a type within a radius of a city without printing them
+ *
+ * Visits the same cities as checkVehiclesInRadius, but keeps its visited flags to itself instead of using the ones of
+ * the graph, so searches can run on several threads at once while the graph and the vehicles are not changed.
+ *
+ * @param g Pointer to the graph of cities and their connections
+ * @param vl Pointer to the linked list of vehicles
+ * @param city The code of the city to start the search from
+ * @param radius The maximum distance from the starting city
+ * @param type The type of vehicle to search for
+ * @param found Receives pointers to the vehicles found, up to capacity
+ * @param capacity The number of vehicles found has room for
+ * @return The number of vehicles in the radius, can be more than the capacity, or -1 for an unknown city, a negative
+ * radius or no memory
+ */
+int findVehiclesInRadius(Vertex *g, VehicleList *vl, int city, float radius, char type[], Vehicle **found, int capacity)
+{
+  METRIC_SCOPE(METRIC_FIND_VEHICLES_IN_RADIUS);
+  TRACE_FUNCTION();
+  RadiusSearch search = {vl, NULL, NULL, -1, type, found, capacity, 0};
+  for (Vertex *aux = g; aux != NULL; aux = aux->next)
+  {
+    if (aux->cod > search.maxCod)
+      search.maxCod = aux->cod;
+  }
+  if (city < 0 || city > search.maxCod || radius < 0)
+  {
+    return -1;
+  }
+
+  search.vertices = (Vertex **)calloc(search.maxCod + 1, sizeof(Vertex *));
+  search.visited = (bool *)calloc(search.maxCod + 1, sizeof(bool));
+  if (search.vertices == NULL || search.visited == NULL)
+  {
+    perror("could not allocate memory!");
+    free(search.vertices);
+    free(search.visited);
+    return -1;
+  }
+  for (Vertex *aux = g; aux != NULL; aux = aux->next)
+  {
+    if (aux->cod >= 0 && search.vertices[aux->cod] == NULL)
+      search.vertices[aux->cod] = aux;
+  }
+
+  int count = -1;
+  if (search.vertices[city] != NULL)
+  {
+    collectVehiclesInRadius(&search, search.vertices[city], radius);
+    count = search.count;
+  }
+  free(search.vertices);
+  free(search.visited);
+  return count;
+}
+
 /**
  * @brief recoverTruck - function that recovers eligible vehicles from a graph of nodes
  * @graph: pointer to the first node of the graph
@@ -557,6 +897,8 @@ void showVehicleByTypeOnLocation(VehicleList *head, char location[], char type[]
  */
 VehicleList *recoverTruck(Vertex *graph, VehicleList **vehicle_list, int truck_capacity)
 {
+  METRIC_SCOPE(METRIC_RECOVER_TRUCK);
+  TRACE_FUNCTION();
   int run_number = 1;
   int collected_count = 0;
 
@@ -666,7 +1008,7 @@ bool checkIsLegibleForTruck(VehicleList *vehicle)
  */
 bool headInsertionVehicleList(VehicleList **head, Vehicle new_vehicle)
 {
-  VehicleList *new_node = (VehicleList *)malloc(sizeof(VehicleList));
+  VehicleList *new_node = (VehicleList *)memAlloc(MEM_VEHICLES, sizeof(VehicleList));
 
   if (new_node == NULL)
   {
@@ -700,9 +1042,11 @@ void moveAndRechargeVehicle(VehicleList **vehicles, char vehicle_registration[50
   {
     if (strcmp(current_vehicle->vehicle.registration, vehicle_registration) == 0)
     {
+      Vehicle before = current_vehicle->vehicle;
       strcpy(current_vehicle->vehicle.location, location);
 
       current_vehicle->vehicle.battery = 100;
+      statsVehicleChanged(&before, &current_vehicle->vehicle);
     }
 
     current_vehicle = current_vehicle->next;
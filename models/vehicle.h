@@ -10,10 +10,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "./pager.h"
 #include "./routes.h"
 
 #pragma once
 
+#define VEHICLES_FILE "./saved-data/vehicles.bin"
+#define VEHICLE_RECORD_SIZE 159 // packed size of a Vehicle in vehicles.bin
+
 typedef struct VehicleList VehicleList;
 
 typedef struct Vehicle
@@ -39,7 +43,13 @@ void printVehicleList(VehicleList *headNode);
 bool editVehicle(VehicleList *headNode, char *registration, Vehicle vehicle);
 bool deleteVehicle(VehicleList **headNode, char *registration);
 bool storeVehicleListInBin(VehicleList *headNode);
+bool storeVehicleListInFile(VehicleList *headNode, char *fileName);
+VehicleList *setVehiclesData(VehicleList **headNode);
+bool storeVehiclesInPager(Pager *pager, VehicleList *headNode);
+VehicleList *loadVehiclesFromPager(Pager *pager, VehicleList **headNode);
+bool findVehicleInPager(Pager *pager, char *registration, Vehicle *vehicle);
 bool searchVehicleByRegistration(VehicleList *headNode, char *registration);
+Vehicle *searchVehicle(VehicleList *headNode, char *registration);
 bool isVehicleAvailable(VehicleList *headNode, char *registration);
 bool editVehicleAvailability(VehicleList *headNode, char *registration, bool isInUse);
 VehicleList *sortVehicleListDesc(VehicleList **headNode);
@@ -47,6 +57,7 @@ void *checkVehiclesInRadius(Vertex *g, VehicleList *vl, int city, float radius,
 void markAsVisited(Vertex *graph);
 void traverseGraph(Vertex *graph, VehicleList *vehicles, Vertex *current_node, float remaining_distance, char type[]);
 void showVehicleByTypeOnLocation(VehicleList *head, char location[], char type[]);
+int findVehiclesInRadius(Vertex *g, VehicleList *vl, int city, float radius, char type[], Vehicle **found, int capacity);
 VehicleList *recoverTruck(Vertex *graph, VehicleList **vehicle_list, int truck_capacity);
 bool checkIsLegibleForTruck(VehicleList *vehicle);
 bool headInsertionVehicleList(VehicleList **head, Vehicle new_vehicle);
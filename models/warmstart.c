@@ -0,0 +1,982 @@
+/**
+ * @file warmstart.c
+ * @brief File containing the functions of the warm start image of the stores and their indexes
+ *
+ * This file contains the writer and the reader of the warm start image. The image holds the users, the vehicles,
+ * the rents and the graph as arrays of records in the layout of this build, next to the indexes that find them:
+ * open addressing tables of record numbers for the NIFs, the registrations, the rent IDs and the cods, and the
+ * rents of each user and of each vehicle grouped in runs. Every reference is a record number, never a pointer, so
+ * the image is used straight from an mmap at any address.
+ *
+ * openWarmImage only maps the file and checks its header, so its cost does not depend on the size of the stores
+ * and the first lookup only faults in the few pages it touches. verifyWarmImage checks the CRC32C of every section
+ * and can run after the first requests were served. The warmLoad functions rebuild the linked lists from the
+ * records when the stores must be changed.
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "./binformat.h"
+#include "./warmstart.h"
+#include "./memstats.h"
+#include "./metrics.h"
+#include "./trace.h"
+
+/**
+ * @brief Hashes a NIF or a cod for the index tables
+ *
+ * @param key The NIF or the cod
+ * @return The hash of the key
+ */
+static uint32_t hashInt(int key)
+{
+  uint32_t h = (uint32_t)key;
+  h ^= h >> 16;
+  h *= 0x7feb352d;
+  h ^= h >> 15;
+  return h;
+}
+
+/**
+ * @brief Hashes a rent ID for the index table
+ *
+ * @param id The rent ID
+ * @return The hash of the ID
+ */
+static uint32_t hashId(int64_t id)
+{
+  uint64_t h = (uint64_t)id;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return (uint32_t)h;
+}
+
+/**
+ * @brief Hashes a registration with FNV-1a for the index tables
+ *
+ * @param registration The registration
+ * @return The hash of the registration
+ */
+static uint32_t hashRegistration(const char *registration)
+{
+  uint32_t h = 2166136261u;
+  while (*registration)
+  {
+    h ^= (unsigned char)*registration++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/**
+ * @brief Gets the number of slots of an index table, a power of two at least twice the number of keys
+ *
+ * @param count The number of keys
+ * @return The number of slots
+ */
+static uint64_t tableCapacity(uint64_t count)
+{
+  uint64_t capacity = 16;
+  while (capacity < count * 2)
+  {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+/**
+ * @brief Allocates an index table with every slot free
+ *
+ * @param capacity The number of slots
+ * @return A pointer to the table, or NULL if there was no memory
+ */
+static uint32_t *createTable(uint64_t capacity)
+{
+  uint32_t *table = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+  if (table == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+  memset(table, 0xff, capacity * sizeof(uint32_t));
+  return table;
+}
+
+/**
+ * @brief Hashes the user or the vehicle of a rent
+ *
+ * @param rent A pointer to the rent
+ * @param byUser True for the user, false for the vehicle
+ * @return The hash of the key
+ */
+static uint32_t hashRentKey(const Rent *rent, bool byUser)
+{
+  return byUser ? hashInt(rent->userNif) : hashRegistration(rent->vehicleRegistration);
+}
+
+/**
+ * @brief Checks if two rents have the same user or the same vehicle
+ *
+ * @param a A pointer to a rent
+ * @param b A pointer to the other rent
+ * @param byUser True to compare the users, false to compare the vehicles
+ * @return True if the keys are equal, false otherwise
+ */
+static bool sameRentKey(const Rent *a, const Rent *b, bool byUser)
+{
+  return byUser ? a->userNif == b->userNif : strcmp(a->vehicleRegistration, b->vehicleRegistration) == 0;
+}
+
+/**
+ * @brief Groups the rent numbers by user or by vehicle
+ *
+ * Each slot of the table holds the run of lists of one key; the key is read from the first rent of the run.
+ *
+ * @param rents The rent records
+ * @param count The number of rents
+ * @param byUser True to group by user, false to group by vehicle
+ * @param groups Receives the table, with capacity slots
+ * @param capacity The number of slots, a power of two larger than the number of keys
+ * @param lists Receives the rent numbers, count of them
+ * @return True if the rents were grouped, false if there was no memory
+ */
+static bool buildGroups(const Rent *rents, uint32_t count, bool byUser, WarmGroup *groups, uint64_t capacity, uint32_t *lists)
+{
+  uint32_t *slotOf = (uint32_t *)malloc(((size_t)count + 1) * sizeof(uint32_t));
+  uint32_t *representative = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+  if (slotOf == NULL || representative == NULL)
+  {
+    perror("could not allocate memory!");
+    free(slotOf);
+    free(representative);
+    return false;
+  }
+
+  memset(groups, 0, capacity * sizeof(WarmGroup));
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint64_t slot = hashRentKey(&rents[i], byUser) & (capacity - 1);
+    while (groups[slot].count > 0 && !sameRentKey(&rents[representative[slot]], &rents[i], byUser))
+    {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    representative[slot] = i;
+    groups[slot].count++;
+    slotOf[i] = (uint32_t)slot;
+  }
+
+  uint32_t first = 0;
+  for (uint64_t slot = 0; slot < capacity; slot++)
+  {
+    groups[slot].first = first;
+    first += groups[slot].count;
+    representative[slot] = groups[slot].first; // from here on, the next free position of the run
+  }
+  for (uint32_t i = 0; i < count; i++)
+  {
+    lists[representative[slotOf[i]]++] = i;
+  }
+
+  free(slotOf);
+  free(representative);
+  return true;
+}
+
+/**
+ * @brief Writes a section of the image, padded to WARM_ALIGNMENT, and records it in the header
+ *
+ * @param fp The image file, positioned at offset
+ * @param header A pointer to the header being built
+ * @param id The section
+ * @param data The bytes of the section
+ * @param length The number of bytes
+ * @param count The number of records or slots of the section
+ * @param offset The position of the section, moved past it and its padding
+ * @return True if the section was written, false otherwise
+ */
+static bool writeSection(FILE *fp, WarmHeader *header, WarmSectionId id, const void *data, uint64_t length, uint64_t count, uint64_t *offset)
+{
+  static const uint8_t padding[WARM_ALIGNMENT] = {0};
+  size_t pad = (size_t)((WARM_ALIGNMENT - length % WARM_ALIGNMENT) % WARM_ALIGNMENT);
+
+  header->sections[id].offset = *offset;
+  header->sections[id].length = length;
+  header->sections[id].count = count;
+  header->sections[id].crc = crc32c(0, data, length);
+  *offset += length + pad;
+  return (length == 0 || fwrite(data, length, 1, fp) == 1) && (pad == 0 || fwrite(padding, pad, 1, fp) == 1);
+}
+
+/**
+ * @brief Builds and writes the sections of the users and their index
+ *
+ * @param fp The image file
+ * @param header A pointer to the header being built
+ * @param users A pointer to the head node of the user list
+ * @param offset The position of the next section
+ * @return True if the sections were written, false otherwise
+ */
+static bool writeUsers(FILE *fp, WarmHeader *header, UserList *users, uint64_t *offset)
+{
+  uint32_t count = 0;
+  for (UserList *node = users; node != NULL; node = node->next)
+  {
+    count++;
+  }
+
+  uint64_t capacity = tableCapacity(count);
+  User *records = (User *)malloc(((size_t)count + 1) * sizeof(User));
+  uint32_t *table = createTable(capacity);
+  bool written = records != NULL && table != NULL;
+
+  uint32_t i = 0;
+  for (UserList *node = users; written && node != NULL; node = node->next, i++)
+  {
+    memcpy(&records[i], &node->user, sizeof(User));
+    uint64_t slot = hashInt(node->user.nif) & (capacity - 1);
+    while (table[slot] != WARM_EMPTY && records[table[slot]].nif != node->user.nif)
+    {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    if (table[slot] == WARM_EMPTY)
+    {
+      table[slot] = i; // the first of two users with the same NIF is the one searchUserByNif finds
+    }
+  }
+
+  written = written && writeSection(fp, header, WARM_USERS, records, (uint64_t)count * sizeof(User), count, offset) &&
+            writeSection(fp, header, WARM_USER_INDEX, table, capacity * sizeof(uint32_t), capacity, offset);
+  free(records);
+  free(table);
+  return written;
+}
+
+/**
+ * @brief Builds and writes the sections of the vehicles and their index
+ *
+ * @param fp The image file
+ * @param header A pointer to the header being built
+ * @param vehicles A pointer to the head node of the vehicle list
+ * @param offset The position of the next section
+ * @return True if the sections were written, false otherwise
+ */
+static bool writeVehicles(FILE *fp, WarmHeader *header, VehicleList *vehicles, uint64_t *offset)
+{
+  uint32_t count = 0;
+  for (VehicleList *node = vehicles; node != NULL; node = node->next)
+  {
+    count++;
+  }
+
+  uint64_t capacity = tableCapacity(count);
+  Vehicle *records = (Vehicle *)malloc(((size_t)count + 1) * sizeof(Vehicle));
+  uint32_t *table = createTable(capacity);
+  bool written = records != NULL && table != NULL;
+
+  uint32_t i = 0;
+  for (VehicleList *node = vehicles; written && node != NULL; node = node->next, i++)
+  {
+    memcpy(&records[i], &node->vehicle, sizeof(Vehicle));
+    uint64_t slot = hashRegistration(node->vehicle.registration) & (capacity - 1);
+    while (table[slot] != WARM_EMPTY && strcmp(records[table[slot]].registration, node->vehicle.registration) != 0)
+    {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    if (table[slot] == WARM_EMPTY)
+    {
+      table[slot] = i;
+    }
+  }
+
+  written = written && writeSection(fp, header, WARM_VEHICLES, records, (uint64_t)count * sizeof(Vehicle), count, offset) &&
+            writeSection(fp, header, WARM_VEHICLE_INDEX, table, capacity * sizeof(uint32_t), capacity, offset);
+  free(records);
+  free(table);
+  return written;
+}
+
+/**
+ * @brief Builds and writes the sections of the rents, their ID index and their user and vehicle groups
+ *
+ * @param fp The image file
+ * @param header A pointer to the header being built
+ * @param rentStore A pointer to the rent store, or NULL for no rents
+ * @param offset The position of the next section
+ * @return True if the sections were written, false otherwise
+ */
+static bool writeRents(FILE *fp, WarmHeader *header, RentStore *rentStore, uint64_t *offset)
+{
+  uint32_t count = 0;
+  for (RentList *node = rentStore != NULL ? rentStore->head : NULL; node != NULL; node = node->next)
+  {
+    count++;
+  }
+
+  uint64_t capacity = tableCapacity(count);
+  Rent *records = (Rent *)malloc(((size_t)count + 1) * sizeof(Rent));
+  uint32_t *table = createTable(capacity);
+  WarmGroup *userGroups = (WarmGroup *)malloc(capacity * sizeof(WarmGroup));
+  WarmGroup *vehicleGroups = (WarmGroup *)malloc(capacity * sizeof(WarmGroup));
+  uint32_t *userLists = (uint32_t *)malloc(((size_t)count + 1) * sizeof(uint32_t));
+  uint32_t *vehicleLists = (uint32_t *)malloc(((size_t)count + 1) * sizeof(uint32_t));
+  bool written = records != NULL && table != NULL && userGroups != NULL && vehicleGroups != NULL && userLists != NULL &&
+                 vehicleLists != NULL;
+  if (!written)
+  {
+    perror("could not allocate memory!");
+  }
+
+  uint32_t i = 0;
+  for (RentList *node = rentStore != NULL ? rentStore->head : NULL; written && node != NULL; node = node->next, i++)
+  {
+    memcpy(&records[i], &node->rent, sizeof(Rent));
+    uint64_t slot = hashId(node->rent.id) & (capacity - 1);
+    while (table[slot] != WARM_EMPTY)
+    {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    table[slot] = i; // IDs are unique in a rent store
+  }
+
+  written = written && buildGroups(records, count, true, userGroups, capacity, userLists) &&
+            buildGroups(records, count, false, vehicleGroups, capacity, vehicleLists);
+  written = written && writeSection(fp, header, WARM_RENTS, records, (uint64_t)count * sizeof(Rent), count, offset) &&
+            writeSection(fp, header, WARM_RENT_INDEX, table, capacity * sizeof(uint32_t), capacity, offset) &&
+            writeSection(fp, header, WARM_RENT_USER_GROUPS, userGroups, capacity * sizeof(WarmGroup), capacity, offset) &&
+            writeSection(fp, header, WARM_RENT_USER_LISTS, userLists, (uint64_t)count * sizeof(uint32_t), count, offset) &&
+            writeSection(fp, header, WARM_RENT_VEHICLE_GROUPS, vehicleGroups, capacity * sizeof(WarmGroup), capacity, offset) &&
+            writeSection(fp, header, WARM_RENT_VEHICLE_LISTS, vehicleLists, (uint64_t)count * sizeof(uint32_t), count, offset);
+  free(records);
+  free(table);
+  free(userGroups);
+  free(vehicleGroups);
+  free(userLists);
+  free(vehicleLists);
+  return written;
+}
+
+/**
+ * @brief Builds and writes the sections of the vertices, their cod index and the edges
+ *
+ * @param fp The image file
+ * @param header A pointer to the header being built
+ * @param graph A pointer to the head of the graph
+ * @param offset The position of the next section
+ * @return True if the sections were written, false otherwise
+ */
+static bool writeGraph(FILE *fp, WarmHeader *header, Vertex *graph, uint64_t *offset)
+{
+  uint32_t count = 0;
+  uint32_t edgeCount = 0;
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next, count++)
+  {
+    for (Adj *adj = vertex->adjacents; adj != NULL; adj = adj->next)
+    {
+      edgeCount++;
+    }
+  }
+
+  uint64_t capacity = tableCapacity(count);
+  WarmVertex *records = (WarmVertex *)calloc((size_t)count + 1, sizeof(WarmVertex));
+  WarmEdge *edges = (WarmEdge *)malloc(((size_t)edgeCount + 1) * sizeof(WarmEdge));
+  uint32_t *table = createTable(capacity);
+  bool written = records != NULL && edges != NULL && table != NULL;
+  if (records == NULL || edges == NULL)
+  {
+    perror("could not allocate memory!");
+  }
+
+  uint32_t i = 0;
+  uint32_t e = 0;
+  for (Vertex *vertex = graph; written && vertex != NULL; vertex = vertex->next, i++)
+  {
+    records[i].cod = vertex->cod;
+    memcpy(records[i].city, vertex->city, N);
+    records[i].city[N - 1] = '\0';
+    records[i].firstEdge = e;
+    for (Adj *adj = vertex->adjacents; adj != NULL; adj = adj->next, e++)
+    {
+      edges[e].cod = adj->cod;
+      edges[e].dist = adj->dist;
+    }
+    records[i].degree = e - records[i].firstEdge;
+
+    uint64_t slot = hashInt(vertex->cod) & (capacity - 1);
+    while (table[slot] != WARM_EMPTY && records[table[slot]].cod != vertex->cod)
+    {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    if (table[slot] == WARM_EMPTY)
+    {
+      table[slot] = i;
+    }
+  }
+
+  written = written && writeSection(fp, header, WARM_VERTICES, records, (uint64_t)count * sizeof(WarmVertex), count, offset) &&
+            writeSection(fp, header, WARM_VERTEX_INDEX, table, capacity * sizeof(uint32_t), capacity, offset) &&
+            writeSection(fp, header, WARM_EDGES, edges, (uint64_t)edgeCount * sizeof(WarmEdge), edgeCount, offset);
+  free(records);
+  free(edges);
+  free(table);
+  return written;
+}
+
+/**
+ * @brief Writes the warm start image of the stores
+ *
+ * The image is written in place; to replace an image that may be in use, write to another file and rename it.
+ *
+ * @param fileName The path of the image
+ * @param users A pointer to the head node of the user list
+ * @param vehicles A pointer to the head node of the vehicle list
+ * @param rentStore A pointer to the rent store, or NULL for no rents
+ * @param graph A pointer to the head of the graph, or NULL for no graph
+ * @return True if the image was written, false otherwise
+ */
+bool writeWarmImage(char *fileName, UserList *users, VehicleList *vehicles, RentStore *rentStore, Vertex *graph)
+{
+  METRIC_SCOPE(METRIC_WRITE_WARM_IMAGE);
+  TRACE_FUNCTION();
+  WarmHeader header;
+  uint64_t offset = (sizeof(WarmHeader) + WARM_ALIGNMENT - 1) / WARM_ALIGNMENT * WARM_ALIGNMENT;
+  FILE *fp = fopen(fileName, "wb");
+
+  if (fp == NULL)
+  {
+    perror("could not open file");
+    return false;
+  }
+
+  memset(&header, 0, sizeof(header));
+  bool written = fseek(fp, (long)offset, SEEK_SET) == 0 && writeUsers(fp, &header, users, &offset) &&
+                 writeVehicles(fp, &header, vehicles, &offset) && writeRents(fp, &header, rentStore, &offset) &&
+                 writeGraph(fp, &header, graph, &offset);
+
+  memcpy(header.magic, WARM_MAGIC, 8);
+  header.version = WARM_VERSION;
+  header.byteOrder = WARM_BYTE_ORDER;
+  header.userSize = sizeof(User);
+  header.vehicleSize = sizeof(Vehicle);
+  header.rentSize = sizeof(Rent);
+  header.sectionCount = WARM_SECTIONS;
+  header.nextRentId = rentStore != NULL ? rentStore->nextId : 0;
+  header.logSequence = rentStore != NULL ? rentStore->sequence : 0;
+  header.generation = rentStore != NULL ? rentStore->generation : 0;
+  header.crc = crc32c(0, &header, offsetof(WarmHeader, crc));
+  written = written && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1;
+  written = fclose(fp) == 0 && written;
+  return written;
+}
+
+/**
+ * @brief Gets the size of a record or a slot of a section
+ *
+ * @param section The section
+ * @return The size in bytes
+ */
+static size_t sectionRecordSize(WarmSectionId section)
+{
+  switch (section)
+  {
+  case WARM_USERS:
+    return sizeof(User);
+  case WARM_VEHICLES:
+    return sizeof(Vehicle);
+  case WARM_RENTS:
+    return sizeof(Rent);
+  case WARM_RENT_USER_GROUPS:
+  case WARM_RENT_VEHICLE_GROUPS:
+    return sizeof(WarmGroup);
+  case WARM_VERTICES:
+    return sizeof(WarmVertex);
+  case WARM_EDGES:
+    return sizeof(WarmEdge);
+  default:
+    return sizeof(uint32_t);
+  }
+}
+
+/**
+ * @brief Checks if a section holds an index table
+ *
+ * @param section The section
+ * @return True for the index tables, whose counts must be powers of two
+ */
+static bool isTable(WarmSectionId section)
+{
+  return section == WARM_USER_INDEX || section == WARM_VEHICLE_INDEX || section == WARM_RENT_INDEX ||
+         section == WARM_RENT_USER_GROUPS || section == WARM_RENT_VEHICLE_GROUPS || section == WARM_VERTEX_INDEX;
+}
+
+/**
+ * @brief Maps a warm start image and checks its header
+ *
+ * Only the header is read: the records and the indexes are faulted in by the lookups that touch them.
+ *
+ * @param fileName The path of the image
+ * @return A pointer to the open image, or NULL if it could not be opened or was written by another build
+ */
+WarmImage *openWarmImage(char *fileName)
+{
+  METRIC_SCOPE(METRIC_OPEN_WARM_IMAGE);
+  TRACE_FUNCTION();
+  WarmImage *image = (WarmImage *)calloc(1, sizeof(WarmImage));
+  if (image == NULL)
+  {
+    perror("could not allocate memory!");
+    return NULL;
+  }
+
+  struct stat info;
+  image->fd = open(fileName, O_RDONLY);
+  if (image->fd < 0 || fstat(image->fd, &info) != 0 || (size_t)info.st_size < sizeof(WarmHeader))
+  {
+    if (image->fd >= 0)
+    {
+      close(image->fd);
+    }
+    free(image);
+    return NULL;
+  }
+  image->size = (size_t)info.st_size;
+  void *data = mmap(NULL, image->size, PROT_READ, MAP_SHARED, image->fd, 0);
+  if (data == MAP_FAILED)
+  {
+    perror("could not map the warm start image");
+    close(image->fd);
+    free(image);
+    return NULL;
+  }
+  madvise(data, image->size, MADV_RANDOM); // readahead would pull megabytes around every page a lookup touches
+  image->data = (const uint8_t *)data;
+  image->header = (const WarmHeader *)data;
+
+  const WarmHeader *header = image->header;
+  bool valid = memcmp(header->magic, WARM_MAGIC, 8) == 0 && header->version == WARM_VERSION &&
+               header->byteOrder == WARM_BYTE_ORDER && header->userSize == sizeof(User) &&
+               header->vehicleSize == sizeof(Vehicle) && header->rentSize == sizeof(Rent) &&
+               header->sectionCount == WARM_SECTIONS && header->crc == crc32c(0, header, offsetof(WarmHeader, crc));
+  for (int id = 0; valid && id < WARM_SECTIONS; id++)
+  {
+    const WarmSection *section = &header->sections[id];
+    valid = section->offset % WARM_ALIGNMENT == 0 && section->offset <= image->size &&
+            section->length <= image->size - section->offset &&
+            section->length == section->count * sectionRecordSize((WarmSectionId)id) && section->count < WARM_EMPTY &&
+            (!isTable((WarmSectionId)id) || (section->count > 0 && (section->count & (section->count - 1)) == 0));
+  }
+  valid = valid && header->sections[WARM_RENT_USER_LISTS].count == header->sections[WARM_RENTS].count &&
+          header->sections[WARM_RENT_VEHICLE_LISTS].count == header->sections[WARM_RENTS].count;
+
+  if (!valid)
+  {
+    fprintf(stderr, "%s is not a warm start image of this build\n", fileName);
+    closeWarmImage(image);
+    return NULL;
+  }
+
+  image->users = (const User *)(image->data + header->sections[WARM_USERS].offset);
+  image->userIndex = (const uint32_t *)(image->data + header->sections[WARM_USER_INDEX].offset);
+  image->vehicles = (const Vehicle *)(image->data + header->sections[WARM_VEHICLES].offset);
+  image->vehicleIndex = (const uint32_t *)(image->data + header->sections[WARM_VEHICLE_INDEX].offset);
+  image->rents = (const Rent *)(image->data + header->sections[WARM_RENTS].offset);
+  image->rentIndex = (const uint32_t *)(image->data + header->sections[WARM_RENT_INDEX].offset);
+  image->rentUserGroups = (const WarmGroup *)(image->data + header->sections[WARM_RENT_USER_GROUPS].offset);
+  image->rentUserLists = (const uint32_t *)(image->data + header->sections[WARM_RENT_USER_LISTS].offset);
+  image->rentVehicleGroups = (const WarmGroup *)(image->data + header->sections[WARM_RENT_VEHICLE_GROUPS].offset);
+  image->rentVehicleLists = (const uint32_t *)(image->data + header->sections[WARM_RENT_VEHICLE_LISTS].offset);
+  image->vertices = (const WarmVertex *)(image->data + header->sections[WARM_VERTICES].offset);
+  image->vertexIndex = (const uint32_t *)(image->data + header->sections[WARM_VERTEX_INDEX].offset);
+  image->edges = (const WarmEdge *)(image->data + header->sections[WARM_EDGES].offset);
+  return image;
+}
+
+/**
+ * @brief Tells the kernel how a section is about to be read
+ *
+ * The image is mapped with MADV_RANDOM for the lookups, which would make a scan fault in one page at a time, so
+ * the scans switch their sections to MADV_SEQUENTIAL and back, or ask for the whole section with MADV_WILLNEED.
+ *
+ * @param image A pointer to the image
+ * @param section The section
+ * @param advice The madvise advice
+ */
+static void adviseSection(WarmImage *image, WarmSectionId section, int advice)
+{
+  uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t start = image->header->sections[section].offset / page * page;
+  uint64_t end = image->header->sections[section].offset + image->header->sections[section].length;
+  if (end > start)
+  {
+    madvise((void *)(image->data + start), end - start, advice);
+  }
+}
+
+/**
+ * @brief Checks the CRC32C of every section of an image
+ *
+ * This reads the whole image, so it is meant to run once the first requests were served.
+ *
+ * @param image A pointer to the image
+ * @return True if every section is intact, false otherwise
+ */
+bool verifyWarmImage(WarmImage *image)
+{
+  for (int id = 0; id < WARM_SECTIONS; id++)
+  {
+    const WarmSection *section = &image->header->sections[id];
+    adviseSection(image, (WarmSectionId)id, MADV_SEQUENTIAL);
+    bool intact = crc32c(0, image->data + section->offset, section->length) == section->crc;
+    adviseSection(image, (WarmSectionId)id, MADV_RANDOM);
+    if (!intact)
+    {
+      fprintf(stderr, "the warm start image has a damaged section %d\n", id);
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Unmaps and closes a warm start image
+ *
+ * @param image A pointer to the image, or NULL
+ */
+void closeWarmImage(WarmImage *image)
+{
+  if (image == NULL)
+  {
+    return;
+  }
+  munmap((void *)image->data, image->size);
+  close(image->fd);
+  free(image);
+}
+
+/**
+ * @brief Gets the number of records, or of slots, of a section
+ *
+ * @param image A pointer to the image
+ * @param section The section
+ * @return The number of records or slots
+ */
+uint64_t warmCount(WarmImage *image, WarmSectionId section)
+{
+  return image->header->sections[section].count;
+}
+
+/**
+ * @brief Finds a user by NIF
+ *
+ * @param image A pointer to the image
+ * @param nif The NIF of the user
+ * @return A pointer to the user in the image, or NULL if there is none
+ */
+const User *warmFindUser(WarmImage *image, int nif)
+{
+  uint64_t mask = warmCount(image, WARM_USER_INDEX) - 1;
+  uint64_t count = warmCount(image, WARM_USERS);
+
+  for (uint64_t slot = hashInt(nif) & mask;; slot = (slot + 1) & mask)
+  {
+    uint32_t user = image->userIndex[slot];
+    if (user >= count)
+    {
+      return NULL;
+    }
+    if (image->users[user].nif == nif)
+    {
+      return &image->users[user];
+    }
+  }
+}
+
+/**
+ * @brief Finds a vehicle by registration
+ *
+ * @param image A pointer to the image
+ * @param registration The registration of the vehicle
+ * @return A pointer to the vehicle in the image, or NULL if there is none
+ */
+const Vehicle *warmFindVehicle(WarmImage *image, const char *registration)
+{
+  uint64_t mask = warmCount(image, WARM_VEHICLE_INDEX) - 1;
+  uint64_t count = warmCount(image, WARM_VEHICLES);
+
+  for (uint64_t slot = hashRegistration(registration) & mask;; slot = (slot + 1) & mask)
+  {
+    uint32_t vehicle = image->vehicleIndex[slot];
+    if (vehicle >= count)
+    {
+      return NULL;
+    }
+    if (strcmp(image->vehicles[vehicle].registration, registration) == 0)
+    {
+      return &image->vehicles[vehicle];
+    }
+  }
+}
+
+/**
+ * @brief Finds a rent by ID
+ *
+ * @param image A pointer to the image
+ * @param id The ID of the rent
+ * @return A pointer to the rent in the image, or NULL if there is none
+ */
+const Rent *warmFindRent(WarmImage *image, int64_t id)
+{
+  uint64_t mask = warmCount(image, WARM_RENT_INDEX) - 1;
+  uint64_t count = warmCount(image, WARM_RENTS);
+
+  for (uint64_t slot = hashId(id) & mask;; slot = (slot + 1) & mask)
+  {
+    uint32_t rent = image->rentIndex[slot];
+    if (rent >= count)
+    {
+      return NULL;
+    }
+    if (image->rents[rent].id == id)
+    {
+      return &image->rents[rent];
+    }
+  }
+}
+
+/**
+ * @brief Finds the run of rents with the same key as a probe rent
+ *
+ * @param image A pointer to the image
+ * @param groups The group table of the key
+ * @param mask The number of slots of the table minus one
+ * @param lists The rent numbers of the key
+ * @param probe A rent with the key
+ * @param byUser True if the key is the user, false if it is the vehicle
+ * @param count Receives the number of rents
+ * @return The rent numbers, or NULL if there are none
+ */
+static const uint32_t *findGroup(WarmImage *image, const WarmGroup *groups, uint64_t mask, const uint32_t *lists, const Rent *probe, bool byUser, uint32_t *count)
+{
+  uint64_t rents = warmCount(image, WARM_RENTS);
+
+  *count = 0;
+  for (uint64_t slot = hashRentKey(probe, byUser) & mask;; slot = (slot + 1) & mask)
+  {
+    const WarmGroup *group = &groups[slot];
+    if (group->count == 0 || group->first >= rents || group->count > rents - group->first || lists[group->first] >= rents)
+    {
+      return NULL;
+    }
+    if (sameRentKey(&image->rents[lists[group->first]], probe, byUser))
+    {
+      *count = group->count;
+      return &lists[group->first];
+    }
+  }
+}
+
+/**
+ * @brief Gets the rents of a user, newest first
+ *
+ * @param image A pointer to the image
+ * @param nif The NIF of the user
+ * @param count Receives the number of rents
+ * @return The numbers of the rents in image->rents, or NULL if the user has none
+ */
+const uint32_t *warmRentsOfUser(WarmImage *image, int nif, uint32_t *count)
+{
+  Rent probe;
+  probe.userNif = nif;
+  return findGroup(image, image->rentUserGroups, warmCount(image, WARM_RENT_USER_GROUPS) - 1, image->rentUserLists, &probe, true, count);
+}
+
+/**
+ * @brief Gets the rents of a vehicle, newest first
+ *
+ * @param image A pointer to the image
+ * @param registration The registration of the vehicle
+ * @param count Receives the number of rents
+ * @return The numbers of the rents in image->rents, or NULL if the vehicle has none
+ */
+const uint32_t *warmRentsOfVehicle(WarmImage *image, const char *registration, uint32_t *count)
+{
+  Rent probe;
+  strncpy(probe.vehicleRegistration, registration, sizeof(probe.vehicleRegistration) - 1);
+  probe.vehicleRegistration[sizeof(probe.vehicleRegistration) - 1] = '\0';
+  return findGroup(image, image->rentVehicleGroups, warmCount(image, WARM_RENT_VEHICLE_GROUPS) - 1, image->rentVehicleLists, &probe, false, count);
+}
+
+/**
+ * @brief Finds a vertex by cod
+ *
+ * @param image A pointer to the image
+ * @param cod The cod of the vertex
+ * @return A pointer to the vertex in the image, or NULL if there is none
+ */
+const WarmVertex *warmFindVertex(WarmImage *image, int cod)
+{
+  uint64_t mask = warmCount(image, WARM_VERTEX_INDEX) - 1;
+  uint64_t count = warmCount(image, WARM_VERTICES);
+
+  for (uint64_t slot = hashInt(cod) & mask;; slot = (slot + 1) & mask)
+  {
+    uint32_t vertex = image->vertexIndex[slot];
+    if (vertex >= count)
+    {
+      return NULL;
+    }
+    if (image->vertices[vertex].cod == cod)
+    {
+      return &image->vertices[vertex];
+    }
+  }
+}
+
+/**
+ * @brief Gets the edges of a vertex, in the order of its adjacency list
+ *
+ * @param image A pointer to the image
+ * @param vertex A pointer to a vertex of the image
+ * @return The vertex->degree edges, or NULL if the vertex points outside the edges
+ */
+const WarmEdge *warmEdgesOf(WarmImage *image, const WarmVertex *vertex)
+{
+  uint64_t count = warmCount(image, WARM_EDGES);
+  if (vertex->firstEdge > count || vertex->degree > count - vertex->firstEdge)
+  {
+    return NULL;
+  }
+  return &image->edges[vertex->firstEdge];
+}
+
+/**
+ * @brief Rebuilds the user list from an image, the same list setUsersData builds from the users file
+ *
+ * @param image A pointer to the image
+ * @param headNode A pointer to the head node of the user list
+ * @return The head node of the user list
+ */
+UserList *warmLoadUsers(WarmImage *image, UserList **headNode)
+{
+  adviseSection(image, WARM_USERS, MADV_SEQUENTIAL);
+  for (uint64_t i = 0; i < warmCount(image, WARM_USERS); i++)
+  {
+    createUserList(headNode, image->users[i]);
+  }
+  adviseSection(image, WARM_USERS, MADV_RANDOM);
+  return *headNode;
+}
+
+/**
+ * @brief Rebuilds the vehicle list from an image, the same list setVehiclesData builds from the vehicles file
+ *
+ * @param image A pointer to the image
+ * @param headNode A pointer to the head node of the vehicle list
+ * @return The head node of the vehicle list
+ */
+VehicleList *warmLoadVehicles(WarmImage *image, VehicleList **headNode)
+{
+  adviseSection(image, WARM_VEHICLES, MADV_SEQUENTIAL);
+  for (uint64_t i = 0; i < warmCount(image, WARM_VEHICLES); i++)
+  {
+    createVehicleList(headNode, image->vehicles[i]);
+  }
+  adviseSection(image, WARM_VEHICLES, MADV_RANDOM);
+  return *headNode;
+}
+
+/**
+ * @brief Rebuilds a rent store from an image, with its indexes, timers and ID generator, like loadRentsFromFile
+ *
+ * The store also gets the number of the last record of the write-ahead log the image holds, so the replay that
+ * follows skips the records already in it.
+ *
+ * Must be called before a write-ahead log is attached to the store, like loadRentsFromFile.
+ *
+ * @param image A pointer to the image
+ * @param rentStore A pointer to an empty rent store
+ * @return A pointer to the rent store
+ */
+RentStore *warmLoadRents(WarmImage *image, RentStore *rentStore)
+{
+  adviseSection(image, WARM_RENTS, MADV_SEQUENTIAL);
+  for (uint64_t i = 0; i < warmCount(image, WARM_RENTS); i++)
+  {
+    createRentList(rentStore, image->rents[i]);
+  }
+  adviseSection(image, WARM_RENTS, MADV_RANDOM);
+  if (image->header->nextRentId > rentStore->nextId)
+  {
+    rentStore->nextId = image->header->nextRentId;
+  }
+  rentStore->sequence = image->header->logSequence;
+  rentStore->generation = image->header->generation;
+  return rentStore;
+}
+
+/**
+ * @brief Rebuilds the graph from an image, the same graph loadGraph and loadAdj build from the graph files
+ *
+ * @param image A pointer to the image
+ * @param graph A pointer to the head of the graph, usually empty
+ * @param res Set to true if every vertex was inserted
+ * @return A pointer to the head of the graph
+ */
+Vertex *warmLoadGraph(WarmImage *image, Vertex *graph, bool *res)
+{
+  uint64_t count = warmCount(image, WARM_VERTICES);
+  Vertex **inserted = (Vertex **)malloc((count + 1) * sizeof(Vertex *));
+
+  *res = false;
+  if (inserted == NULL)
+  {
+    perror("could not allocate memory!");
+    return graph;
+  }
+
+  *res = true;
+  adviseSection(image, WARM_VERTICES, MADV_WILLNEED);
+  adviseSection(image, WARM_EDGES, MADV_WILLNEED);
+  for (uint64_t i = 0; i < count; i++)
+  {
+    char city[N];
+    bool added;
+    memcpy(city, image->vertices[i].city, N);
+    city[N - 1] = '\0';
+    inserted[i] = createRouteVertex(city, image->vertices[i].cod);
+    graph = insertRouteVertex(graph, inserted[i], &added);
+    if (!added)
+    {
+      memFree(MEM_VERTICES, inserted[i]);
+      inserted[i] = NULL;
+      *res = false;
+    }
+  }
+
+  // the adjacents are added to the vertices directly, searching each origin in the list would be quadratic
+  for (uint64_t i = 0; i < count; i++)
+  {
+    const WarmEdge *edges = warmEdgesOf(image, &image->vertices[i]);
+    // insertAdj prepends, like loadAdj reading the adjacency file of the vertex
+    for (uint32_t e = 0; inserted[i] != NULL && edges != NULL && e < image->vertices[i].degree; e++)
+    {
+      bool added;
+      Adj *adj = createAdj(edges[e].cod, edges[e].dist);
+      inserted[i]->adjacents = insertAdj(inserted[i]->adjacents, adj, &added);
+      if (!added)
+      {
+        memFree(MEM_EDGES, adj);
+      }
+    }
+  }
+
+  free(inserted);
+  return graph;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file warmstart.h
+ * @brief File containing the functions of the warm start image of the stores and their indexes
+ *
+ * @author João Pereira
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "./user.h"
+#include "./vehicle.h"
+#include "./rentals.h"
+#include "./routes.h"
+#pragma once
+
+#define WARM_FILE "./saved-data/warm.img"
+#define WARM_MAGIC "AEDWARM1"
+#define WARM_VERSION 3
+#define WARM_BYTE_ORDER 0x01020304u
+#define WARM_ALIGNMENT 64
+#define WARM_EMPTY UINT32_MAX // free slot of an index table
+
+typedef enum WarmSectionId
+{
+  WARM_USERS,               // User records
+  WARM_USER_INDEX,          // NIF -> user number
+  WARM_VEHICLES,            // Vehicle records
+  WARM_VEHICLE_INDEX,       // registration -> vehicle number
+  WARM_RENTS,               // Rent records
+  WARM_RENT_INDEX,          // ID -> rent number
+  WARM_RENT_USER_GROUPS,    // NIF -> run of WARM_RENT_USER_LISTS
+  WARM_RENT_USER_LISTS,     // rent numbers, grouped by user
+  WARM_RENT_VEHICLE_GROUPS, // registration -> run of WARM_RENT_VEHICLE_LISTS
+  WARM_RENT_VEHICLE_LISTS,  // rent numbers, grouped by vehicle
+  WARM_VERTICES,            // WarmVertex records
+  WARM_VERTEX_INDEX,        // cod -> vertex number
+  WARM_EDGES,               // WarmEdge records, grouped by origin
+  WARM_SECTIONS
+} WarmSectionId;
+
+typedef struct WarmSection
+{
+  uint64_t offset; // from the start of the file, a multiple of WARM_ALIGNMENT
+  uint64_t length;
+  uint64_t count; // records, or slots for the index tables, which are a power of two
+  uint32_t crc;   // CRC32C of the section
+  uint32_t reserved;
+} WarmSection;
+
+typedef struct WarmHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder; // WARM_BYTE_ORDER as written by the machine that wrote the image
+  uint32_t userSize;  // sizeof of the records, an image is only read by a build with the same layout
+  uint32_t vehicleSize;
+  uint32_t rentSize;
+  uint32_t sectionCount;
+  int64_t nextRentId;
+  int64_t logSequence; // number of the last record of the rents log the image holds
+  int64_t generation;  // of the rent files written with the image, it holds the stores of saved-data while they match
+  WarmSection sections[WARM_SECTIONS];
+  uint32_t crc; // CRC32C of the header up to this field
+  uint32_t reserved;
+} WarmHeader;
+
+typedef struct WarmGroup // run of rent numbers of one user or one vehicle, count is 0 for a free slot
+{
+  uint32_t first;
+  uint32_t count;
+} WarmGroup;
+
+typedef struct WarmVertex
+{
+  int cod;
+  char city[N];
+  uint32_t firstEdge;
+  uint32_t degree;
+} WarmVertex;
+
+typedef struct WarmEdge
+{
+  int cod;
+  float dist;
+} WarmEdge;
+
+typedef struct WarmImage
+{
+  int fd;
+  const uint8_t *data; // the whole image, mapped read-only
+  size_t size;
+  const WarmHeader *header;
+  const User *users;
+  const uint32_t *userIndex;
+  const Vehicle *vehicles;
+  const uint32_t *vehicleIndex;
+  const Rent *rents;
+  const uint32_t *rentIndex;
+  const WarmGroup *rentUserGroups;
+  const uint32_t *rentUserLists;
+  const WarmGroup *rentVehicleGroups;
+  const uint32_t *rentVehicleLists;
+  const WarmVertex *vertices;
+  const uint32_t *vertexIndex;
+  const WarmEdge *edges;
+} WarmImage;
+
+bool writeWarmImage(char *fileName, UserList *users, VehicleList *vehicles, RentStore *rentStore, Vertex *graph);
+WarmImage *openWarmImage(char *fileName);
+bool verifyWarmImage(WarmImage *image);
+void closeWarmImage(WarmImage *image);
+uint64_t warmCount(WarmImage *image, WarmSectionId section);
+const User *warmFindUser(WarmImage *image, int nif);
+const Vehicle *warmFindVehicle(WarmImage *image, const char *registration);
+const Rent *warmFindRent(WarmImage *image, int64_t id);
+const uint32_t *warmRentsOfUser(WarmImage *image, int nif, uint32_t *count);
+const uint32_t *warmRentsOfVehicle(WarmImage *image, const char *registration, uint32_t *count);
+const WarmVertex *warmFindVertex(WarmImage *image, int cod);
+const WarmEdge *warmEdgesOf(WarmImage *image, const WarmVertex *vertex);
+UserList *warmLoadUsers(WarmImage *image, UserList **headNode);
+VehicleList *warmLoadVehicles(WarmImage *image, VehicleList **headNode);
+RentStore *warmLoadRents(WarmImage *image, RentStore *rentStore);
+Vertex *warmLoadGraph(WarmImage *image, Vertex *graph, bool *res);
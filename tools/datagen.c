@@ -0,0 +1,481 @@
+/**
+ * @file datagen.c
+ * @brief Generator of synthetic road networks, users and fleets
+ *
+ * Writes the four files of initial-data (routes.txt, edges.txt, users.txt and vehicles.txt) in the formats read
+ * by routesReadTxt, readUsersFromTxt and readVehiclesFromTxt, and the matching snapshot of saved-data, written
+ * with writeSnapshot with the compressed edge file in it, so a run can start from either.
+ *
+ * The road network is planar: the cities sit on a jittered grid five kilometres apart and the roads join grid
+ * neighbours, never crossing. A spanning comb of roads is always kept so every city can be reached, the other
+ * grid roads are kept or dropped to reach the requested degree, and above four one diagonal per grid cell is added.
+ * Every road goes both ways and its length is the straight distance with a detour of 5 to 35 percent.
+ *
+ * Users get a valid NIF, a Portuguese name, email and phone and a wallet that is empty for one in five of them.
+ * Vehicles are two thirds scooters and one third bicycles, mostly charged, and most of them are parked at the busy
+ * cities (one in fifty). Each kind of data has its own random stream derived from the seed, so the same seed always
+ * gives the same files, and changing the number of users does not change the roads or the fleet.
+ *
+ * Usage: datagen [directory] [cities] [degree] [users] [vehicles] [seed]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "../models/snapshot.h"
+
+#define GRID_SPACING 5.0 // km between neighbouring cities before the jitter
+#define HUB_EVERY 50     // one city in this many is a busy one
+#define MAX_DEGREE 6
+#define PATH_SIZE 512
+
+static const char *syllables[] = {"ba", "be", "bra", "ca", "co", "da", "do", "fa", "fe", "fi", "ga", "go",
+                                  "la", "le", "li", "lo", "ma", "me", "mi", "mo", "na", "no", "pa", "pe",
+                                  "po", "ra", "re", "ri", "sa", "se", "ta", "to", "va", "ve", "vi", "za"};
+static const char *firstNames[] = {"Joao", "Maria", "Ana", "Pedro", "Tiago", "Ines", "Rita", "Miguel", "Sofia", "Rui",
+                                   "Beatriz", "Diogo", "Carla", "Nuno", "Marta", "Bruno", "Joana", "Andre", "Catarina", "Luis"};
+static const char *surnames[] = {"Silva", "Santos", "Ferreira", "Pereira", "Oliveira", "Costa", "Rodrigues", "Martins", "Jesus", "Sousa",
+                                 "Fernandes", "Goncalves", "Gomes", "Lopes", "Marques", "Alves", "Almeida", "Ribeiro", "Pinto", "Carvalho"};
+
+typedef struct City
+{
+  double x; // km
+  double y;
+  Vertex *vertex;
+} City;
+
+/**
+ * @brief splitmix64 pseudo random generator, the same seed always gives the same sequence
+ *
+ * @param state A pointer to the generator state
+ * @return The next pseudo random number
+ */
+static unsigned long long nextRandom(unsigned long long *state)
+{
+  unsigned long long z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Gets a random number in [0, 1)
+ *
+ * @param state A pointer to the generator state
+ * @return The random number
+ */
+static double randomUnit(unsigned long long *state)
+{
+  return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Gets a random number in [0, bound)
+ *
+ * @param state A pointer to the generator state
+ * @param bound The bound
+ * @return The random number
+ */
+static int randomBelow(unsigned long long *state, int bound)
+{
+  return (int)(nextRandom(state) % (unsigned long long)bound);
+}
+
+/**
+ * @brief Gets the square root of a non negative number with Newton's method, the build does not link libm
+ *
+ * @param value The number
+ * @return The square root
+ */
+static double squareRoot(double value)
+{
+  double root = value > 1 ? value : 1;
+  for (int i = 0; i < 64; i++)
+  {
+    double next = 0.5 * (root + value / root);
+    if (next == root)
+    {
+      break;
+    }
+    root = next;
+  }
+  return value > 0 ? root : 0;
+}
+
+/**
+ * @brief Writes the name of a city, syllables in a mixed radix of the city number so every name is different
+ *
+ * @param city Receives the name
+ * @param number The number of the city
+ * @param length The number of syllables of every name
+ */
+static void cityName(char *city, int number, int length)
+{
+  int count = sizeof(syllables) / sizeof(syllables[0]);
+  city[0] = '\0';
+  for (int i = 0; i < length; i++)
+  {
+    strcat(city, syllables[number % count]);
+    number /= count;
+  }
+  city[0] = (char)(city[0] - 'a' + 'A');
+}
+
+/**
+ * @brief Adds a road in both directions
+ *
+ * @param cities The cities
+ * @param a The number of a city
+ * @param b The number of the other city
+ * @param state A pointer to the generator of the graph
+ * @param edges The file receiving the roads as text
+ * @return The number of directed roads added
+ */
+static int addRoad(City *cities, int a, int b, unsigned long long *state, FILE *edges)
+{
+  double dx = cities[a].x - cities[b].x;
+  double dy = cities[a].y - cities[b].y;
+  double detour = 1.05 + 0.3 * randomUnit(state);
+  float distance = (float)((long)(squareRoot(dx * dx + dy * dy) * detour * 100 + 0.5) / 100.0);
+  bool res;
+  int added = 0;
+
+  cities[a].vertex->adjacents = insertAdj(cities[a].vertex->adjacents, createAdj(b, distance), &res);
+  added += res;
+  cities[b].vertex->adjacents = insertAdj(cities[b].vertex->adjacents, createAdj(a, distance), &res);
+  added += res;
+  fprintf(edges, "%s %s %.2f\n", cities[a].vertex->city, cities[b].vertex->city, distance);
+  fprintf(edges, "%s %s %.2f\n", cities[b].vertex->city, cities[a].vertex->city, distance);
+  return added;
+}
+
+/**
+ * @brief Compares two cities by name, descending, for qsort
+ *
+ * @param a A pointer to a city
+ * @param b A pointer to the other city
+ * @return Negative, zero or positive as the name of a comes after, equals or comes before the name of b
+ */
+static int compareCitiesDesc(const void *a, const void *b)
+{
+  return strcmp((*(City *const *)b)->vertex->city, (*(City *const *)a)->vertex->city);
+}
+
+/**
+ * @brief Builds the path of a file in a directory
+ *
+ * @param path Receives the path, with room for PATH_SIZE bytes
+ * @param directory The directory
+ * @param name The name of the file in the directory
+ * @return True if the path fits, false otherwise
+ */
+static bool filePath(char *path, char *directory, char *name)
+{
+  int length = snprintf(path, PATH_SIZE, "%s/%s", directory, name);
+  if (length < 0 || length >= PATH_SIZE)
+  {
+    fprintf(stderr, "the path of %s in %s is too long\n", name, directory);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Generates the road network and writes routes.txt and edges.txt
+ *
+ * @param directory The initial-data directory
+ * @param count The number of cities
+ * @param degree The average number of roads leaving a city, from 2 to MAX_DEGREE
+ * @param seed The seed
+ * @param cities Receives the cities, count of them
+ * @param roads Receives the number of directed roads
+ * @return A pointer to the head of the graph, or NULL if a file could not be written
+ */
+static Vertex *generateGraph(char *directory, int count, double degree, unsigned long long seed, City *cities, long *roads)
+{
+  unsigned long long state = seed ^ 0x67726170680aULL;
+  char path[PATH_SIZE];
+  int width = (int)squareRoot(count);
+  int length = 2;
+  bool res;
+
+  while (width * width < count)
+  {
+    width++;
+  }
+  for (long names = 36 * 36; names < count; names *= 36)
+  {
+    length++;
+  }
+
+  FILE *routes = filePath(path, directory, "routes.txt") ? fopen(path, "w") : NULL;
+  FILE *edges = filePath(path, directory, "edges.txt") ? fopen(path, "w") : NULL;
+  City **sorted = (City **)malloc(count * sizeof(City *));
+  if (routes == NULL || edges == NULL || sorted == NULL)
+  {
+    perror("could not open file");
+    return NULL;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    char city[N];
+    cityName(city, i, length);
+    cities[i].x = (i % width + 0.7 * randomUnit(&state) - 0.35) * GRID_SPACING;
+    cities[i].y = (i / width + 0.7 * randomUnit(&state) - 0.35) * GRID_SPACING;
+    cities[i].vertex = createRouteVertex(city, i);
+    sorted[i] = &cities[i];
+    fprintf(routes, "%s\n", city);
+  }
+
+  // inserted from the last name to the first, each vertex goes to the head of the sorted list
+  Vertex *graph = createRoute();
+  qsort(sorted, count, sizeof(City *), compareCitiesDesc);
+  for (int i = 0; i < count; i++)
+  {
+    graph = insertRouteVertex(graph, sorted[i]->vertex, &res);
+  }
+  free(sorted);
+
+  // the comb (every road along a row, and the roads down the first column) keeps the graph connected, the other
+  // grid roads are kept with the probability that gives the degree asked for
+  double keep = degree >= 4 ? 1 : degree / 2 - 1;
+  double diagonal = degree > 4 ? (degree - 4) / 2 : 0;
+  *roads = 0;
+  for (int i = 0; i < count; i++)
+  {
+    int column = i % width;
+    int right = column + 1 < width && i + 1 < count ? i + 1 : -1;
+    int down = i + width < count ? i + width : -1;
+    if (right >= 0)
+    {
+      *roads += addRoad(cities, i, right, &state, edges);
+    }
+    if (down >= 0 && (column == 0 || randomUnit(&state) < keep))
+    {
+      *roads += addRoad(cities, i, down, &state, edges);
+    }
+    if (right >= 0 && down >= 0 && down + 1 < count && randomUnit(&state) < diagonal)
+    {
+      // one diagonal per cell, in either direction, keeps the graph planar
+      if (randomUnit(&state) < 0.5)
+        *roads += addRoad(cities, i, down + 1, &state, edges);
+      else
+        *roads += addRoad(cities, right, down, &state, edges);
+    }
+  }
+
+  bool written = fclose(routes) == 0;
+  written = fclose(edges) == 0 && written;
+  return written ? graph : NULL;
+}
+
+/**
+ * @brief Writes a valid NIF of a person: a 2, seven digits and the mod 11 check digit
+ *
+ * @param number The number of the user, below 10^7
+ * @return The NIF
+ */
+static int personNif(int number)
+{
+  int base = 20000000 + number;
+  int sum = 0;
+  int weight = 9;
+  for (int divisor = 10000000; divisor > 0; divisor /= 10, weight--)
+  {
+    sum += (base / divisor % 10) * weight;
+  }
+  int check = 11 - sum % 11;
+  return base * 10 + (check >= 10 ? 0 : check);
+}
+
+/**
+ * @brief Generates the users and writes users.txt
+ *
+ * @param directory The initial-data directory
+ * @param count The number of users
+ * @param seed The seed
+ * @param users Receives the user list, in the order readUsersFromTxt builds it
+ * @return True if the file was written, false otherwise
+ */
+static bool generateUsers(char *directory, int count, unsigned long long seed, UserList **users)
+{
+  unsigned long long state = seed ^ 0x75736572730aULL;
+  int firstCount = sizeof(firstNames) / sizeof(firstNames[0]);
+  int surnameCount = sizeof(surnames) / sizeof(surnames[0]);
+  char path[PATH_SIZE];
+  FILE *fp = filePath(path, directory, "users.txt") ? fopen(path, "w") : NULL;
+  if (fp == NULL)
+  {
+    perror("could not open file");
+    return false;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    User user = {0};
+    const char *first = firstNames[randomBelow(&state, firstCount)];
+    const char *surname = surnames[randomBelow(&state, surnameCount)];
+    double wallet = randomUnit(&state);
+
+    user.nif = personNif(i);
+    snprintf(user.name, sizeof(user.name), "%s %s", first, surname);
+    snprintf(user.email, sizeof(user.email), "%s.%s%d@mail.pt", first, surname, i);
+    for (char *c = user.email; *c; c++)
+    {
+      if (*c >= 'A' && *c <= 'Z')
+        *c = (char)(*c - 'A' + 'a');
+    }
+    user.phone = (randomBelow(&state, 10) < 6 ? 910000000 : 930000000) + randomBelow(&state, 10000000);
+    user.zip = 1000 + randomBelow(&state, 9000);
+    for (int c = 0; c < 10; c++)
+    {
+      user.password[c] = "abcdefghijkmnpqrstuvwxyz23456789"[randomBelow(&state, 32)];
+    }
+    // one in five never topped up, most keep a few euros, a few keep a lot
+    user.wallet = wallet < 0.2 ? 0 : wallet < 0.7 ? 5 + randomBelow(&state, 46) : wallet < 0.95 ? 50 + randomBelow(&state, 151) : 200 + randomBelow(&state, 801);
+    user.isManager = i == 0 || randomBelow(&state, 1000) == 0;
+
+    fprintf(fp, "%d;%s;%s;%d;%d;%s;%d;%d\n", user.nif, user.name, user.email, user.phone, user.zip, user.password,
+            user.wallet, user.isManager);
+    if (!createUserList(users, user))
+    {
+      fclose(fp);
+      return false;
+    }
+  }
+  return fclose(fp) == 0;
+}
+
+/**
+ * @brief Writes the registration of a vehicle, in the Portuguese 00-00-AA format and then AA-00-00
+ *
+ * @param registration Receives the registration
+ * @param number The number of the vehicle, below 2 * 100 * 100 * 26 * 26
+ */
+static void vehicleRegistration(char *registration, int number)
+{
+  int digits = number % 10000;
+  int letters = number / 10000 % 676;
+  if (number < 6760000)
+    sprintf(registration, "%02d-%02d-%c%c", digits / 100, digits % 100, 'A' + letters / 26, 'A' + letters % 26);
+  else
+    sprintf(registration, "%c%c-%02d-%02d", 'A' + letters / 26, 'A' + letters % 26, digits / 100, digits % 100);
+}
+
+/**
+ * @brief Generates the fleet and writes vehicles.txt
+ *
+ * @param directory The initial-data directory
+ * @param count The number of vehicles
+ * @param seed The seed
+ * @param cities The cities where the vehicles are parked
+ * @param cityCount The number of cities
+ * @param vehicles Receives the vehicle list, in the order readVehiclesFromTxt builds it
+ * @return True if the file was written, false otherwise
+ */
+static bool generateVehicles(char *directory, int count, unsigned long long seed, City *cities, int cityCount, VehicleList **vehicles)
+{
+  unsigned long long state = seed ^ 0x666c6565740aULL;
+  int hubs = cityCount / HUB_EVERY > 0 ? cityCount / HUB_EVERY : 1;
+  char path[PATH_SIZE];
+  FILE *fp = filePath(path, directory, "vehicles.txt") ? fopen(path, "w") : NULL;
+  if (fp == NULL)
+  {
+    perror("could not open file");
+    return false;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    Vehicle vehicle = {0};
+    double charge = randomUnit(&state);
+    bool scooter = randomBelow(&state, 3) < 2;
+    int city = randomBelow(&state, 10) < 7 ? randomBelow(&state, hubs) * HUB_EVERY % cityCount : randomBelow(&state, cityCount);
+
+    vehicleRegistration(vehicle.registration, i);
+    strcpy(vehicle.type, scooter ? "trotinete" : "bicicleta");
+    // charged overnight: most are full or close to it, some are half way, a few need the truck
+    vehicle.battery = charge < 0.7 ? 60 + randomBelow(&state, 41) : charge < 0.9 ? 20 + randomBelow(&state, 40) : randomBelow(&state, 20);
+    vehicle.cost = scooter ? 1 + randomBelow(&state, 2) : 1;
+    strcpy(vehicle.location, cities[city].vertex->city);
+
+    fprintf(fp, "%s;%s;%d;%d;%d;%s\n", vehicle.registration, vehicle.type, vehicle.battery, vehicle.cost,
+            vehicle.isInUse, vehicle.location);
+    if (!createVehicleList(vehicles, vehicle))
+    {
+      fclose(fp);
+      return false;
+    }
+  }
+  return fclose(fp) == 0;
+}
+
+/**
+ * @brief Creates a directory if it does not exist
+ *
+ * @param path The path of the directory
+ * @return True if the directory exists, false otherwise
+ */
+static bool makeDirectory(char *path)
+{
+  if (mkdir(path, 0755) != 0 && errno != EEXIST)
+  {
+    perror("could not create the directory");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  char *directory = argc > 1 ? argv[1] : "./generated";
+  int cityCount = argc > 2 ? atoi(argv[2]) : 1000;
+  double degree = argc > 3 ? atof(argv[3]) : 4;
+  int userCount = argc > 4 ? atoi(argv[4]) : 10000;
+  int vehicleCount = argc > 5 ? atoi(argv[5]) : 5000;
+  unsigned long long seed = argc > 6 ? strtoull(argv[6], NULL, 10) : 1;
+  char initialData[PATH_SIZE];
+  char savedData[PATH_SIZE];
+
+  if (cityCount < 2 || degree < 2 || degree > MAX_DEGREE || userCount < 0 || userCount >= 10000000 ||
+      vehicleCount < 0 || vehicleCount >= 2 * 6760000)
+  {
+    fprintf(stderr, "Usage: datagen [directory] [cities >= 2] [degree 2-%d] [users < 10^7] [vehicles < 13520000] [seed]\n",
+            MAX_DEGREE);
+    return 1;
+  }
+  if (!filePath(initialData, directory, "initial-data") || !filePath(savedData, directory, "saved-data") ||
+      !makeDirectory(directory) || !makeDirectory(initialData) || !makeDirectory(savedData))
+  {
+    return 1;
+  }
+
+  City *cities = (City *)malloc(cityCount * sizeof(City));
+  UserList *users = NULL;
+  VehicleList *vehicles = NULL;
+  long roads;
+  if (cities == NULL)
+  {
+    perror("could not allocate memory!");
+    return 1;
+  }
+
+  Vertex *graph = generateGraph(initialData, cityCount, degree, seed, cities, &roads);
+  if (graph == NULL || !generateUsers(initialData, userCount, seed, &users) ||
+      !generateVehicles(initialData, vehicleCount, seed, cities, cityCount, &vehicles))
+  {
+    return 1;
+  }
+
+  SnapshotReport report;
+  bool written = writeSnapshot(savedData, users, vehicles, NULL, graph, &report);
+  printf("%d cities, %ld roads (%.2f per city), %d users, %d vehicles, seed %llu\n", cityCount, roads,
+         (double)roads / cityCount, userCount, vehicleCount, seed);
+  printf("%s: %s, %d files, %.1f MB\n", savedData, written ? "written" : "FAILED", report.files, report.bytes / 1e6);
+  return written ? 0 : 1;
+}
@@ -0,0 +1,540 @@
+/**
+ * @file loadgen.c
+ * @brief Load generator for the server mode, reporting throughput and tail latency
+ *
+ * Opens [connections] connections to a running server and keeps [depth] requests in flight on each of them for
+ * [seconds], from one thread with epoll. The requests are a fixed mix of the operations of the protocol, weighted
+ * like a rental service (mostly vehicle and wallet lookups, then rents, returns and credits, a few radius and route
+ * queries, and now and then a new user or a vehicle moved to another city), over the users, vehicles and cities of
+ * saved-data, so it must run from the directory the server was started in. The latency of a request is the time from when it was written to the socket until its response
+ * arrived, so it includes the time it waited behind the other requests of its connection.
+ *
+ * At the end it prints, per operation and in total, the requests, how many were answered with ERR (a vehicle that
+ * was already rented, a wallet without funds), the throughput and the p50, p99, p99.9 and maximum latency.
+ *
+ * With a [commands] file every request is also written to it in the order it was queued, so the session can be run
+ * again with "my_program replay" against the same saved-data.
+ *
+ * Usage: loadgen [address] [connections] [depth] [seconds] [seed] [commands]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../models/server.h"
+
+#define REQUEST_SIZE 128
+#define INPUT_SIZE 65536
+#define NEAR_RADIUS 10
+#define DRAIN_SECONDS 5 // how long the responses still in flight are waited for after the run
+
+typedef enum OperationId
+{
+  OP_VEHICLE,
+  OP_WALLET,
+  OP_CREDIT,
+  OP_RENT,
+  OP_RETURN,
+  OP_NEAR,
+  OP_ROUTE,
+  OP_USER,
+  OP_MOVE,
+  OPERATIONS
+} OperationId;
+
+static const char *operationNames[OPERATIONS] = {"VEHICLE", "WALLET", "CREDIT", "RENT", "RETURN",
+                                                 "NEAR",    "ROUTE",  "USER",   "MOVE"};
+static const int operationWeights[OPERATIONS] = {34, 20, 10, 15, 10, 4, 5, 1, 1}; // out of 100
+
+typedef struct Samples
+{
+  int64_t *latencies; // ns
+  long count;
+  long capacity;
+  long refused;
+} Samples;
+
+typedef struct Pending
+{
+  OperationId operation;
+  int64_t sent; // ns
+} Pending;
+
+typedef struct Connection
+{
+  int fd;
+  bool writing; // EPOLLOUT is in the interest set
+  char *output;
+  int outputStart;
+  int outputLength;
+  char input[INPUT_SIZE];
+  int inputLength;
+  Pending *pending; // ring of the requests in flight, in the order they were sent
+  int head;
+  int count;
+} Connection;
+
+typedef struct Keys
+{
+  int *nifs;
+  int nifCount;
+  char (*registrations)[50];
+  char (*types)[50];
+  int vehicleCount;
+  int *cods;
+  int codCount;
+  int nextNif; // NIF of the next new user, above every NIF of saved-data
+} Keys;
+
+/**
+ * @brief Gets the current time in nanoseconds from a monotonic clock
+ *
+ * @return The current time in nanoseconds
+ */
+static int64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Gets the next number of a xorshift64* generator
+ *
+ * @param state The state of the generator, not 0
+ * @return The next number
+ */
+static unsigned long long nextRandom(unsigned long long *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+/**
+ * @brief Reads the NIFs, registrations and city cods of saved-data
+ *
+ * @param keys Receives the keys
+ * @return True if there is at least one of each, false otherwise
+ */
+static bool readKeys(Keys *keys)
+{
+  UserList *users = NULL;
+  VehicleList *vehicles = NULL;
+  Vertex *graph = createRoute();
+  bool res;
+  setUsersData(&users);
+  setVehiclesData(&vehicles);
+  graph = loadGraph(graph, GRAPH_FILE, &res);
+
+  memset(keys, 0, sizeof(Keys));
+  for (UserList *node = users; node != NULL; node = node->next)
+    keys->nifCount++;
+  for (VehicleList *node = vehicles; node != NULL; node = node->next)
+    keys->vehicleCount++;
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+    keys->codCount++;
+  if (keys->nifCount == 0 || keys->vehicleCount == 0 || keys->codCount == 0)
+  {
+    fprintf(stderr, "saved-data needs users, vehicles and cities\n");
+    return false;
+  }
+
+  keys->nifs = (int *)malloc(keys->nifCount * sizeof(int));
+  keys->registrations = malloc(keys->vehicleCount * sizeof(*keys->registrations));
+  keys->types = malloc(keys->vehicleCount * sizeof(*keys->types));
+  keys->cods = (int *)malloc(keys->codCount * sizeof(int));
+  if (keys->nifs == NULL || keys->registrations == NULL || keys->types == NULL || keys->cods == NULL)
+  {
+    perror("could not allocate memory!");
+    return false;
+  }
+  int i = 0;
+  for (UserList *node = users; node != NULL; node = node->next)
+  {
+    keys->nifs[i++] = node->user.nif;
+    if (node->user.nif >= keys->nextNif)
+      keys->nextNif = node->user.nif + 1;
+  }
+  i = 0;
+  for (VehicleList *node = vehicles; node != NULL; node = node->next, i++)
+  {
+    strcpy(keys->registrations[i], node->vehicle.registration);
+    strcpy(keys->types[i], node->vehicle.type);
+  }
+  i = 0;
+  for (Vertex *vertex = graph; vertex != NULL; vertex = vertex->next)
+    keys->cods[i++] = vertex->cod;
+  return true;
+}
+
+/**
+ * @brief Connects to the server
+ *
+ * @param address A port of the loopback address, or the path of a Unix domain socket
+ * @return The non-blocking socket, or -1 if it could not connect
+ */
+static int connectServer(char *address)
+{
+  char *end;
+  long port = strtol(address, &end, 10);
+  int fd;
+  if (end != address && *end == '\0')
+  {
+    struct sockaddr_in in = {0};
+    int noDelay = 1;
+    in.sin_family = AF_INET;
+    in.sin_port = htons((uint16_t)port);
+    in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&in, sizeof(in)) != 0)
+    {
+      perror("could not connect");
+      return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  }
+  else
+  {
+    struct sockaddr_un un = {0};
+    un.sun_family = AF_UNIX;
+    strncpy(un.sun_path, address, sizeof(un.sun_path) - 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&un, sizeof(un)) != 0)
+    {
+      perror("could not connect");
+      return -1;
+    }
+  }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  return fd;
+}
+
+/**
+ * @brief Writes a random request at the end of the output of a connection and remembers it as in flight
+ *
+ * @param connection A pointer to the connection
+ * @param depth The size of the ring of requests in flight
+ * @param keys The keys the requests are made of
+ * @param state The state of the random generator
+ * @param log The file every request is also written to, or NULL
+ */
+static void queueRequest(Connection *connection, int depth, Keys *keys, unsigned long long *state, FILE *log)
+{
+  int pick = (int)(nextRandom(state) % 100);
+  OperationId operation = 0;
+  while (pick >= operationWeights[operation])
+    pick -= operationWeights[operation++];
+
+  if (connection->outputStart > 0)
+  {
+    memmove(connection->output, connection->output + connection->outputStart, connection->outputLength);
+    connection->outputStart = 0;
+  }
+  char *request = connection->output + connection->outputLength;
+  int vehicle = (int)(nextRandom(state) % keys->vehicleCount);
+  int nif = keys->nifs[nextRandom(state) % keys->nifCount];
+  int cod = keys->cods[nextRandom(state) % keys->codCount];
+  int length = 0;
+  switch (operation)
+  {
+  case OP_VEHICLE:
+    length = sprintf(request, "VEHICLE %s\n", keys->registrations[vehicle]);
+    break;
+  case OP_WALLET:
+    length = sprintf(request, "WALLET %d\n", nif);
+    break;
+  case OP_CREDIT:
+    length = sprintf(request, "CREDIT %d %d\n", nif, (int)(nextRandom(state) % 20) + 1);
+    break;
+  case OP_RENT:
+    length = sprintf(request, "RENT %s %d %d\n", keys->registrations[vehicle], nif, (int)(nextRandom(state) % 60) + 1);
+    break;
+  case OP_RETURN:
+    length = sprintf(request, "RETURN %s\n", keys->registrations[vehicle]);
+    break;
+  case OP_NEAR:
+    length = sprintf(request, "NEAR %d %d %s\n", cod, NEAR_RADIUS, keys->types[vehicle]);
+    break;
+  case OP_ROUTE:
+    length = sprintf(request, "ROUTE %d %d\n", cod, keys->cods[nextRandom(state) % keys->codCount]);
+    break;
+  case OP_USER:
+    length = sprintf(request, "USER %d %d\n", keys->nextNif++, (int)(nextRandom(state) % 100));
+    break;
+  case OP_MOVE:
+    length = sprintf(request, "MOVE %s %d\n", keys->registrations[vehicle], cod);
+    break;
+  default:
+    break;
+  }
+  if (log != NULL)
+    fwrite(request, 1, length, log);
+  connection->outputLength += length;
+  Pending *pending = &connection->pending[(connection->head + connection->count++) % depth];
+  pending->operation = operation;
+  pending->sent = now();
+}
+
+/**
+ * @brief Sends the output of a connection until it is empty or the socket is full
+ *
+ * @param connection A pointer to the connection
+ * @return False if the connection failed, true otherwise
+ */
+static bool sendRequests(Connection *connection)
+{
+  while (connection->outputLength > 0)
+  {
+    ssize_t sent = send(connection->fd, connection->output + connection->outputStart, connection->outputLength,
+                        MSG_NOSIGNAL);
+    if (sent < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    connection->outputStart += (int)sent;
+    connection->outputLength -= (int)sent;
+  }
+  connection->outputStart = 0;
+  return true;
+}
+
+/**
+ * @brief Adds a latency to the samples of an operation
+ *
+ * @param samples A pointer to the samples
+ * @param latency The latency in ns
+ * @return False if there was no memory, true otherwise
+ */
+static bool addSample(Samples *samples, int64_t latency)
+{
+  if (samples->count == samples->capacity)
+  {
+    long capacity = samples->capacity == 0 ? 4096 : samples->capacity * 2;
+    int64_t *latencies = (int64_t *)realloc(samples->latencies, capacity * sizeof(int64_t));
+    if (latencies == NULL)
+    {
+      perror("could not allocate memory!");
+      return false;
+    }
+    samples->latencies = latencies;
+    samples->capacity = capacity;
+  }
+  samples->latencies[samples->count++] = latency;
+  return true;
+}
+
+/**
+ * @brief Reads the responses waiting on a connection and matches them with the requests in flight
+ *
+ * @param connection A pointer to the connection
+ * @param depth The size of the ring of requests in flight
+ * @param samples The samples of each operation
+ * @return False if the connection failed or was closed by the server, true otherwise
+ */
+static bool readResponses(Connection *connection, int depth, Samples *samples)
+{
+  ssize_t received = recv(connection->fd, connection->input + connection->inputLength,
+                          INPUT_SIZE - connection->inputLength, 0);
+  if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    return false;
+  if (received < 0)
+    return true;
+  connection->inputLength += (int)received;
+
+  int64_t arrived = now();
+  int start = 0;
+  char *end;
+  while ((end = memchr(connection->input + start, '\n', connection->inputLength - start)) != NULL)
+  {
+    if (connection->count == 0)
+    {
+      fprintf(stderr, "response without a request\n");
+      return false;
+    }
+    Pending *pending = &connection->pending[connection->head];
+    connection->head = (connection->head + 1) % depth;
+    connection->count--;
+    Samples *operation = &samples[pending->operation];
+    operation->refused += strncmp(connection->input + start, "ERR", 3) == 0;
+    if (!addSample(operation, arrived - pending->sent))
+      return false;
+    start = (int)(end - connection->input) + 1;
+  }
+  memmove(connection->input, connection->input + start, connection->inputLength - start);
+  connection->inputLength -= start;
+  return true;
+}
+
+/**
+ * @brief Compares two latencies for qsort
+ *
+ * @param a A pointer to the first latency
+ * @param b A pointer to the second latency
+ * @return Negative, zero or positive as a is smaller than, equal to or larger than b
+ */
+static int compareLatencies(const void *a, const void *b)
+{
+  int64_t x = *(const int64_t *)a;
+  int64_t y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Prints a line of the report
+ *
+ * @param name The name of the operation
+ * @param samples The samples, sorted
+ * @param seconds The duration of the run
+ */
+static void printReportLine(const char *name, Samples *samples, double seconds)
+{
+  if (samples->count == 0)
+  {
+    printf("%-10s %10d\n", name, 0);
+    return;
+  }
+  long last = samples->count - 1;
+  printf("%-10s %10ld %10ld %12.0f %10.1f %10.1f %10.1f %10.1f\n", name, samples->count, samples->refused,
+         samples->count / seconds, samples->latencies[(long)(last * 0.50)] / 1e3,
+         samples->latencies[(long)(last * 0.99)] / 1e3, samples->latencies[(long)(last * 0.999)] / 1e3,
+         samples->latencies[last] / 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+  char *address = argc > 1 ? argv[1] : SERVER_ADDRESS;
+  int connectionCount = argc > 2 ? atoi(argv[2]) : 16;
+  int depth = argc > 3 ? atoi(argv[3]) : 16;
+  double seconds = argc > 4 ? atof(argv[4]) : 10;
+  unsigned long long state = argc > 5 ? strtoull(argv[5], NULL, 10) : 42;
+  if (connectionCount < 1 || depth < 1 || seconds <= 0)
+  {
+    fprintf(stderr, "Usage: loadgen [address] [connections] [depth] [seconds] [seed] [commands]\n");
+    return 2;
+  }
+  FILE *log = NULL;
+  if (argc > 6)
+  {
+    log = fopen(argv[6], "w");
+    if (log == NULL)
+    {
+      perror("Could not open file");
+      return 2;
+    }
+  }
+  if (state == 0)
+    state = 42;
+
+  Keys keys;
+  if (!readKeys(&keys))
+    return 2;
+
+  int epollFd = epoll_create1(0);
+  Connection *connections = (Connection *)calloc(connectionCount, sizeof(Connection));
+  if (epollFd < 0 || connections == NULL)
+  {
+    perror("could not allocate memory!");
+    return 2;
+  }
+  for (int i = 0; i < connectionCount; i++)
+  {
+    Connection *connection = &connections[i];
+    connection->fd = connectServer(address);
+    connection->output = (char *)malloc(depth * REQUEST_SIZE);
+    connection->pending = (Pending *)malloc(depth * sizeof(Pending));
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+    if (connection->fd < 0 || connection->output == NULL || connection->pending == NULL ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, connection->fd, &event) != 0)
+      return 2;
+  }
+
+  Samples samples[OPERATIONS] = {0};
+  bool ok = true;
+  int64_t start = now();
+  int64_t deadline = start + (int64_t)(seconds * 1e9);
+  int64_t finish = start;
+  while (ok)
+  {
+    int64_t current = now();
+    bool issuing = current < deadline;
+    int inFlight = 0;
+    for (int i = 0; i < connectionCount && ok; i++)
+    {
+      Connection *connection = &connections[i];
+      while (issuing && connection->count < depth)
+        queueRequest(connection, depth, &keys, &state, log);
+      ok = sendRequests(connection);
+      bool writing = connection->outputLength > 0;
+      if (writing != connection->writing)
+      {
+        struct epoll_event event = {.events = EPOLLIN | (writing ? EPOLLOUT : 0), .data.ptr = connection};
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->writing = writing;
+      }
+      inFlight += connection->count;
+    }
+    if (!issuing && inFlight == 0)
+      break;
+    if (!issuing && current > deadline + (int64_t)DRAIN_SECONDS * 1000000000)
+    {
+      fprintf(stderr, "%d requests still without a response\n", inFlight);
+      ok = false;
+      break;
+    }
+
+    struct epoll_event events[SERVER_EVENTS];
+    int count = epoll_wait(epollFd, events, SERVER_EVENTS, 100);
+    for (int i = 0; i < count && ok; i++)
+    {
+      Connection *connection = (Connection *)events[i].data.ptr;
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        ok = readResponses(connection, depth, samples);
+      if (ok && (events[i].events & EPOLLOUT))
+        ok = sendRequests(connection);
+    }
+    finish = now();
+  }
+  if (!ok)
+    fprintf(stderr, "the run stopped early, a connection failed\n");
+
+  double elapsed = (finish - start) / 1e9;
+  Samples total = {0};
+  for (int op = 0; op < OPERATIONS; op++)
+  {
+    total.refused += samples[op].refused;
+    for (long i = 0; i < samples[op].count; i++)
+      addSample(&total, samples[op].latencies[i]);
+    qsort(samples[op].latencies, samples[op].count, sizeof(int64_t), compareLatencies);
+  }
+  qsort(total.latencies, total.count, sizeof(int64_t), compareLatencies);
+
+  printf("address %s  connections %d  depth %d  seconds %.2f\n\n", address, connectionCount, depth, elapsed);
+  printf("%-10s %10s %10s %12s %10s %10s %10s %10s\n", "operation", "requests", "refused", "per second", "p50 us",
+         "p99 us", "p99.9 us", "max us");
+  for (int op = 0; op < OPERATIONS; op++)
+    printReportLine(operationNames[op], &samples[op], elapsed);
+  printReportLine("total", &total, elapsed);
+
+  for (int i = 0; i < connectionCount; i++)
+    close(connections[i].fd);
+  if (log != NULL && fclose(log) != 0)
+  {
+    perror("could not write the commands");
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,472 @@
+/**
+ * @file regress.c
+ * @brief Performance regression check of the models against a stored baseline
+ *
+ * Runs suite_bench [runs] times and takes, for every operation and size, the median latency of each run. The
+ * medians of the runs are summarised by their own median and a 95% bootstrap confidence interval of it, so one slow
+ * run moves neither. "update" writes the summary as the baseline JSON, with the suite parameters it was taken with.
+ * "check" runs the suite with the parameters of the baseline and prints a table of both medians, their intervals
+ * and the change. An operation regressed when it is more than [threshold] percent slower and its interval lies
+ * entirely above the one of the baseline, so noise inside the intervals is not reported. Any regression makes the
+ * check fail with exit code 1.
+ *
+ * The baseline holds times of the machine it was taken on, so it is compared with runs on that same machine and
+ * taken again, with "update", when the machine or the suite changes.
+ *
+ * Usage: regress check [baseline] [runs] [threshold percent] [suite binary]
+ *        regress update [baseline] [runs] [max records] [budget seconds] [max samples] [suite binary]
+ *
+ * @author João Pereira
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MAX_RUNS 64
+#define MAX_ENTRIES 1024
+#define NAME_SIZE 64
+#define LINE_SIZE 1024
+#define RESAMPLES 2000
+#define SEED 42
+
+typedef struct Entry
+{
+  char group[NAME_SIZE];
+  char operation[NAME_SIZE];
+  long records;
+  double runs[MAX_RUNS]; // median latency of each run, in ns
+  int runCount;
+  double median; // median of the runs and its 95% confidence interval, in ns
+  double low;
+  double high;
+} Entry;
+
+typedef struct Summary
+{
+  Entry *entries;
+  int count;
+  long maxRecords;
+  double budget;
+  long maxSamples;
+  int runs;
+} Summary;
+
+/**
+ * @brief Finds the value of a key in a JSON line written by suite_bench or by this program
+ *
+ * @param line The line
+ * @param key The key, without quotes
+ * @return A pointer to the first character of the value, or NULL if the key is not in the line
+ */
+static const char *findValue(const char *line, const char *key)
+{
+  char quoted[NAME_SIZE + 4];
+  snprintf(quoted, sizeof(quoted), "\"%s\":", key);
+  const char *found = strstr(line, quoted);
+  if (found == NULL)
+    return NULL;
+  found += strlen(quoted);
+  while (*found == ' ')
+    found++;
+  return found;
+}
+
+/**
+ * @brief Reads a string value of a JSON line
+ *
+ * @param line The line
+ * @param key The key
+ * @param value Receives the string, NAME_SIZE bytes
+ * @return True if the key holds a string, false otherwise
+ */
+static bool readString(const char *line, const char *key, char *value)
+{
+  const char *found = findValue(line, key);
+  if (found == NULL || *found != '"')
+    return false;
+  found++;
+  int length = 0;
+  while (found[length] != '"' && found[length] != '\0' && length < NAME_SIZE - 1)
+  {
+    value[length] = found[length];
+    length++;
+  }
+  value[length] = '\0';
+  return found[length] == '"';
+}
+
+/**
+ * @brief Reads a number value of a JSON line
+ *
+ * @param line The line
+ * @param key The key
+ * @param value Receives the number
+ * @return True if the key holds a number, false otherwise
+ */
+static bool readNumber(const char *line, const char *key, double *value)
+{
+  const char *found = findValue(line, key);
+  char *end;
+  if (found == NULL)
+    return false;
+  *value = strtod(found, &end);
+  return end != found;
+}
+
+/**
+ * @brief Finds the entry of an operation and size, adding it if it is not there
+ *
+ * @param summary A pointer to the summary
+ * @param group The group of the operation
+ * @param operation The operation
+ * @param records The size
+ * @return A pointer to the entry, or NULL if the summary is full
+ */
+static Entry *findEntry(Summary *summary, const char *group, const char *operation, long records)
+{
+  for (int i = 0; i < summary->count; i++)
+  {
+    Entry *entry = &summary->entries[i];
+    if (entry->records == records && strcmp(entry->operation, operation) == 0 && strcmp(entry->group, group) == 0)
+      return entry;
+  }
+  if (summary->count == MAX_ENTRIES)
+    return NULL;
+  Entry *entry = &summary->entries[summary->count++];
+  memset(entry, 0, sizeof(Entry));
+  strcpy(entry->group, group);
+  strcpy(entry->operation, operation);
+  entry->records = records;
+  return entry;
+}
+
+/**
+ * @brief Runs suite_bench once and adds the median latency of every operation it timed to the summary
+ *
+ * @param summary A pointer to the summary, holding the suite parameters
+ * @param suite The path of the suite_bench binary
+ * @return True if the suite ran and its report was read, false otherwise
+ */
+static bool runSuite(Summary *summary, char *suite)
+{
+  char maxRecords[32], budget[32], maxSamples[32];
+  snprintf(maxRecords, sizeof(maxRecords), "%ld", summary->maxRecords);
+  snprintf(budget, sizeof(budget), "%g", summary->budget);
+  snprintf(maxSamples, sizeof(maxSamples), "%ld", summary->maxSamples);
+  FILE *report = tmpfile();
+  if (report == NULL)
+  {
+    perror("could not open file");
+    return false;
+  }
+
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    dup2(fileno(report), STDOUT_FILENO);
+    execl(suite, suite, maxRecords, budget, maxSamples, (char *)NULL);
+    perror("could not run the suite");
+    _exit(127);
+  }
+  int status;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    fprintf(stderr, "%s did not finish\n", suite);
+    fclose(report);
+    return false;
+  }
+
+  char line[LINE_SIZE];
+  int results = 0;
+  rewind(report);
+  while (fgets(line, sizeof(line), report) != NULL)
+  {
+    char group[NAME_SIZE], operation[NAME_SIZE];
+    double records, p50;
+    if (!readString(line, "group", group) || !readString(line, "operation", operation) ||
+        !readNumber(line, "records", &records) || !readNumber(line, "p50_ns", &p50))
+      continue; // not a result, or a skipped operation
+    Entry *entry = findEntry(summary, group, operation, (long)records);
+    if (entry != NULL && entry->runCount < MAX_RUNS)
+      entry->runs[entry->runCount++] = p50;
+    results++;
+  }
+  fclose(report);
+  return results > 0;
+}
+
+/**
+ * @brief Compares two doubles for qsort
+ *
+ * @param a A pointer to a double
+ * @param b A pointer to the other double
+ * @return Negative, zero or positive as a is below, equal to or above b
+ */
+static int compareDoubles(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Gets the median of some values
+ *
+ * @param values The values, they are sorted
+ * @param count The number of values
+ * @return The median
+ */
+static double median(double *values, int count)
+{
+  qsort(values, count, sizeof(double), compareDoubles);
+  return count % 2 == 1 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+/**
+ * @brief xorshift64 pseudo random generator, the intervals are the same for the same runs
+ *
+ * @param state A pointer to the generator state
+ * @return The next pseudo random number
+ */
+static unsigned long long nextRandom(unsigned long long *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/**
+ * @brief Computes the median of the runs of an entry and its 95% bootstrap confidence interval
+ *
+ * @param entry A pointer to the entry
+ */
+static void summarise(Entry *entry)
+{
+  double sample[MAX_RUNS];
+  double medians[RESAMPLES];
+  unsigned long long state = SEED;
+  int count = entry->runCount;
+
+  memcpy(sample, entry->runs, count * sizeof(double));
+  entry->median = median(sample, count);
+  for (int r = 0; r < RESAMPLES; r++)
+  {
+    for (int i = 0; i < count; i++)
+      sample[i] = entry->runs[nextRandom(&state) % count];
+    medians[r] = median(sample, count);
+  }
+  qsort(medians, RESAMPLES, sizeof(double), compareDoubles);
+  entry->low = medians[(int)(RESAMPLES * 0.025)];
+  entry->high = medians[(int)(RESAMPLES * 0.975) - 1];
+}
+
+/**
+ * @brief Runs the suite a number of times and summarises every operation
+ *
+ * @param summary A pointer to the summary, holding the suite parameters and the number of runs
+ * @param suite The path of the suite_bench binary
+ * @return True if every run finished, false otherwise
+ */
+static bool measure(Summary *summary, char *suite)
+{
+  for (int run = 0; run < summary->runs; run++)
+  {
+    fprintf(stderr, "run %d of %d\n", run + 1, summary->runs);
+    if (!runSuite(summary, suite))
+      return false;
+  }
+  for (int i = 0; i < summary->count; i++)
+    summarise(&summary->entries[i]);
+  return true;
+}
+
+/**
+ * @brief Writes a summary as a baseline JSON file
+ *
+ * @param summary A pointer to the summary
+ * @param fileName The path of the file
+ * @return True if the file was written, false otherwise
+ */
+static bool writeBaseline(Summary *summary, char *fileName)
+{
+  FILE *fp = fopen(fileName, "w");
+  if (fp == NULL)
+  {
+    perror("could not open file");
+    return false;
+  }
+  fprintf(fp, "{\n  \"benchmark\": \"suite_bench\",\n  \"max_records\": %ld,\n  \"budget_seconds\": %g,\n"
+              "  \"max_samples\": %ld,\n  \"runs\": %d,\n  \"results\": [",
+          summary->maxRecords, summary->budget, summary->maxSamples, summary->runs);
+  for (int i = 0; i < summary->count; i++)
+  {
+    Entry *entry = &summary->entries[i];
+    fprintf(fp, "%s\n    {\"group\": \"%s\", \"operation\": \"%s\", \"records\": %ld, \"p50_ns\": %.1f, "
+                "\"ci_low_ns\": %.1f, \"ci_high_ns\": %.1f}",
+            i == 0 ? "" : ",", entry->group, entry->operation, entry->records, entry->median, entry->low, entry->high);
+  }
+  fprintf(fp, "\n  ]\n}\n");
+  return fclose(fp) == 0;
+}
+
+/**
+ * @brief Reads a baseline JSON file
+ *
+ * @param summary Receives the suite parameters and the summarised operations
+ * @param fileName The path of the file
+ * @return True if the file was read, false otherwise
+ */
+static bool readBaseline(Summary *summary, char *fileName)
+{
+  FILE *fp = fopen(fileName, "r");
+  char line[LINE_SIZE];
+  double value;
+  if (fp == NULL)
+  {
+    perror("could not open the baseline");
+    return false;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    char group[NAME_SIZE], operation[NAME_SIZE];
+    double records;
+    if (readNumber(line, "max_records", &value))
+      summary->maxRecords = (long)value;
+    else if (readNumber(line, "budget_seconds", &value))
+      summary->budget = value;
+    else if (readNumber(line, "max_samples", &value))
+      summary->maxSamples = (long)value;
+    else if (readString(line, "group", group) && readString(line, "operation", operation) &&
+             readNumber(line, "records", &records))
+    {
+      Entry *entry = findEntry(summary, group, operation, (long)records);
+      if (entry == NULL || !readNumber(line, "p50_ns", &entry->median) ||
+          !readNumber(line, "ci_low_ns", &entry->low) || !readNumber(line, "ci_high_ns", &entry->high))
+      {
+        fclose(fp);
+        return false;
+      }
+    }
+  }
+  fclose(fp);
+  return summary->maxRecords > 0 && summary->budget > 0 && summary->maxSamples > 0 && summary->count > 0;
+}
+
+/**
+ * @brief Compares a run with the baseline and prints the table of changes
+ *
+ * @param baseline A pointer to the baseline
+ * @param current A pointer to the summary of the runs
+ * @param threshold The largest slowdown allowed, as a fraction
+ * @return The number of operations that regressed
+ */
+static int compare(Summary *baseline, Summary *current, double threshold)
+{
+  int regressions = 0;
+  printf("%-10s %-28s %9s %28s %28s %9s  %s\n", "group", "operation", "records", "baseline p50 ns [95% CI]",
+         "current p50 ns [95% CI]", "change", "status");
+  for (int i = 0; i < current->count; i++)
+  {
+    Entry *now = &current->entries[i];
+    Entry *before = NULL;
+    for (int j = 0; j < baseline->count && before == NULL; j++)
+    {
+      Entry *entry = &baseline->entries[j];
+      if (entry->records == now->records && strcmp(entry->operation, now->operation) == 0 &&
+          strcmp(entry->group, now->group) == 0)
+        before = entry;
+    }
+
+    char currentText[64], baselineText[64];
+    snprintf(currentText, sizeof(currentText), "%.0f [%.0f, %.0f]", now->median, now->low, now->high);
+    if (before == NULL)
+    {
+      printf("%-10s %-28s %9ld %28s %28s %9s  %s\n", now->group, now->operation, now->records, "-", currentText, "-",
+             "new");
+      continue;
+    }
+    before->runCount = -1; // matched
+    snprintf(baselineText, sizeof(baselineText), "%.0f [%.0f, %.0f]", before->median, before->low, before->high);
+    double change = before->median > 0 ? now->median / before->median - 1 : 0;
+    const char *status = "ok";
+    if (change > threshold && now->low > before->high)
+    {
+      status = "REGRESSED";
+      regressions++;
+    }
+    else if (change < -threshold && now->high < before->low)
+    {
+      status = "faster";
+    }
+    printf("%-10s %-28s %9ld %28s %28s %+8.1f%%  %s\n", now->group, now->operation, now->records, baselineText,
+           currentText, change * 100, status);
+  }
+  for (int j = 0; j < baseline->count; j++)
+  {
+    Entry *entry = &baseline->entries[j];
+    if (entry->runCount != -1)
+      printf("%-10s %-28s %9ld %28s %28s %9s  %s\n", entry->group, entry->operation, entry->records, "-", "-", "-",
+             "missing");
+  }
+  return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+  char *mode = argc > 1 ? argv[1] : "check";
+  char *baselineFile = argc > 2 ? argv[2] : "benchmarks/baseline.json";
+  bool update = strcmp(mode, "update") == 0;
+  Summary current = {0};
+  Summary baseline = {0};
+  current.runs = argc > 3 ? atoi(argv[3]) : 5;
+  current.entries = (Entry *)calloc(MAX_ENTRIES, sizeof(Entry));
+  baseline.entries = (Entry *)calloc(MAX_ENTRIES, sizeof(Entry));
+  if (current.entries == NULL || baseline.entries == NULL)
+  {
+    perror("could not allocate memory!");
+    return 2;
+  }
+  if ((!update && strcmp(mode, "check") != 0) || current.runs < 1 || current.runs > MAX_RUNS)
+  {
+    fprintf(stderr, "Usage: regress check [baseline] [runs 1-%d] [threshold percent] [suite binary]\n"
+                    "       regress update [baseline] [runs 1-%d] [max records] [budget seconds] [max samples] "
+                    "[suite binary]\n",
+            MAX_RUNS, MAX_RUNS);
+    return 2;
+  }
+
+  if (update)
+  {
+    current.maxRecords = argc > 4 ? atol(argv[4]) : 10000;
+    current.budget = argc > 5 ? atof(argv[5]) : 0.05;
+    current.maxSamples = argc > 6 ? atol(argv[6]) : 100000;
+    char *suite = argc > 7 ? argv[7] : "./suite_bench";
+    if (!measure(&current, suite) || !writeBaseline(&current, baselineFile))
+      return 2;
+    printf("%d operations written to %s\n", current.count, baselineFile);
+    return 0;
+  }
+
+  double threshold = (argc > 4 ? atof(argv[4]) : 10) / 100;
+  char *suite = argc > 5 ? argv[5] : "./suite_bench";
+  if (!readBaseline(&baseline, baselineFile))
+  {
+    fprintf(stderr, "%s is not a baseline written by regress update\n", baselineFile);
+    return 2;
+  }
+  current.maxRecords = baseline.maxRecords;
+  current.budget = baseline.budget;
+  current.maxSamples = baseline.maxSamples;
+  if (!measure(&current, suite))
+    return 2;
+  int regressions = compare(&baseline, &current, threshold);
+  printf("\n%d of %d operations regressed by more than %.0f%%: %s\n", regressions, current.count, threshold * 100,
+         regressions == 0 ? "OK" : "FAILED");
+  return regressions == 0 ? 0 : 1;
+}